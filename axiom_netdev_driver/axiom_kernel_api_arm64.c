@@ -14,7 +14,11 @@
 #include <linux/io.h>
 #include <linux/types.h>
 #include <linux/vmalloc.h>
+#include <linux/spinlock.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
 #include <linux/wait.h>
+#include <linux/timex.h>
 
 #include "axiom_nic_regs.h"
 #include "axiom_nic_regs_arm64.h"
@@ -24,21 +28,371 @@
 
 extern int verbose;
 
+/*! \brief bytes in a location of the FIFOs (the AXI4 data port is 64 bit) */
+#define AXIOM_FIFO_WORD_SIZE            8
+
+/*! \brief packets queued for the DMA on each TX FIFO */
+#define AXIOM_FIFO_DMA_SLOTS            64
+/*! \brief default of the fifo_dma_min module parameter */
+#define AXIOM_FIFO_DMA_MIN_DEF          64
+/*! \brief bytes of the AXI4 TX data port address range */
+#define AXIOM_FIFO_DMA_PORT_SIZE        \
+    (XLLF_AXI4_RDFD_OFFSET - XLLF_AXI4_TDFD_OFFSET)
+
+/*! \brief burst transfer module parameter */
+static bool fifo_burst = true;
+module_param(fifo_burst, bool, 0644);
+MODULE_PARM_DESC(fifo_burst, "use burst transfers on the AXI4 FIFO data ports");
+
+/*! \brief smallest packet moved by the DMA module parameter */
+static unsigned int fifo_dma_min = AXIOM_FIFO_DMA_MIN_DEF;
+module_param(fifo_dma_min, uint, 0644);
+MODULE_PARM_DESC(fifo_dma_min, "smaller TX packets (bytes) are written with "
+        "PIO also if the FIFO has a DMA channel");
+
+#ifdef AXIOM_HW_PROFILE
+/*! \brief cycles spent to move packets through a FIFO */
+typedef struct axiom_hw_prof {
+    uint64_t cycles;            /*!< \brief total cycles */
+    uint64_t packets;           /*!< \brief packets moved */
+} axiom_hw_prof_t;
+
+#define AXIOM_HW_PROF_START(_start)                                     \
+    cycles_t _start = get_cycles()
+#define AXIOM_HW_PROF_END(_prof, _start)                                \
+    do {                                                                \
+        (_prof)->cycles += get_cycles() - (_start);                     \
+        (_prof)->packets++;                                             \
+    } while (0)
+#else /* !AXIOM_HW_PROFILE */
+#define AXIOM_HW_PROF_START(_start)
+#define AXIOM_HW_PROF_END(_prof, _start)
+#endif /* AXIOM_HW_PROFILE */
+
+/*!
+ * \brief Shadow of the vacancy (TX) or occupancy (RX) register of a FIFO
+ *
+ * The credit is the number of locations that are surely free (TX) or used
+ * (RX) in the FIFO: it is decremented when a packet is moved and the register
+ * is read again only when the credit runs out. The lock serializes the credit
+ * updates with the FIFO accesses, so a refresh never overwrites the credit
+ * consumed by a concurrent packet.
+ */
+typedef struct axiom_fifo_credit {
+    spinlock_t lock;            /*!< \brief credit and FIFO data lock */
+    uint32_t credit;            /*!< \brief locations not yet consumed */
+    bool tx;                    /*!< \brief TX (vacancy) or RX (occupancy) */
+    /*! \brief TX locations queued for the DMA and not yet in the FIFO */
+    uint32_t pending;
+} axiom_fifo_credit_t;
+
+/*!
+ * \brief DMA engine transfers to a TX FIFO
+ *
+ * Packets are copied in a coherent ring and moved to the AXI4 data port by a
+ * memcpy capable DMA channel, so the CPU only handles the completions.
+ * The length register of a packet must be written after its data and before
+ * the data of the next packet, so the packets can't be batched in a single
+ * transfer: there is one transfer at a time and the completion callback
+ * writes the length and starts the next one. For small packets (e.g. the RDMA
+ * descriptors) the copy, the transfer setup and the completion cost more than
+ * the PIO write, so the packets smaller than fifo_dma_min are written by the
+ * CPU when no transfer is queued.
+ * The ring is protected by the lock of the FIFO credit.
+ */
+typedef struct axiom_fifo_dma {
+    struct dma_chan *chan;      /*!< \brief DMA channel, NULL to use PIO */
+    axi_fifo_t *fifo;           /*!< \brief TX FIFO */
+    axiom_fifo_credit_t *credit;/*!< \brief shadow credit of the FIFO */
+    dma_addr_t port;            /*!< \brief DMA address of the data port */
+    void *ring;                 /*!< \brief packets to transfer */
+    dma_addr_t ring_dma;        /*!< \brief DMA address of the ring */
+    size_t slot_size;           /*!< \brief bytes of each ring slot */
+    /*! \brief bytes of the packet in each ring slot */
+    uint32_t len[AXIOM_FIFO_DMA_SLOTS];
+    unsigned int head;          /*!< \brief next slot to fill */
+    unsigned int tail;          /*!< \brief next slot to transfer */
+    bool busy;                  /*!< \brief a transfer is in progress */
+} axiom_fifo_dma_t;
+
 /*! \brief AXIOM HW device status */
 typedef struct axiom_dev {
     axiom_dev_regs_t regs; /*!< \brief Memory mapped IO registers */
     axiom_msg_id_t next_raw_id;
+    axiom_fifo_credit_t raw_tx_credit;  /*!< \brief RAW TX shadow credit */
+    axiom_fifo_credit_t raw_rx_credit;  /*!< \brief RAW RX shadow credit */
+    axiom_fifo_credit_t rdma_tx_credit; /*!< \brief RDMA TX shadow credit */
+    axiom_fifo_credit_t rdma_rx_credit; /*!< \brief RDMA RX shadow credit */
+    axiom_fifo_dma_t raw_tx_dma;        /*!< \brief RAW TX DMA */
+    axiom_fifo_dma_t rdma_tx_dma;       /*!< \brief RDMA TX DMA */
+#ifdef AXIOM_HW_PROFILE
+    axiom_hw_prof_t prof_raw_tx;        /*!< \brief RAW TX profiling */
+    axiom_hw_prof_t prof_raw_rx;        /*!< \brief RAW RX profiling */
+#endif
 } axiom_dev_t;
 
+inline static void
+axiom_fifo_credit_init(axiom_fifo_credit_t *c, bool tx)
+{
+    spin_lock_init(&c->lock);
+    c->credit = 0;
+    c->tx = tx;
+    c->pending = 0;
+}
+
+/* re-read the register if the credit is less than 'words' (lock held) */
+inline static uint32_t
+axiom_fifo_credit_refill(axiom_fifo_credit_t *c, axi_fifo_t *fifo,
+        uint32_t words)
+{
+    if (c->credit < words && c->tx) {
+        uint32_t vacancy = axi_fifo_tx_vacancy(fifo);
+
+        /* the space of the packets queued for the DMA is already taken */
+        c->credit = (vacancy > c->pending) ? vacancy - c->pending : 0;
+    } else if (c->credit < words) {
+        c->credit = axi_fifo_rx_occupancy(fifo);
+    }
+
+    return c->credit;
+}
+
+/* consume 'words' locations (lock held) */
+inline static void
+axiom_fifo_credit_consume(axiom_fifo_credit_t *c, uint32_t words)
+{
+    c->credit = (c->credit > words) ? c->credit - words : 0;
+}
+
+inline static axiom_queue_len_t
+axiom_fifo_credit_avail(axiom_fifo_credit_t *c, axi_fifo_t *fifo)
+{
+    unsigned long flags;
+    uint32_t credit;
+
+    spin_lock_irqsave(&c->lock, flags);
+    credit = axiom_fifo_credit_refill(c, fifo, 1);
+    spin_unlock_irqrestore(&c->lock, flags);
+
+    return credit;
+}
+
+inline static bool
+axiom_fifo_dma_full(axiom_fifo_dma_t *d)
+{
+    return d->chan && (d->head - d->tail) == AXIOM_FIFO_DMA_SLOTS;
+}
+
+/*
+ * Wait until the TX FIFO (and the DMA ring, if used) has room for 'words'
+ * locations and take them.
+ * Returns with the credit lock held: the caller writes the packet and
+ * releases it.
+ */
+inline static void
+axiom_fifo_tx_reserve(axiom_fifo_credit_t *c, axi_fifo_t *fifo,
+        axiom_fifo_dma_t *d, uint32_t words, unsigned long *flags)
+{
+    spin_lock_irqsave(&c->lock, *flags);
+    while (axiom_fifo_credit_refill(c, fifo, words) < words ||
+            axiom_fifo_dma_full(d)) {
+        spin_unlock_irqrestore(&c->lock, *flags);
+        schedule();
+        spin_lock_irqsave(&c->lock, *flags);
+    }
+
+    axiom_fifo_credit_consume(c, words);
+}
+
+inline static bool
+axiom_fifo_burst(axi_fifo_t *fifo)
+{
+    /* the AXI4-Lite data interface does not support bursts */
+    return fifo_burst && fifo->axi4;
+}
+
+/* write a packet in the TX FIFO with the CPU */
+inline static void
+axiom_fifo_pio_write(axi_fifo_t *fifo, const void *buf, uint32_t bytes)
+{
+    int i, words = bytes / AXIOM_FIFO_WORD_SIZE;
+
+    if (axiom_fifo_burst(fifo)) {
+        axi_fifo_write64_burst(fifo, buf, words);
+    } else {
+        for (i = 0; i < words; i++) {
+            axi_fifo_write64(fifo, ((uint64_t *)buf)[i]);
+        }
+    }
+
+    /* write the total length */
+    axi_fifo_tx_setlen(fifo, bytes);
+}
+
+static void axiom_fifo_dma_callback(void *data);
+
+/* start the transfer of the oldest packet in the ring (credit lock held) */
+static void
+axiom_fifo_dma_start(axiom_fifo_dma_t *d)
+{
+    while (d->tail != d->head) {
+        unsigned int slot = d->tail % AXIOM_FIFO_DMA_SLOTS;
+        struct dma_async_tx_descriptor *desc;
+
+        desc = dmaengine_prep_dma_memcpy(d->chan, d->port,
+                d->ring_dma + slot * d->slot_size, d->len[slot],
+                DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+        if (likely(desc)) {
+            desc->callback = axiom_fifo_dma_callback;
+            desc->callback_param = d;
+            dmaengine_submit(desc);
+            dma_async_issue_pending(d->chan);
+            d->busy = true;
+            return;
+        }
+
+        /* no DMA descriptors available: move the packet with the CPU */
+        axiom_fifo_pio_write(d->fifo, d->ring + slot * d->slot_size,
+                d->len[slot]);
+        d->credit->pending -= d->len[slot] / AXIOM_FIFO_WORD_SIZE;
+        d->tail++;
+    }
+}
+
+static void
+axiom_fifo_dma_callback(void *data)
+{
+    axiom_fifo_dma_t *d = data;
+    unsigned int slot = d->tail % AXIOM_FIFO_DMA_SLOTS;
+    unsigned long flags;
+
+    spin_lock_irqsave(&d->credit->lock, flags);
+
+    /* the data of the packet is in the FIFO: write its length */
+    axi_fifo_tx_setlen(d->fifo, d->len[slot]);
+    d->credit->pending -= d->len[slot] / AXIOM_FIFO_WORD_SIZE;
+    d->tail++;
+    d->busy = false;
+
+    axiom_fifo_dma_start(d);
+
+    spin_unlock_irqrestore(&d->credit->lock, flags);
+}
+
+/* queue a packet in the DMA ring (credit lock held, ring not full) */
+inline static void
+axiom_fifo_dma_queue(axiom_fifo_dma_t *d, const void *buf, uint32_t bytes)
+{
+    unsigned int slot = d->head % AXIOM_FIFO_DMA_SLOTS;
+
+    memcpy(d->ring + slot * d->slot_size, buf, bytes);
+    d->len[slot] = bytes;
+    d->credit->pending += bytes / AXIOM_FIFO_WORD_SIZE;
+    d->head++;
+
+    if (!d->busy)
+        axiom_fifo_dma_start(d);
+}
+
+/*
+ * Move a packet to the TX FIFO, through the DMA if available and the packet
+ * is not small (lock held). The packets queued for the DMA go first, so a
+ * small one is queued behind them to keep the order.
+ */
+inline static void
+axiom_fifo_tx_push(axiom_fifo_dma_t *d, const void *buf, uint32_t bytes)
+{
+    if (d->chan && (bytes >= READ_ONCE(fifo_dma_min) || d->tail != d->head))
+        axiom_fifo_dma_queue(d, buf, bytes);
+    else
+        axiom_fifo_pio_write(d->fifo, buf, bytes);
+}
+
+static int
+axiom_fifo_dma_init(axiom_fifo_dma_t *d, axi_fifo_t *fifo,
+        axiom_fifo_credit_t *credit, size_t slot_size)
+{
+    struct device *dma_dev;
+
+    d->fifo = fifo;
+    d->credit = credit;
+    d->chan = NULL;
+
+    /* DMA channel not available for this FIFO: use PIO */
+    if (fifo->dma_chan == NULL)
+        return 0;
+
+    dma_dev = fifo->dma_chan->device->dev;
+    d->slot_size = ALIGN(slot_size, AXIOM_FIFO_WORD_SIZE);
+
+    d->ring = dma_alloc_coherent(dma_dev,
+            d->slot_size * AXIOM_FIFO_DMA_SLOTS, &d->ring_dma, GFP_KERNEL);
+    if (d->ring == NULL)
+        return -ENOMEM;
+
+    d->port = dma_map_resource(dma_dev,
+            fifo->axi4_paddr + XLLF_AXI4_TDFD_OFFSET,
+            AXIOM_FIFO_DMA_PORT_SIZE, DMA_TO_DEVICE, 0);
+    if (dma_mapping_error(dma_dev, d->port)) {
+        dma_free_coherent(dma_dev, d->slot_size * AXIOM_FIFO_DMA_SLOTS,
+                d->ring, d->ring_dma);
+        return -EIO;
+    }
+
+    d->head = d->tail = 0;
+    d->busy = false;
+    d->chan = fifo->dma_chan;
+
+    return 0;
+}
+
+static void
+axiom_fifo_dma_release(axiom_fifo_dma_t *d)
+{
+    struct device *dma_dev;
+
+    if (d->chan == NULL)
+        return;
+
+    dma_dev = d->chan->device->dev;
+
+    dmaengine_terminate_sync(d->chan);
+    dma_unmap_resource(dma_dev, d->port, AXIOM_FIFO_DMA_PORT_SIZE,
+            DMA_TO_DEVICE, 0);
+    dma_free_coherent(dma_dev, d->slot_size * AXIOM_FIFO_DMA_SLOTS,
+            d->ring, d->ring_dma);
+    d->chan = NULL;
+}
 
 axiom_dev_t *
 axiom_hw_dev_alloc(axiom_dev_regs_t *regs)
 {
     axiom_dev_t *dev;
 
-    dev = vmalloc(sizeof(*dev));
+    dev = vzalloc(sizeof(*dev));
+    if (dev == NULL)
+        return NULL;
+
     dev->regs = *regs;
     dev->next_raw_id = 0;
+    axiom_fifo_credit_init(&dev->raw_tx_credit, true);
+    axiom_fifo_credit_init(&dev->raw_rx_credit, false);
+    axiom_fifo_credit_init(&dev->rdma_tx_credit, true);
+    axiom_fifo_credit_init(&dev->rdma_rx_credit, false);
+
+    if (axiom_fifo_dma_init(&dev->raw_tx_dma, &dev->regs.axi.fifo_raw_tx,
+                &dev->raw_tx_credit, sizeof(axiom_raw_msg_t))) {
+        EPRINTF("RAW TX DMA init failed - use PIO");
+    }
+
+    if (axiom_fifo_dma_init(&dev->rdma_tx_dma, &dev->regs.axi.fifo_rdma_tx,
+                &dev->rdma_tx_credit, sizeof(axiom_rdma_hdr_t))) {
+        EPRINTF("RDMA TX DMA init failed - use PIO");
+    }
+
+    IPRINTF(verbose, "RAW TX: %s - RDMA TX: %s",
+            dev->raw_tx_dma.chan ? "DMA" : "PIO",
+            dev->rdma_tx_dma.chan ? "DMA" : "PIO");
 
     return dev;
 }
@@ -46,6 +400,8 @@ axiom_hw_dev_alloc(axiom_dev_regs_t *regs)
 void
 axiom_hw_dev_free(axiom_dev_t *dev)
 {
+    axiom_fifo_dma_release(&dev->rdma_tx_dma);
+    axiom_fifo_dma_release(&dev->raw_tx_dma);
     vfree(dev);
 }
 
@@ -92,31 +448,32 @@ axiom_hw_check_version(axiom_dev_t *dev)
 axiom_msg_id_t
 axiom_hw_raw_tx(axiom_dev_t *dev, axiom_raw_msg_t *msg)
 {
-    int i, payload_size;
-    uint32_t total_size = 0;
+    axi_fifo_t *fifo = &dev->regs.axi.fifo_raw_tx;
+    int payload_size, words;
+    uint32_t total_size = 8;
+    unsigned long flags;
 
     msg->header.tx.port_type.field.s = 0;
     msg->header.tx.msg_id = dev->next_raw_id++;
     payload_size = msg->header.tx.payload_size;
 
+    /* header + 3 byte of payload, then the rest of the payload */
+    if (payload_size > 3)
+        total_size += ALIGN(payload_size - 3, AXIOM_FIFO_WORD_SIZE);
+    words = total_size / AXIOM_FIFO_WORD_SIZE;
+
     /* wait untill we have space for header and payload */
-    while (axiom_hw_raw_tx_avail(dev) < sizeof(msg->header) + payload_size) {
-        schedule();
-    }
+    axiom_fifo_tx_reserve(&dev->raw_tx_credit, fifo, &dev->raw_tx_dma, words,
+            &flags);
 
-    /* write header + 3 byte of payload */
-    axi_fifo_write64(&dev->regs.axi.fifo_raw_tx, *((uint64_t *) &msg->header));
-    total_size += 8;
+    {
+        AXIOM_HW_PROF_START(start);
 
-    /* write payload (first 3 byte written with the header) */
-    for (i = 3; i < payload_size && i < sizeof(axiom_raw_payload_t); i += 8) {
-        axi_fifo_write64(&dev->regs.axi.fifo_raw_tx,
-                *((uint64_t *)&(msg->payload.raw[i])));
-        total_size += 8;
-    }
+        axiom_fifo_tx_push(&dev->raw_tx_dma, msg, total_size);
 
-    /* write the total length */
-    axi_fifo_tx_setlen(&dev->regs.axi.fifo_raw_tx, total_size);
+        AXIOM_HW_PROF_END(&dev->prof_raw_tx, start);
+    }
+    spin_unlock_irqrestore(&dev->raw_tx_credit.lock, flags);
 
 #if 0
     IPRINTF(1, "total_size: %u - header(+3byte payload): 0x%llx",
@@ -129,31 +486,39 @@ axiom_hw_raw_tx(axiom_dev_t *dev, axiom_raw_msg_t *msg)
 axiom_queue_len_t
 axiom_hw_raw_tx_avail(axiom_dev_t *dev)
 {
-    return axi_fifo_tx_vacancy(&dev->regs.axi.fifo_raw_tx);
+    return axiom_fifo_credit_avail(&dev->raw_tx_credit,
+            &dev->regs.axi.fifo_raw_tx);
 }
 
 axiom_msg_id_t
 axiom_hw_raw_rx(axiom_dev_t *dev, axiom_raw_msg_t *msg)
 {
+    axi_fifo_t *fifo = &dev->regs.axi.fifo_raw_rx;
     uint32_t total_size;
-    int i;
+    unsigned long flags;
+    int i, words;
+    AXIOM_HW_PROF_START(start);
+
+    spin_lock_irqsave(&dev->raw_rx_credit.lock, flags);
 
     /* *getlen() returns the size of the first packet in the FIFO */
-    total_size = axi_fifo_rx_getlen(&dev->regs.axi.fifo_raw_rx);
-
-    /* read header and 3 bytes of payload*/
-    *((uint64_t *)&msg->header) = axi_fifo_read64(&dev->regs.axi.fifo_raw_rx);
-    total_size -=8;
-
-    /* read payload */
-    i = 3;
-    while (total_size > 0) {
-        *((uint64_t *)&(msg->payload.raw[i])) =
-            axi_fifo_read64(&dev->regs.axi.fifo_raw_rx);
-        total_size -= 8;
-        i += 8;
+    total_size = axi_fifo_rx_getlen(fifo);
+    words = total_size / AXIOM_FIFO_WORD_SIZE;
+
+    /* header and 3 bytes of payload in the first word, then the payload */
+    if (axiom_fifo_burst(fifo)) {
+        axi_fifo_read64_burst(fifo, msg, words);
+    } else {
+        for (i = 0; i < words; i++) {
+            ((uint64_t *)msg)[i] = axi_fifo_read64(fifo);
+        }
     }
 
+    axiom_fifo_credit_consume(&dev->raw_rx_credit, words);
+    spin_unlock_irqrestore(&dev->raw_rx_credit.lock, flags);
+
+    AXIOM_HW_PROF_END(&dev->prof_raw_rx, start);
+
 #if 0
     IPRINTF(1, "header(+3byte payload): 0x%llx", *((uint64_t *)&msg->header));
 #endif
@@ -164,28 +529,25 @@ axiom_hw_raw_rx(axiom_dev_t *dev, axiom_raw_msg_t *msg)
 axiom_queue_len_t
 axiom_hw_raw_rx_avail(axiom_dev_t *dev)
 {
-    return axi_fifo_rx_occupancy(&dev->regs.axi.fifo_raw_rx);
+    return axiom_fifo_credit_avail(&dev->raw_rx_credit,
+            &dev->regs.axi.fifo_raw_rx);
 }
 
 axiom_msg_id_t
 axiom_hw_rdma_tx(axiom_dev_t *dev, axiom_rdma_hdr_t *header)
 {
-    uint64_t *raw = ((uint64_t *)header);
     uint32_t total_size = 16;
+    unsigned long flags;
 
     header->tx.port_type.field.s = 0;
 
     /* wait untill we have space for the RDMA descriptor */
-    while (axiom_hw_rdma_tx_avail(dev) < total_size) {
-        schedule();
-    };
+    axiom_fifo_tx_reserve(&dev->rdma_tx_credit, &dev->regs.axi.fifo_rdma_tx,
+            &dev->rdma_tx_dma, total_size / AXIOM_FIFO_WORD_SIZE, &flags);
 
-    /* write the RDMA descriptor */
-    axi_fifo_write64(&dev->regs.axi.fifo_rdma_tx, raw[0]);
-    axi_fifo_write64(&dev->regs.axi.fifo_rdma_tx, raw[1]);
-
-    /* write the total length */
-    axi_fifo_tx_setlen(&dev->regs.axi.fifo_rdma_tx, total_size);
+    /* write the RDMA descriptor and the total length */
+    axiom_fifo_tx_push(&dev->rdma_tx_dma, header, total_size);
+    spin_unlock_irqrestore(&dev->rdma_tx_credit.lock, flags);
 
     return header->tx.msg_id;
 }
@@ -193,7 +555,8 @@ axiom_hw_rdma_tx(axiom_dev_t *dev, axiom_rdma_hdr_t *header)
 axiom_queue_len_t
 axiom_hw_rdma_tx_avail(axiom_dev_t *dev)
 {
-    return axi_fifo_tx_vacancy(&dev->regs.axi.fifo_rdma_tx);
+    return axiom_fifo_credit_avail(&dev->rdma_tx_credit,
+            &dev->regs.axi.fifo_rdma_tx);
 }
 
 axiom_msg_id_t
@@ -201,6 +564,9 @@ axiom_hw_rdma_rx(axiom_dev_t *dev, axiom_rdma_hdr_t *header)
 {
     uint64_t *raw = ((uint64_t *)header);
     uint32_t total_size;
+    unsigned long flags;
+
+    spin_lock_irqsave(&dev->rdma_rx_credit.lock, flags);
 
     /* *getlen() returns the size of the first packet in the FIFO */
     total_size = axi_fifo_rx_getlen(&dev->regs.axi.fifo_rdma_rx);
@@ -209,12 +575,16 @@ axiom_hw_rdma_rx(axiom_dev_t *dev, axiom_rdma_hdr_t *header)
     raw[0] = axi_fifo_read64(&dev->regs.axi.fifo_rdma_rx);
     raw[1] = axi_fifo_read64(&dev->regs.axi.fifo_rdma_rx);
 
+    axiom_fifo_credit_consume(&dev->rdma_rx_credit, 2);
+    spin_unlock_irqrestore(&dev->rdma_rx_credit.lock, flags);
+
     /* XXX: debug only! To be removed */
     if (total_size != 16) {
         EPRINTF("WRONG RDMA HEADER - S: %u - size %u",
                 header->rx.port_type.field.s, total_size);
         EPRINTF("occpuancy: %u - hdr[0]: 0x%llx hdr[1]: 0x%llx",
-                axiom_hw_rdma_rx_avail(dev), raw[0], raw[1]);
+                axi_fifo_rx_occupancy(&dev->regs.axi.fifo_rdma_rx),
+                raw[0], raw[1]);
     }
 
     DPRINTF("total_size: %u - hdr[0]: 0x%llx hdr[1]: 0x%llx",
@@ -226,7 +596,8 @@ axiom_hw_rdma_rx(axiom_dev_t *dev, axiom_rdma_hdr_t *header)
 axiom_queue_len_t
 axiom_hw_rdma_rx_avail(axiom_dev_t *dev)
 {
-    return axi_fifo_rx_occupancy(&dev->regs.axi.fifo_rdma_rx);
+    return axiom_fifo_credit_avail(&dev->rdma_rx_credit,
+            &dev->regs.axi.fifo_rdma_rx);
 }
 
 uint32_t
@@ -460,6 +831,24 @@ axiom_print_queue_reg(axiom_dev_t *dev)
     buf32 = axi_fifo_rx_occupancy(&dev->regs.axi.fifo_rdma_rx);
     printk(KERN_ERR "axiom - rdma_rx_occupancy: 0x%08x\n", buf32);
 
+#ifdef AXIOM_HW_PROFILE
+    printk(KERN_ERR "axiom - raw_tx: %llu packets - %llu cycles/packet\n",
+            dev->prof_raw_tx.packets, dev->prof_raw_tx.packets ?
+            div64_u64(dev->prof_raw_tx.cycles, dev->prof_raw_tx.packets) : 0);
+    printk(KERN_ERR "axiom - raw_rx: %llu packets - %llu cycles/packet\n",
+            dev->prof_raw_rx.packets, dev->prof_raw_rx.packets ?
+            div64_u64(dev->prof_raw_rx.cycles, dev->prof_raw_rx.packets) : 0);
+
+    /*
+     * Each report covers the packets moved since the previous one, so the
+     * burst and the word by word paths can be compared switching fifo_burst
+     * between two reports. Not under the FIFO locks: a packet moved during
+     * the reset may be lost from the counters.
+     */
+    memset(&dev->prof_raw_tx, 0, sizeof(dev->prof_raw_tx));
+    memset(&dev->prof_raw_rx, 0, sizeof(dev->prof_raw_rx));
+#endif
+
     printk(KERN_ERR "axiom --- QUEUE REGISTERS end ---\n");
 }
 
@@ -0,0 +1,970 @@
+/*!
+ * \file axiom_kernel_api_sw.c
+ *
+ * \version     v1.2
+ * \date        2016-11-14
+ *
+ * This file contains the Axiom NIC hardware API implemented by the software
+ * emulator (virtual switch between emulated NICs).
+ * The file is compiled both in the kernel module (SWNIC=1) and in the user
+ * space library libaxiom_swnic.a.
+ *
+ * Copyright (C) 2016, Evidence Srl
+ * Terms of use are as specified in COPYING
+ */
+#ifdef __KERNEL__
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/io.h>
+#include <linux/types.h>
+#include <linux/vmalloc.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#else /* !__KERNEL__ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#endif /* __KERNEL__ */
+
+#include "axiom_nic_regs.h"
+#include "axiom_nic_packets.h"
+#include "axiom_nic_api_sw.h"
+
+#ifdef __KERNEL__
+#include "axiom_kernel_api.h"
+
+#define axsw_lock_t                     spinlock_t
+#define AXSW_LOCK_INIT(_lock)           DEFINE_SPINLOCK(_lock)
+#define axsw_lock(_lock)                spin_lock(_lock)
+#define axsw_unlock(_lock)              spin_unlock(_lock)
+#define axsw_zalloc(_size)              vzalloc(_size)
+#define axsw_free(_ptr)                 vfree(_ptr)
+#define axsw_yield()                    schedule()
+#define AXSW_PRINT(_fmt, ...)           printk(KERN_ERR _fmt, ##__VA_ARGS__)
+#else /* !__KERNEL__ */
+#include "dprintf.h"
+#include "axiom_utility.h"
+
+#define axsw_lock_t                     pthread_mutex_t
+#define AXSW_LOCK_INIT(_lock)           pthread_mutex_t _lock = \
+                                            PTHREAD_MUTEX_INITIALIZER
+#define axsw_lock(_lock)                pthread_mutex_lock(_lock)
+#define axsw_unlock(_lock)              pthread_mutex_unlock(_lock)
+#define axsw_zalloc(_size)              calloc(1, _size)
+#define axsw_free(_ptr)                 free(_ptr)
+#define axsw_yield()                    sched_yield()
+#define AXSW_PRINT(_fmt, ...)           fprintf(stderr, _fmt, ##__VA_ARGS__)
+#endif /* __KERNEL__ */
+
+/*! \brief RAW FIFO of the emulated NIC (packets) */
+typedef struct axsw_raw_fifo {
+    uint32_t head;                                      /*!< \brief 1st packet */
+    uint32_t count;                                     /*!< \brief packets */
+    axiom_raw_msg_t msg[AXIOM_SW_RAW_FIFO_LEN];         /*!< \brief packets */
+} axsw_raw_fifo_t;
+
+/*! \brief RDMA FIFO of the emulated NIC (descriptors) */
+typedef struct axsw_rdma_fifo {
+    uint32_t head;                                      /*!< \brief 1st desc */
+    uint32_t count;                                     /*!< \brief descs */
+    axiom_rdma_hdr_t hdr[AXIOM_SW_RDMA_FIFO_LEN];       /*!< \brief descs */
+} axsw_rdma_fifo_t;
+
+/*! \brief Virtual link between two interfaces of two emulated NICs */
+typedef struct axsw_link {
+    axiom_dev_t *peer;          /*!< \brief NIC connected to the interface */
+    axiom_if_id_t peer_if;      /*!< \brief interface of the peer NIC */
+} axsw_link_t;
+
+/*! \brief AXIOM emulated device status */
+typedef struct axiom_dev {
+    int index;                  /*!< \brief index in the virtual switch */
+    axiom_msg_id_t next_raw_id;
+    uint32_t node_id;           /*!< \brief NODEID register */
+    uint32_t control;           /*!< \brief CONTROL register */
+    uint32_t irq_mask;          /*!< \brief MSKIRQ register */
+    uint32_t irq_pending;       /*!< \brief PNDIRQ register */
+    axiom_sw_irq_handler_t irq_handler;
+    void *irq_data;
+
+    /*! \brief routing table (interface id for each node) */
+    uint8_t routing[AXIOMREG_LEN_ROUTING];
+    /*! \brief virtual links (index 0 is the loopback interface) */
+    axsw_link_t link[AXIOM_INTERFACES_NUM];
+    /*! \brief LONG buffers descriptors */
+    axiomreg_long_buf_t long_buf[AXIOMREG_LEN_LONG_BUF];
+
+    uint64_t zone_start;        /*!< \brief DMA_START register */
+    uint64_t zone_size;         /*!< \brief DMA_END - DMA_START + 1 */
+    uint8_t *zone_vaddr;        /*!< \brief RDMA zone mapped by the emulator */
+
+    axsw_raw_fifo_t raw_tx;
+    axsw_raw_fifo_t raw_rx;
+    axsw_rdma_fifo_t rdma_tx;
+    axsw_rdma_fifo_t rdma_rx;
+
+    uint32_t raw_discarded;     /*!< \brief RAW packets not routable */
+} axiom_dev_t;
+
+/*! \brief Interrupt handler to call after the release of the switch lock */
+typedef struct axsw_notify {
+    axiom_sw_irq_handler_t handler;
+    void *data;
+} axsw_notify_t;
+
+/*! \brief Virtual switch: protects all emulated NICs */
+static AXSW_LOCK_INIT(axsw_lock);
+static axiom_dev_t *axsw_nics[AXIOM_SW_NICS_MAX];
+
+
+/*************************** switch internals *********************************/
+
+inline static void *
+axsw_zone_map(uint64_t start, uint64_t size)
+{
+#ifdef __KERNEL__
+    return memremap(start, size, MEMREMAP_WB);
+#else
+    /* in user space the RDMA zone is a buffer of the caller */
+    return (void *)(uintptr_t)start;
+#endif
+}
+
+inline static void
+axsw_zone_unmap(void *vaddr)
+{
+#ifdef __KERNEL__
+    if (vaddr)
+        memunmap(vaddr);
+#endif
+}
+
+/* return the address of [offset, offset + size) in the RDMA zone */
+inline static uint8_t *
+axsw_zone(axiom_dev_t *dev, uint32_t offset, uint32_t size)
+{
+    if (unlikely(!dev->zone_vaddr ||
+                (uint64_t)offset + size > dev->zone_size))
+        return NULL;
+
+    return dev->zone_vaddr + offset;
+}
+
+inline static void
+axsw_raise_irq(axiom_dev_t *dev, uint32_t irq)
+{
+    dev->irq_pending |= irq;
+}
+
+/* find the NIC where a packet sent to node_id is delivered */
+static axiom_dev_t *
+axsw_route(axiom_dev_t *dev, axiom_node_id_t node_id)
+{
+    int hops;
+
+    for (hops = 0; dev && hops < AXIOM_SW_NICS_MAX; hops++) {
+        uint8_t if_id;
+
+        /* transit NICs deliver the packets addressed to them */
+        if (hops && dev->node_id == node_id)
+            return dev;
+
+        if_id = dev->routing[node_id];
+        if (if_id == AXIOMREG_ROUTING_LOOPBACK_IF)
+            return dev;
+
+        if (if_id >= AXIOM_INTERFACES_NUM)
+            return NULL;
+
+        dev = dev->link[if_id].peer;
+    }
+
+    /* routing loop */
+    return NULL;
+}
+
+/*
+ * Forward the first packet of the RAW TX FIFO.
+ * Returns 0 if the destination RX FIFO is full, 1 otherwise.
+ */
+static int
+axsw_raw_forward(axiom_dev_t *dev)
+{
+    axiom_raw_msg_t *msg = &dev->raw_tx.msg[dev->raw_tx.head];
+    axsw_raw_fifo_t *rx;
+    axiom_dev_t *dst;
+    uint8_t src;
+
+    if (msg->header.tx.port_type.field.type == AXIOM_TYPE_RAW_NEIGHBOUR) {
+        /* the destination is the interface, the source is the remote one */
+        axiom_if_id_t if_id = msg->header.tx.dst;
+
+        if (if_id == AXIOMREG_ROUTING_LOOPBACK_IF) {
+            dst = dev;
+            src = AXIOMREG_ROUTING_LOOPBACK_IF;
+        } else if (if_id < AXIOM_INTERFACES_NUM) {
+            dst = dev->link[if_id].peer;
+            src = dev->link[if_id].peer_if;
+        } else {
+            dst = NULL;
+            src = 0;
+        }
+    } else {
+        dst = axsw_route(dev, msg->header.tx.dst);
+        src = dev->node_id;
+    }
+
+    /* unreachable: the packet is lost */
+    if (!dst) {
+        DPRINTF("RAW packet discarded - dst: %u", msg->header.tx.dst);
+        dev->raw_discarded++;
+        return 1;
+    }
+
+    rx = &dst->raw_rx;
+    if (rx->count == AXIOM_SW_RAW_FIFO_LEN)
+        return 0;
+
+    memcpy(&rx->msg[(rx->head + rx->count) % AXIOM_SW_RAW_FIFO_LEN], msg,
+            sizeof(msg->header) + msg->header.tx.payload_size);
+    rx->msg[(rx->head + rx->count) % AXIOM_SW_RAW_FIFO_LEN].header.rx.src =
+        src;
+    rx->count++;
+
+    axsw_raise_irq(dst, AXIOMREG_IRQ_RAW_RX);
+
+    return 1;
+}
+
+inline static void
+axsw_rdma_push(axiom_dev_t *dev, axiom_rdma_hdr_t *hdr)
+{
+    axsw_rdma_fifo_t *rx = &dev->rdma_rx;
+
+    memcpy(&rx->hdr[(rx->head + rx->count) % AXIOM_SW_RDMA_FIFO_LEN], hdr,
+            sizeof(*hdr));
+    rx->count++;
+
+    axsw_raise_irq(dev, AXIOMREG_IRQ_RDMA_RX);
+}
+
+/* find a free LONG buffer for size bytes */
+static axiomreg_long_buf_t *
+axsw_long_buf_get(axiom_dev_t *dev, uint32_t size)
+{
+    int i;
+
+    for (i = 0; i < AXIOMREG_LEN_LONG_BUF; i++) {
+        axiomreg_long_buf_t *long_buf = &dev->long_buf[i];
+
+        if ((long_buf->field.flags & AXIOMREG_LONG_BUF_FREE) &&
+                long_buf->field.size >= size)
+            return long_buf;
+    }
+
+    return NULL;
+}
+
+/*
+ * Execute the first descriptor of the RDMA TX FIFO: copy the payload between
+ * the RDMA zones, put the descriptor on the receiver (RDMA WRITE and LONG) and
+ * the ACK on the sender.
+ * Returns 0 if the RX FIFOs involved are full, 1 otherwise.
+ */
+static int
+axsw_rdma_forward(axiom_dev_t *dev)
+{
+    axiom_rdma_hdr_t *hdr = &dev->rdma_tx.hdr[dev->rdma_tx.head];
+    int type = hdr->tx.port_type.field.type;
+    axiom_rdma_hdr_t rx_hdr, ack_hdr;
+    axiomreg_long_buf_t *long_buf = NULL;
+    uint8_t *src_vaddr = NULL, *dst_vaddr = NULL;
+    uint32_t size, dst_addr = hdr->tx.dst_addr;
+    int error = 0, desc;
+    axiom_dev_t *dst;
+
+    if (type == AXIOM_TYPE_LONG_DATA) {
+        size = hdr->tx.payload_size;
+    } else {
+        size = hdr->tx.payload_size << AXIOM_RDMA_PAYLOAD_SIZE_ORDER;
+    }
+
+    dst = axsw_route(dev, hdr->tx.dst);
+
+    /* space for the ACK on the sender and the descriptor on the receiver */
+    desc = dst && (type == AXIOM_TYPE_RDMA_WRITE ||
+            type == AXIOM_TYPE_LONG_DATA);
+    if (dev->rdma_rx.count + ((desc && dst == dev) ? 2 : 1) >
+            AXIOM_SW_RDMA_FIFO_LEN)
+        return 0;
+    if (desc && dst != dev && dst->rdma_rx.count == AXIOM_SW_RDMA_FIFO_LEN)
+        return 0;
+
+    if (!dst) {
+        error = 1;
+        goto ack;
+    }
+
+    switch (type) {
+    case AXIOM_TYPE_RDMA_WRITE:
+        src_vaddr = axsw_zone(dev, hdr->tx.src_addr, size);
+        dst_vaddr = axsw_zone(dst, hdr->tx.dst_addr, size);
+        break;
+    case AXIOM_TYPE_RDMA_READ:
+        src_vaddr = axsw_zone(dst, hdr->tx.src_addr, size);
+        dst_vaddr = axsw_zone(dev, hdr->tx.dst_addr, size);
+        break;
+    case AXIOM_TYPE_LONG_DATA:
+        /* no LONG buffer available on the receiver: the sender retries */
+        long_buf = axsw_long_buf_get(dst, size);
+        if (!long_buf) {
+            error = 1;
+            goto ack;
+        }
+        dst_addr = long_buf->field.address;
+        src_vaddr = axsw_zone(dev, hdr->tx.src_addr, size);
+        dst_vaddr = axsw_zone(dst, dst_addr, size);
+        break;
+    default:
+        EPRINTF("RDMA descriptor discarded - unexpected type %d", type);
+        error = 1;
+        goto ack;
+    }
+
+    if (unlikely(!src_vaddr || !dst_vaddr)) {
+        EPRINTF("RDMA descriptor discarded - address out of the RDMA zone - "
+                "src: 0x%x dst: 0x%x size: %u", hdr->tx.src_addr,
+                hdr->tx.dst_addr, size);
+        error = 1;
+        goto ack;
+    }
+
+    memcpy(dst_vaddr, src_vaddr, size);
+
+    if (type != AXIOM_TYPE_RDMA_READ) {
+        if (long_buf) {
+            long_buf->field.flags &= ~AXIOMREG_LONG_BUF_FREE;
+            long_buf->field.msg_id = hdr->tx.msg_id;
+        }
+
+        memset(&rx_hdr, 0, sizeof(rx_hdr));
+        rx_hdr.rx.port_type = hdr->tx.port_type;
+        rx_hdr.rx.src = dev->node_id;
+        rx_hdr.rx.msg_id = hdr->tx.msg_id;
+        rx_hdr.rx.payload_size = hdr->tx.payload_size;
+        rx_hdr.rx.dst_addr = dst_addr;
+        axsw_rdma_push(dst, &rx_hdr);
+    }
+
+ack:
+    memset(&ack_hdr, 0, sizeof(ack_hdr));
+    ack_hdr.rx.port_type = hdr->tx.port_type;
+    ack_hdr.rx.port_type.field.s = 1;
+    ack_hdr.rx.port_type.field.error = error;
+    ack_hdr.rx.src = hdr->tx.dst;
+    ack_hdr.rx.msg_id = hdr->tx.msg_id;
+    ack_hdr.rx.payload_size = hdr->tx.payload_size;
+    ack_hdr.rx.dst_addr = dst_addr;
+    axsw_rdma_push(dev, &ack_hdr);
+
+    return 1;
+}
+
+/*
+ * Move the packets from the TX FIFOs to the RX FIFOs until no progress is
+ * possible. Must be called with the switch lock held.
+ */
+static void
+axsw_pump(void)
+{
+    int i, progress;
+
+    do {
+        progress = 0;
+
+        for (i = 0; i < AXIOM_SW_NICS_MAX; i++) {
+            axiom_dev_t *dev = axsw_nics[i];
+
+            if (!dev)
+                continue;
+
+            while (dev->raw_tx.count && axsw_raw_forward(dev)) {
+                dev->raw_tx.head = (dev->raw_tx.head + 1) %
+                    AXIOM_SW_RAW_FIFO_LEN;
+                dev->raw_tx.count--;
+                axsw_raise_irq(dev, AXIOMREG_IRQ_RAW_TX);
+                progress = 1;
+            }
+
+            while (dev->rdma_tx.count && axsw_rdma_forward(dev)) {
+                dev->rdma_tx.head = (dev->rdma_tx.head + 1) %
+                    AXIOM_SW_RDMA_FIFO_LEN;
+                dev->rdma_tx.count--;
+                axsw_raise_irq(dev, AXIOMREG_IRQ_RDMA_TX);
+                progress = 1;
+            }
+        }
+    } while (progress);
+}
+
+/*
+ * Collect the handlers of the NICs with unmasked pending interrupts.
+ * Must be called with the switch lock held.
+ */
+static int
+axsw_collect_irq(axsw_notify_t *notify)
+{
+    int i, n = 0;
+
+    for (i = 0; i < AXIOM_SW_NICS_MAX; i++) {
+        axiom_dev_t *dev = axsw_nics[i];
+
+        if (dev && dev->irq_handler && (dev->irq_pending & dev->irq_mask)) {
+            notify[n].handler = dev->irq_handler;
+            notify[n].data = dev->irq_data;
+            n++;
+        }
+    }
+
+    return n;
+}
+
+/* release the switch lock and call the interrupt handlers */
+static void
+axsw_unlock_and_notify(void)
+{
+    axsw_notify_t notify[AXIOM_SW_NICS_MAX];
+    int i, n;
+
+    n = axsw_collect_irq(notify);
+    axsw_unlock(&axsw_lock);
+
+    for (i = 0; i < n; i++) {
+        notify[i].handler(notify[i].data);
+    }
+}
+
+
+/*************************** emulator API *************************************/
+
+axiom_dev_t *
+axiom_sw_dev_alloc(void)
+{
+    axiom_dev_t *dev;
+    int i;
+
+    dev = axsw_zalloc(sizeof(*dev));
+    if (!dev)
+        return NULL;
+
+    memset(dev->routing, AXIOMREG_ROUTING_NULL_IF, sizeof(dev->routing));
+
+    axsw_lock(&axsw_lock);
+    for (i = 0; i < AXIOM_SW_NICS_MAX; i++) {
+        if (!axsw_nics[i]) {
+            dev->index = i;
+            axsw_nics[i] = dev;
+            break;
+        }
+    }
+    axsw_unlock(&axsw_lock);
+
+    if (i == AXIOM_SW_NICS_MAX) {
+        EPRINTF("too many emulated NICs [max %d]", AXIOM_SW_NICS_MAX);
+        axsw_free(dev);
+        return NULL;
+    }
+
+    return dev;
+}
+
+void
+axiom_sw_dev_free(axiom_dev_t *dev)
+{
+    int i, if_id;
+
+    axsw_lock(&axsw_lock);
+    axsw_nics[dev->index] = NULL;
+
+    /* unplug the links */
+    for (i = 0; i < AXIOM_SW_NICS_MAX; i++) {
+        if (!axsw_nics[i])
+            continue;
+
+        for (if_id = 0; if_id < AXIOM_INTERFACES_NUM; if_id++) {
+            if (axsw_nics[i]->link[if_id].peer == dev)
+                axsw_nics[i]->link[if_id].peer = NULL;
+        }
+    }
+    axsw_unlock(&axsw_lock);
+
+    axsw_zone_unmap(dev->zone_vaddr);
+    axsw_free(dev);
+}
+
+axiom_err_t
+axiom_sw_connect(axiom_dev_t *dev_a, axiom_if_id_t if_a, axiom_dev_t *dev_b,
+        axiom_if_id_t if_b)
+{
+    if (if_a == AXIOMREG_ROUTING_LOOPBACK_IF || if_a >= AXIOM_INTERFACES_NUM ||
+            if_b == AXIOMREG_ROUTING_LOOPBACK_IF ||
+            if_b >= AXIOM_INTERFACES_NUM) {
+        EPRINTF("invalid interfaces - if_a: %u if_b: %u", if_a, if_b);
+        return AXIOM_RET_ERROR;
+    }
+
+    axsw_lock(&axsw_lock);
+    dev_a->link[if_a].peer = dev_b;
+    dev_a->link[if_a].peer_if = if_b;
+    dev_b->link[if_b].peer = dev_a;
+    dev_b->link[if_b].peer_if = if_a;
+    axsw_unlock(&axsw_lock);
+
+    return AXIOM_RET_OK;
+}
+
+void
+axiom_sw_set_irq_handler(axiom_dev_t *dev, axiom_sw_irq_handler_t handler,
+        void *data)
+{
+    axsw_lock(&axsw_lock);
+    dev->irq_handler = handler;
+    dev->irq_data = data;
+    axsw_unlock(&axsw_lock);
+}
+
+uint32_t
+axiom_sw_raw_discarded(axiom_dev_t *dev)
+{
+    uint32_t ret;
+
+    axsw_lock(&axsw_lock);
+    ret = dev->raw_discarded;
+    axsw_unlock(&axsw_lock);
+
+    return ret;
+}
+
+#ifdef __KERNEL__
+axiom_dev_t *
+axiom_hw_dev_alloc(axiom_dev_regs_t *regs)
+{
+    /* no registers to map */
+    return axiom_sw_dev_alloc();
+}
+
+void
+axiom_hw_dev_free(axiom_dev_t *dev)
+{
+    axiom_sw_dev_free(dev);
+}
+#endif /* __KERNEL__ */
+
+
+/*************************** HW API *******************************************/
+
+void
+axiom_hw_enable_irq(axiom_dev_t *dev)
+{
+    axsw_lock(&axsw_lock);
+    dev->irq_mask = AXIOMREG_IRQ_ALL;
+    /* interrupts raised while masked */
+    axsw_unlock_and_notify();
+}
+
+void
+axiom_hw_disable_irq(axiom_dev_t *dev)
+{
+    axsw_lock(&axsw_lock);
+    dev->irq_mask = 0;
+    axsw_unlock(&axsw_lock);
+}
+
+uint32_t
+axiom_hw_pending_irq(axiom_dev_t *dev)
+{
+    uint32_t ret;
+
+    axsw_lock(&axsw_lock);
+    ret = dev->irq_pending;
+    axsw_unlock(&axsw_lock);
+
+    return ret;
+}
+
+void
+axiom_hw_ack_irq(axiom_dev_t *dev, uint32_t ack_irq)
+{
+    axsw_lock(&axsw_lock);
+    dev->irq_pending &= ~ack_irq;
+    axsw_unlock(&axsw_lock);
+}
+
+axiom_err_t
+axiom_hw_check_version(axiom_dev_t *dev)
+{
+    IPRINTF(1, "version: 0x%08x (software emulator)", AXIOM_SW_VERSION);
+
+    return AXIOM_RET_OK;
+}
+
+axiom_msg_id_t
+axiom_hw_raw_tx(axiom_dev_t *dev, axiom_raw_msg_t *msg)
+{
+    axsw_raw_fifo_t *tx = &dev->raw_tx;
+
+    msg->header.tx.port_type.field.s = 0;
+    msg->header.tx.msg_id = dev->next_raw_id++;
+
+    /* wait untill we have space for the packet */
+    while (axiom_hw_raw_tx_avail(dev) == 0) {
+        axsw_yield();
+    }
+
+    axsw_lock(&axsw_lock);
+    memcpy(&tx->msg[(tx->head + tx->count) % AXIOM_SW_RAW_FIFO_LEN], msg,
+            sizeof(msg->header) + msg->header.tx.payload_size);
+    tx->count++;
+
+    axsw_pump();
+    axsw_unlock_and_notify();
+
+    return msg->header.tx.msg_id;
+}
+
+axiom_queue_len_t
+axiom_hw_raw_tx_avail(axiom_dev_t *dev)
+{
+    axiom_queue_len_t ret;
+
+    axsw_lock(&axsw_lock);
+    ret = AXIOM_SW_RAW_FIFO_LEN - dev->raw_tx.count;
+    axsw_unlock(&axsw_lock);
+
+    return ret;
+}
+
+axiom_msg_id_t
+axiom_hw_raw_rx(axiom_dev_t *dev, axiom_raw_msg_t *msg)
+{
+    axsw_raw_fifo_t *rx = &dev->raw_rx;
+    axiom_raw_msg_t *head;
+
+    axsw_lock(&axsw_lock);
+    if (unlikely(rx->count == 0)) {
+        axsw_unlock(&axsw_lock);
+        EPRINTF("RAW RX FIFO empty");
+        memset(&msg->header, 0, sizeof(msg->header));
+        return 0;
+    }
+
+    head = &rx->msg[rx->head];
+    memcpy(msg, head, sizeof(head->header) + head->header.rx.payload_size);
+    rx->head = (rx->head + 1) % AXIOM_SW_RAW_FIFO_LEN;
+    rx->count--;
+
+    /* senders blocked by this FIFO can restart */
+    axsw_pump();
+    axsw_unlock_and_notify();
+
+    return msg->header.rx.msg_id;
+}
+
+axiom_queue_len_t
+axiom_hw_raw_rx_avail(axiom_dev_t *dev)
+{
+    axiom_queue_len_t ret;
+
+    axsw_lock(&axsw_lock);
+    ret = dev->raw_rx.count;
+    axsw_unlock(&axsw_lock);
+
+    return ret;
+}
+
+axiom_msg_id_t
+axiom_hw_rdma_tx(axiom_dev_t *dev, axiom_rdma_hdr_t *header)
+{
+    axsw_rdma_fifo_t *tx = &dev->rdma_tx;
+
+    header->tx.port_type.field.s = 0;
+
+    /* wait untill we have space for the RDMA descriptor */
+    while (axiom_hw_rdma_tx_avail(dev) == 0) {
+        axsw_yield();
+    }
+
+    axsw_lock(&axsw_lock);
+    memcpy(&tx->hdr[(tx->head + tx->count) % AXIOM_SW_RDMA_FIFO_LEN], header,
+            sizeof(*header));
+    tx->count++;
+
+    axsw_pump();
+    axsw_unlock_and_notify();
+
+    return header->tx.msg_id;
+}
+
+axiom_queue_len_t
+axiom_hw_rdma_tx_avail(axiom_dev_t *dev)
+{
+    axiom_queue_len_t ret;
+
+    axsw_lock(&axsw_lock);
+    ret = AXIOM_SW_RDMA_FIFO_LEN - dev->rdma_tx.count;
+    axsw_unlock(&axsw_lock);
+
+    return ret;
+}
+
+axiom_msg_id_t
+axiom_hw_rdma_rx(axiom_dev_t *dev, axiom_rdma_hdr_t *header)
+{
+    axsw_rdma_fifo_t *rx = &dev->rdma_rx;
+
+    axsw_lock(&axsw_lock);
+    if (unlikely(rx->count == 0)) {
+        axsw_unlock(&axsw_lock);
+        EPRINTF("RDMA RX FIFO empty");
+        memset(header, 0, sizeof(*header));
+        return 0;
+    }
+
+    memcpy(header, &rx->hdr[rx->head], sizeof(*header));
+    rx->head = (rx->head + 1) % AXIOM_SW_RDMA_FIFO_LEN;
+    rx->count--;
+
+    /* senders blocked by this FIFO can restart */
+    axsw_pump();
+    axsw_unlock_and_notify();
+
+    return header->rx.msg_id;
+}
+
+axiom_queue_len_t
+axiom_hw_rdma_rx_avail(axiom_dev_t *dev)
+{
+    axiom_queue_len_t ret;
+
+    axsw_lock(&axsw_lock);
+    ret = dev->rdma_rx.count;
+    axsw_unlock(&axsw_lock);
+
+    return ret;
+}
+
+uint32_t
+axiom_hw_read_ni_status(axiom_dev_t *dev)
+{
+    return 0x0;
+}
+
+void
+axiom_hw_set_ni_control(axiom_dev_t *dev, uint32_t reg_mask)
+{
+    dev->control = reg_mask;
+}
+
+uint32_t
+axiom_hw_read_ni_control(axiom_dev_t *dev)
+{
+    return dev->control;
+}
+
+void
+axiom_hw_set_rdma_zone(axiom_dev_t *dev, uint64_t start, uint64_t end)
+{
+    void *vaddr = NULL;
+    void *old_vaddr;
+
+    /* a zone at address 0 removes the RDMA zone of the NIC */
+    if (start)
+        vaddr = axsw_zone_map(start, end - start + 1);
+
+    if (start && !vaddr)
+        EPRINTF("unable to map the RDMA zone 0x%llx-0x%llx",
+                (unsigned long long)start, (unsigned long long)end);
+
+    axsw_lock(&axsw_lock);
+    old_vaddr = dev->zone_vaddr;
+    dev->zone_vaddr = vaddr;
+    dev->zone_start = start;
+    dev->zone_size = vaddr ? end - start + 1 : 0;
+    axsw_unlock(&axsw_lock);
+
+    axsw_zone_unmap(old_vaddr);
+}
+
+void
+axiom_hw_set_long_buf(axiom_dev_t *dev, int buf_id,
+        axiomreg_long_buf_t *long_buf)
+{
+    if (unlikely(buf_id < 0 || buf_id >= AXIOMREG_LEN_LONG_BUF))
+        return;
+
+    axsw_lock(&axsw_lock);
+    dev->long_buf[buf_id] = *long_buf;
+    /* LONG messages blocked by the lack of buffers can restart */
+    axsw_pump();
+    axsw_unlock_and_notify();
+}
+
+void
+axiom_hw_set_node_id(axiom_dev_t *dev, axiom_node_id_t node_id)
+{
+    axsw_lock(&axsw_lock);
+    dev->node_id = node_id;
+    axsw_unlock(&axsw_lock);
+}
+
+axiom_node_id_t
+axiom_hw_get_node_id(axiom_dev_t *dev)
+{
+    return dev->node_id;
+}
+
+axiom_err_t
+axiom_hw_set_routing(axiom_dev_t *dev, axiom_node_id_t node_id,
+        uint8_t enabled_mask)
+{
+    uint8_t enabled_if = AXIOMREG_ROUTING_NULL_IF;
+    int i;
+
+    /* like the hardware, only the first interface enabled is used */
+    for (i = 0; i < AXIOM_INTERFACES_NUM; i++) {
+        if (enabled_mask & (1 << i)) {
+            enabled_if = i;
+            break;
+        }
+    }
+
+    axsw_lock(&axsw_lock);
+    dev->routing[node_id] = enabled_if;
+    axsw_unlock(&axsw_lock);
+
+    return AXIOM_RET_OK;
+}
+
+axiom_err_t
+axiom_hw_get_routing(axiom_dev_t *dev, axiom_node_id_t node_id,
+        uint8_t *enabled_mask)
+{
+    uint8_t enabled_if = dev->routing[node_id];
+
+    if (enabled_if == AXIOMREG_ROUTING_NULL_IF)
+        *enabled_mask = 0;
+    else
+        *enabled_mask = (1 << enabled_if);
+
+    return AXIOM_RET_OK;
+}
+
+axiom_err_t
+axiom_hw_get_if_number(axiom_dev_t *dev, axiom_if_id_t *if_number)
+{
+    /* Return the number of physical interface plus 1 (loopback) */
+    *if_number = AXIOM_INTERFACES_NUM;
+
+    return AXIOM_RET_OK;
+}
+
+axiom_err_t
+axiom_hw_get_if_info(axiom_dev_t *dev, axiom_if_id_t if_number,
+        uint8_t *if_features)
+{
+    uint8_t ftr = 0;
+
+    if (if_number >= AXIOM_INTERFACES_NUM) {
+        *if_features = 0;
+        return AXIOM_RET_ERROR;
+    }
+
+    /* Interface 0 is the loopback IF, return 0x0 features */
+    if (if_number != AXIOMREG_ROUTING_LOOPBACK_IF) {
+        ftr = AXIOMREG_IFINFO_TX | AXIOMREG_IFINFO_RX;
+
+        axsw_lock(&axsw_lock);
+        if (dev->link[if_number].peer)
+            ftr |= AXIOMREG_IFINFO_CONNECTED;
+        axsw_unlock(&axsw_lock);
+    }
+
+    *if_features = ftr;
+
+    return AXIOM_RET_OK;
+}
+
+void
+axiom_print_status_reg(axiom_dev_t *dev)
+{
+    uint8_t ftr;
+    int i;
+
+    AXSW_PRINT("axiom --- STATUS REGISTERS start ---\n");
+
+    AXSW_PRINT("axiom - version: 0x%08x\n", AXIOM_SW_VERSION);
+    AXSW_PRINT("axiom - ifnumber: 0x%08x\n", AXIOM_INTERFACES_MAX);
+
+    for (i = 1; i < AXIOM_INTERFACES_NUM; i++) {
+        axiom_hw_get_if_info(dev, i, &ftr);
+        AXSW_PRINT("axiom - ifinfo[%d]: 0x%02x\n", i - 1, ftr);
+    }
+
+    AXSW_PRINT("axiom --- STATUS REGISTERS end ---\n");
+}
+
+void
+axiom_print_control_reg(axiom_dev_t *dev)
+{
+    AXSW_PRINT("axiom --- CONTROL REGISTERS start ---\n");
+
+    AXSW_PRINT("axiom - control: 0x%08x\n", dev->control);
+    AXSW_PRINT("axiom - nodeid: 0x%08x\n", dev->node_id);
+
+    AXSW_PRINT("axiom --- CONTROL REGISTERS end ---\n");
+}
+
+void
+axiom_print_routing_reg(axiom_dev_t *dev)
+{
+    int i;
+
+    AXSW_PRINT("axiom --- ROUTING REGISTERS start ---\n");
+
+    for (i = 0; i < AXIOMREG_LEN_ROUTING; i++) {
+        if (dev->routing[i] != AXIOMREG_ROUTING_NULL_IF)
+            AXSW_PRINT("axiom - routing[%d]: if %u\n", i, dev->routing[i]);
+    }
+
+    AXSW_PRINT("axiom --- ROUTING REGISTERS end ---\n");
+}
+
+void
+axiom_print_queue_reg(axiom_dev_t *dev)
+{
+    AXSW_PRINT("axiom --- QUEUE REGISTERS start ---\n");
+
+    AXSW_PRINT("axiom - raw_tx_vacancy: 0x%08x\n",
+            axiom_hw_raw_tx_avail(dev));
+    AXSW_PRINT("axiom - raw_rx_occupancy: 0x%08x\n",
+            axiom_hw_raw_rx_avail(dev));
+    AXSW_PRINT("axiom - rdma_tx_vacancy: 0x%08x\n",
+            axiom_hw_rdma_tx_avail(dev));
+    AXSW_PRINT("axiom - rdma_rx_occupancy: 0x%08x\n",
+            axiom_hw_rdma_rx_avail(dev));
+    AXSW_PRINT("axiom - raw_discarded: %u\n", axiom_sw_raw_discarded(dev));
+
+    AXSW_PRINT("axiom --- QUEUE REGISTERS end ---\n");
+}
+
+void
+axiom_print_fpga_debug(axiom_dev_t *dev)
+{
+    AXSW_PRINT("axiom --- FPGA DEBUG start ---\n");
+    AXSW_PRINT("axiom --- FPGA GPIO debug not found (software emulator)\n");
+    AXSW_PRINT("axiom --- FPGA DEBUG end ---\n");
+}
@@ -10,6 +10,8 @@
  * Terms of use are as specified in COPYING
  */
 #include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/version.h>
 
 #include "axiom_kthread.h"
 #include "dprintf.h"
@@ -63,6 +65,111 @@ axiom_kthread_getpid(struct axiom_kthread *ctx)
     return ctx->pid;
 }
 
+int
+axiom_kthread_set_affinity(struct axiom_kthread *ctx,
+        const struct cpumask *cpumask)
+{
+    int ret;
+
+    if (!ctx->task)
+        return -ESRCH;
+
+    ret = set_cpus_allowed_ptr(ctx->task, cpumask);
+    if (ret)
+        return ret;
+
+    cpumask_copy(&ctx->cpus, cpumask);
+
+    return 0;
+}
+
+const struct cpumask *
+axiom_kthread_get_affinity(struct axiom_kthread *ctx)
+{
+    return &ctx->cpus;
+}
+
+int
+axiom_kthread_set_nice(struct axiom_kthread *ctx, int nice)
+{
+    if (!ctx->task)
+        return -ESRCH;
+
+    if (nice < MIN_NICE || nice > MAX_NICE)
+        return -EINVAL;
+
+    set_user_nice(ctx->task, nice);
+    ctx->nice = nice;
+
+    return 0;
+}
+
+int
+axiom_kthread_get_nice(struct axiom_kthread *ctx)
+{
+    return ctx->nice;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+/*
+ * Since Linux 5.9 sched_setscheduler_nocheck() is not exported to the
+ * modules: the kthread can only be moved to the default SCHED_FIFO priority
+ * of the kernel (MAX_RT_PRIO / 2), whatever priority is requested.
+ */
+int
+axiom_kthread_set_rt_priority(struct axiom_kthread *ctx, int rt_priority)
+{
+    if (!ctx->task)
+        return -ESRCH;
+
+    if (rt_priority < 0 || rt_priority >= MAX_RT_PRIO)
+        return -EINVAL;
+
+    if (rt_priority == 0) {
+        /* back to SCHED_NORMAL: restore the nice value */
+        sched_set_normal(ctx->task, ctx->nice);
+        ctx->rt_priority = 0;
+    } else {
+        sched_set_fifo(ctx->task);
+        ctx->rt_priority = MAX_RT_PRIO / 2;
+    }
+
+    return 0;
+}
+#else /* LINUX_VERSION_CODE < KERNEL_VERSION(5, 9, 0) */
+int
+axiom_kthread_set_rt_priority(struct axiom_kthread *ctx, int rt_priority)
+{
+    struct sched_param param = { .sched_priority = rt_priority };
+    int ret;
+
+    if (!ctx->task)
+        return -ESRCH;
+
+    if (rt_priority < 0 || rt_priority >= MAX_USER_RT_PRIO)
+        return -EINVAL;
+
+    ret = sched_setscheduler_nocheck(ctx->task,
+            (rt_priority == 0) ? SCHED_NORMAL : SCHED_FIFO, &param);
+    if (ret)
+        return ret;
+
+    ctx->rt_priority = rt_priority;
+
+    /* back to SCHED_NORMAL: restore the nice value */
+    if (rt_priority == 0)
+        set_user_nice(ctx->task, ctx->nice);
+
+    return 0;
+}
+#endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0) */
+
+int
+axiom_kthread_get_rt_priority(struct axiom_kthread *ctx)
+{
+    return ctx->rt_priority;
+}
+
 int
 axiom_kthread_init(struct axiom_kthread *ctx, axkt_worker_fn_t worker_fn,
         axkt_work_todo_fn_t work_todo_fn, void *worker_data, char *name)
@@ -86,6 +193,9 @@ axiom_kthread_init(struct axiom_kthread *ctx, axkt_worker_fn_t worker_fn,
     ctx->worker_data = worker_data;
     atomic_set(&ctx->scheduled, 0);
     ctx->pid = pid_nr(task_pid(ctx->task));
+    cpumask_copy(&ctx->cpus, cpu_possible_mask);
+    ctx->nice = 0;
+    ctx->rt_priority = 0;
 
     /* start the kthread */
     wake_up_process(ctx->task);
@@ -29,6 +29,11 @@ struct axiom_kthread {
     void *worker_data;                  /*!< \brief Worker private data */
 
     pid_t pid;                          /*!< \brief PID of this kthread */
+
+    cpumask_t cpus;                     /*!< \brief CPUs allowed */
+    int nice;                           /*!< \brief nice value */
+    int rt_priority;                    /*!< \brief SCHED_FIFO priority
+                                          (0 = SCHED_NORMAL) */
 };
 
 
@@ -73,4 +78,75 @@ axiom_kthread_wakeup(struct axiom_kthread *ctx);
  */
 pid_t
 axiom_kthread_getpid(struct axiom_kthread *ctx);
+
+/*!
+ * \brief Set the CPUs where the AXIOM kernel thread is allowed to run.
+ *
+ * \param ctx           AXIOM kernel thread data context
+ * \param cpumask       Allowed CPUs
+ *
+ * \return 0 on success, an error (< 0) otherwise.
+ */
+int
+axiom_kthread_set_affinity(struct axiom_kthread *ctx,
+        const struct cpumask *cpumask);
+
+/*!
+ * \brief Get the CPUs where the AXIOM kernel thread is allowed to run.
+ *
+ * \param ctx           AXIOM kernel thread data context
+ *
+ * \return Allowed CPUs.
+ */
+const struct cpumask *
+axiom_kthread_get_affinity(struct axiom_kthread *ctx);
+
+/*!
+ * \brief Set the nice value of the AXIOM kernel thread.
+ *
+ * The nice value is used only when the kthread is in SCHED_NORMAL.
+ *
+ * \param ctx           AXIOM kernel thread data context
+ * \param nice          Nice value [-20, 19]
+ *
+ * \return 0 on success, an error (< 0) otherwise.
+ */
+int
+axiom_kthread_set_nice(struct axiom_kthread *ctx, int nice);
+
+/*!
+ * \brief Get the nice value of the AXIOM kernel thread.
+ *
+ * \param ctx           AXIOM kernel thread data context
+ *
+ * \return nice value of the AXIOM kernel thread.
+ */
+int
+axiom_kthread_get_nice(struct axiom_kthread *ctx);
+
+/*!
+ * \brief Set the real-time priority of the AXIOM kernel thread.
+ *
+ * Since Linux 5.9 any priority > 0 selects the default SCHED_FIFO priority
+ * of the kernel (MAX_RT_PRIO / 2), returned by
+ * axiom_kthread_get_rt_priority().
+ *
+ * \param ctx           AXIOM kernel thread data context
+ * \param rt_priority   SCHED_FIFO priority [1, MAX_RT_PRIO - 1], or 0 to
+ *                      move the kthread back to SCHED_NORMAL
+ *
+ * \return 0 on success, an error (< 0) otherwise.
+ */
+int
+axiom_kthread_set_rt_priority(struct axiom_kthread *ctx, int rt_priority);
+
+/*!
+ * \brief Get the real-time priority of the AXIOM kernel thread.
+ *
+ * \param ctx           AXIOM kernel thread data context
+ *
+ * \return SCHED_FIFO priority, 0 if the kthread is in SCHED_NORMAL.
+ */
+int
+axiom_kthread_get_rt_priority(struct axiom_kthread *ctx);
 #endif /* AXIOM_KTHREAD_H */
@@ -28,6 +28,7 @@
 #include <linux/slab.h>
 
 #include "evi_queue.h"
+#include "evi_stack.h"
 
 #include "dprintf.h"
 #include "axiom_nic_types.h"
@@ -63,16 +64,50 @@
 #define AXIOMNET_DEV_RDMA_NAME  "axiom-rdma"
 /*! \brief AXIOM char device class */
 #define AXIOMNET_DEV_CLASS      "axiomchar"
-/*! \brief max concurrent open allowed on an AXIOM char device */
-#define AXIOMNET_MAX_OPEN       64
+/*! \brief default max concurrent open allowed on the AXIOM char devices
+ *         (max_open module parameter) */
+#define AXIOMNET_MAX_OPEN_DEF   4096
+
+/*! \brief max fds in the group bound to a port (bind with
+ *         AXIOCTL_BIND_FLAGS_REUSEPORT) */
+#define AXIOMNET_GROUP_MAX               8
+/*! \brief first software RX queue of the group members (the first member
+ *         uses the queue of the port) */
+#define AXIOMNET_GROUP_QUEUE_BASE        (AXIOM_PORT_NUM + AXIOM_SUBPORT_NUM)
+/*! \brief number of AXIOM software RX queues: one per port, one per
+ *         sub-port, then one per member (except the first) of the groups */
+#define AXIOMNET_RX_QUEUE_NUM            (AXIOMNET_GROUP_QUEUE_BASE + \
+        AXIOM_PORT_NUM * (AXIOMNET_GROUP_MAX - 1))
+/*! \brief software RX queue of a sub-port */
+#define AXIOMNET_SUBPORT_QUEUE(_s)       (AXIOM_PORT_NUM + (_s))
+/*! \brief software RX queue of a member of the group bound to a port */
+#define AXIOMNET_GROUP_QUEUE(_p, _m)     ((_m) == 0 ? (_p) :                \
+        AXIOMNET_GROUP_QUEUE_BASE + (_p) * (AXIOMNET_GROUP_MAX - 1) + (_m) - 1)
 
 /*! \brief number of AXIOM software RAW queue */
-#define AXIOMNET_RAW_QUEUE_NUM           AXIOM_PORT_NUM
-/*! \brief number of free elements in the AXIOM free RAW queue */
-#define AXIOMNET_RAW_QUEUE_FREE_LEN      (256 * AXIOMNET_RAW_QUEUE_NUM)
+#define AXIOMNET_RAW_QUEUE_NUM           AXIOMNET_RX_QUEUE_NUM
+/*! \brief RAW queue of the messages read on a HW port and handed off to the
+ *         RX worker of the port, that moves them to their SW RX queue */
+#define AXIOMNET_RAW_HANDOFF_QUEUE(_p)   (AXIOMNET_RAW_QUEUE_NUM + (_p))
+/*! \brief number of queues in the AXIOM RAW queue manager */
+#define AXIOMNET_RAW_EVIQ_NUM            (AXIOMNET_RAW_QUEUE_NUM +          \
+        AXIOM_PORT_NUM)
+/*! \brief max messages in the RAW queue of a port */
+#define AXIOMNET_RAW_QUEUE_DEPTH         256
+/*! \brief max messages in the RAW queue of a sub-port or of a group member
+ *         (except the first, that uses the queue of the port) */
+#define AXIOMNET_RAW_SUBQUEUE_DEPTH      32
+/*! \brief max messages in a RAW queue */
+#define AXIOMNET_RAW_QUEUE_MAX(_q)       ((_q) < AXIOM_PORT_NUM ?           \
+        AXIOMNET_RAW_QUEUE_DEPTH : AXIOMNET_RAW_SUBQUEUE_DEPTH)
+/*! \brief number of free elements in the AXIOM free RAW queue: every queue
+ *         can be full without starving the others */
+#define AXIOMNET_RAW_QUEUE_FREE_LEN      (AXIOMNET_RAW_QUEUE_DEPTH *        \
+        AXIOM_PORT_NUM + AXIOMNET_RAW_SUBQUEUE_DEPTH *                     \
+        (AXIOMNET_RAW_QUEUE_NUM - AXIOM_PORT_NUM))
+/*! \brief max messages moved from/to the SW queues with one lock */
+#define AXIOMNET_QUEUE_BATCH             16
 
-/*! \brief number of AXIOM software RDMA queue */
-#define AXIOMNET_RDMA_QUEUE_NUM          0
 /*! \brief number of free elements in the AXIOM free RDMA queue */
 #define AXIOMNET_RDMA_QUEUE_FREE_LEN     AXIOM_MSG_ID_NUM
 
@@ -82,18 +117,40 @@
 #define AXIOMNET_LONG_TXQUEUE_FREE_LEN   AXIOMREG_LEN_LONG_BUF
 
 /*! \brief number of AXIOM software LONG RX queue */
-#define AXIOMNET_LONG_RXQUEUE_NUM        AXIOM_PORT_NUM
+#define AXIOMNET_LONG_RXQUEUE_NUM        AXIOMNET_RX_QUEUE_NUM
 /*! \brief number of free elements in the AXIOM free LONG RX queue */
 #define AXIOMNET_LONG_RXQUEUE_FREE_LEN   AXIOMREG_LEN_LONG_BUF
 
 /*! \brief Invalid number of AXIOM port */
 #define AXIOMNET_PORT_INVALID           -1
 
+/*! \brief max number of RAW RX kthreads (one per CPU) */
+#define AXIOMNET_RAW_RX_WORKERS_MAX     AXIOM_PORT_NUM
+/*! \brief RAW RX kthread not bound to a CPU */
+#define AXIOMNET_CPU_ANY                -1
+
+/*! \brief busy poll time of the open taken from the sysfs parameter */
+#define AXIOMNET_BUSY_POLL_DEFAULT      -1
+/*! \brief max busy poll time in usec */
+#define AXIOMNET_BUSY_POLL_MAX_USEC     10000
+
 /*! \brief max number of retry to send RDMA request */
 #define AXIOMNET_MAX_RDMA_RETRY         1000
 
 #define AXIOMNET_MAX_IOVEC              16
 
+/*! \brief max number of entries of the submission ring */
+#define AXIOMNET_RING_MAX_ENTRIES       4096
+
+/*! \brief max number of memory regions registered on a RDMA open */
+#define AXIOMNET_MR_MAX                 64
+
+/*! \brief AXIOM memory region registered by the user */
+struct axiomnet_mr {
+    unsigned long offset;               /*!< \brief offset in the RDMA zone */
+    uint64_t size;                      /*!< \brief size (0 if not used) */
+};
+
 /*! \brief AXIOM RDMA callback function */
 typedef void (*axiom_callback_fn_t)(struct axiomnet_drvdata *drvdata,
         void *data, axiom_rdma_hdr_t *rdma_hdr);
@@ -112,9 +169,12 @@ typedef struct axiom_rdma_status {
     bool ack_received;                  /*!< \brief Is ack received? */
     bool ack_waiting;                   /*!< \brief We need to wait the ack */
     wait_queue_head_t wait_queue;       /*!< \brief wait queue */
-    eviq_pnt_t queue_slot;              /*!< \brief queue slot to free */
+    int32_t queue_slot;                 /*!< \brief queue slot to free */
     axiom_callback_t callback;          /*!< \brief callback to call when
                                                     packet is received */
+    struct axiomnet_priv *owner;        /*!< \brief open that sent the async
+                                                    message (cleared under
+                                                    the RDMA queue_lock) */
     axiom_rdma_hdr_t header;            /*!< \brief header of packet to check */
 } axiom_rdma_status_t;
 
@@ -123,6 +183,8 @@ struct axiomnet_raw_queue {
     spinlock_t queue_lock;              /*!< \brief queue lock */
     evi_queue_t evi_queue;              /*!< \brief queue manager */
     axiom_raw_msg_t *queue_desc;        /*!< \brief queue elements */
+    /*! \brief SW RX queue of each element in a hand-off queue */
+    uint16_t *handoff_dst;
 };
 
 /*! \brief Structure to handle an AXIOM software LONG queue */
@@ -134,8 +196,8 @@ struct axiomnet_long_queue {
 
 /*! \brief Structure to handle an AXIOM software RDMA queue */
 struct axiomnet_rdma_queue {
-    spinlock_t queue_lock;              /*!< \brief queue lock */
-    evi_queue_t evi_queue;              /*!< \brief queue manager */
+    spinlock_t queue_lock;              /*!< \brief lock of the owners */
+    evi_stack_t free_slots;             /*!< \brief free slots (lock-free) */
     axiom_rdma_status_t *queue_desc;    /*!< \brief queue elements */
 };
 
@@ -145,13 +207,38 @@ struct axiomnet_sw_port {
     wait_queue_head_t wait_queue;       /*!< \brief port wait queue */
 };
 
+/*! \brief Group of fds bound to the same port (AXIOCTL_BIND_FLAGS_REUSEPORT) */
+struct axiomnet_port_group {
+    unsigned long members;              /*!< \brief members bound (bitmap) */
+    unsigned int next;                  /*!< \brief next member (round robin)*/
+    bool hash_src;                      /*!< \brief member chosen by source */
+};
+
 /*! \brief Structure to handle an AXIOM hardware RAW RX ring */
 struct axiomnet_raw_rx_hwring {
     struct axiomnet_drvdata *drvdata;   /*!< \brief AXIOM driver data */
     struct axiomnet_raw_queue sw_queue; /*!< \brief AXIOM software queue */
     /*!< \brief ports of this ring */
-    struct axiomnet_sw_port ports[AXIOM_PORT_NUM];
+    struct axiomnet_sw_port ports[AXIOMNET_RAW_QUEUE_NUM];
     uint8_t port_used;                  /*!< \brief Current port bound */
+    /*! \brief groups of fds bound to each port */
+    struct axiomnet_port_group groups[AXIOM_PORT_NUM];
+    /*! \brief sub-ports bound */
+    DECLARE_BITMAP(subport_used, AXIOM_SUBPORT_NUM);
+    /*! \brief held by the RX worker that is reading the HW FIFO */
+    struct mutex hw_lock;
+    /*! \brief RX worker that handles each port (port steering) */
+    uint8_t port_worker[AXIOM_PORT_NUM];
+};
+
+/*! \brief Structure to handle a RAW RX worker (kthread bound to a CPU) */
+struct axiomnet_raw_rx_worker {
+    struct axiomnet_drvdata *drvdata;   /*!< \brief AXIOM driver data */
+    struct axiom_kthread kthread;       /*!< \brief kthread of this worker */
+    int id;                             /*!< \brief index of this worker */
+    int cpu;                            /*!< \brief CPU or AXIOMNET_CPU_ANY */
+    /*! \brief ports steered to this worker with processes to wake up */
+    unsigned long wake_pending;
 };
 
 /*! \brief Structure to handle an AXIOM hardware RAW TX ring */
@@ -178,8 +265,12 @@ struct axiomnet_rdma_rx_hwring {
     struct axiomnet_rdma_queue *tx_rdma_queue;
     struct axiomnet_long_queue long_queue; /*!< \brief AXIOM software queue */
     /*!< \brief ports of this ring for LONG messages*/
-    struct axiomnet_sw_port long_ports[AXIOM_PORT_NUM];
+    struct axiomnet_sw_port long_ports[AXIOMNET_LONG_RXQUEUE_NUM];
     uint8_t port_used;                  /*!< \brief Current port bound */
+    /*! \brief groups of fds bound to each port */
+    struct axiomnet_port_group groups[AXIOM_PORT_NUM];
+    /*! \brief sub-ports bound */
+    DECLARE_BITMAP(subport_used, AXIOM_SUBPORT_NUM);
     //struct axiomnet_rdma_queue sw_queue; /*!< \brief AXIOM software queue */
     /*!< \brief ports of this ring */
     //struct axiomnet_sw_port ports[AXIOM_PORT_NUM];
@@ -196,7 +287,7 @@ struct axiomnet_long_buf_lut {
 struct axiomnet_drvdata {
     axiom_dev_t *dev_api;               /*!< \brief AXIOM dev HW API*/
     struct mutex lock;                  /*!< \brief Axiom driver mutex */
-    int used;                           /*!< \brief Current number of open() */
+    atomic_t used;                      /*!< \brief Current number of open() */
 
     /* DMA */
     dma_addr_t dma_paddr;
@@ -221,7 +312,9 @@ struct axiomnet_drvdata {
     struct axiomnet_rdma_rx_hwring rdma_rx_ring;/*!\brief RDMA RX ring */
 
     /* kthread */
-    struct axiom_kthread kthread_raw;   /*!< \brief kthread for RAW */
+    /*! \brief kthreads for RAW RX */
+    struct axiomnet_raw_rx_worker raw_rx_workers[AXIOMNET_RAW_RX_WORKERS_MAX];
+    int raw_rx_workers_num;             /*!< \brief number of RAW RX workers */
     struct axiom_kthread kthread_rdma;  /*!< \brief kthread for RDMA */
     struct axiom_kthread kthread_wtd;   /*!< \brief kthread for watchdog */
 
@@ -232,6 +325,10 @@ struct axiomnet_drvdata {
 
     /* routing info */
     axiom_if_id_t routing_table[AXIOM_NODES_NUM];/*!< \brief Routing table */
+    uint32_t routing_gen;       /*!< \brief incremented at each change of the
+                                             routing table (under lock) */
+    axiom_info_page_t *info_page;   /*!< \brief page mapped by the user space
+                                                 (copy of routing_gen) */
     axiom_node_id_t node_id;                     /*!< \brief AXIOM Node ID */
 };
 
@@ -247,6 +344,37 @@ struct axiomnet_chrdev {
     struct axiomnet_drvdata *drvdata;
 };
 
+/*! \brief RDMA request of a submission ring waiting for the ack */
+struct axiomnet_ring_op {
+    struct axiomnet_ring *ring;         /*!< \brief ring of the request */
+    uint64_t user_data;                 /*!< \brief user_data of the SQE */
+    struct axiomnet_ring_op *next;      /*!< \brief next free op */
+};
+
+/*! \brief AXIOM submission and completion rings of an event fd */
+struct axiomnet_ring {
+    struct axiomnet_drvdata *drvdata;   /*!< \brief AXIOM device driver data */
+    atomic_t refs;                      /*!< \brief event fd + RDMA in flight */
+    void *mem;                          /*!< \brief area mapped in user space */
+    size_t size;                        /*!< \brief size of the area */
+    axiom_ring_hdr_t *hdr;              /*!< \brief shared indexes */
+    axiom_ring_sqe_t *sqes;             /*!< \brief submission queue */
+    axiom_ring_cqe_t *cqes;             /*!< \brief completion queue */
+    uint32_t sq_entries;                /*!< \brief SQ entries */
+    uint32_t cq_entries;                /*!< \brief CQ entries */
+    struct mutex submit_mutex;          /*!< \brief serializes the submitters
+                                                    and protects sq_head */
+    uint32_t sq_head;                   /*!< \brief next SQE to consume */
+    spinlock_t cq_lock;                 /*!< \brief protects the fields below
+                                                    and the CQ posting */
+    uint32_t cq_tail;                   /*!< \brief next CQE to post */
+    uint32_t cq_reserved;               /*!< \brief CQE reserved by requests
+                                                    not yet completed */
+    struct axiomnet_ring_op *ops;       /*!< \brief RDMA op contexts */
+    struct axiomnet_ring_op *free_ops;  /*!< \brief free RDMA op contexts */
+    wait_queue_head_t wait_queue;       /*!< \brief woken on each CQE */
+};
+
 typedef enum {
     AXNET_FDTYPE_GENERIC = 0,
     AXNET_FDTYPE_RAW,
@@ -257,9 +385,35 @@ typedef enum {
 /*! \brief AXIOM private data for each open */
 struct axiomnet_priv {
     struct axiomnet_drvdata *drvdata;   /*!< \brief AXIOM device driver data */
-    int bind_port;                      /*!< \biref Port bound to the process */
+    int bind_port;                      /*!< \biref Port bound to the process
+                                             (SW RX queue index) */
     axiomnet_fdtype_t type;             /*!< \brief Type of file descriptor */
     int rdma_debug;                     /*!< \brief RDMA debug enabled */
+    int busy_poll_usec;                 /*!< \brief usec to spin in the
+                                                    receive before sleeping
+                                                    (AXIOMNET_BUSY_POLL_DEFAULT
+                                                    to use the sysfs value) */
+    struct file *event_raw;             /*!< \brief RAW fd attached to the
+                                                    event fd */
+    struct file *event_long;            /*!< \brief LONG fd attached to the
+                                                    event fd */
+    struct file *event_rdma;            /*!< \brief RDMA fd attached to the
+                                                    event fd */
+    int recv_next;                      /*!< \brief queue served first by the
+                                                    next AXNET_RECV (0 RAW,
+                                                    1 LONG) */
+    wait_queue_head_t rdma_wait_queue;  /*!< \brief wait queue for the
+                                                    completions of the async
+                                                    RDMA sent by this open */
+    atomic_t rdma_completed;            /*!< \brief async RDMA completed and
+                                                    not yet checked */
+    struct axiomnet_ring *ring;         /*!< \brief submission ring of the
+                                                    event fd */
+    spinlock_t mr_lock;                 /*!< \brief lock of the MR table */
+    struct axiomnet_mr *mr;             /*!< \brief memory regions registered
+                                                    (AXIOMNET_MR_MAX entries,
+                                                    allocated on the first
+                                                    registration) */
 };
 
 #endif /* AXIOM_NETDEV_H */
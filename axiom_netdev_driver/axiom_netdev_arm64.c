@@ -13,6 +13,7 @@
 #include <linux/of.h>
 #include <linux/of_device.h>
 #include <linux/of_address.h>
+#include <linux/dmaengine.h>
 
 #include "axiom_netdev.h"
 #include "axiom_xilinx.h"
@@ -190,6 +191,8 @@ static int axiomnet_fifo_init(struct axiomnet_armdata *armdata,
         goto error;
     }
 
+    fifo->axi4_paddr = axi_res.start;
+
     DPRINTF("%s AXI4 mapped - paddr: 0x%llx vaddr: %p", fifo_name,
             axi_res.start, fifo->axi4_base_addr);
 
@@ -248,6 +251,57 @@ error:
 
 
 
+/*
+ * DMA channels are optional: if the device-tree has a memcpy capable channel
+ * for a TX FIFO (e.g. dmas = <&gdma 0>; dma-names = "raw-tx";), the HW API
+ * moves the packets of that FIFO with the DMA engine instead of PIO.
+ * If the DMA controller is not probed yet, the probe is deferred.
+ */
+static int axiomnet_dma_init(struct axiomnet_armdata *armdata,
+        const char *dma_name, struct axi_fifo *fifo)
+{
+    struct dma_chan *chan;
+
+    fifo->dma_chan = NULL;
+
+    chan = dma_request_chan(armdata->dev, dma_name);
+    if (IS_ERR(chan)) {
+        if (PTR_ERR(chan) == -EPROBE_DEFER)
+            return -EPROBE_DEFER;
+        IPRINTF(verbose, "%s: DMA channel not found - use PIO", dma_name);
+        return 0;
+    }
+
+    if (!dma_has_cap(DMA_MEMCPY, chan->device->cap_mask)) {
+        dev_warn(armdata->dev, "%s: DMA channel without memcpy - use PIO\n",
+                dma_name);
+        dma_release_channel(chan);
+        return 0;
+    }
+
+    fifo->dma_chan = chan;
+
+    IPRINTF(1, "%s: DMA channel %s", dma_name, dma_chan_name(chan));
+
+    return 0;
+}
+
+static void axiomnet_dma_release(struct axiomnet_armdata *armdata)
+{
+    struct axi_fifo *fifos[] = {
+        &armdata->regs.axi.fifo_raw_tx,
+        &armdata->regs.axi.fifo_rdma_tx,
+    };
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(fifos); i++) {
+        if (fifos[i]->dma_chan) {
+            dma_release_channel(fifos[i]->dma_chan);
+            fifos[i]->dma_chan = NULL;
+        }
+    }
+}
+
 static int axiomnet_axi_init(struct axiomnet_armdata *armdata)
 {
     struct res_to_init {
@@ -274,6 +328,12 @@ static int axiomnet_axi_init(struct axiomnet_armdata *armdata)
         {"fifo-rdma-rx", &armdata->regs.axi.fifo_rdma_rx, true}
     };
 
+#define DMA_NUM         2
+    struct res_to_init dma_to_init[DMA_NUM] = {
+        {"raw-tx", &armdata->regs.axi.fifo_raw_tx, false},
+        {"rdma-tx", &armdata->regs.axi.fifo_rdma_tx, false},
+    };
+
 #define BRAM_NUM        2
     struct res_to_init bram_to_init[BRAM_NUM] = {
         {"bram-long-buf", &armdata->regs.axi.long_buf, true},
@@ -309,12 +369,21 @@ static int axiomnet_axi_init(struct axiomnet_armdata *armdata)
         }
     }
 
+    /* init DMA channels of the TX FIFOs */
+    for (i = 0; i < DMA_NUM; i++) {
+        err = axiomnet_dma_init(armdata, dma_to_init[i].name,
+                dma_to_init[i].res);
+        if (err) {
+            goto free_dma;
+        }
+    }
+
     /* init BRAM registers */
     for (i = 0; i < BRAM_NUM; i++) {
         err = axiomnet_bram_init(armdata, bram_to_init[i].name,
                 bram_to_init[i].res);
         if (err & bram_to_init[i].mandatory) {
-            goto error;
+            goto free_dma;
         }
     }
 
@@ -337,6 +406,8 @@ static int axiomnet_axi_init(struct axiomnet_armdata *armdata)
 
     return 0;
 
+free_dma:
+    axiomnet_dma_release(armdata);
 error:
     return err;
 }
@@ -366,7 +437,7 @@ static int axiomnet_arm_probe(struct platform_device *pdev)
     if (armdata->dev_api == NULL) {
         dev_err(&pdev->dev, "could not alloc axiom API\n");
         err = -ENOMEM;
-        goto free_local;
+        goto free_dma;
     }
 
     axiom_hw_disable_irq(armdata->dev_api);
@@ -396,6 +467,8 @@ free_irq:
     free_irq(armdata->irq, armdata);
 free_hw_dev:
     axiom_hw_dev_free(armdata->dev_api);
+free_dma:
+    axiomnet_dma_release(armdata);
 free_local:
     kfree(armdata);
     DPRINTF("error: %d", err);
@@ -411,6 +484,7 @@ static int axiomnet_arm_remove(struct platform_device *pdev)
 
     free_irq(armdata->irq, armdata);
     axiom_hw_dev_free(armdata->dev_api);
+    axiomnet_dma_release(armdata);
     kfree(armdata);
 
     IPRINTF(1, "AXIOM NIC driver unloaded");
@@ -22,6 +22,12 @@ MODULE_VERSION("v1.2");
 /*! \brief default watchdog period in msec */
 #define AXIOM_WATCHDOG_PERIOD_MSEC_DEF          100
 
+/*! \brief default usec to spin in the receive before sleeping */
+#define AXIOM_BUSY_POLL_USEC_DEF                0
+
+/*! \brief default RAW inline receive (disabled) */
+#define AXIOM_RAW_RX_INLINE_DEF                 0
+
 /*! \brief size of LONG buffer (must be aligned to 16 bytes) */
 #define AXIOM_LONG_PAYLOAD_BUF_SIZE             65536
 
@@ -30,6 +36,22 @@ int verbose = 0;
 module_param(verbose, int, 0644);
 MODULE_PARM_DESC(verbose, "versbose level (0=none,...,16=all)");
 
+/*! \brief CPUs of the RAW RX kthreads module parameter */
+static int raw_rx_cpus[AXIOMNET_RAW_RX_WORKERS_MAX];
+static int raw_rx_cpus_num = 0;
+module_param_array(raw_rx_cpus, int, &raw_rx_cpus_num, 0444);
+MODULE_PARM_DESC(raw_rx_cpus, "CPUs of the RAW RX kthreads, one kthread bound "
+        "to each CPU (default: one kthread not bound)");
+
+/*! \brief max concurrent open module parameter */
+static int max_open = AXIOMNET_MAX_OPEN_DEF;
+module_param(max_open, int, 0644);
+MODULE_PARM_DESC(max_open, "max concurrent open of the AXIOM char devices, "
+        "each axiom_open() uses 4 (0=no limit)");
+
+/*! \brief cache of the per-open structures */
+static struct kmem_cache *axiomnet_priv_cache;
+
 struct axiomnet_chrdev chrdev;
 
 static int axiomnet_alloc_chrdev(struct axiomnet_drvdata *drvdata,
@@ -140,6 +162,84 @@ static inline unsigned long axiom_copy_to_user(void __user *to,
 
 /************************ AxiomNet Device Driver ******************************/
 
+/* RAW RX worker bound to the current CPU, or the first one */
+inline static struct axiomnet_raw_rx_worker *
+axiomnet_raw_rx_local_worker(struct axiomnet_drvdata *drvdata)
+{
+    int cpu = raw_smp_processor_id(), i;
+
+    for (i = 0; i < drvdata->raw_rx_workers_num; i++) {
+        if (READ_ONCE(drvdata->raw_rx_workers[i].cpu) == cpu)
+            return &drvdata->raw_rx_workers[i];
+    }
+
+    return &drvdata->raw_rx_workers[0];
+}
+
+/*
+ * RAW RX worker that handles the messages of a port. The sub-port queues are
+ * not steered: they are handled by the worker of the current CPU.
+ */
+inline static struct axiomnet_raw_rx_worker *
+axiomnet_raw_rx_port_worker(struct axiomnet_drvdata *drvdata, int port)
+{
+    int id;
+
+    if (port >= AXIOM_PORT_NUM)
+        return axiomnet_raw_rx_local_worker(drvdata);
+
+    id = READ_ONCE(drvdata->raw_rx_ring.port_worker[port]);
+
+    return &drvdata->raw_rx_workers[id];
+}
+
+/*
+ * SW RX queue of a message received on AXIOM_PORT_SUB: the destination
+ * sub-port is in the tag at the start of the payload. Returns -1 if the
+ * payload is too short to contain the tag or the sub-port is not valid.
+ */
+inline static int
+axiomnet_subport_queue(void *payload, size_t payload_size)
+{
+    axiom_subport_hdr_t *tag = payload;
+
+    if (unlikely(payload_size < sizeof(*tag) ||
+                tag->dst > AXIOM_SUBPORT_MAX))
+        return -1;
+
+    return AXIOMNET_SUBPORT_QUEUE(tag->dst);
+}
+
+/*
+ * SW RX queue of a message received on a port. If the port is bound by a
+ * group of fds, the member is chosen round robin or by source node. Only one
+ * context at a time delivers the messages of a ring, so next is not atomic.
+ */
+inline static int
+axiomnet_group_queue(struct axiomnet_port_group *group, int port,
+        axiom_node_id_t src)
+{
+    unsigned long members = READ_ONCE(group->members);
+    unsigned int k;
+    int member;
+
+    if (likely(members == 0))
+        return port;
+
+    if (group->hash_src) {
+        k = src % hweight_long(members);
+    } else {
+        k = group->next++ % hweight_long(members);
+    }
+
+    for_each_set_bit(member, &members, AXIOMNET_GROUP_MAX) {
+        if (k-- == 0)
+            break;
+    }
+
+    return AXIOMNET_GROUP_QUEUE(port, member);
+}
+
 void axiomnet_irqhandler(struct axiomnet_drvdata *drvdata)
 {
     uint32_t irq_pending;
@@ -148,7 +248,8 @@ void axiomnet_irqhandler(struct axiomnet_drvdata *drvdata)
     irq_pending = axiom_hw_pending_irq(drvdata->dev_api);
 
     if (irq_pending & AXIOMREG_IRQ_RAW_RX) {
-        axiom_kthread_wakeup(&drvdata->kthread_raw);
+        /* the HW FIFO is read by the worker of the CPU that takes the IRQ */
+        axiom_kthread_wakeup(&axiomnet_raw_rx_local_worker(drvdata)->kthread);
         drvdata->stats.irq_raw_rx++;
     }
 
@@ -174,11 +275,33 @@ void axiomnet_irqhandler(struct axiomnet_drvdata *drvdata)
     DPRINTF("end");
 }
 
+/*
+ * The blocking syscalls wait as exclusive waiters, so a wake_up() wakes only
+ * one of them. The woken process passes the wake up to the next waiter when
+ * there are other slots or messages available.
+ */
+inline static void axiomnet_wake_next(wait_queue_head_t *wait_queue)
+{
+    if (wq_has_sleeper(wait_queue))
+        wake_up(wait_queue);
+}
+
+/*
+ * A syscall doesn't wait if the fd is non-blocking or if the caller asks it
+ * for this call only, so threads that share the fds don't change the
+ * behaviour of each other.
+ */
+inline static bool axiomnet_nonblock(struct file *filep, uint32_t flags)
+{
+    return (filep->f_flags & O_NONBLOCK) ||
+        (flags & AXIOCTL_MSG_FLAGS_NONBLOCK);
+}
+
 /****************************** RAW functions *********************************/
 
 inline static int axiomnet_raw_tx_avail(struct axiomnet_raw_tx_hwring *tx_ring)
 {
-    /*TODO: try to minimize the register read */
+    /* the HW backend reads the register only when its shadow credit ends */
     return axiom_hw_raw_tx_avail(tx_ring->drvdata->dev_api);
 }
 
@@ -187,19 +310,21 @@ inline static int axiomnet_raw_rx_avail(struct axiomnet_raw_rx_hwring *rx_ring,
 {
     int avail;
 
-    avail = eviq_avail(&rx_ring->sw_queue.evi_queue, port);
+    avail = eviq_count(&rx_ring->sw_queue.evi_queue, port);
     DPRINTF("queue - avail %d port: %d", avail, port);
 
     return avail;
 }
 
 inline static int axiomnet_raw_send(struct file *filep,
-        axiom_raw_hdr_t *header, const struct iovec *iov, int iovcnt)
+        axiom_raw_hdr_t *header, const struct iovec *iov, int iovcnt,
+        bool nonblock)
 {
     struct axiomnet_priv *priv = filep->private_data;
     struct axiomnet_drvdata *drvdata = priv->drvdata;
     struct axiomnet_raw_tx_hwring *tx_ring = &drvdata->raw_tx_ring;
     axiom_raw_msg_t raw_msg;
+    bool waited = false;
     int ret, i, offset;
 
     DPRINTF("start");
@@ -216,22 +341,29 @@ inline static int axiomnet_raw_send(struct file *filep,
     mutex_lock(&tx_ring->port.mutex);
 
     while (axiomnet_raw_tx_avail(tx_ring) == 0) { /* no space to write */
+        if (waited)
+            drvdata->stats.spurious_raw_tx++;
         drvdata->stats.wait_raw_tx++;
         mutex_unlock(&tx_ring->port.mutex);
 
         /* no blocking write */
-        if (filep->f_flags & O_NONBLOCK)
+        if (nonblock)
             return -EAGAIN;
 
         /* put the process in the wait_queue to wait new space (irq) */
-        if (wait_event_interruptible(tx_ring->port.wait_queue,
+        if (wait_event_interruptible_exclusive(tx_ring->port.wait_queue,
                     axiomnet_raw_tx_avail(tx_ring) != 0))
             return -ERESTARTSYS;
 
         mutex_lock(&tx_ring->port.mutex);
+        waited = true;
     }
     mutex_unlock(&tx_ring->port.mutex);
 
+    /* the IRQ frees more slots: let the next sender check them */
+    if (waited)
+        axiomnet_wake_next(&tx_ring->port.wait_queue);
+
     offset = 0;
     for (i = 0; i < iovcnt; i++) {
         int copied = iov[i].iov_len;
@@ -294,62 +426,179 @@ inline static bool axiomnet_raw_rx_work_todo(void *data)
     return ret;
 }
 
-inline static void axiom_raw_rx_dequeue(struct axiomnet_raw_rx_hwring *rx_ring)
+/*
+ * Wake up the processes waiting on a port. If the port is steered to another
+ * worker, the wake up is delegated to it, so it happens on the CPU where the
+ * consumer of the port runs.
+ */
+inline static void axiomnet_raw_rx_wake_port(
+        struct axiomnet_raw_rx_worker *worker, int port)
+{
+    struct axiomnet_drvdata *drvdata = worker->drvdata;
+    struct axiomnet_raw_rx_worker *owner;
+
+    owner = axiomnet_raw_rx_port_worker(drvdata, port);
+    if (owner == worker || port >= AXIOM_PORT_NUM) {
+        wake_up(&drvdata->raw_rx_ring.ports[port].wait_queue);
+        return;
+    }
+
+    if (!test_and_set_bit(port, &owner->wake_pending))
+        axiom_kthread_wakeup(&owner->kthread);
+}
+
+/*
+ * Enqueue n messages in a SW RX queue, with the queue lock held. The messages
+ * in excess of the depth of the queue are discarded. The queue is set in wake
+ * if it was empty.
+ */
+inline static void axiomnet_raw_rx_enqueue(struct axiomnet_drvdata *drvdata,
+        int queue, eviq_pnt_t *slots, int n, unsigned long *wake)
+{
+    evi_queue_t *evi_queue = &drvdata->raw_rx_ring.sw_queue.evi_queue;
+    int drop;
+
+    if (eviq_avail(evi_queue, queue) == 0)
+        set_bit(queue, wake);
+
+    /* queue full: the messages in excess are discarded */
+    drop = n - min_t(int, n, AXIOMNET_RAW_QUEUE_MAX(queue) -
+            eviq_count(evi_queue, queue));
+    if (unlikely(drop)) {
+        eviq_free_push_n(evi_queue, slots + n - drop, drop);
+        drvdata->stats.err_raw_rx += drop;
+    }
+    eviq_enqueue_n(evi_queue, queue, slots, n - drop);
+}
+
+/*
+ * Move the RAW messages from the HW FIFO to the SW queues. The free slots are
+ * taken and the messages are enqueued in batches of AXIOMNET_QUEUE_BATCH, so
+ * the queue lock is taken twice per batch instead of twice per message.
+ *
+ * With handoff, the messages of a port steered to another worker are only
+ * put in the hand-off queue of the port: that worker moves them to their SW
+ * queue and wakes up the receivers on its CPU. The messages of a port follow
+ * the ones still in its hand-off queue, so the order is kept also if the
+ * port is steered again or read inline.
+ */
+inline static void axiom_raw_rx_dequeue(struct axiomnet_raw_rx_worker *worker,
+        bool handoff)
 {
+    struct axiomnet_drvdata *drvdata = worker->drvdata;
+    struct axiomnet_raw_rx_hwring *rx_ring = &drvdata->raw_rx_ring;
     struct axiomnet_raw_queue *sw_queue = &rx_ring->sw_queue;
-    struct axiomnet_drvdata *drvdata = rx_ring->drvdata;
+    eviq_pnt_t slots[AXIOMNET_QUEUE_BATCH];
+    uint16_t ports[AXIOMNET_QUEUE_BATCH];
+    uint8_t hw_ports[AXIOMNET_QUEUE_BATCH];
+    DECLARE_BITMAP(wake, AXIOMNET_RAW_QUEUE_NUM);
+    unsigned long handoff_wake;
     unsigned long flags;
     uint32_t received = 0;
-    int port;
-    eviq_pnt_t queue_slot = EVIQ_NONE;
+    int port, hw_port, queue, i, n, read, run;
     DPRINTF("start");
 
 
     /* something to read */
     while (axiomnet_raw_rx_work_todo(rx_ring)) {
-        int avail;
         axiom_raw_msg_t *raw_msg;
 
         spin_lock_irqsave(&sw_queue->queue_lock, flags);
-        queue_slot = eviq_free_pop(&sw_queue->evi_queue);
+        n = eviq_free_pop_n(&sw_queue->evi_queue, slots, AXIOMNET_QUEUE_BATCH);
         spin_unlock_irqrestore(&sw_queue->queue_lock, flags);
 
-        if (unlikely(queue_slot == EVIQ_NONE)) {
+        if (unlikely(n == 0)) {
             EPRINTF("RAW SW queue empty")
             break;
         }
 
-        raw_msg = &(sw_queue->queue_desc[queue_slot]);
-
-        axiom_hw_raw_rx(drvdata->dev_api, raw_msg);
-        port = raw_msg->header.rx.port_type.field.port;
+        /* the first message is available, the others are checked */
+        for (read = 0; read < n; read++) {
+            if (read && axiom_hw_raw_rx_avail(drvdata->dev_api) == 0)
+                break;
 
-        /* check valid port */
-        if (unlikely(port < 0 || port > AXIOM_PORT_MAX)) {
-            EPRINTF("message discarded - wrong port %d", port);
+            raw_msg = &(sw_queue->queue_desc[slots[read]]);
 
-            drvdata->stats.err_raw_rx++;
+            axiom_hw_raw_rx(drvdata->dev_api, raw_msg);
+            hw_port = raw_msg->header.rx.port_type.field.port;
+            if (hw_port == AXIOM_PORT_SUB) {
+                port = axiomnet_subport_queue(&raw_msg->payload,
+                        raw_msg->header.rx.payload_size);
+            } else {
+                port = axiomnet_group_queue(&rx_ring->groups[hw_port],
+                        hw_port, raw_msg->header.rx.src);
+            }
 
-            spin_lock_irqsave(&sw_queue->queue_lock, flags);
-            eviq_free_push(&sw_queue->evi_queue, queue_slot);
-            spin_unlock_irqrestore(&sw_queue->queue_lock, flags);
-            continue;
+            /* check valid port */
+            if (unlikely(port < 0 || port >= AXIOMNET_RAW_QUEUE_NUM)) {
+                EPRINTF("message discarded - wrong port %d", port);
+                drvdata->stats.err_raw_rx++;
+                port = AXIOMNET_RAW_EVIQ_NUM;
+            } else {
+                DPRINTF("queue insert - received: %d queue_slot: %d "
+                        "port: %d", received, slots[read], port);
+                received++;
+                drvdata->stats.pkt_raw_rx++;
+                drvdata->stats.bytes_raw_rx +=
+                    raw_msg->header.tx.payload_size;
+
+                /* the sub-port messages are not steered */
+                if (hw_port < AXIOM_PORT_NUM) {
+                    sw_queue->handoff_dst[slots[read]] = port;
+                    if (handoff && axiomnet_raw_rx_port_worker(drvdata,
+                                hw_port) != worker)
+                        port = AXIOMNET_RAW_HANDOFF_QUEUE(hw_port);
+                }
+            }
+            ports[read] = port;
+            hw_ports[read] = hw_port;
         }
 
+        bitmap_zero(wake, AXIOMNET_RAW_QUEUE_NUM);
+        handoff_wake = 0;
+
         spin_lock_irqsave(&sw_queue->queue_lock, flags);
-        avail = eviq_avail(&sw_queue->evi_queue, port);
-        eviq_enqueue(&sw_queue->evi_queue, port, queue_slot);
-        spin_unlock_irqrestore(&sw_queue->queue_lock, flags);
-        if (avail == 0)
-            wake_up(&rx_ring->ports[port].wait_queue);
+        for (i = 0; i < read; i += run) {
+            port = ports[i];
+            hw_port = hw_ports[i];
+
+            /* consecutive messages for the same port are enqueued together */
+            for (run = 1; i + run < read && ports[i + run] == port; run++)
+                ;
+
+            /* messages discarded */
+            if (unlikely(port == AXIOMNET_RAW_EVIQ_NUM)) {
+                eviq_free_push_n(&sw_queue->evi_queue, slots + i, run);
+                continue;
+            }
+
+            /* behind the messages of the port not moved yet */
+            queue = AXIOMNET_RAW_HANDOFF_QUEUE(hw_port);
+            if (hw_port < AXIOM_PORT_NUM &&
+                    eviq_avail(&sw_queue->evi_queue, queue))
+                port = queue;
+
+            if (port < AXIOMNET_RAW_QUEUE_NUM) {
+                axiomnet_raw_rx_enqueue(drvdata, port, slots + i, run, wake);
+                continue;
+            }
 
-        DPRINTF("queue insert - received: %d queue_slot: %d port: %d", received,
-                queue_slot, port);
+            if (eviq_avail(&sw_queue->evi_queue, port) == 0)
+                set_bit(hw_port, &handoff_wake);
+            eviq_enqueue_n(&sw_queue->evi_queue, port, slots + i, run);
+        }
+        /* give back the slots not used */
+        eviq_free_push_n(&sw_queue->evi_queue, slots + read, n - read);
+        spin_unlock_irqrestore(&sw_queue->queue_lock, flags);
 
-        received++;
+        for_each_set_bit(port, wake, AXIOMNET_RAW_QUEUE_NUM) {
+            axiomnet_raw_rx_wake_port(worker, port);
+        }
 
-        drvdata->stats.pkt_raw_rx++;
-        drvdata->stats.bytes_raw_rx += raw_msg->header.tx.payload_size;
+        for_each_set_bit(hw_port, &handoff_wake, AXIOM_PORT_NUM) {
+            axiom_kthread_wakeup(&axiomnet_raw_rx_port_worker(drvdata,
+                        hw_port)->kthread);
+        }
     }
 
     DPRINTF("received: %d", received);
@@ -357,8 +606,178 @@ inline static void axiom_raw_rx_dequeue(struct axiomnet_raw_rx_hwring *rx_ring)
     DPRINTF("end");
 }
 
+/*
+ * Move the messages handed off for the ports steered to this worker to their
+ * SW RX queues and wake up the receivers, on the CPU of this worker. Only the
+ * slots and the SW queues are touched, not the messages.
+ */
+static void axiomnet_raw_rx_handoff(struct axiomnet_raw_rx_worker *worker)
+{
+    struct axiomnet_drvdata *drvdata = worker->drvdata;
+    struct axiomnet_raw_rx_hwring *rx_ring = &drvdata->raw_rx_ring;
+    struct axiomnet_raw_queue *sw_queue = &rx_ring->sw_queue;
+    eviq_pnt_t slots[AXIOMNET_QUEUE_BATCH];
+    DECLARE_BITMAP(wake, AXIOMNET_RAW_QUEUE_NUM);
+    unsigned long flags;
+    int hw_port, port, i, n, run;
+
+    for (hw_port = 0; hw_port < AXIOM_PORT_NUM; hw_port++) {
+        if (axiomnet_raw_rx_port_worker(drvdata, hw_port) != worker)
+            continue;
+
+        do {
+            bitmap_zero(wake, AXIOMNET_RAW_QUEUE_NUM);
+
+            spin_lock_irqsave(&sw_queue->queue_lock, flags);
+            n = eviq_dequeue_n(&sw_queue->evi_queue,
+                    AXIOMNET_RAW_HANDOFF_QUEUE(hw_port), slots,
+                    AXIOMNET_QUEUE_BATCH);
+            for (i = 0; i < n; i += run) {
+                port = sw_queue->handoff_dst[slots[i]];
+
+                for (run = 1; i + run < n &&
+                        sw_queue->handoff_dst[slots[i + run]] == port; run++)
+                    ;
+
+                axiomnet_raw_rx_enqueue(drvdata, port, slots + i, run, wake);
+            }
+            spin_unlock_irqrestore(&sw_queue->queue_lock, flags);
+
+            for_each_set_bit(port, wake, AXIOMNET_RAW_QUEUE_NUM) {
+                wake_up(&rx_ring->ports[port].wait_queue);
+            }
+        } while (n == AXIOMNET_QUEUE_BATCH);
+    }
+}
+
+/* messages handed off for the ports steered to this worker */
+inline static bool axiomnet_raw_rx_handoff_todo(
+        struct axiomnet_raw_rx_worker *worker)
+{
+    struct axiomnet_drvdata *drvdata = worker->drvdata;
+    struct axiomnet_raw_queue *sw_queue = &drvdata->raw_rx_ring.sw_queue;
+    unsigned long flags;
+    bool ret = false;
+    int hw_port;
+
+    spin_lock_irqsave(&sw_queue->queue_lock, flags);
+    for (hw_port = 0; hw_port < AXIOM_PORT_NUM && !ret; hw_port++) {
+        ret = axiomnet_raw_rx_port_worker(drvdata, hw_port) == worker &&
+            eviq_avail(&sw_queue->evi_queue,
+                    AXIOMNET_RAW_HANDOFF_QUEUE(hw_port));
+    }
+    spin_unlock_irqrestore(&sw_queue->queue_lock, flags);
+
+    return ret;
+}
+
+inline static void axiomnet_raw_rx_drain(struct axiomnet_raw_rx_worker *worker,
+        bool handoff)
+{
+    struct axiomnet_raw_rx_hwring *rx_ring = &worker->drvdata->raw_rx_ring;
+
+    /*
+     * Only one context at a time reads the HW FIFO. The FIFO is checked again
+     * after the release, so messages that arrived while another context failed
+     * the trylock are not lost.
+     */
+    while (axiomnet_raw_rx_work_todo(rx_ring) &&
+            mutex_trylock(&rx_ring->hw_lock)) {
+        /* fetch raw rx queue elements */
+        axiom_raw_rx_dequeue(worker, handoff);
+        mutex_unlock(&rx_ring->hw_lock);
+    }
+}
+
+/*
+ * Inline receive: the receiver reads the HW FIFO itself, enqueueing the
+ * messages of the other ports (and waking their receivers) and taking its own
+ * without waiting the RAW RX kthreads. Returns true if the port of the open
+ * has something to read.
+ */
+inline static bool axiomnet_raw_rx_inline(struct axiomnet_priv *priv)
+{
+    struct axiomnet_drvdata *drvdata = priv->drvdata;
+    struct axiomnet_raw_rx_hwring *rx_ring = &drvdata->raw_rx_ring;
+
+    if (!drvdata->sysfs_param.raw_rx_inline)
+        return false;
+
+    axiomnet_raw_rx_drain(axiomnet_raw_rx_local_worker(drvdata), false);
+
+    return axiomnet_raw_rx_avail(rx_ring, priv->bind_port) != 0;
+}
+
+/*************************** Busy poll functions ******************************/
+
+typedef bool (*axiomnet_busy_poll_fn_t)(struct axiomnet_priv *priv);
+
+inline static uint32_t axiomnet_busy_poll_usec(struct axiomnet_priv *priv)
+{
+    if (priv->busy_poll_usec != AXIOMNET_BUSY_POLL_DEFAULT)
+        return priv->busy_poll_usec;
+
+    return priv->drvdata->sysfs_param.busy_poll_usec;
+}
+
+static long axiomnet_set_busy_poll(struct axiomnet_priv *priv, int usec)
+{
+    if (usec > AXIOMNET_BUSY_POLL_MAX_USEC)
+        return -EINVAL;
+
+    /* a negative value restores the sysfs parameter */
+    if (usec < 0)
+        usec = AXIOMNET_BUSY_POLL_DEFAULT;
+
+    priv->busy_poll_usec = usec;
+
+    return 0;
+}
+
+/*
+ * Spin until poll_fn() finds something to receive, the busy poll time of the
+ * open expires or the process needs to be rescheduled.
+ * Returns true if the receive can be done without sleeping.
+ */
+static bool axiomnet_busy_poll(struct axiomnet_priv *priv,
+        axiomnet_busy_poll_fn_t poll_fn)
+{
+    uint32_t usec = axiomnet_busy_poll_usec(priv);
+    u64 end;
+
+    if (usec == 0)
+        return false;
+
+    end = ktime_get_ns() + (u64)usec * NSEC_PER_USEC;
+
+    do {
+        if (poll_fn(priv))
+            return true;
+
+        cpu_relax();
+    } while (!need_resched() && !signal_pending(current) &&
+            ktime_get_ns() < end);
+
+    return poll_fn(priv);
+}
+
+/* poll the HW FIFO, without waiting the RAW RX kthreads, and the port queue */
+static bool axiomnet_raw_rx_busy_poll(struct axiomnet_priv *priv)
+{
+    struct axiomnet_drvdata *drvdata = priv->drvdata;
+    struct axiomnet_raw_rx_hwring *rx_ring = &drvdata->raw_rx_ring;
+
+    if (axiomnet_raw_rx_avail(rx_ring, priv->bind_port) != 0)
+        return true;
+
+    axiomnet_raw_rx_drain(axiomnet_raw_rx_local_worker(drvdata), false);
+
+    return axiomnet_raw_rx_avail(rx_ring, priv->bind_port) != 0;
+}
+
 inline static ssize_t axiomnet_raw_recv(struct file *filep,
-        axiom_raw_hdr_t *header, const struct iovec *iov, int iovcnt)
+        axiom_raw_hdr_t *header, const struct iovec *iov, int iovcnt,
+        bool nonblock)
 {
     struct axiomnet_priv *priv = filep->private_data;
     struct axiomnet_drvdata *drvdata = priv->drvdata;
@@ -371,6 +790,7 @@ inline static ssize_t axiomnet_raw_recv(struct file *filep,
     axiom_raw_msg_t *raw_msg;
     eviq_pnt_t queue_slot;
     unsigned long flags;
+    bool waited = false, polled = false;
 
     DPRINTF("start");
 
@@ -384,28 +804,53 @@ inline static ssize_t axiomnet_raw_recv(struct file *filep,
     mutex_lock(&rx_ring->ports[port].mutex);
 
     while (axiomnet_raw_rx_avail(rx_ring, port) == 0) { /* nothing to read */
+        /* read the HW FIFO without waiting the RAW RX kthreads */
+        if (axiomnet_raw_rx_inline(priv)) {
+            drvdata->stats.inline_raw_rx++;
+            continue;
+        }
+
+        if (waited)
+            drvdata->stats.spurious_raw_rx++;
         drvdata->stats.wait_raw_rx++;
         mutex_unlock(&rx_ring->ports[port].mutex);
 
-        /* no blocking write */
-        if (filep->f_flags & O_NONBLOCK)
+        /* no blocking read */
+        if (nonblock)
             return -EAGAIN;
 
+        /* spin for a while before sleeping */
+        if (!polled) {
+            polled = true;
+            if (axiomnet_busy_poll(priv, axiomnet_raw_rx_busy_poll)) {
+                drvdata->stats.busy_poll_raw_rx++;
+                mutex_lock(&rx_ring->ports[port].mutex);
+                continue;
+            }
+        }
+
         /* put the process in the wait_queue to wait new space (irq) */
-        if (wait_event_interruptible(rx_ring->ports[port].wait_queue,
+        if (wait_event_interruptible_exclusive(
+                    rx_ring->ports[port].wait_queue,
                     axiomnet_raw_rx_avail(rx_ring, port) != 0))
             return -ERESTARTSYS;
 
         mutex_lock(&rx_ring->ports[port].mutex);
+        waited = true;
     }
 
     /* copy packet from the ring */
     spin_lock_irqsave(&sw_queue->queue_lock, flags);
     queue_slot = eviq_dequeue(&sw_queue->evi_queue, port);
+    avail = eviq_avail(&sw_queue->evi_queue, port);
     spin_unlock_irqrestore(&sw_queue->queue_lock, flags);
 
     mutex_unlock(&rx_ring->ports[port].mutex);
 
+    /* one wake up for each message available on the port */
+    if (avail)
+        axiomnet_wake_next(&rx_ring->ports[port].wait_queue);
+
     /* XXX: impossible! */
     if (unlikely(queue_slot == EVIQ_NONE)) {
         len = -EFAULT;
@@ -447,9 +892,10 @@ free_enqueue:
     avail = eviq_free_avail(&sw_queue->evi_queue);
     eviq_free_push(&sw_queue->evi_queue, queue_slot);
     spin_unlock_irqrestore(&sw_queue->queue_lock, flags);
-    /* send a notification to kthread */
+    /* send a notification to the kthread of this port */
     if (avail == 0)
-        axiom_kthread_wakeup(&drvdata->kthread_raw);
+        axiom_kthread_wakeup(&axiomnet_raw_rx_port_worker(drvdata,
+                    port)->kthread);
 
 err:
     DPRINTF("end len:%zu", len);
@@ -460,9 +906,11 @@ static long axiomnet_raw_flush(struct axiomnet_priv *priv) {
     struct axiomnet_drvdata *drvdata = priv->drvdata;
     struct axiomnet_raw_rx_hwring *rx_ring = &drvdata->raw_rx_ring;
     struct axiomnet_raw_queue *sw_queue = &rx_ring->sw_queue;
+    eviq_pnt_t slots[AXIOMNET_QUEUE_BATCH];
     int port = priv->bind_port;
     unsigned long flags;
     long ret = 0;
+    int n;
 
     /* check bind */
     if (port == AXIOMNET_PORT_INVALID) {
@@ -475,29 +923,20 @@ static long axiomnet_raw_flush(struct axiomnet_priv *priv) {
     /* take the lock to avoid enqueue during the flush */
     spin_lock_irqsave(&sw_queue->queue_lock, flags);
 
-    while (axiomnet_raw_rx_avail(rx_ring, port) != 0) {
-        eviq_pnt_t queue_slot;
-
-        queue_slot = eviq_dequeue(&sw_queue->evi_queue, port);
-
-        /* XXX: impossible! */
-        if (queue_slot == EVIQ_NONE) {
-            ret = -EFAULT;
-            goto err;
-        }
-
-        eviq_free_push(&sw_queue->evi_queue, queue_slot);
+    do {
+        n = eviq_dequeue_n(&sw_queue->evi_queue, port, slots,
+                AXIOMNET_QUEUE_BATCH);
+        eviq_free_push_n(&sw_queue->evi_queue, slots, n);
 
-        DPRINTF("queue remove - queue_slot: %d port: %d", queue_slot, port);
-    }
+        DPRINTF("queue remove - slots: %d port: %d", n, port);
+    } while (n == AXIOMNET_QUEUE_BATCH);
 
-err:
     spin_unlock_irqrestore(&sw_queue->queue_lock, flags);
 
     mutex_unlock(&rx_ring->ports[port].mutex);
 
-    /* send a notification to kthread */
-    axiom_kthread_wakeup(&drvdata->kthread_raw);
+    /* send a notification to the kthread of this port */
+    axiom_kthread_wakeup(&axiomnet_raw_rx_port_worker(drvdata, port)->kthread);
 
     return ret;
 }
@@ -519,9 +958,9 @@ axiomnet_long_rdma2buf(struct axiomnet_drvdata *drvdata,
 
 inline static int axiomnet_rdma_tx_avail(struct axiomnet_rdma_tx_hwring *tx_ring)
 {
-    /*TODO: try to minimize the register read */
+    /* the HW backend reads the register only when its shadow credit ends */
     return axiom_hw_rdma_tx_avail(tx_ring->drvdata->dev_api) &&
-        eviq_free_avail(&tx_ring->rdma_queue.evi_queue);
+        evis_avail(&tx_ring->rdma_queue.free_slots);
 }
 
 inline static int axiomnet_rdma_tx(struct file *filep,
@@ -533,8 +972,8 @@ inline static int axiomnet_rdma_tx(struct file *filep,
     struct axiomnet_rdma_tx_hwring *tx_ring = &drvdata->rdma_tx_ring;
     struct axiomnet_rdma_queue *rdma_queue = &tx_ring->rdma_queue;
     axiom_rdma_status_t *rdma_status;
-    eviq_pnt_t queue_slot = EVIQ_NONE;
-    unsigned long flags;
+    int32_t queue_slot = EVIS_NONE;
+    bool waited = false;
     int ret, avail;
 
     DPRINTF("start");
@@ -563,29 +1002,36 @@ inline static int axiomnet_rdma_tx(struct file *filep,
 
     /* check slot available in the HW ring */
     while (axiomnet_rdma_tx_avail(tx_ring) == 0) { /* no space to write */
+        if (waited)
+            drvdata->stats.spurious_rdma_tx++;
         drvdata->stats.wait_rdma_tx++;
         mutex_unlock(&tx_ring->rdma_port.mutex);
 
         /* no blocking write */
-        if (filep->f_flags & O_NONBLOCK)
+        if ((filep->f_flags & O_NONBLOCK) ||
+                (user_flags & AXIOCTL_RDMA_FLAGS_NONBLOCK))
             return -EAGAIN;
 
         /* put the process in the wait_queue to wait new space (irq) */
-        if (wait_event_interruptible(tx_ring->rdma_port.wait_queue,
+        if (wait_event_interruptible_exclusive(tx_ring->rdma_port.wait_queue,
                     axiomnet_rdma_tx_avail(tx_ring) != 0))
             return -ERESTARTSYS;
 
         mutex_lock(&tx_ring->rdma_port.mutex);
+        waited = true;
     }
 
-    spin_lock_irqsave(&rdma_queue->queue_lock, flags);
-    queue_slot = eviq_free_pop(&rdma_queue->evi_queue);
-    spin_unlock_irqrestore(&rdma_queue->queue_lock, flags);
+    queue_slot = evis_pop(&rdma_queue->free_slots);
+    avail = evis_avail(&rdma_queue->free_slots);
 
     mutex_unlock(&tx_ring->rdma_port.mutex);
 
+    /* other slots are free: let the next sender take one */
+    if (avail)
+        axiomnet_wake_next(&tx_ring->rdma_port.wait_queue);
+
     /* impossible */
-    if (unlikely(queue_slot == EVIQ_NONE)) {
+    if (unlikely(queue_slot == EVIS_NONE)) {
         ret = -EFAULT;
         return ret;
     }
@@ -597,6 +1043,7 @@ inline static int axiomnet_rdma_tx(struct file *filep,
     if (token) {
         token->rdma.msg_id = rdma_status->msg_id;
         token->rdma.status = AXIOM_TOKEN_PENDING;
+        token->rdma.counted = 0;
         token->rdma.value = rdma_status->msg_id_counter;
     }
 
@@ -607,6 +1054,7 @@ inline static int axiomnet_rdma_tx(struct file *filep,
     rdma_status->ack_received = false;
     rdma_status->queue_slot = queue_slot;
     rdma_status->retries = 0;
+    rdma_status->owner = NULL;
     memcpy(&rdma_status->header, header, sizeof(*header));
 
     if (callback) {
@@ -616,6 +1064,11 @@ inline static int axiomnet_rdma_tx(struct file *filep,
         /* if it is async call, avoid to wait the ack */
         if (user_flags & AXIOCTL_RDMA_FLAGS_ASYNC) {
             rdma_status->ack_waiting = false;
+            /* notify the completion only to this open */
+            rdma_status->owner = priv;
+            /* the ack increments rdma_completed, the check decrements it */
+            if (token)
+                token->rdma.counted = 1;
         } else {
             rdma_status->ack_waiting = true;
         }
@@ -654,6 +1107,8 @@ inline static int axiomnet_rdma_tx(struct file *filep,
         }
 
         mutex_lock(&tx_ring->rdma_port.mutex);
+        if (rdma_status->ack_received == false)
+            drvdata->stats.spurious_rdma_rx++;
     }
 
     rdma_status->ack_received = false;
@@ -662,12 +1117,10 @@ inline static int axiomnet_rdma_tx(struct file *filep,
 err:
     mutex_unlock(&tx_ring->rdma_port.mutex);
 
-    spin_lock_irqsave(&rdma_queue->queue_lock, flags);
-    avail = eviq_free_avail(&rdma_queue->evi_queue);
-    eviq_free_push(&rdma_queue->evi_queue, queue_slot);
-    spin_unlock_irqrestore(&rdma_queue->queue_lock, flags);
-    /* send a notification to other thread */
-    if (avail == 0)
+    /* the message was not sent (or it was acked): nobody else uses owner */
+    rdma_status->owner = NULL;
+    /* send a notification to other thread if the free slots were ended */
+    if (evis_push(&rdma_queue->free_slots, queue_slot))
         wake_up(&(tx_ring->rdma_port.wait_queue));
 
 err_nolock:
@@ -720,6 +1173,8 @@ static long axiomnet_rdma_check(struct file *filep,
 
         if (rdma_status->msg_id_counter != tokens[i].rdma.value) {
             tokens[i].rdma.status = AXIOM_TOKEN_ACKED;
+            if (tokens[i].rdma.counted)
+                atomic_dec_if_positive(&priv->rdma_completed);
             acked++;
         }
     }
@@ -789,6 +1244,8 @@ static long axiomnet_rdma_wait(struct file *filep,
     }
 
     token.rdma.status = AXIOM_TOKEN_ACKED;
+    if (token.rdma.counted)
+        atomic_dec_if_positive(&priv->rdma_completed);
 
     ret = axiom_copy_to_user(token_ioctl->tokens, &token, sizeof(token));
     if (ret) {
@@ -798,54 +1255,199 @@ static long axiomnet_rdma_wait(struct file *filep,
     return 0;
 }
 
-inline static int axiomnet_long_rx_avail(struct axiomnet_rdma_rx_hwring *rx_ring,
-        int port)
+/* translate an offset in a registered memory region in a RDMA zone offset */
+inline static int axiomnet_mr2off(struct axiomnet_priv *priv, uint32_t mr,
+        unsigned long addr, size_t size, unsigned long *offset)
 {
-    int avail;
+    int ret = -EFAULT;
 
-    avail = eviq_avail(&rx_ring->long_queue.evi_queue, port);
-    DPRINTF("queue - avail %d port: %d", avail, port);
+    spin_lock(&priv->mr_lock);
+    if (likely(priv->mr && mr < AXIOMNET_MR_MAX && addr <= priv->mr[mr].size
+                && size <= priv->mr[mr].size - addr)) {
+        *offset = priv->mr[mr].offset + addr;
+        ret = 0;
+    }
+    spin_unlock(&priv->mr_lock);
 
-    return avail;
+    return ret;
 }
 
-inline static bool axiomnet_rdma_rx_work_todo(void *data)
+/* translate the virtual addresses of a RDMA request in RDMA zone offsets */
+static int axiomnet_rdma_prepare(struct axiomnet_priv *priv,
+        axiom_ioctl_rdma_t *rdma)
 {
-    struct axiomnet_rdma_rx_hwring *rx_ring = data;
-    return (axiom_hw_rdma_rx_avail(rx_ring->drvdata->dev_api) != 0);
-}
+    unsigned long offset;
+    long ret;
 
-inline static void axiom_rdma_rx_dequeue(struct axiomnet_rdma_rx_hwring *rx_ring)
-{
-    struct axiomnet_drvdata *drvdata = rx_ring->drvdata;
-    axiom_rdma_hdr_t rdma_hdr;
-    axiom_msg_id_t msg_id;
+    if (rdma->flags & AXIOCTL_RDMA_FLAGS_MR) {
+        /* the regions were validated by axiom_mem_dev_virt2off() */
+        size_t size = (size_t)rdma->header.tx.payload_size <<
+            AXIOM_RDMA_PAYLOAD_SIZE_ORDER;
 
-    /* something to read */
-    while (axiomnet_rdma_rx_work_todo(rx_ring)) {
-        msg_id = axiom_hw_rdma_rx(rx_ring->drvdata->dev_api, &rdma_hdr);
+        ret = axiomnet_mr2off(priv, rdma->src_mr,
+                (unsigned long)(rdma->src_addr), size, &offset);
+        if (ret) {
+            EPRINTF("invalid src - mr %u offset %p", rdma->src_mr,
+                    rdma->src_addr);
+            return ret;
+        }
+        rdma->header.tx.src_addr = offset;
 
-        /* if the s_bit is set, we received an ack, otherwise it is a LONG msg*/
-        if (unlikely(rdma_hdr.rx.port_type.field.s == 1)) {
-            axiom_rdma_status_t *rdma_status =
-                &(rx_ring->tx_rdma_queue->queue_desc[msg_id]);
-            struct axiomnet_rdma_queue *rdma_queue = rx_ring->tx_rdma_queue;
+        ret = axiomnet_mr2off(priv, rdma->dst_mr,
+                (unsigned long)(rdma->dst_addr), size, &offset);
+        if (ret) {
+            EPRINTF("invalid dst - mr %u offset %p", rdma->dst_mr,
+                    rdma->dst_addr);
+            return ret;
+        }
+        rdma->header.tx.dst_addr = offset;
+    } else if (likely(priv->rdma_debug == 0)) {
+        ret = axiom_mem_dev_virt2off(rdma->app_id,
+                (unsigned long)(rdma->src_addr),
+                rdma->header.tx.payload_size, &offset);
+        if (ret) {
+            EPRINTF("axiom_mem_dev_virt2off - ret %ld", ret);
+            return -EFAULT;
+        }
+        rdma->header.tx.src_addr = offset;
 
-            if (unlikely(rdma_status->header.tx.dst != rdma_hdr.rx.src)) {
-                EPRINTF("Message (id = %u) discarded - unexpected ACK received "
-                        "from %u [expected from %u]", msg_id, rdma_hdr.rx.src,
-                        rdma_status->header.tx.dst);
+        ret = axiom_mem_dev_virt2off(rdma->app_id,
+                (unsigned long)(rdma->dst_addr),
+                rdma->header.tx.payload_size, &offset);
+        if (ret) {
+            EPRINTF("axiom_mem_dev_virt2off - ret %ld", ret);
+            return -EFAULT;
+        }
+        rdma->header.tx.dst_addr = offset;
+    } else { /* if RDMA debug is enabled, we can't use the allocator API */
+        rdma->header.tx.src_addr = (unsigned long)(rdma->src_addr);
+        rdma->header.tx.dst_addr = (unsigned long)(rdma->dst_addr);
+    }
 
-                drvdata->stats.err_rdma_rx++;
-                continue;
-            }
+    IPRINTF(verbose, "RDMA - src_offset: %d dst_offset: %d",
+            rdma->header.tx.src_addr, rdma->header.tx.dst_addr);
 
-            /* retry to send packet if there is an error on remote node */
-            if (rdma_hdr.rx.port_type.field.error == 1 &&
-                    rdma_status->retries < AXIOMNET_MAX_RDMA_RETRY) {
-                struct axiomnet_rdma_tx_hwring *tx_ring =
-                    &drvdata->rdma_tx_ring;
-                int ret;
+    return 0;
+}
+
+/*
+ * Validate a memory region of the RDMA zone once: the RDMA requests with
+ * AXIOCTL_RDMA_FLAGS_MR use the offset saved here, without translating the
+ * virtual addresses.
+ */
+static long axiomnet_mr_reg(struct axiomnet_priv *priv, axiom_ioctl_mr_t *mr)
+{
+    struct axiomnet_mr *table;
+    unsigned long offset;
+    long ret;
+    int i;
+
+    if (mr->size == 0)
+        return -EINVAL;
+
+    if (likely(priv->rdma_debug == 0)) {
+        ret = axiom_mem_dev_virt2off(mr->app_id, (unsigned long)(mr->addr),
+                mr->size, &offset);
+        if (ret) {
+            EPRINTF("axiom_mem_dev_virt2off - ret %ld", ret);
+            return -EFAULT;
+        }
+    } else { /* if RDMA debug is enabled, we can't use the allocator API */
+        offset = (unsigned long)(mr->addr);
+    }
+
+    if (READ_ONCE(priv->mr) == NULL) {
+        table = kcalloc(AXIOMNET_MR_MAX, sizeof(*table), GFP_KERNEL);
+        if (table == NULL)
+            return -ENOMEM;
+
+        if (cmpxchg(&priv->mr, NULL, table) != NULL)
+            kfree(table);
+    }
+
+    spin_lock(&priv->mr_lock);
+    for (i = 0; i < AXIOMNET_MR_MAX; i++) {
+        if (priv->mr[i].size == 0) {
+            priv->mr[i].offset = offset;
+            priv->mr[i].size = mr->size;
+            break;
+        }
+    }
+    spin_unlock(&priv->mr_lock);
+
+    if (i == AXIOMNET_MR_MAX)
+        return -ENOSPC;
+
+    mr->mr = i;
+
+    DPRINTF("MR %d - addr: %p size: %llu offset: 0x%lx", i, mr->addr,
+            mr->size, offset);
+
+    return 0;
+}
+
+static long axiomnet_mr_dereg(struct axiomnet_priv *priv, uint32_t mr)
+{
+    long ret = -EINVAL;
+
+    spin_lock(&priv->mr_lock);
+    if (priv->mr && mr < AXIOMNET_MR_MAX && priv->mr[mr].size != 0) {
+        priv->mr[mr].size = 0;
+        ret = 0;
+    }
+    spin_unlock(&priv->mr_lock);
+
+    return ret;
+}
+
+inline static int axiomnet_long_rx_avail(struct axiomnet_rdma_rx_hwring *rx_ring,
+        int port)
+{
+    int avail;
+
+    avail = eviq_count(&rx_ring->long_queue.evi_queue, port);
+    DPRINTF("queue - avail %d port: %d", avail, port);
+
+    return avail;
+}
+
+inline static bool axiomnet_rdma_rx_work_todo(void *data)
+{
+    struct axiomnet_rdma_rx_hwring *rx_ring = data;
+    return (axiom_hw_rdma_rx_avail(rx_ring->drvdata->dev_api) != 0);
+}
+
+inline static void axiom_rdma_rx_dequeue(struct axiomnet_rdma_rx_hwring *rx_ring)
+{
+    struct axiomnet_drvdata *drvdata = rx_ring->drvdata;
+    axiom_rdma_hdr_t rdma_hdr;
+    axiom_msg_id_t msg_id;
+
+    /* something to read */
+    while (axiomnet_rdma_rx_work_todo(rx_ring)) {
+        msg_id = axiom_hw_rdma_rx(rx_ring->drvdata->dev_api, &rdma_hdr);
+
+        /* if the s_bit is set, we received an ack, otherwise it is a LONG msg*/
+        if (unlikely(rdma_hdr.rx.port_type.field.s == 1)) {
+            axiom_rdma_status_t *rdma_status =
+                &(rx_ring->tx_rdma_queue->queue_desc[msg_id]);
+            struct axiomnet_rdma_queue *rdma_queue = rx_ring->tx_rdma_queue;
+
+            if (unlikely(rdma_status->header.tx.dst != rdma_hdr.rx.src)) {
+                EPRINTF("Message (id = %u) discarded - unexpected ACK received "
+                        "from %u [expected from %u]", msg_id, rdma_hdr.rx.src,
+                        rdma_status->header.tx.dst);
+
+                drvdata->stats.err_rdma_rx++;
+                continue;
+            }
+
+            /* retry to send packet if there is an error on remote node */
+            if (rdma_hdr.rx.port_type.field.error == 1 &&
+                    rdma_status->retries < AXIOMNET_MAX_RDMA_RETRY) {
+                struct axiomnet_rdma_tx_hwring *tx_ring =
+                    &drvdata->rdma_tx_ring;
+                int ret;
 
                 mutex_lock(&tx_ring->rdma_port.mutex);
 
@@ -898,7 +1500,6 @@ inline static void axiom_rdma_rx_dequeue(struct axiomnet_rdma_rx_hwring *rx_ring
                 struct axiomnet_rdma_tx_hwring *tx_ring =
                     &rx_ring->drvdata->rdma_tx_ring;
                 unsigned long flags;
-                int avail;
 
                 if (rdma_status->callback.func) {
                     rdma_status->callback.func(rx_ring->drvdata,
@@ -908,12 +1509,26 @@ inline static void axiom_rdma_rx_dequeue(struct axiomnet_rdma_rx_hwring *rx_ring
                 rdma_status->ack_received = false;
                 rdma_status->header.tx.dst = AXIOM_NULL_NODE;
 
-                spin_lock_irqsave(&rdma_queue->queue_lock, flags);
-                avail = eviq_free_avail(&rdma_queue->evi_queue);
-                eviq_free_push(&rdma_queue->evi_queue, rdma_status->queue_slot);
-                spin_unlock_irqrestore(&rdma_queue->queue_lock, flags);
-                /* send a notification to other thread */
-                if (avail)
+                /*
+                 * The owner is set before the send and only cleared later,
+                 * so the lock (against the release of the open) is needed
+                 * only by the async messages.
+                 */
+                if (READ_ONCE(rdma_status->owner)) {
+                    spin_lock_irqsave(&rdma_queue->queue_lock, flags);
+                    /* wake up only the open that sent the message */
+                    if (rdma_status->owner) {
+                        atomic_inc(&rdma_status->owner->rdma_completed);
+                        wake_up(&rdma_status->owner->rdma_wait_queue);
+                        rdma_status->owner = NULL;
+                    }
+                    spin_unlock_irqrestore(&rdma_queue->queue_lock, flags);
+                }
+
+                /* send a notification to other thread only if the free
+                 * slots were ended */
+                if (evis_push(&rdma_queue->free_slots,
+                            rdma_status->queue_slot))
                     wake_up(&(tx_ring->rdma_port.wait_queue));
 
             }
@@ -969,9 +1584,27 @@ inline static void axiom_rdma_rx_dequeue(struct axiomnet_rdma_rx_hwring *rx_ring
             memcpy(&long_msg->header, &rdma_hdr, sizeof(rdma_hdr));
 
             port = long_msg->header.rx.port_type.field.port;
+            if (port == AXIOM_PORT_SUB) {
+                struct axiomnet_long_buf_lut *long_buf_lut;
+
+                long_buf_lut = axiomnet_long_rdma2buf(drvdata,
+                        long_msg->header.rx.dst_addr);
+                port = -1;
+                if (likely(long_buf_lut))
+                    port = axiomnet_subport_queue(long_buf_lut->long_buf_sw,
+                            long_msg->header.rx.payload_size);
+
+                /* the buffer is not read: give it back to the HW */
+                if (unlikely(port < 0 && long_buf_lut))
+                    axiom_hw_set_long_buf(drvdata->dev_api,
+                            long_buf_lut->buf_id, &long_buf_lut->long_buf_hw);
+            } else {
+                port = axiomnet_group_queue(&rx_ring->groups[port], port,
+                        long_msg->header.rx.src);
+            }
 
             /* check valid port */
-            if (unlikely(port < 0 || port > AXIOM_PORT_MAX)) {
+            if (unlikely(port < 0 || port >= AXIOMNET_LONG_RXQUEUE_NUM)) {
                 EPRINTF("Message discarded - wrong port %d", port);
 
                 drvdata->stats.err_long_rx++;
@@ -1025,7 +1658,8 @@ inline static int axiomnet_long_tx_avail(struct axiomnet_rdma_tx_hwring *tx_ring
 }
 
 inline static int axiomnet_long_send(struct file *filep,
-        axiom_rdma_hdr_t *user_header, const struct iovec *iov, int iovcnt)
+        axiom_rdma_hdr_t *user_header, const struct iovec *iov, int iovcnt,
+        bool nonblock)
 {
     struct axiomnet_priv *priv = filep->private_data;
     struct axiomnet_drvdata *drvdata = priv->drvdata;
@@ -1035,33 +1669,42 @@ inline static int axiomnet_long_send(struct file *filep,
     axiom_long_msg_t *long_msg;
     eviq_pnt_t queue_slot = EVIQ_NONE;
     unsigned long flags;
+    bool waited = false;
     int ret, i, offset, avail;
 
     mutex_lock(&tx_ring->long_port.mutex);
 
     /* check slot available in the SW queue */
     while (axiomnet_long_tx_avail(tx_ring) == 0) { /* no space to write */
+        if (waited)
+            drvdata->stats.spurious_long_tx++;
         drvdata->stats.wait_long_tx++;
         mutex_unlock(&tx_ring->long_port.mutex);
 
         /* no blocking write */
-        if (filep->f_flags & O_NONBLOCK)
+        if (nonblock)
             return -EAGAIN;
 
         /* put the process in the wait_queue to wait new space (irq) */
-        if (wait_event_interruptible(tx_ring->long_port.wait_queue,
+        if (wait_event_interruptible_exclusive(tx_ring->long_port.wait_queue,
                     axiomnet_long_tx_avail(tx_ring) != 0))
             return -ERESTARTSYS;
 
         mutex_lock(&tx_ring->long_port.mutex);
+        waited = true;
     }
 
     spin_lock_irqsave(&long_queue->queue_lock, flags);
     queue_slot = eviq_free_pop(&long_queue->evi_queue);
+    avail = eviq_free_avail(&long_queue->evi_queue);
     spin_unlock_irqrestore(&long_queue->queue_lock, flags);
 
     mutex_unlock(&tx_ring->long_port.mutex);
 
+    /* other slots are free: let the next sender take one */
+    if (avail)
+        axiomnet_wake_next(&tx_ring->long_port.wait_queue);
+
     /* impossible */
     if (unlikely(queue_slot == EVIQ_NONE)) {
         ret = -EFAULT;
@@ -1106,7 +1749,8 @@ inline static int axiomnet_long_send(struct file *filep,
     cb.func = axiomnet_long_callback;
     cb.data = (void *)(uintptr_t)queue_slot;
 
-    ret = axiomnet_rdma_tx(filep, &(long_msg->header), NULL, &cb, 0);
+    ret = axiomnet_rdma_tx(filep, &(long_msg->header), NULL, &cb,
+            nonblock ? AXIOCTL_RDMA_FLAGS_NONBLOCK : 0);
     if (ret < 0) {
         mutex_lock(&tx_ring->long_port.mutex);
         drvdata->stats.err_long_tx++;
@@ -1138,8 +1782,17 @@ err:
     return ret;
 }
 
+/* poll the port queue filled by the RDMA kthread */
+static bool axiomnet_long_rx_busy_poll(struct axiomnet_priv *priv)
+{
+    struct axiomnet_rdma_rx_hwring *rx_ring = &priv->drvdata->rdma_rx_ring;
+
+    return axiomnet_long_rx_avail(rx_ring, priv->bind_port) != 0;
+}
+
 inline static ssize_t axiomnet_long_recv(struct file *filep,
-        axiom_rdma_hdr_t *header, const struct iovec *iov, int iovcnt)
+        axiom_rdma_hdr_t *header, const struct iovec *iov, int iovcnt,
+        bool nonblock)
 {
     struct axiomnet_priv *priv = filep->private_data;
     struct axiomnet_drvdata *drvdata = priv->drvdata;
@@ -1153,6 +1806,7 @@ inline static ssize_t axiomnet_long_recv(struct file *filep,
     axiom_long_msg_t *long_msg;
     eviq_pnt_t queue_slot;
     unsigned long flags;
+    bool waited = false, polled = false;
 
     /* check bind */
     if (unlikely(port == AXIOMNET_PORT_INVALID)) {
@@ -1164,28 +1818,47 @@ inline static ssize_t axiomnet_long_recv(struct file *filep,
     mutex_lock(&rx_ring->long_ports[port].mutex);
 
     while (axiomnet_long_rx_avail(rx_ring, port) == 0) { /* nothing to read */
+        if (waited)
+            drvdata->stats.spurious_long_rx++;
         drvdata->stats.wait_long_rx++;
         mutex_unlock(&rx_ring->long_ports[port].mutex);
 
-        /* no blocking write */
-        if (filep->f_flags & O_NONBLOCK)
+        /* no blocking read */
+        if (nonblock)
             return -EAGAIN;
 
+        /* spin for a while before sleeping */
+        if (!polled) {
+            polled = true;
+            if (axiomnet_busy_poll(priv, axiomnet_long_rx_busy_poll)) {
+                drvdata->stats.busy_poll_long_rx++;
+                mutex_lock(&rx_ring->long_ports[port].mutex);
+                continue;
+            }
+        }
+
         /* put the process in the wait_queue to wait new space (irq) */
-        if (wait_event_interruptible(rx_ring->long_ports[port].wait_queue,
+        if (wait_event_interruptible_exclusive(
+                    rx_ring->long_ports[port].wait_queue,
                     axiomnet_long_rx_avail(rx_ring, port) != 0))
             return -ERESTARTSYS;
 
         mutex_lock(&rx_ring->long_ports[port].mutex);
+        waited = true;
     }
 
     /* copy packet from the ring */
     spin_lock_irqsave(&long_queue->queue_lock, flags);
     queue_slot = eviq_dequeue(&long_queue->evi_queue, port);
+    avail = eviq_avail(&long_queue->evi_queue, port);
     spin_unlock_irqrestore(&long_queue->queue_lock, flags);
 
     mutex_unlock(&rx_ring->long_ports[port].mutex);
 
+    /* one wake up for each message available on the port */
+    if (avail)
+        axiomnet_wake_next(&rx_ring->long_ports[port].wait_queue);
+
     /* XXX: impossible! */
     if (unlikely(queue_slot == EVIQ_NONE)) {
         len = -EFAULT;
@@ -1257,9 +1930,11 @@ static long axiomnet_long_flush(struct axiomnet_priv *priv) {
     struct axiomnet_drvdata *drvdata = priv->drvdata;
     struct axiomnet_rdma_rx_hwring *rx_ring = &drvdata->rdma_rx_ring;
     struct axiomnet_long_queue *long_queue = &rx_ring->long_queue;
+    eviq_pnt_t slots[AXIOMNET_QUEUE_BATCH];
     int port = priv->bind_port;
     unsigned long flags;
     long ret = 0;
+    int i, n;
 
     /* check bind */
     if (port == AXIOMNET_PORT_INVALID) {
@@ -1272,39 +1947,37 @@ static long axiomnet_long_flush(struct axiomnet_priv *priv) {
     /* take the lock to avoid enqueue during the flush */
     spin_lock_irqsave(&long_queue->queue_lock, flags);
 
-    while (axiomnet_long_rx_avail(rx_ring, port) != 0) {
-        eviq_pnt_t queue_slot;
-        axiom_long_msg_t *long_msg;
-        struct axiomnet_long_buf_lut *long_buf_lut;
-
-        queue_slot = eviq_dequeue(&long_queue->evi_queue, port);
-        /* XXX: impossible! */
-        if (queue_slot == EVIQ_NONE) {
-            ret = -EFAULT;
-            goto err;
-        }
+    do {
+        n = eviq_dequeue_n(&long_queue->evi_queue, port, slots,
+                AXIOMNET_QUEUE_BATCH);
 
-        long_msg = &(long_queue->queue_desc[queue_slot]);
+        for (i = 0; i < n; i++) {
+            axiom_long_msg_t *long_msg;
+            struct axiomnet_long_buf_lut *long_buf_lut;
 
-        /* find the long buffer where the payload is stored */
-        long_buf_lut = axiomnet_long_rdma2buf(drvdata, long_msg->header.rx.dst_addr);
-        if (unlikely(!long_buf_lut)) {
-            EPRINTF("invalid dst_addr: 0x%x", long_msg->header.rx.dst_addr);
-            ret = -EFAULT;
-            goto err;
-        }
+            long_msg = &(long_queue->queue_desc[slots[i]]);
 
-        eviq_free_push(&long_queue->evi_queue, queue_slot);
+            /* find the long buffer where the payload is stored */
+            long_buf_lut = axiomnet_long_rdma2buf(drvdata,
+                    long_msg->header.rx.dst_addr);
+            if (unlikely(!long_buf_lut)) {
+                EPRINTF("invalid dst_addr: 0x%x",
+                        long_msg->header.rx.dst_addr);
+                ret = -EFAULT;
+                continue;
+            }
 
-        /* free the buffer for the HW, copying the initialization structure */
-        axiom_hw_set_long_buf(drvdata->dev_api, long_buf_lut->buf_id,
-                &long_buf_lut->long_buf_hw);
+            /* free the buffer for the HW, copying the initialization
+             * structure */
+            axiom_hw_set_long_buf(drvdata->dev_api, long_buf_lut->buf_id,
+                    &long_buf_lut->long_buf_hw);
+        }
 
+        eviq_free_push_n(&long_queue->evi_queue, slots, n);
 
-        DPRINTF("queue remove - queue_slot: %d port: %d", queue_slot, port);
-    }
+        DPRINTF("queue remove - slots: %d port: %d", n, port);
+    } while (n == AXIOMNET_QUEUE_BATCH);
 
-err:
     spin_unlock_irqrestore(&long_queue->queue_lock, flags);
 
     mutex_unlock(&rx_ring->long_ports[port].mutex);
@@ -1315,12 +1988,34 @@ err:
 }
 
 /**************************** Worker functions ********************************/
+inline static bool axiomnet_raw_rx_worker_work_todo(void *data)
+{
+    struct axiomnet_raw_rx_worker *worker = data;
+    struct axiomnet_raw_rx_hwring *rx_ring = &worker->drvdata->raw_rx_ring;
+
+    if (READ_ONCE(worker->wake_pending) != 0 ||
+            axiomnet_raw_rx_handoff_todo(worker))
+        return true;
+
+    /* the worker that holds the hw_lock checks the FIFO again on release */
+    return !mutex_is_locked(&rx_ring->hw_lock) &&
+        axiomnet_raw_rx_work_todo(rx_ring);
+}
+
 static void axiomnet_raw_rx_worker(void *data)
 {
-    struct axiomnet_raw_rx_hwring *rx_ring = data;
+    struct axiomnet_raw_rx_worker *worker = data;
+    struct axiomnet_raw_rx_hwring *rx_ring = &worker->drvdata->raw_rx_ring;
+    int port;
+
+    /* wake up the ports steered to this worker by the other workers */
+    for (port = 0; port < AXIOM_PORT_NUM; port++) {
+        if (test_and_clear_bit(port, &worker->wake_pending))
+            wake_up(&rx_ring->ports[port].wait_queue);
+    }
 
-    /* fetch raw rx queue elements */
-    axiom_raw_rx_dequeue(rx_ring);
+    axiomnet_raw_rx_drain(worker, true);
+    axiomnet_raw_rx_handoff(worker);
 }
 
 static void axiomnet_rdma_rx_worker(void *data)
@@ -1346,7 +2041,7 @@ static void axiomnet_watchdog_worker(void *data)
     struct axiomnet_drvdata *drvdata = (struct axiomnet_drvdata *) data;
 
     if (axiomnet_raw_rx_work_todo(&drvdata->raw_rx_ring)) {
-        axiom_kthread_wakeup(&(drvdata->kthread_raw));
+        axiom_kthread_wakeup(&(drvdata->raw_rx_workers[0].kthread));
     }
 
     if (axiomnet_raw_tx_avail(&drvdata->raw_tx_ring)) {
@@ -1369,8 +2064,13 @@ static void axiomnet_watchdog_worker(void *data)
 static void axiomnet_raw_rx_hwring_release(struct axiomnet_drvdata *drvdata,
             struct axiomnet_raw_rx_hwring *rx_ring)
 {
+    if (rx_ring->sw_queue.handoff_dst) {
+        kfree(rx_ring->sw_queue.handoff_dst);
+        rx_ring->sw_queue.handoff_dst = NULL;
+    }
+
     if (rx_ring->sw_queue.queue_desc) {
-        kfree(rx_ring->sw_queue.queue_desc);
+        vfree(rx_ring->sw_queue.queue_desc);
         rx_ring->sw_queue.queue_desc = NULL;
     }
 
@@ -1384,29 +2084,47 @@ static int axiomnet_raw_rx_hwring_init(struct axiomnet_drvdata *drvdata,
 
     rx_ring->drvdata = drvdata;
 
-    for (port = 0; port < AXIOM_PORT_NUM; port++) {
+    for (port = 0; port < AXIOMNET_RAW_QUEUE_NUM; port++) {
         mutex_init(&rx_ring->ports[port].mutex);
         init_waitqueue_head(&rx_ring->ports[port].wait_queue);
     }
 
+    for (port = 0; port < AXIOM_PORT_NUM; port++) {
+        /* default steering: ports spread round robin among the workers */
+        rx_ring->port_worker[port] = port % drvdata->raw_rx_workers_num;
+    }
+    memset(rx_ring->groups, 0, sizeof(rx_ring->groups));
+    bitmap_zero(rx_ring->subport_used, AXIOM_SUBPORT_NUM);
+
+    mutex_init(&rx_ring->hw_lock);
     spin_lock_init(&rx_ring->sw_queue.queue_lock);
 
-    err = eviq_init(&rx_ring->sw_queue.evi_queue, AXIOMNET_RAW_QUEUE_NUM,
+    err = eviq_init(&rx_ring->sw_queue.evi_queue, AXIOMNET_RAW_EVIQ_NUM,
             AXIOMNET_RAW_QUEUE_FREE_LEN);
     if (err) {
         err = -ENOMEM;
         goto err;
     }
 
-    rx_ring->sw_queue.queue_desc = kcalloc(AXIOMNET_RAW_QUEUE_FREE_LEN,
-            sizeof(*(rx_ring->sw_queue.queue_desc)), GFP_KERNEL);
+    rx_ring->sw_queue.queue_desc = vzalloc(AXIOMNET_RAW_QUEUE_FREE_LEN *
+            sizeof(*(rx_ring->sw_queue.queue_desc)));
     if (rx_ring->sw_queue.queue_desc == NULL) {
         err = -ENOMEM;
         goto release_eviq;
     }
 
+    rx_ring->sw_queue.handoff_dst = kcalloc(AXIOMNET_RAW_QUEUE_FREE_LEN,
+            sizeof(*(rx_ring->sw_queue.handoff_dst)), GFP_KERNEL);
+    if (rx_ring->sw_queue.handoff_dst == NULL) {
+        err = -ENOMEM;
+        goto free_desc;
+    }
+
     return 0;
 
+free_desc:
+    vfree(rx_ring->sw_queue.queue_desc);
+    rx_ring->sw_queue.queue_desc = NULL;
 release_eviq:
     eviq_release(&rx_ring->sw_queue.evi_queue);
 err:
@@ -1414,6 +2132,84 @@ err:
     return err;
 }
 
+static int axiomnet_raw_rx_workers_config(struct axiomnet_drvdata *drvdata)
+{
+    int i;
+
+    if (raw_rx_cpus_num == 0) {
+        drvdata->raw_rx_workers_num = 1;
+        drvdata->raw_rx_workers[0].cpu = AXIOMNET_CPU_ANY;
+        return 0;
+    }
+
+    for (i = 0; i < raw_rx_cpus_num; i++) {
+        int cpu = raw_rx_cpus[i];
+
+        if (cpu < 0 || cpu >= nr_cpu_ids || !cpu_online(cpu)) {
+            EPRINTF("invalid CPU %d in raw_rx_cpus", cpu);
+            return -EINVAL;
+        }
+
+        drvdata->raw_rx_workers[i].cpu = cpu;
+    }
+
+    drvdata->raw_rx_workers_num = raw_rx_cpus_num;
+
+    return 0;
+}
+
+static void axiomnet_raw_rx_workers_release(struct axiomnet_drvdata *drvdata)
+{
+    int i;
+
+    for (i = drvdata->raw_rx_workers_num - 1; i >= 0; i--) {
+        axiom_kthread_uninit(&drvdata->raw_rx_workers[i].kthread);
+    }
+}
+
+static int axiomnet_raw_rx_workers_init(struct axiomnet_drvdata *drvdata)
+{
+    char name[32];
+    int i, err;
+
+    for (i = 0; i < drvdata->raw_rx_workers_num; i++) {
+        struct axiomnet_raw_rx_worker *worker = &drvdata->raw_rx_workers[i];
+
+        worker->drvdata = drvdata;
+        worker->id = i;
+        worker->wake_pending = 0;
+
+        if (i == 0)
+            snprintf(name, sizeof(name), "RAW kthread");
+        else
+            snprintf(name, sizeof(name), "RAW kthread %d", i);
+
+        err = axiom_kthread_init(&worker->kthread, axiomnet_raw_rx_worker,
+                axiomnet_raw_rx_worker_work_todo, worker, name);
+        if (err)
+            goto err;
+
+        if (worker->cpu == AXIOMNET_CPU_ANY)
+            continue;
+
+        err = axiom_kthread_set_affinity(&worker->kthread,
+                cpumask_of(worker->cpu));
+        if (err) {
+            axiom_kthread_uninit(&worker->kthread);
+            goto err;
+        }
+    }
+
+    return 0;
+
+err:
+    while (--i >= 0) {
+        axiom_kthread_uninit(&drvdata->raw_rx_workers[i].kthread);
+    }
+    DPRINTF("error: %d", err);
+    return err;
+}
+
 static int axiomnet_raw_tx_hwring_init(struct axiomnet_drvdata *drvdata,
         struct axiomnet_raw_tx_hwring *tx_ring)
 {
@@ -1479,7 +2275,7 @@ static void axiomnet_rdma_tx_hwring_release(struct axiomnet_drvdata *drvdata,
         tx_ring->rdma_queue.queue_desc = NULL;
     }
 
-    eviq_release(&tx_ring->rdma_queue.evi_queue);
+    evis_release(&tx_ring->rdma_queue.free_slots);
 }
 
 static int axiomnet_rdma_rx_hwring_init(struct axiomnet_drvdata *drvdata,
@@ -1491,10 +2287,12 @@ static int axiomnet_rdma_rx_hwring_init(struct axiomnet_drvdata *drvdata,
     rx_ring->tx_rdma_queue = &(drvdata->rdma_tx_ring.rdma_queue);
 
     /* init LONG queue */
-    for (port = 0; port < AXIOM_PORT_NUM; port++) {
+    for (port = 0; port < AXIOMNET_LONG_RXQUEUE_NUM; port++) {
         mutex_init(&rx_ring->long_ports[port].mutex);
         init_waitqueue_head(&rx_ring->long_ports[port].wait_queue);
     }
+    memset(rx_ring->groups, 0, sizeof(rx_ring->groups));
+    bitmap_zero(rx_ring->subport_used, AXIOM_SUBPORT_NUM);
 
     err = axiomnet_long_queue_init(&rx_ring->long_queue,
             AXIOMNET_LONG_RXQUEUE_NUM, AXIOMNET_LONG_RXQUEUE_FREE_LEN);
@@ -1518,7 +2316,7 @@ static int axiomnet_rdma_tx_hwring_init(struct axiomnet_drvdata *drvdata,
 
     spin_lock_init(&tx_ring->rdma_queue.queue_lock);
 
-    err = eviq_init(&tx_ring->rdma_queue.evi_queue, AXIOMNET_RDMA_QUEUE_NUM,
+    err = evis_init(&tx_ring->rdma_queue.free_slots,
             AXIOMNET_RDMA_QUEUE_FREE_LEN);
     if (err) {
         err = -ENOMEM;
@@ -1529,7 +2327,7 @@ static int axiomnet_rdma_tx_hwring_init(struct axiomnet_drvdata *drvdata,
             sizeof(*(tx_ring->rdma_queue.queue_desc)), GFP_KERNEL);
     if (tx_ring->rdma_queue.queue_desc == NULL) {
         err = -ENOMEM;
-        goto release_rdma_eviq;
+        goto release_rdma_slots;
     }
 
     for (i = 0; i < AXIOMNET_RDMA_QUEUE_FREE_LEN; i++) {
@@ -1554,8 +2352,8 @@ static int axiomnet_rdma_tx_hwring_init(struct axiomnet_drvdata *drvdata,
 free_rdma_queue:
     kfree(tx_ring->rdma_queue.queue_desc);
     tx_ring->rdma_queue.queue_desc = NULL;
-release_rdma_eviq:
-    eviq_release(&tx_ring->rdma_queue.evi_queue);
+release_rdma_slots:
+    evis_release(&tx_ring->rdma_queue.free_slots);
 err:
     DPRINTF("error: %d", err);
     return err;
@@ -1682,7 +2480,7 @@ err:
 int axiomnet_probe(struct axiomnet_drvdata *drvdata,
     axiom_dev_t *dev_api)
 {
-    int err = 0;
+    int err = 0, i;
 
     DPRINTF("start");
 
@@ -1705,11 +2503,29 @@ int axiomnet_probe(struct axiomnet_drvdata *drvdata,
         axiom_print_queue_reg(drvdata->dev_api);
     }
 
+    /* the routing table may be set before the probe: read it once */
+    for (i = 0; i < AXIOM_NODES_NUM; i++) {
+        axiom_hw_get_routing(drvdata->dev_api, i, &drvdata->routing_table[i]);
+    }
+
+    /* RAW RX workers, needed by sysfs and RAW RX ring */
+    err = axiomnet_raw_rx_workers_config(drvdata);
+    if (err) {
+        return err;
+    }
+
+    /* page with the generation of the routing table, mapped by the users */
+    drvdata->info_page = (axiom_info_page_t *)get_zeroed_page(GFP_KERNEL);
+    if (drvdata->info_page == NULL) {
+        EPRINTF("could not alloc info page\n");
+        return -ENOMEM;
+    }
+
     /* alloc char device */
     err = axiomnet_alloc_chrdev(drvdata, &chrdev);
     if (err) {
         EPRINTF("could not alloc char dev\n");
-        return err;
+        goto free_info_page;
     }
 
     /* init sysfs parameters */
@@ -1722,6 +2538,8 @@ int axiomnet_probe(struct axiomnet_drvdata *drvdata,
     /* set default values */
     drvdata->sysfs_param.watchdog_period_msec = AXIOM_RETRY_DELAY_USEC_DEF;
     drvdata->sysfs_param.retry_delay_usec = AXIOM_WATCHDOG_PERIOD_MSEC_DEF;
+    drvdata->sysfs_param.busy_poll_usec = AXIOM_BUSY_POLL_USEC_DEF;
+    drvdata->sysfs_param.raw_rx_inline = AXIOM_RAW_RX_INLINE_DEF;
 
     /* init RAW TX ring */
     err = axiomnet_raw_tx_hwring_init(drvdata, &drvdata->raw_tx_ring);
@@ -1751,9 +2569,8 @@ int axiomnet_probe(struct axiomnet_drvdata *drvdata,
         goto free_rx_ring;
     }
 
-    /* init RAW kthread */
-    err = axiom_kthread_init(&drvdata->kthread_raw, axiomnet_raw_rx_worker,
-            axiomnet_raw_rx_work_todo, &drvdata->raw_rx_ring, "RAW kthread");
+    /* init RAW kthreads */
+    err = axiomnet_raw_rx_workers_init(drvdata);
     if (err) {
         EPRINTF("could not init kthread\n");
         goto free_rdma_rx_ring;
@@ -1793,7 +2610,7 @@ free_rdma:
 free_rdma_kthread:
     axiom_kthread_uninit(&drvdata->kthread_rdma);
 free_raw_kthread:
-    axiom_kthread_uninit(&drvdata->kthread_raw);
+    axiomnet_raw_rx_workers_release(drvdata);
 free_rdma_rx_ring:
     axiomnet_rdma_rx_hwring_release(drvdata, &drvdata->rdma_rx_ring);
 free_rx_ring:
@@ -1804,6 +2621,8 @@ free_sysfs:
     axiom_sysfs_uninit(&drvdata->sysfs_param);
 free_cdev:
     axiomnet_destroy_chrdev(drvdata, &chrdev);
+free_info_page:
+    free_page((unsigned long)drvdata->info_page);
 
     DPRINTF("error: %d", err);
     return err;
@@ -1819,7 +2638,7 @@ int axiomnet_remove(struct axiomnet_drvdata *drvdata)
 
     axiom_kthread_uninit(&drvdata->kthread_wtd);
     axiom_kthread_uninit(&drvdata->kthread_rdma);
-    axiom_kthread_uninit(&drvdata->kthread_raw);
+    axiomnet_raw_rx_workers_release(drvdata);
 
     axiomnet_rdma_rx_hwring_release(drvdata, &drvdata->rdma_rx_ring);
     axiomnet_raw_rx_hwring_release(drvdata, &drvdata->raw_rx_ring);
@@ -1827,33 +2646,156 @@ int axiomnet_remove(struct axiomnet_drvdata *drvdata)
 
     axiom_sysfs_uninit(&drvdata->sysfs_param);
     axiomnet_destroy_chrdev(drvdata, &chrdev);
+    free_page((unsigned long)drvdata->info_page);
     DPRINTF("end");
     return 0;
 }
 
 /****************************** Ports Handling  *******************************/
 
+/*
+ * Drop the messages left in the queue of a group member. The queue is flushed
+ * when the member leaves and when a new member joins, so the messages spread
+ * to a member that left (also those still in flight, chosen before the leave)
+ * are lost and never delivered to a later member.
+ */
+static void axiomnet_group_flush(struct axiomnet_priv *priv)
+{
+    if (priv->type == AXNET_FDTYPE_RAW) {
+        axiomnet_raw_flush(priv);
+    } else {
+        axiomnet_long_flush(priv);
+    }
+}
+
+/* remove a member from the group of a port (drvdata->lock held) */
+static void axiomnet_group_leave(struct axiomnet_port_group *group,
+        uint8_t *port_used, int port, int member)
+{
+    unsigned long members = group->members & ~(1UL << member);
+
+    WRITE_ONCE(group->members, members);
+
+    /* the last member releases the port */
+    if (members == 0)
+        *port_used &= ~(1 << (uint8_t)port);
+}
+
+/* add a member to the group of a port (drvdata->lock held) */
+static long axiomnet_group_join(struct axiomnet_priv *priv,
+        struct axiomnet_port_group *group, int port)
+{
+    unsigned long members = group->members;
+    int member;
+
+    member = find_first_zero_bit(&members, AXIOMNET_GROUP_MAX);
+    if (member >= AXIOMNET_GROUP_MAX) {
+        EPRINTF("Port %d group full", port);
+        return -EBUSY;
+    }
+
+    DPRINTF("port: %d member: %d", port, member);
+
+    priv->bind_port = AXIOMNET_GROUP_QUEUE(port, member);
+    WRITE_ONCE(group->members, members | (1UL << member));
+
+    return 0;
+}
+
 static void axiomnet_unbind(struct axiomnet_priv *priv) {
     struct axiomnet_drvdata *drvdata = priv->drvdata;
+    struct axiomnet_port_group *groups;
+    unsigned long *subport_used;
+    uint8_t *port_used;
+    int queue = priv->bind_port;
+    bool member_left = false;
 
     /* check if the process bound some port */
-    if (priv->bind_port == AXIOMNET_PORT_INVALID ||
-            priv->bind_port > AXIOM_PORT_MAX) {
+    if (queue == AXIOMNET_PORT_INVALID || queue >= AXIOMNET_RX_QUEUE_NUM) {
+        return;
+    }
+
+    if (priv->type == AXNET_FDTYPE_RAW) {
+        port_used = &drvdata->raw_rx_ring.port_used;
+        groups = drvdata->raw_rx_ring.groups;
+        subport_used = drvdata->raw_rx_ring.subport_used;
+    } else if (priv->type == AXNET_FDTYPE_LONG) {
+        port_used = &drvdata->rdma_rx_ring.port_used;
+        groups = drvdata->rdma_rx_ring.groups;
+        subport_used = drvdata->rdma_rx_ring.subport_used;
+    } else {
         return;
     }
 
     mutex_lock(&drvdata->lock);
-    if (priv->type == AXNET_FDTYPE_RAW)
-        drvdata->raw_rx_ring.port_used &= ~(1 << (uint8_t)(priv->bind_port));
-    if (priv->type == AXNET_FDTYPE_LONG)
-        drvdata->rdma_rx_ring.port_used &= ~(1 << (uint8_t)(priv->bind_port));
+    if (queue >= AXIOMNET_GROUP_QUEUE_BASE) {
+        int port, member;
+
+        queue -= AXIOMNET_GROUP_QUEUE_BASE;
+        port = queue / (AXIOMNET_GROUP_MAX - 1);
+        member = queue % (AXIOMNET_GROUP_MAX - 1) + 1;
+        axiomnet_group_leave(&groups[port], port_used, port, member);
+        member_left = true;
+    } else if (queue >= AXIOM_PORT_NUM) {
+        clear_bit(queue - AXIOM_PORT_NUM, subport_used);
+    } else if (groups[queue].members) {
+        /* first member of a group */
+        axiomnet_group_leave(&groups[queue], port_used, queue, 0);
+        member_left = true;
+    } else {
+        *port_used &= ~(1 << (uint8_t)queue);
+    }
     mutex_unlock(&drvdata->lock);
 
+    if (member_left)
+        axiomnet_group_flush(priv);
+
     priv->bind_port = AXIOMNET_PORT_INVALID;
 }
 
-static long axiomnet_bind(struct axiomnet_priv *priv, uint8_t *port) {
+/* bind a sub-port of AXIOM_PORT_SUB (drvdata->lock held) */
+static long axiomnet_bind_subport(struct axiomnet_priv *priv,
+        uint16_t *subport)
+{
+    struct axiomnet_drvdata *drvdata = priv->drvdata;
+    unsigned long *subport_used;
+
+    if (priv->type == AXNET_FDTYPE_RAW) {
+        subport_used = drvdata->raw_rx_ring.subport_used;
+    } else {
+        subport_used = drvdata->rdma_rx_ring.subport_used;
+    }
+
+    if (*subport == AXIOM_SUBPORT_ANY) {
+        /* assign first sub-port available */
+        *subport = find_first_zero_bit(subport_used, AXIOM_SUBPORT_NUM);
+        if (*subport >= AXIOM_SUBPORT_NUM) {
+            *subport = AXIOM_SUBPORT_ANY;
+            return -EBUSY;
+        }
+    } else if (*subport > AXIOM_SUBPORT_MAX) {
+        return -EFBIG;
+    }
+
+    DPRINTF("subport: %d", *subport);
+
+    /* check if sub-port is already bound */
+    if (test_bit(*subport, subport_used)) {
+        EPRINTF("Sub-port %d already bound", *subport);
+        return -EBUSY;
+    }
+
+    set_bit(*subport, subport_used);
+    priv->bind_port = AXIOMNET_SUBPORT_QUEUE(*subport);
+
+    return 0;
+}
+
+static long axiomnet_bind(struct axiomnet_priv *priv, uint8_t *port,
+        uint16_t *subport, uint32_t flags) {
     struct axiomnet_drvdata *drvdata = priv->drvdata;
+    struct axiomnet_port_group *group;
+    bool joined = false;
     long ret = 0;
     uint8_t port_used, port_set;
 
@@ -1864,14 +2806,21 @@ static long axiomnet_bind(struct axiomnet_priv *priv, uint8_t *port) {
 
     if (priv->type == AXNET_FDTYPE_RAW) {
         port_used = drvdata->raw_rx_ring.port_used;
+        group = drvdata->raw_rx_ring.groups;
     } else if (priv->type == AXNET_FDTYPE_LONG) {
         port_used = drvdata->rdma_rx_ring.port_used;
+        group = drvdata->rdma_rx_ring.groups;
     } else {
         EPRINTF("bind not allowed on this file descriptor");
         ret = -EFAULT;
         goto exit;
     }
 
+    if (*port == AXIOM_PORT_SUB) {
+        ret = axiomnet_bind_subport(priv, subport);
+        goto exit;
+    }
+
     if (*port == AXIOM_PORT_ANY) {
         int i;
         /* assign first port available */
@@ -1894,6 +2843,15 @@ static long axiomnet_bind(struct axiomnet_priv *priv, uint8_t *port) {
 
     DPRINTF("port: 0x%x port_used: 0x%x", *port, port_used);
 
+    group += *port;
+
+    /* join the group of fds that bound the port */
+    if ((flags & AXIOCTL_BIND_FLAGS_REUSEPORT) && group->members) {
+        ret = axiomnet_group_join(priv, group, *port);
+        joined = (ret == 0);
+        goto exit;
+    }
+
     /* check if port is already bound */
     if (((1 << *port) & port_used)) {
         EPRINTF("Port %d already bound", *port);
@@ -1910,11 +2868,22 @@ static long axiomnet_bind(struct axiomnet_priv *priv, uint8_t *port) {
         drvdata->rdma_rx_ring.port_used |= port_set;
     }
 
+    /* first member of a new group: it uses the queue of the port */
+    if (flags & AXIOCTL_BIND_FLAGS_REUSEPORT) {
+        group->hash_src = !!(flags & AXIOCTL_BIND_FLAGS_HASH_SRC);
+        group->next = 0;
+        WRITE_ONCE(group->members, 1UL);
+    }
+
     DPRINTF("port: 0x%x", *port);
 
 exit:
     mutex_unlock(&drvdata->lock);
 
+    /* don't inherit the messages of a member that left */
+    if (joined)
+        axiomnet_group_flush(priv);
+
     return ret;
 }
 
@@ -1947,11 +2916,14 @@ void axiomnet_debug_raw(struct axiomnet_drvdata *drvdata)
 
     printk(KERN_ERR "  rx-avail [HW]: %u\n",
             axiom_hw_raw_rx_avail(drvdata->dev_api));
-    printk(KERN_ERR "  rx-avail [SW] free_slot: %u\n",
-            eviq_free_avail(&rx_ring->sw_queue.evi_queue));
+    printk(KERN_ERR "  rx-avail [SW] free_slot: %d\n",
+            eviq_free_count(&rx_ring->sw_queue.evi_queue));
     for (i = 0; i < AXIOM_PORT_NUM; i++) {
-        printk(KERN_ERR "  rx-avail[%d] [SW]: %d\n", i,
-                axiomnet_raw_rx_avail(rx_ring, i));
+        printk(KERN_ERR "  rx-avail[%d] [SW]: %d (max %d) handoff: %d\n", i,
+                axiomnet_raw_rx_avail(rx_ring, i),
+                eviq_hwm(&rx_ring->sw_queue.evi_queue, i),
+                eviq_count(&rx_ring->sw_queue.evi_queue,
+                    AXIOMNET_RAW_HANDOFF_QUEUE(i)));
     }
 
 }
@@ -1967,11 +2939,12 @@ void axiomnet_debug_long(struct axiomnet_drvdata *drvdata)
     printk(KERN_ERR "  tx-avail [SW]: %d\n\n",
             axiomnet_long_tx_avail(tx_ring));
 
-    printk(KERN_ERR "  rx-avail [SW] free_slot: %u\n",
-            eviq_free_avail(&long_queue->evi_queue));
+    printk(KERN_ERR "  rx-avail [SW] free_slot: %d\n",
+            eviq_free_count(&long_queue->evi_queue));
     for (i = 0; i < AXIOM_PORT_NUM; i++) {
-        printk(KERN_ERR "  rx-avail[%d] [SW]: %d\n", i,
-                axiomnet_long_rx_avail(rx_ring, i));
+        printk(KERN_ERR "  rx-avail[%d] [SW]: %d (max %d)\n", i,
+                axiomnet_long_rx_avail(rx_ring, i),
+                eviq_hwm(&long_queue->evi_queue, i));
     }
 
 }
@@ -1982,144 +2955,846 @@ void axiomnet_debug_rdma(struct axiomnet_drvdata *drvdata)
     struct axiomnet_rdma_rx_hwring *rx_ring = &drvdata->rdma_rx_ring;
     int i;
 
-    printk(KERN_ERR "---- AXIOM DEBUG RDMA ----\n");
-    printk(KERN_ERR "  tx-avail [HW]: %u\n",
-            axiom_hw_rdma_tx_avail(drvdata->dev_api));
-    printk(KERN_ERR "  tx-avail [SW]: %d\n\n",
-            axiomnet_rdma_tx_avail(tx_ring));
+    printk(KERN_ERR "---- AXIOM DEBUG RDMA ----\n");
+    printk(KERN_ERR "  tx-avail [HW]: %u\n",
+            axiom_hw_rdma_tx_avail(drvdata->dev_api));
+    printk(KERN_ERR "  tx-avail [SW]: %d\n\n",
+            axiomnet_rdma_tx_avail(tx_ring));
+
+    printk(KERN_ERR "  rx-avail [HW]: %u\n\n",
+            axiom_hw_rdma_rx_avail(drvdata->dev_api));
+
+    for (i = 0; i < AXIOMNET_RDMA_QUEUE_FREE_LEN; i++) {
+        axiom_rdma_status_t *rdma_status =
+            &(rx_ring->tx_rdma_queue->queue_desc[i]);
+        printk(KERN_ERR "  rdma_status[%d] - ack_wait: 0x%x ack_recv: 0x%x "
+                "rid: 0x%x\n", i, rdma_status->ack_waiting,
+                rdma_status->ack_received, rdma_status->header.tx.dst);
+    }
+}
+
+
+int axiomnet_debug_info(struct axiomnet_drvdata *drvdata, uint32_t flags)
+{
+    if (!drvdata)
+        return -EINVAL;
+
+    printk(KERN_ERR "\n---- AXIOM NIC DEBUG ----\n\n");
+
+    if (flags & AXIOM_DEBUG_FLAG_STATUS)
+        axiom_print_status_reg(drvdata->dev_api);
+    if (flags & AXIOM_DEBUG_FLAG_CONTROL)
+        axiom_print_control_reg(drvdata->dev_api);
+    if (flags & AXIOM_DEBUG_FLAG_ROUTING)
+        axiom_print_routing_reg(drvdata->dev_api);
+    if (flags & AXIOM_DEBUG_FLAG_QUEUES)
+        axiom_print_queue_reg(drvdata->dev_api);
+    if (flags & AXIOM_DEBUG_FLAG_FPGA)
+        axiom_print_fpga_debug(drvdata->dev_api);
+
+    printk(KERN_ERR "\n---- AXIOM DRIVER DEBUG ----\n\n");
+    if (flags & AXIOM_DEBUG_FLAG_RAW)
+        axiomnet_debug_raw(drvdata);
+    if (flags & AXIOM_DEBUG_FLAG_LONG)
+        axiomnet_debug_long(drvdata);
+    if (flags & AXIOM_DEBUG_FLAG_RDMA)
+        axiomnet_debug_rdma(drvdata);
+
+    return 0;
+}
+
+/* copy the depth and the high-water mark of the RX queues in the stats */
+static void axiomnet_stats_update(struct axiomnet_drvdata *drvdata)
+{
+    struct axiomnet_raw_queue *sw_queue = &drvdata->raw_rx_ring.sw_queue;
+    struct axiomnet_long_queue *long_queue =
+        &drvdata->rdma_rx_ring.long_queue;
+    axiom_stats_t *stats = &drvdata->stats;
+    unsigned long flags;
+    int i;
+
+    spin_lock_irqsave(&sw_queue->queue_lock, flags);
+    for (i = 0; i < AXIOM_PORT_NUM; i++) {
+        stats->queue_raw_rx[i] = eviq_count(&sw_queue->evi_queue, i);
+        stats->hwm_raw_rx[i] = eviq_hwm(&sw_queue->evi_queue, i);
+    }
+    stats->free_raw_rx = eviq_free_count(&sw_queue->evi_queue);
+    spin_unlock_irqrestore(&sw_queue->queue_lock, flags);
+
+    spin_lock_irqsave(&long_queue->queue_lock, flags);
+    for (i = 0; i < AXIOM_PORT_NUM; i++) {
+        stats->queue_long_rx[i] = eviq_count(&long_queue->evi_queue, i);
+        stats->hwm_long_rx[i] = eviq_hwm(&long_queue->evi_queue, i);
+    }
+    stats->free_long_rx = eviq_free_count(&long_queue->evi_queue);
+    spin_unlock_irqrestore(&long_queue->queue_lock, flags);
+}
+
+/************************ AxiomNet Char Device  ******************************/
+
+static unsigned int axiomnet_poll_raw(struct file *filep, poll_table *wait)
+{
+    struct axiomnet_priv *priv = filep->private_data;
+    struct axiomnet_drvdata *drvdata = priv->drvdata;
+    struct axiomnet_raw_tx_hwring *tx_ring = &drvdata->raw_tx_ring;
+    struct axiomnet_raw_rx_hwring *rx_ring = &drvdata->raw_rx_ring;
+    int port = priv->bind_port;
+    unsigned int ret = 0;
+
+    poll_wait(filep, &tx_ring->port.wait_queue, wait);
+
+    if (poll_requested_events(wait) & POLLOUT) {
+        drvdata->stats.poll_raw_tx++;
+        if (axiomnet_raw_tx_avail(tx_ring) != 0) { /* space to write */
+            ret |= POLLOUT | POLLWRNORM;
+            drvdata->stats.poll_avail_raw_tx++;
+        }
+    }
+
+    if ((poll_requested_events(wait) & POLLIN) &&
+            (port != AXIOMNET_PORT_INVALID)) {
+        poll_wait(filep, &rx_ring->ports[port].wait_queue, wait);
+
+        drvdata->stats.poll_raw_rx++;
+        if (axiomnet_raw_rx_avail(rx_ring, port) != 0) { /* something to read */
+            ret |= POLLIN | POLLRDNORM;
+            drvdata->stats.poll_avail_raw_rx++;
+        }
+    }
+
+    return ret;
+}
+
+static unsigned int axiomnet_poll_rdma(struct file *filep, poll_table *wait)
+{
+    struct axiomnet_priv *priv = filep->private_data;
+    struct axiomnet_drvdata *drvdata = priv->drvdata;
+    struct axiomnet_rdma_tx_hwring *tx_ring = &drvdata->rdma_tx_ring;
+    unsigned int ret = 0;
+
+    if (poll_requested_events(wait) & POLLOUT) {
+        poll_wait(filep, &tx_ring->rdma_port.wait_queue, wait);
+
+        drvdata->stats.poll_rdma_tx++;
+        if (axiomnet_rdma_tx_avail(tx_ring) != 0) { /* space to write */
+            ret |= POLLOUT | POLLWRNORM;
+            drvdata->stats.poll_avail_rdma_tx++;
+        }
+    }
+
+    if (poll_requested_events(wait) & POLLIN) {
+        poll_wait(filep, &priv->rdma_wait_queue, wait);
+
+        drvdata->stats.poll_rdma_rx++;
+        /* one of the async RDMA sent by this open is completed */
+        if (atomic_read(&priv->rdma_completed) > 0) {
+            ret |= POLLIN | POLLRDNORM;
+            drvdata->stats.poll_avail_rdma_rx++;
+        }
+    }
+
+    return ret;
+}
+
+static unsigned int axiomnet_poll_long(struct file *filep, poll_table *wait)
+{
+    struct axiomnet_priv *priv = filep->private_data;
+    struct axiomnet_drvdata *drvdata = priv->drvdata;
+    struct axiomnet_rdma_tx_hwring *tx_ring = &drvdata->rdma_tx_ring;
+    struct axiomnet_rdma_rx_hwring *rx_ring = &drvdata->rdma_rx_ring;
+    int port = priv->bind_port;
+    unsigned int ret = 0;
+
+    poll_wait(filep, &tx_ring->long_port.wait_queue, wait);
+    poll_wait(filep, &tx_ring->rdma_port.wait_queue, wait);
+
+    if (poll_requested_events(wait) & POLLOUT) {
+        drvdata->stats.poll_long_tx++;
+        if ((axiomnet_long_tx_avail(tx_ring) != 0) &&
+                (axiomnet_rdma_tx_avail(tx_ring) != 0)) { /* space to write */
+            ret |= POLLOUT | POLLWRNORM;
+            drvdata->stats.poll_avail_long_tx++;
+        }
+    }
+
+    if ((poll_requested_events(wait) & POLLIN) &&
+            (port != AXIOMNET_PORT_INVALID)) {
+        if (port != AXIOMNET_PORT_INVALID) {
+            poll_wait(filep, &rx_ring->long_ports[port].wait_queue, wait);
+
+            drvdata->stats.poll_long_rx++;
+            if (axiomnet_long_rx_avail(rx_ring, port) != 0) { /* something to read */
+                ret |= POLLIN | POLLRDNORM;
+                drvdata->stats.poll_avail_long_rx++;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/****************************** Ring functions ********************************/
+
+/*
+ * The event fd can create a submission ring (SQ) and a completion ring (CQ),
+ * mapped in user space, to send RAW and LONG messages and to start RDMA
+ * through the fds attached to it: the process fills many SQE and the driver
+ * consumes all of them in a single AXNET_RING_ENTER. RAW and LONG requests
+ * complete when the message is queued in the NIC, RDMA requests when the ack
+ * is received, so hundreds of RDMA can be in flight. Every SQE consumed
+ * reserves a CQE, so the CQ never overflows.
+ */
+
+static void axiomnet_ring_put(struct axiomnet_ring *ring)
+{
+    if (!atomic_dec_and_test(&ring->refs))
+        return;
+
+    vfree(ring->ops);
+    vfree(ring->mem);
+    kfree(ring);
+}
+
+/* number of CQE posted and not yet consumed by the user */
+inline static uint32_t axiomnet_ring_cq_ready(struct axiomnet_ring *ring)
+{
+    return READ_ONCE(ring->cq_tail) - READ_ONCE(ring->hdr->cq_head);
+}
+
+/* reserve a CQE for a new request, returns false if the CQ is full */
+static bool axiomnet_ring_cq_reserve(struct axiomnet_ring *ring)
+{
+    unsigned long flags;
+    uint32_t used;
+    bool ret = false;
+
+    spin_lock_irqsave(&ring->cq_lock, flags);
+    used = ring->cq_tail - READ_ONCE(ring->hdr->cq_head);
+    if (used <= ring->cq_entries &&
+            used + ring->cq_reserved < ring->cq_entries) {
+        ring->cq_reserved++;
+        ret = true;
+    }
+    spin_unlock_irqrestore(&ring->cq_lock, flags);
+
+    return ret;
+}
+
+static void axiomnet_ring_cq_unreserve(struct axiomnet_ring *ring)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&ring->cq_lock, flags);
+    ring->cq_reserved--;
+    spin_unlock_irqrestore(&ring->cq_lock, flags);
+}
+
+/* post the CQE reserved by a request (cq_lock held) */
+inline static void axiomnet_ring_cq_post_locked(struct axiomnet_ring *ring,
+        uint64_t user_data, int result)
+{
+    axiom_ring_cqe_t *cqe = &ring->cqes[ring->cq_tail &
+        (ring->cq_entries - 1)];
+
+    cqe->user_data = user_data;
+    cqe->result = result;
+    cqe->flags = 0;
+
+    ring->cq_reserved--;
+    ring->cq_tail++;
+    /* the CQE must be visible before the new tail */
+    smp_store_release(&ring->hdr->cq_tail, ring->cq_tail);
+}
+
+inline static void axiomnet_ring_wake(struct axiomnet_ring *ring)
+{
+    if (wq_has_sleeper(&ring->wait_queue))
+        wake_up(&ring->wait_queue);
+}
+
+static void axiomnet_ring_cq_post(struct axiomnet_ring *ring,
+        uint64_t user_data, int result)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&ring->cq_lock, flags);
+    axiomnet_ring_cq_post_locked(ring, user_data, result);
+    spin_unlock_irqrestore(&ring->cq_lock, flags);
+
+    axiomnet_ring_wake(ring);
+}
+
+/*
+ * Each RDMA in flight holds a CQE reservation, so there are always free op
+ * contexts (one for each CQE)
+ */
+static struct axiomnet_ring_op *axiomnet_ring_op_get(struct axiomnet_ring *ring,
+        uint64_t user_data)
+{
+    struct axiomnet_ring_op *op;
+    unsigned long flags;
+
+    spin_lock_irqsave(&ring->cq_lock, flags);
+    op = ring->free_ops;
+    ring->free_ops = op->next;
+    spin_unlock_irqrestore(&ring->cq_lock, flags);
+
+    op->user_data = user_data;
+
+    return op;
+}
+
+inline static void axiomnet_ring_op_free_locked(struct axiomnet_ring *ring,
+        struct axiomnet_ring_op *op)
+{
+    op->next = ring->free_ops;
+    ring->free_ops = op;
+}
+
+/* called by the RDMA kthread when the ack of a RDMA request is received */
+static void axiomnet_ring_rdma_callback(struct axiomnet_drvdata *drvdata,
+        void *data, axiom_rdma_hdr_t *rdma_hdr)
+{
+    struct axiomnet_ring_op *op = data;
+    struct axiomnet_ring *ring = op->ring;
+    unsigned long flags;
+
+    spin_lock_irqsave(&ring->cq_lock, flags);
+    axiomnet_ring_cq_post_locked(ring, op->user_data,
+            rdma_hdr->rx.port_type.field.error ? -EIO : 0);
+    axiomnet_ring_op_free_locked(ring, op);
+    spin_unlock_irqrestore(&ring->cq_lock, flags);
+
+    axiomnet_ring_wake(ring);
+
+    /* the event fd may be already closed */
+    axiomnet_ring_put(ring);
+}
+
+/*
+ * Execute a SQE with a CQE reserved. Returns -EAGAIN or -ERESTARTSYS if the
+ * SQE must not be consumed, otherwise the result is posted in the CQ (now or
+ * when the RDMA ack is received).
+ */
+static int axiomnet_ring_sqe_exec(struct axiomnet_priv *priv,
+        struct axiomnet_ring *ring, axiom_ring_sqe_t *sqe)
+{
+    struct axiomnet_ring_op *op;
+    axiom_callback_t cb;
+    struct iovec iov;
+    struct file *file;
+    unsigned long flags;
+    bool nonblock = sqe->flags & AXIOM_RING_SQE_FLAGS_NONBLOCK;
+    int ret;
+
+    switch (sqe->opcode) {
+    case AXIOM_RING_OP_SEND_RAW:
+        file = READ_ONCE(priv->event_raw);
+        if (file == NULL) {
+            ret = -EBADF;
+            break;
+        }
+        iov.iov_base = sqe->op.raw.payload;
+        iov.iov_len = sqe->op.raw.header.tx.payload_size;
+        ret = axiomnet_raw_send(file, &(sqe->op.raw.header), &iov, 1,
+                nonblock || (file->f_flags & O_NONBLOCK));
+        break;
+    case AXIOM_RING_OP_SEND_LONG:
+        file = READ_ONCE(priv->event_long);
+        if (file == NULL) {
+            ret = -EBADF;
+            break;
+        }
+        iov.iov_base = sqe->op.long_msg.payload;
+        iov.iov_len = sqe->op.long_msg.header.tx.payload_size;
+        ret = axiomnet_long_send(file, &(sqe->op.long_msg.header), &iov, 1,
+                nonblock || (file->f_flags & O_NONBLOCK));
+        break;
+    case AXIOM_RING_OP_RDMA:
+        file = READ_ONCE(priv->event_rdma);
+        if (file == NULL) {
+            ret = -EBADF;
+            break;
+        }
+        ret = axiomnet_rdma_prepare(file->private_data, &(sqe->op.rdma));
+        if (ret)
+            break;
+
+        op = axiomnet_ring_op_get(ring, sqe->user_data);
+        cb.func = axiomnet_ring_rdma_callback;
+        cb.data = op;
+
+        /* the ring must survive until the ack is received */
+        atomic_inc(&ring->refs);
+        ret = axiomnet_rdma_tx(file, &(sqe->op.rdma.header), NULL, &cb,
+                nonblock ? AXIOCTL_RDMA_FLAGS_NONBLOCK : 0);
+        if (ret >= 0)
+            return 0;
+
+        /* the event fd holds a reference: refs can't drop to zero */
+        atomic_dec(&ring->refs);
+        spin_lock_irqsave(&ring->cq_lock, flags);
+        axiomnet_ring_op_free_locked(ring, op);
+        spin_unlock_irqrestore(&ring->cq_lock, flags);
+        break;
+    default:
+        ret = -EINVAL;
+    }
+
+    if (ret == -EAGAIN || ret == -ERESTARTSYS)
+        return ret;
+
+    axiomnet_ring_cq_post(ring, sqe->user_data, ret < 0 ? ret : 0);
+
+    return 0;
+}
+
+static long axiomnet_ring_setup(struct axiomnet_priv *priv,
+        axiom_ioctl_ring_setup_t *setup)
+{
+    struct axiomnet_ring *ring;
+    size_t sq_offset, cq_offset, size;
+    uint32_t entries;
+    long ret;
+    int i;
+
+    if (setup->sq_entries == 0 ||
+            setup->sq_entries > AXIOMNET_RING_MAX_ENTRIES)
+        return -EINVAL;
+
+    if (READ_ONCE(priv->ring))
+        return -EBUSY;
+
+    entries = roundup_pow_of_two(setup->sq_entries);
+
+    /* the SQ and the CQ start on different cache lines */
+    sq_offset = ALIGN(sizeof(axiom_ring_hdr_t), L1_CACHE_BYTES);
+    cq_offset = ALIGN(sq_offset + entries * sizeof(axiom_ring_sqe_t),
+            L1_CACHE_BYTES);
+    size = PAGE_ALIGN(cq_offset + 2 * entries * sizeof(axiom_ring_cqe_t));
+
+    ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+    if (ring == NULL)
+        return -ENOMEM;
+
+    ring->mem = vmalloc_user(size);
+    if (ring->mem == NULL) {
+        ret = -ENOMEM;
+        goto free_ring;
+    }
+
+    ring->ops = vzalloc(2 * entries * sizeof(*ring->ops));
+    if (ring->ops == NULL) {
+        ret = -ENOMEM;
+        goto free_mem;
+    }
+
+    ring->drvdata = priv->drvdata;
+    atomic_set(&ring->refs, 1);
+    ring->size = size;
+    ring->hdr = ring->mem;
+    ring->sqes = ring->mem + sq_offset;
+    ring->cqes = ring->mem + cq_offset;
+    ring->sq_entries = entries;
+    ring->cq_entries = 2 * entries;
+    ring->hdr->sq_mask = ring->sq_entries - 1;
+    ring->hdr->cq_mask = ring->cq_entries - 1;
+    mutex_init(&ring->submit_mutex);
+    spin_lock_init(&ring->cq_lock);
+    init_waitqueue_head(&ring->wait_queue);
+
+    for (i = 0; i < ring->cq_entries; i++) {
+        ring->ops[i].ring = ring;
+        axiomnet_ring_op_free_locked(ring, &ring->ops[i]);
+    }
+
+    /* only one ring for each event fd */
+    if (cmpxchg(&priv->ring, NULL, ring) != NULL) {
+        ret = -EBUSY;
+        goto free_ops;
+    }
+
+    setup->sq_entries = ring->sq_entries;
+    setup->cq_entries = ring->cq_entries;
+    setup->sq_offset = sq_offset;
+    setup->cq_offset = cq_offset;
+    setup->size = size;
+
+    return 0;
+
+free_ops:
+    vfree(ring->ops);
+free_mem:
+    vfree(ring->mem);
+free_ring:
+    kfree(ring);
+    return ret;
+}
+
+/*
+ * Consume up to enter->to_submit SQE, then wait until enter->min_complete
+ * CQE are available. Returns the number of SQE consumed.
+ */
+static long axiomnet_ring_enter(struct axiomnet_priv *priv,
+        axiom_ioctl_ring_enter_t *enter)
+{
+    struct axiomnet_ring *ring = READ_ONCE(priv->ring);
+    struct axiomnet_drvdata *drvdata = priv->drvdata;
+    axiom_ring_sqe_t sqe;
+    uint32_t tail, submitted = 0, min_complete;
+    long ret = 0;
+
+    if (ring == NULL)
+        return -EINVAL;
+
+    drvdata->stats.ring_enter++;
+
+    mutex_lock(&ring->submit_mutex);
+
+    tail = smp_load_acquire(&ring->hdr->sq_tail);
+    if (unlikely(tail - ring->sq_head > ring->sq_entries)) {
+        mutex_unlock(&ring->submit_mutex);
+        return -EINVAL;
+    }
+
+    while (submitted < enter->to_submit && ring->sq_head != tail) {
+        if (!axiomnet_ring_cq_reserve(ring)) {
+            ret = -EBUSY;
+            break;
+        }
+
+        /* the user can change the SQE at any time: execute a copy */
+        memcpy(&sqe, &ring->sqes[ring->sq_head & (ring->sq_entries - 1)],
+                sizeof(sqe));
+
+        ret = axiomnet_ring_sqe_exec(priv, ring, &sqe);
+        if (ret) {
+            axiomnet_ring_cq_unreserve(ring);
+            break;
+        }
+
+        ring->sq_head++;
+        submitted++;
+    }
+
+    /* the user can reuse the SQE consumed */
+    smp_store_release(&ring->hdr->sq_head, ring->sq_head);
+    drvdata->stats.ring_sqe += submitted;
+
+    mutex_unlock(&ring->submit_mutex);
+
+    if (ret && submitted == 0)
+        return ret;
+
+    min_complete = min(enter->min_complete, ring->cq_entries);
+    if (min_complete && wait_event_interruptible(ring->wait_queue,
+                axiomnet_ring_cq_ready(ring) >= min_complete)) {
+        if (submitted == 0)
+            return -ERESTARTSYS;
+    }
+
+    return submitted;
+}
+
+/* map read-only the information page of the device */
+static int axiomnet_mmap_info(struct axiomnet_drvdata *drvdata,
+        struct vm_area_struct *vma)
+{
+    if (vma->vm_end - vma->vm_start > PAGE_SIZE ||
+            (vma->vm_flags & VM_WRITE))
+        return -EINVAL;
+
+    vma->vm_flags &= ~VM_MAYWRITE;
+
+    return remap_pfn_range(vma, vma->vm_start,
+            virt_to_phys(drvdata->info_page) >> PAGE_SHIFT, PAGE_SIZE,
+            vma->vm_page_prot);
+}
+
+static int axiomnet_mmap_generic(struct file *filep,
+        struct vm_area_struct *vma)
+{
+    struct axiomnet_priv *priv = filep->private_data;
+    struct axiomnet_ring *ring = READ_ONCE(priv->ring);
+
+    if (vma->vm_pgoff == (AXIOM_INFO_MMAP_OFFSET >> PAGE_SHIFT))
+        return axiomnet_mmap_info(priv->drvdata, vma);
 
-    printk(KERN_ERR "  rx-avail [HW]: %u\n\n",
-            axiom_hw_rdma_rx_avail(drvdata->dev_api));
+    if (ring == NULL || vma->vm_pgoff != 0 ||
+            vma->vm_end - vma->vm_start > ring->size)
+        return -EINVAL;
 
-    for (i = 0; i < AXIOMNET_RDMA_QUEUE_FREE_LEN; i++) {
-        axiom_rdma_status_t *rdma_status =
-            &(rx_ring->tx_rdma_queue->queue_desc[i]);
-        printk(KERN_ERR "  rdma_status[%d] - ack_wait: 0x%x ack_recv: 0x%x "
-                "rid: 0x%x\n", i, rdma_status->ack_waiting,
-                rdma_status->ack_received, rdma_status->header.tx.dst);
-    }
+    return remap_vmalloc_range(vma, ring->mem, 0);
 }
 
+/***************************** Event functions ********************************/
 
-int axiomnet_debug_info(struct axiomnet_drvdata *drvdata, uint32_t flags)
+static struct file_operations axiomnet_raw_fops;
+static struct file_operations axiomnet_long_fops;
+static struct file_operations axiomnet_rdma_fops;
+
+/*
+ * The generic fd works as event fd: it is readable when one of the RAW, LONG
+ * and RDMA fds attached to it has something to receive. It waits on the wait
+ * queues of the attached fds, which are woken when a port queue becomes not
+ * empty or when an async RDMA completes, so with epoll it can be used
+ * edge-triggered. The RAW and LONG ports must be bound before adding the
+ * event fd to a poll/epoll set.
+ */
+static long axiomnet_event_attach(struct axiomnet_priv *priv, int fd)
 {
-    if (!drvdata)
-        return -EINVAL;
+    struct file *file, **slot;
+    long ret;
 
-    printk(KERN_ERR "\n---- AXIOM NIC DEBUG ----\n\n");
+    file = fget(fd);
+    if (file == NULL)
+        return -EBADF;
 
-    if (flags & AXIOM_DEBUG_FLAG_STATUS)
-        axiom_print_status_reg(drvdata->dev_api);
-    if (flags & AXIOM_DEBUG_FLAG_CONTROL)
-        axiom_print_control_reg(drvdata->dev_api);
-    if (flags & AXIOM_DEBUG_FLAG_ROUTING)
-        axiom_print_routing_reg(drvdata->dev_api);
-    if (flags & AXIOM_DEBUG_FLAG_QUEUES)
-        axiom_print_queue_reg(drvdata->dev_api);
-    if (flags & AXIOM_DEBUG_FLAG_FPGA)
-        axiom_print_fpga_debug(drvdata->dev_api);
+    if (file->f_op == &axiomnet_raw_fops) {
+        slot = &priv->event_raw;
+    } else if (file->f_op == &axiomnet_long_fops) {
+        slot = &priv->event_long;
+    } else if (file->f_op == &axiomnet_rdma_fops) {
+        slot = &priv->event_rdma;
+    } else {
+        ret = -EINVAL;
+        goto err;
+    }
 
-    printk(KERN_ERR "\n---- AXIOM DRIVER DEBUG ----\n\n");
-    if (flags & AXIOM_DEBUG_FLAG_RAW)
-        axiomnet_debug_raw(drvdata);
-    if (flags & AXIOM_DEBUG_FLAG_LONG)
-        axiomnet_debug_long(drvdata);
-    if (flags & AXIOM_DEBUG_FLAG_RDMA)
-        axiomnet_debug_rdma(drvdata);
+    /* the ports of the attached fd are looked up in the rings of this device */
+    if (((struct axiomnet_priv *)file->private_data)->drvdata !=
+            priv->drvdata) {
+        ret = -EINVAL;
+        goto err;
+    }
+
+    /* the attached fd can't be replaced while the event fd is polled */
+    if (cmpxchg(slot, NULL, file) != NULL) {
+        ret = -EBUSY;
+        goto err;
+    }
 
     return 0;
+
+err:
+    fput(file);
+    return ret;
 }
 
-/************************ AxiomNet Char Device  ******************************/
+static void axiomnet_event_release(struct axiomnet_priv *priv)
+{
+    if (priv->event_raw)
+        fput(priv->event_raw);
+    if (priv->event_long)
+        fput(priv->event_long);
+    if (priv->event_rdma)
+        fput(priv->event_rdma);
+}
 
-static unsigned int axiomnet_poll_raw(struct file *filep, poll_table *wait)
+/* returns the pending events (AXIOM_EVENT_*) of the attached fds */
+static uint32_t axiomnet_event_poll(struct file *filep, poll_table *wait)
 {
     struct axiomnet_priv *priv = filep->private_data;
     struct axiomnet_drvdata *drvdata = priv->drvdata;
-    struct axiomnet_raw_tx_hwring *tx_ring = &drvdata->raw_tx_ring;
-    struct axiomnet_raw_rx_hwring *rx_ring = &drvdata->raw_rx_ring;
-    int port = priv->bind_port;
-    unsigned int ret = 0;
+    struct axiomnet_raw_rx_hwring *raw_rx_ring = &drvdata->raw_rx_ring;
+    struct axiomnet_rdma_rx_hwring *rdma_rx_ring = &drvdata->rdma_rx_ring;
+    struct axiomnet_priv *src;
+    struct axiomnet_ring *ring;
+    struct file *file;
+    uint32_t events = 0;
+    int port;
 
-    poll_wait(filep, &tx_ring->port.wait_queue, wait);
+    file = READ_ONCE(priv->event_raw);
+    if (file) {
+        src = file->private_data;
+        port = READ_ONCE(src->bind_port);
+        if (port != AXIOMNET_PORT_INVALID) {
+            poll_wait(filep, &raw_rx_ring->ports[port].wait_queue, wait);
+            if (axiomnet_raw_rx_avail(raw_rx_ring, port) != 0)
+                events |= AXIOM_EVENT_RAW;
+        }
+    }
 
-    if (poll_requested_events(wait) & POLLOUT) {
-        drvdata->stats.poll_raw_tx++;
-        if (axiomnet_raw_tx_avail(tx_ring) != 0) { /* space to write */
-            ret |= POLLOUT | POLLWRNORM;
-            drvdata->stats.poll_avail_raw_tx++;
+    file = READ_ONCE(priv->event_long);
+    if (file) {
+        src = file->private_data;
+        port = READ_ONCE(src->bind_port);
+        if (port != AXIOMNET_PORT_INVALID) {
+            poll_wait(filep, &rdma_rx_ring->long_ports[port].wait_queue, wait);
+            if (axiomnet_long_rx_avail(rdma_rx_ring, port) != 0)
+                events |= AXIOM_EVENT_LONG;
         }
     }
 
-    if ((poll_requested_events(wait) & POLLIN) &&
-            (port != AXIOMNET_PORT_INVALID)) {
-        poll_wait(filep, &rx_ring->ports[port].wait_queue, wait);
+    file = READ_ONCE(priv->event_rdma);
+    if (file) {
+        src = file->private_data;
+        poll_wait(filep, &src->rdma_wait_queue, wait);
+        if (atomic_read(&src->rdma_completed) > 0)
+            events |= AXIOM_EVENT_RDMA;
+    }
 
-        drvdata->stats.poll_raw_rx++;
-        if (axiomnet_raw_rx_avail(rx_ring, port) != 0) { /* something to read */
-            ret |= POLLIN | POLLRDNORM;
-            drvdata->stats.poll_avail_raw_rx++;
-        }
+    ring = READ_ONCE(priv->ring);
+    if (ring) {
+        poll_wait(filep, &ring->wait_queue, wait);
+        if (axiomnet_ring_cq_ready(ring) != 0)
+            events |= AXIOM_EVENT_CQ;
     }
 
-    return ret;
+    return events;
 }
 
-static unsigned int axiomnet_poll_rdma(struct file *filep, poll_table *wait)
+static unsigned int axiomnet_poll_generic(struct file *filep, poll_table *wait)
+{
+    if (axiomnet_event_poll(filep, wait) != 0)
+        return POLLIN | POLLRDNORM;
+
+    return 0;
+}
+
+/* wait until the port of the RAW or of the LONG attached fd is not empty */
+static long axiomnet_recv_wait(struct axiomnet_priv *priv)
 {
-    struct axiomnet_priv *priv = filep->private_data;
     struct axiomnet_drvdata *drvdata = priv->drvdata;
-    struct axiomnet_rdma_tx_hwring *tx_ring = &drvdata->rdma_tx_ring;
-    unsigned int ret = 0;
+    struct axiomnet_raw_rx_hwring *raw_rx_ring = &drvdata->raw_rx_ring;
+    struct axiomnet_rdma_rx_hwring *rdma_rx_ring = &drvdata->rdma_rx_ring;
+    wait_queue_head_t *raw_wq = NULL, *long_wq = NULL;
+    int raw_port = AXIOMNET_PORT_INVALID, long_port = AXIOMNET_PORT_INVALID;
+    DEFINE_WAIT(raw_wait);
+    DEFINE_WAIT(long_wait);
+    long ret = 0;
 
-    poll_wait(filep, &tx_ring->rdma_port.wait_queue, wait);
+    if (priv->event_raw) {
+        raw_port = READ_ONCE(((struct axiomnet_priv *)
+                    priv->event_raw->private_data)->bind_port);
+        if (raw_port != AXIOMNET_PORT_INVALID)
+            raw_wq = &raw_rx_ring->ports[raw_port].wait_queue;
+    }
 
-    if (poll_requested_events(wait) & POLLOUT) {
-        drvdata->stats.poll_rdma_tx++;
-        if (axiomnet_rdma_tx_avail(tx_ring) != 0) { /* space to write */
-            ret |= POLLOUT | POLLWRNORM;
-            drvdata->stats.poll_avail_rdma_tx++;
+    if (priv->event_long) {
+        long_port = READ_ONCE(((struct axiomnet_priv *)
+                    priv->event_long->private_data)->bind_port);
+        if (long_port != AXIOMNET_PORT_INVALID)
+            long_wq = &rdma_rx_ring->long_ports[long_port].wait_queue;
+    }
+
+    if (raw_wq == NULL && long_wq == NULL) {
+        EPRINTF("port not assigned");
+        return -EFAULT;
+    }
+
+    for (;;) {
+        if (raw_wq)
+            prepare_to_wait(raw_wq, &raw_wait, TASK_INTERRUPTIBLE);
+        if (long_wq)
+            prepare_to_wait(long_wq, &long_wait, TASK_INTERRUPTIBLE);
+
+        if (raw_wq && axiomnet_raw_rx_avail(raw_rx_ring, raw_port) != 0)
+            break;
+        if (long_wq && axiomnet_long_rx_avail(rdma_rx_ring, long_port) != 0)
+            break;
+
+        if (signal_pending(current)) {
+            ret = -ERESTARTSYS;
+            break;
         }
+
+        schedule();
     }
 
+    if (raw_wq)
+        finish_wait(raw_wq, &raw_wait);
+    if (long_wq)
+        finish_wait(long_wq, &long_wait);
+
     return ret;
 }
 
-static unsigned int axiomnet_poll_long(struct file *filep, poll_table *wait)
+/* poll the ports of the RAW and of the LONG fds attached to the event fd */
+static bool axiomnet_recv_busy_poll(struct axiomnet_priv *priv)
+{
+    struct file *raw_file = READ_ONCE(priv->event_raw);
+    struct file *long_file = READ_ONCE(priv->event_long);
+    struct axiomnet_priv *port_priv;
+
+    if (raw_file) {
+        port_priv = raw_file->private_data;
+        if (READ_ONCE(port_priv->bind_port) != AXIOMNET_PORT_INVALID &&
+                axiomnet_raw_rx_busy_poll(port_priv))
+            return true;
+    }
+
+    if (long_file) {
+        port_priv = long_file->private_data;
+        if (READ_ONCE(port_priv->bind_port) != AXIOMNET_PORT_INVALID &&
+                axiomnet_long_rx_busy_poll(port_priv))
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Receive a RAW or a LONG message, whichever is available, from the fds
+ * attached to the event fd, with a single syscall. The queue checked first
+ * alternates after each message, so a busy queue can't starve the other one.
+ */
+static long axiomnet_recv(struct file *filep, axiom_ioctl_recv_iov_t *recv,
+        struct iovec *iov)
 {
     struct axiomnet_priv *priv = filep->private_data;
-    struct axiomnet_drvdata *drvdata = priv->drvdata;
-    struct axiomnet_rdma_tx_hwring *tx_ring = &drvdata->rdma_tx_ring;
-    struct axiomnet_rdma_rx_hwring *rx_ring = &drvdata->rdma_rx_ring;
-    int port = priv->bind_port;
-    unsigned int ret = 0;
+    struct file *raw_file = READ_ONCE(priv->event_raw);
+    struct file *long_file = READ_ONCE(priv->event_long);
+    bool nonblock = (filep->f_flags & O_NONBLOCK) ||
+        (recv->flags & AXIOCTL_RECV_FLAGS_NONBLOCK);
+    bool polled = false;
+    long ret;
+    int i, queue;
 
-    poll_wait(filep, &tx_ring->long_port.wait_queue, wait);
-    poll_wait(filep, &tx_ring->rdma_port.wait_queue, wait);
+    if (raw_file == NULL && long_file == NULL)
+        return -EINVAL;
 
-    if (poll_requested_events(wait) & POLLOUT) {
-        drvdata->stats.poll_long_tx++;
-        if ((axiomnet_long_tx_avail(tx_ring) != 0) &&
-                (axiomnet_rdma_tx_avail(tx_ring) != 0)) { /* space to write */
-            ret |= POLLOUT | POLLWRNORM;
-            drvdata->stats.poll_avail_long_tx++;
+    for (;;) {
+        for (i = 0; i < 2; i++) {
+            queue = (priv->recv_next + i) & 1;
+
+            if (queue == 0 && raw_file) {
+                recv->header.raw.rx.payload_size = min_t(uint32_t,
+                        recv->payload_size, AXIOM_RAW_PAYLOAD_MAX_SIZE);
+                ret = axiomnet_raw_recv(raw_file, &recv->header.raw, iov,
+                        recv->iovcnt, true);
+                recv->event = AXIOM_EVENT_RAW;
+            } else if (queue == 1 && long_file) {
+                recv->header.rdma.rx.payload_size = min_t(uint32_t,
+                        recv->payload_size, AXIOM_LONG_PAYLOAD_MAX_SIZE);
+                ret = axiomnet_long_recv(long_file, &recv->header.rdma, iov,
+                        recv->iovcnt, true);
+                recv->event = AXIOM_EVENT_LONG;
+            } else {
+                continue;
+            }
+
+            if (ret != -EAGAIN) {
+                if (ret >= 0)
+                    priv->recv_next = !queue;
+                return ret;
+            }
         }
-    }
 
-    if ((poll_requested_events(wait) & POLLIN) &&
-            (port != AXIOMNET_PORT_INVALID)) {
-        if (port != AXIOMNET_PORT_INVALID) {
-            poll_wait(filep, &rx_ring->long_ports[port].wait_queue, wait);
+        if (nonblock)
+            return -EAGAIN;
 
-            drvdata->stats.poll_long_rx++;
-            if (axiomnet_long_rx_avail(rx_ring, port) != 0) { /* something to read */
-                ret |= POLLIN | POLLRDNORM;
-                drvdata->stats.poll_avail_long_rx++;
-            }
+        /* spin for a while before sleeping */
+        if (!polled) {
+            polled = true;
+            if (axiomnet_busy_poll(priv, axiomnet_recv_busy_poll))
+                continue;
         }
-    }
 
-    return ret;
+        ret = axiomnet_recv_wait(priv);
+        if (ret)
+            return ret;
+    }
 }
 
 static long axiomnet_ioctl_raw(struct file *filep, unsigned int cmd,
@@ -2145,7 +3820,8 @@ static long axiomnet_ioctl_raw(struct file *filep, unsigned int cmd,
         ret = axiom_copy_from_user(&buf_bind, argp, sizeof(buf_bind));
         if (ret)
             return -EFAULT;
-        ret = axiomnet_bind(priv, &(buf_bind.port));
+        ret = axiomnet_bind(priv, &(buf_bind.port), &(buf_bind.subport),
+                buf_bind.flags);
         DPRINTF("bind port: %x flush: %x", priv->bind_port, buf_bind.flush);
         if (ret)
             return ret;
@@ -2159,13 +3835,17 @@ static long axiomnet_ioctl_raw(struct file *filep, unsigned int cmd,
         if (ret)
             return -EFAULT;
         break;
+    case AXNET_UNBIND:
+        axiomnet_unbind(priv);
+        break;
     case AXNET_SEND_RAW:
         ret = axiom_copy_from_user(&buf_raw, argp, sizeof(buf_raw));
         if (ret)
             return -EFAULT;
         iov[0].iov_base = buf_raw.payload;
         iov[0].iov_len = buf_raw.header.tx.payload_size;
-        ret = axiomnet_raw_send(filep, &(buf_raw.header), iov, 1);
+        ret = axiomnet_raw_send(filep, &(buf_raw.header), iov, 1,
+                axiomnet_nonblock(filep, buf_raw.flags));
         break;
     case AXNET_SEND_RAW_IOV:
         ret = axiom_copy_from_user(&buf_raw_iov, argp, sizeof(buf_raw_iov));
@@ -2178,7 +3858,8 @@ static long axiomnet_ioctl_raw(struct file *filep, unsigned int cmd,
         if (ret)
             return -EFAULT;
         ret = axiomnet_raw_send(filep, &(buf_raw_iov.header), iov,
-                buf_raw_iov.iovcnt);
+                buf_raw_iov.iovcnt,
+                axiomnet_nonblock(filep, buf_raw_iov.flags));
         break;
     case AXNET_RECV_RAW:
         ret = axiom_copy_from_user(&buf_raw, argp, sizeof(buf_raw));
@@ -2186,7 +3867,8 @@ static long axiomnet_ioctl_raw(struct file *filep, unsigned int cmd,
             return -EFAULT;
         iov[0].iov_base = buf_raw.payload;
         iov[0].iov_len = buf_raw.header.rx.payload_size;
-        ret = axiomnet_raw_recv(filep, &(buf_raw.header), iov, 1);
+        ret = axiomnet_raw_recv(filep, &(buf_raw.header), iov, 1,
+                axiomnet_nonblock(filep, buf_raw.flags));
         if (ret < 0)
             return ret;
         ret = axiom_copy_to_user(argp, &buf_raw, sizeof(buf_raw));
@@ -2204,7 +3886,8 @@ static long axiomnet_ioctl_raw(struct file *filep, unsigned int cmd,
         if (ret)
             return -EFAULT;
         ret = axiomnet_raw_recv(filep, &(buf_raw_iov.header), iov,
-                buf_raw_iov.iovcnt);
+                buf_raw_iov.iovcnt,
+                axiomnet_nonblock(filep, buf_raw_iov.flags));
         if (ret < 0)
             return ret;
         ret = axiom_copy_to_user(argp, &buf_raw_iov, sizeof(buf_raw_iov));
@@ -2225,6 +3908,12 @@ static long axiomnet_ioctl_raw(struct file *filep, unsigned int cmd,
     case AXNET_FLUSH_RAW:
         ret = axiomnet_raw_flush(priv);
         break;
+    case AXNET_SET_BUSY_POLL:
+        ret = get_user(buf_int, (int __user*)arg);
+        if (ret)
+            return -EFAULT;
+        ret = axiomnet_set_busy_poll(priv, buf_int);
+        break;
     default:
         ret = -EINVAL;
     }
@@ -2256,7 +3945,8 @@ static long axiomnet_ioctl_long(struct file *filep, unsigned int cmd,
         ret = axiom_copy_from_user(&buf_bind, argp, sizeof(buf_bind));
         if (ret)
             return -EFAULT;
-        ret = axiomnet_bind(priv, &(buf_bind.port));
+        ret = axiomnet_bind(priv, &(buf_bind.port), &(buf_bind.subport),
+                buf_bind.flags);
         DPRINTF("bind port: %x flush: %x", priv->bind_port, buf_bind.flush);
         if (ret)
             return ret;
@@ -2270,13 +3960,17 @@ static long axiomnet_ioctl_long(struct file *filep, unsigned int cmd,
         if (ret)
             return -EFAULT;
         break;
+    case AXNET_UNBIND:
+        axiomnet_unbind(priv);
+        break;
     case AXNET_SEND_LONG:
         ret = axiom_copy_from_user(&buf_long, argp, sizeof(buf_long));
         if (ret)
             return -EFAULT;
         iov[0].iov_base = buf_long.payload;
         iov[0].iov_len = buf_long.header.tx.payload_size;
-        ret = axiomnet_long_send(filep, &(buf_long.header), iov, 1);
+        ret = axiomnet_long_send(filep, &(buf_long.header), iov, 1,
+                filep->f_flags & O_NONBLOCK);
         break;
     case AXNET_SEND_LONG_IOV:
         ret = axiom_copy_from_user(&buf_long_iov, argp, sizeof(buf_long_iov));
@@ -2289,7 +3983,8 @@ static long axiomnet_ioctl_long(struct file *filep, unsigned int cmd,
         if (ret)
             return -EFAULT;
         ret = axiomnet_long_send(filep, &(buf_long_iov.header), iov,
-                buf_long_iov.iovcnt);
+                buf_long_iov.iovcnt,
+                axiomnet_nonblock(filep, buf_long_iov.flags));
         break;
     case AXNET_RECV_LONG:
         ret = axiom_copy_from_user(&buf_long, argp, sizeof(buf_long));
@@ -2297,7 +3992,8 @@ static long axiomnet_ioctl_long(struct file *filep, unsigned int cmd,
             return -EFAULT;
         iov[0].iov_base = buf_long.payload;
         iov[0].iov_len = buf_long.header.rx.payload_size;
-        ret = axiomnet_long_recv(filep, &(buf_long.header), iov, 1);
+        ret = axiomnet_long_recv(filep, &(buf_long.header), iov, 1,
+                filep->f_flags & O_NONBLOCK);
         if (ret < 0)
             return ret;
         ret = axiom_copy_to_user(argp, &buf_long, sizeof(buf_long));
@@ -2315,7 +4011,8 @@ static long axiomnet_ioctl_long(struct file *filep, unsigned int cmd,
         if (ret)
             return -EFAULT;
         ret = axiomnet_long_recv(filep, &(buf_long_iov.header), iov,
-                buf_long_iov.iovcnt);
+                buf_long_iov.iovcnt,
+                axiomnet_nonblock(filep, buf_long_iov.flags));
         if (ret < 0)
             return ret;
         ret = axiom_copy_to_user(argp, &buf_long_iov, sizeof(buf_long_iov));
@@ -2337,6 +4034,12 @@ static long axiomnet_ioctl_long(struct file *filep, unsigned int cmd,
     case AXNET_FLUSH_LONG:
         ret = axiomnet_long_flush(priv);
         break;
+    case AXNET_SET_BUSY_POLL:
+        ret = get_user(buf_int, (int __user*)arg);
+        if (ret)
+            return -EFAULT;
+        ret = axiomnet_set_busy_poll(priv, buf_int);
+        break;
     default:
         ret = -EINVAL;
     }
@@ -2353,8 +4056,9 @@ static long axiomnet_ioctl_rdma(struct file *filep, unsigned int cmd,
     void __user* argp = (void __user*)arg;
     axiom_ioctl_rdma_t buf_rdma;
     axiom_ioctl_token_t buf_token;
+    axiom_ioctl_mr_t buf_mr;
     uint64_t buf_uint64;
-    unsigned long buf_ulong;
+    uint32_t buf_uint32;
     long ret = 0, err;
 
     DPRINTF("start");
@@ -2373,33 +4077,9 @@ static long axiomnet_ioctl_rdma(struct file *filep, unsigned int cmd,
         if (ret)
             return -EFAULT;
 
-        if (likely(priv->rdma_debug == 0)) {
-            ret = axiom_mem_dev_virt2off(buf_rdma.app_id,
-                    (unsigned long)(buf_rdma.src_addr),
-                    buf_rdma.header.tx.payload_size,
-                    &buf_ulong);
-            if (ret) {
-                EPRINTF("axiom_mem_dev_virt2off - ret %ld", ret);
-                return -EFAULT;
-            }
-            buf_rdma.header.tx.src_addr = buf_ulong;
-
-            ret = axiom_mem_dev_virt2off(buf_rdma.app_id,
-                    (unsigned long)(buf_rdma.dst_addr),
-                    buf_rdma.header.tx.payload_size,
-                    &buf_ulong);
-            if (ret) {
-                EPRINTF("axiom_mem_dev_virt2off - ret %ld", ret);
-                return -EFAULT;
-            }
-            buf_rdma.header.tx.dst_addr = buf_ulong;
-        } else { /* if RDMA debug is enabled, we can't use the allocator API */
-            buf_rdma.header.tx.src_addr = (unsigned long)(buf_rdma.src_addr);
-            buf_rdma.header.tx.dst_addr = (unsigned long)(buf_rdma.dst_addr);
-        }
-
-        IPRINTF(verbose, "RDMA - src_offset: %d dst_offset: %d",
-                buf_rdma.header.tx.src_addr, buf_rdma.header.tx.dst_addr);
+        ret = axiomnet_rdma_prepare(priv, &buf_rdma);
+        if (ret)
+            return ret;
 
         ret = axiomnet_rdma_tx(filep, &(buf_rdma.header), &(buf_rdma.token),
                 NULL, buf_rdma.flags);
@@ -2410,6 +4090,25 @@ static long axiomnet_ioctl_rdma(struct file *filep, unsigned int cmd,
         if (err)
             return -EFAULT;
         break;
+    case AXNET_MR_REG:
+        ret = axiom_copy_from_user(&buf_mr, argp, sizeof(buf_mr));
+        if (ret)
+            return -EFAULT;
+
+        ret = axiomnet_mr_reg(priv, &buf_mr);
+        if (ret)
+            return ret;
+
+        err = axiom_copy_to_user(argp, &buf_mr, sizeof(buf_mr));
+        if (err)
+            return -EFAULT;
+        break;
+    case AXNET_MR_DEREG:
+        ret = get_user(buf_uint32, (uint32_t __user*)arg);
+        if (ret)
+            return -EFAULT;
+        ret = axiomnet_mr_dereg(priv, buf_uint32);
+        break;
     case AXNET_RDMA_CHECK:
         ret = axiom_copy_from_user(&buf_token, argp, sizeof(buf_token));
         if (ret)
@@ -2444,7 +4143,13 @@ static long axiomnet_ioctl_generic(struct file *filep, unsigned int cmd,
     uint8_t buf_uint8;
     uint8_t buf_uint8_2;
     axiom_ioctl_routing_t buf_routing;
+    axiom_ioctl_routing_table_t buf_routing_table;
     axiom_ioctl_debug_t buf_debug;
+    axiom_ioctl_recv_iov_t buf_recv;
+    axiom_ioctl_ring_setup_t buf_ring_setup;
+    axiom_ioctl_ring_enter_t buf_ring_enter;
+    struct iovec iov[AXIOMNET_MAX_IOVEC];
+    int buf_int;
     long ret = 0;
 
     DPRINTF("start");
@@ -2467,23 +4172,46 @@ static long axiomnet_ioctl_generic(struct file *filep, unsigned int cmd,
         ret = axiom_copy_from_user(&buf_routing, argp, sizeof(buf_routing));
         if (ret)
             return -EFAULT;
+        mutex_lock(&drvdata->lock);
         ret = axiom_hw_set_routing(drvdata->dev_api, buf_routing.node_id,
                 buf_routing.enabled_mask);
+        if (ret == 0) {
+            drvdata->routing_table[buf_routing.node_id] =
+                buf_routing.enabled_mask;
+            WRITE_ONCE(drvdata->info_page->routing_gen, ++drvdata->routing_gen);
+        }
+        mutex_unlock(&drvdata->lock);
         if (ret)
             return -EFAULT;
-        drvdata->routing_table[buf_routing.node_id] = buf_routing.enabled_mask;
         break;
     case AXNET_GET_ROUTING:
         ret = axiom_copy_from_user(&buf_routing, argp, sizeof(buf_routing));
         if (ret)
             return -EFAULT;
+        mutex_lock(&drvdata->lock);
         ret = axiom_hw_get_routing(drvdata->dev_api, buf_routing.node_id,
                 &buf_routing.enabled_mask);
+        if (ret == 0 && drvdata->routing_table[buf_routing.node_id] !=
+                buf_routing.enabled_mask) {
+            drvdata->routing_table[buf_routing.node_id] =
+                buf_routing.enabled_mask;
+            WRITE_ONCE(drvdata->info_page->routing_gen, ++drvdata->routing_gen);
+        }
+        mutex_unlock(&drvdata->lock);
         if (ret)
             return -EFAULT;
-        drvdata->routing_table[buf_routing.node_id] = buf_routing.enabled_mask;
         ret = axiom_copy_to_user(argp, &buf_routing, sizeof(buf_routing));
         break;
+    case AXNET_GET_ROUTING_TABLE:
+        /* the copy of the mirror does not read the HW routing table */
+        mutex_lock(&drvdata->lock);
+        buf_routing_table.generation = drvdata->routing_gen;
+        memcpy(buf_routing_table.enabled_mask, drvdata->routing_table,
+                sizeof(buf_routing_table.enabled_mask));
+        mutex_unlock(&drvdata->lock);
+        ret = axiom_copy_to_user(argp, &buf_routing_table,
+                sizeof(buf_routing_table));
+        break;
     case AXNET_GET_IFNUMBER:
         ret = axiom_hw_get_if_number(drvdata->dev_api, &buf_uint8);
         put_user(buf_uint8, (uint8_t __user*)arg);
@@ -2506,10 +4234,65 @@ static long axiomnet_ioctl_generic(struct file *filep, unsigned int cmd,
         axiom_hw_set_ni_control(drvdata->dev_api, buf_uint32);
         break;
     case AXNET_GET_STATS:
+        axiomnet_stats_update(drvdata);
         ret = axiom_copy_to_user(argp, &drvdata->stats, sizeof(drvdata->stats));
         if (ret)
             return -EFAULT;
         break;
+    case AXNET_EVENT_ATTACH:
+        ret = get_user(buf_int, (int __user*)arg);
+        if (ret)
+            return -EFAULT;
+        ret = axiomnet_event_attach(priv, buf_int);
+        break;
+    case AXNET_EVENT_GET:
+        buf_uint32 = axiomnet_event_poll(filep, NULL);
+        if (put_user(buf_uint32, (uint32_t __user*)arg))
+            return -EFAULT;
+        break;
+    case AXNET_RECV:
+        ret = axiom_copy_from_user(&buf_recv, argp, sizeof(buf_recv));
+        if (ret)
+            return -EFAULT;
+        if (buf_recv.iovcnt > AXIOMNET_MAX_IOVEC)
+            return -EFBIG;
+        ret = axiom_copy_from_user(&iov, buf_recv.iov, buf_recv.iovcnt *
+                sizeof(buf_recv.iov[0]));
+        if (ret)
+            return -EFAULT;
+        ret = axiomnet_recv(filep, &buf_recv, iov);
+        if (ret < 0)
+            return ret;
+        ret = axiom_copy_to_user(argp, &buf_recv, sizeof(buf_recv));
+        if (ret)
+            return -EFAULT;
+        break;
+    case AXNET_SET_BUSY_POLL:
+        ret = get_user(buf_int, (int __user*)arg);
+        if (ret)
+            return -EFAULT;
+        ret = axiomnet_set_busy_poll(priv, buf_int);
+        break;
+    case AXNET_RING_SETUP:
+        ret = axiom_copy_from_user(&buf_ring_setup, argp,
+                sizeof(buf_ring_setup));
+        if (ret)
+            return -EFAULT;
+        ret = axiomnet_ring_setup(priv, &buf_ring_setup);
+        if (ret)
+            return ret;
+        ret = axiom_copy_to_user(argp, &buf_ring_setup,
+                sizeof(buf_ring_setup));
+        if (ret)
+            return -EFAULT;
+        break;
+    case AXNET_RING_ENTER:
+        ret = axiom_copy_from_user(&buf_ring_enter, argp,
+                sizeof(buf_ring_enter));
+        if (ret)
+            return -EFAULT;
+        ret = axiomnet_ring_enter(priv, &buf_ring_enter);
+        break;
     case AXNET_DEBUG_INFO:
         ret = axiom_copy_from_user(&buf_debug, argp, sizeof(buf_debug));
         if (ret)
@@ -2571,25 +4354,27 @@ static int axiomnet_open_generic(struct inode *inode, struct file *filep)
 {
     struct axiomnet_drvdata *drvdata = chrdev.drvdata;
     struct axiomnet_priv *priv;
-    int err = 0;
+    int err = 0, limit = READ_ONCE(max_open);
 
     DPRINTF("start minor: %u drvdata: %p", iminor(inode), drvdata);
 
+    /* count the open without the driver mutex */
+    if (atomic_inc_return(&drvdata->used) > limit && limit > 0) {
+        err = -EBUSY;
+        goto err;
+    }
+
     /* allocate per-open structure and fill it out */
-    priv = kzalloc(sizeof(*priv), GFP_KERNEL);
-    if (priv == NULL)
-        return -ENOMEM;
+    priv = kmem_cache_zalloc(axiomnet_priv_cache, GFP_KERNEL);
+    if (priv == NULL) {
+        err = -ENOMEM;
+        goto err;
+    }
 
     /* set invalid port */
     priv->bind_port = AXIOMNET_PORT_INVALID;
-
-    mutex_lock(&drvdata->lock);
-    if (drvdata->used >= AXIOMNET_MAX_OPEN) {
-        err = -EBUSY;
-        goto err;
-    }
-    drvdata->used++;
-    mutex_unlock(&drvdata->lock);
+    priv->busy_poll_usec = AXIOMNET_BUSY_POLL_DEFAULT;
+    spin_lock_init(&priv->mr_lock);
 
     priv->drvdata = drvdata;
     priv->type = AXNET_FDTYPE_GENERIC;
@@ -2600,9 +4385,8 @@ static int axiomnet_open_generic(struct inode *inode, struct file *filep)
     return 0;
 
 err:
-    mutex_unlock(&drvdata->lock);
+    atomic_dec(&drvdata->used);
     pr_err("unable to open char dev [error %d]\n", err);
-    kfree(priv);
     DPRINTF("error: %d", err);
     return err;
 }
@@ -2649,10 +4433,28 @@ static int axiomnet_open_rdma(struct inode *inode, struct file *filep)
     priv = filep->private_data;
     priv->type = AXNET_FDTYPE_RDMA;
     priv->rdma_debug = 0;
+    init_waitqueue_head(&priv->rdma_wait_queue);
+    atomic_set(&priv->rdma_completed, 0);
 
     return 0;
 }
 
+/* detach the open from the async RDMA still in flight */
+static void axiomnet_rdma_release_owner(struct axiomnet_priv *priv)
+{
+    struct axiomnet_rdma_queue *rdma_queue =
+        &priv->drvdata->rdma_tx_ring.rdma_queue;
+    unsigned long flags;
+    int i;
+
+    spin_lock_irqsave(&rdma_queue->queue_lock, flags);
+    for (i = 0; i < AXIOMNET_RDMA_QUEUE_FREE_LEN; i++) {
+        if (rdma_queue->queue_desc[i].owner == priv)
+            rdma_queue->queue_desc[i].owner = NULL;
+    }
+    spin_unlock_irqrestore(&rdma_queue->queue_lock, flags);
+}
+
 static int axiomnet_release(struct inode *inode, struct file *filep)
 {
     struct axiomnet_drvdata *drvdata = chrdev.drvdata;
@@ -2662,14 +4464,20 @@ static int axiomnet_release(struct inode *inode, struct file *filep)
 
     axiomnet_unbind(priv);
 
-    mutex_lock(&drvdata->lock);
-
-    drvdata->used--;
-
-    mutex_unlock(&drvdata->lock);
+    if (priv->type == AXNET_FDTYPE_RDMA)
+        axiomnet_rdma_release_owner(priv);
+    if (priv->type == AXNET_FDTYPE_GENERIC) {
+        /* RDMA in flight keep the ring until their ack */
+        if (priv->ring)
+            axiomnet_ring_put(priv->ring);
+        axiomnet_event_release(priv);
+    }
 
     filep->private_data = NULL;
-    kfree(priv);
+    kfree(priv->mr);
+    kmem_cache_free(axiomnet_priv_cache, priv);
+
+    atomic_dec(&drvdata->used);
 
     DPRINTF("end");
     return 0;
@@ -2681,6 +4489,8 @@ static struct file_operations axiomnet_fops =
     .open = axiomnet_open_generic,
     .release = axiomnet_release,
     .unlocked_ioctl = axiomnet_ioctl_generic,
+    .poll = axiomnet_poll_generic,
+    .mmap = axiomnet_mmap_generic,
 };
 
 static struct file_operations axiomnet_raw_fops =
@@ -2754,7 +4564,7 @@ static int axiomnet_alloc_chrdev(struct axiomnet_drvdata *drvdata,
         goto free_long_dev;
     }
 
-    drvdata->used = 0;
+    atomic_set(&drvdata->used, 0);
     chrdev->drvdata = drvdata;
 
     DPRINTF("end major:%d", MAJOR(chrdev->dev));
@@ -2884,7 +4694,14 @@ int axiomnet_init(void)
     int err = 0;
     DPRINTF("start");
 
+    axiomnet_priv_cache = kmem_cache_create("axiomnet_priv",
+            sizeof(struct axiomnet_priv), 0, SLAB_HWCACHE_ALIGN, NULL);
+    if (axiomnet_priv_cache == NULL)
+        return -ENOMEM;
+
     err = axiomnet_init_chrdev(&chrdev);
+    if (err)
+        kmem_cache_destroy(axiomnet_priv_cache);
 
     DPRINTF("end");
     return err;
@@ -2895,5 +4712,6 @@ void axiomnet_cleanup(void)
 {
     DPRINTF("start");
     axiomnet_cleanup_chrdev(&chrdev);
+    kmem_cache_destroy(axiomnet_priv_cache);
     DPRINTF("end");
 }
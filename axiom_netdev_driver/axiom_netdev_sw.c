@@ -0,0 +1,150 @@
+/*!
+ * \file axiom_netdev_sw.c
+ *
+ * \version     v1.2
+ * \date        2016-11-14
+ *
+ * This file contains the implementation of the Axiom NIC kernel module on top
+ * of the software emulator (no hardware needed).
+ *
+ * The driver supports one device, so the module exposes one emulated NIC with
+ * the loopback interface routed to its own node id: RAW, LONG and RDMA
+ * messages sent to sw_node_id come back to the same host.
+ *
+ * Copyright (C) 2016, Evidence Srl
+ * Terms of use are as specified in COPYING
+ */
+#include "axiom_netdev.h"
+#include "axiom_nic_api_sw.h"
+
+static int sw_node_id = 0;
+module_param(sw_node_id, int, 0);
+MODULE_PARM_DESC(sw_node_id, "Node id of the emulated NIC");
+
+/*! \brief AXIOM software emulator device driver data */
+struct axiomnet_swdata {
+    struct axiomnet_drvdata drvdata;    /*!< \brief AXIOM device driver data */
+    axiom_dev_t *dev_api;               /*!< \brief AXIOM dev HW API*/
+};
+
+static struct axiomnet_swdata *axiomnet_swdata;
+
+static void axiomnet_sw_irq(void *data)
+{
+    struct axiomnet_swdata *swdata = data;
+
+    axiomnet_irqhandler(&swdata->drvdata);
+}
+
+static int axiomnet_sw_probe(void)
+{
+    struct axiomnet_swdata *swdata;
+    int err = 0;
+
+    DPRINTF("start");
+
+    if (sw_node_id < 0 || sw_node_id > AXIOM_NODES_MAX) {
+        EPRINTF("invalid sw_node_id %d", sw_node_id);
+        return -EINVAL;
+    }
+
+    /* allocate our structure and fill it out */
+    swdata = kzalloc(sizeof(*swdata), GFP_KERNEL);
+    if (swdata == NULL)
+        return -ENOMEM;
+
+    /* allocate axiom api (emulated NIC) */
+    swdata->dev_api = axiom_hw_dev_alloc(NULL);
+    if (swdata->dev_api == NULL) {
+        err = -ENOMEM;
+        goto free_local;
+    }
+
+    axiom_hw_disable_irq(swdata->dev_api);
+
+    axiom_hw_set_node_id(swdata->dev_api, sw_node_id);
+    axiom_hw_set_routing(swdata->dev_api, sw_node_id,
+            (1 << AXIOMREG_ROUTING_LOOPBACK_IF));
+
+    /* setup IRQ */
+    axiom_sw_set_irq_handler(swdata->dev_api, axiomnet_sw_irq, swdata);
+
+    /* probe AXIOM common driver */
+    err = axiomnet_probe(&swdata->drvdata, swdata->dev_api);
+    if (err) {
+        goto free_irq;
+    }
+
+    axiomnet_swdata = swdata;
+
+    IPRINTF(1, "AXIOM NIC driver loaded (software emulator - node %d)",
+            sw_node_id);
+    return 0;
+
+free_irq:
+    axiom_sw_set_irq_handler(swdata->dev_api, NULL, NULL);
+    axiom_hw_dev_free(swdata->dev_api);
+free_local:
+    kfree(swdata);
+    DPRINTF("error: %d", err);
+    return err;
+}
+
+static void axiomnet_sw_remove(void)
+{
+    struct axiomnet_swdata *swdata = axiomnet_swdata;
+
+    /* remove AXIOM common driver */
+    axiomnet_remove(&swdata->drvdata);
+
+    axiom_sw_set_irq_handler(swdata->dev_api, NULL, NULL);
+    axiom_hw_dev_free(swdata->dev_api);
+    kfree(swdata);
+    axiomnet_swdata = NULL;
+
+    IPRINTF(1, "AXIOM NIC driver unloaded");
+}
+
+/********************** AxiomNet Module [un]init *****************************/
+
+/*
+ * Entry point for loading the module
+ *
+ * Returns 0 on success, negative on failure
+ */
+static int __init axiomnet_sw_init(void)
+{
+    int err;
+
+    /* init the AXIOM module */
+    err = axiomnet_init();
+    if (err) {
+        goto err;
+    }
+
+    /* there is no bus to probe: create the emulated device */
+    err = axiomnet_sw_probe();
+    if (err) {
+        goto cleanup;
+    }
+
+    return 0;
+
+cleanup:
+    axiomnet_cleanup();
+err:
+    pr_err("unable to init axiomnet module [error %d]\n", err);
+    return err;
+}
+
+/* Entry point for unloading the module */
+static void __exit axiomnet_sw_cleanup(void)
+{
+    axiomnet_sw_remove();
+
+    /* clean the axiom module */
+    axiomnet_cleanup();
+}
+
+module_init(axiomnet_sw_init);
+module_exit(axiomnet_sw_cleanup);
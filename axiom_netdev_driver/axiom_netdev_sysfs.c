@@ -133,9 +133,124 @@ axsys_retry_delay_store(struct device *dev, struct device_attribute *attr,
 static DEVICE_ATTR(retry_delay_usec, S_IRUGO | S_IWUSR,
         axsys_retry_delay_show, axsys_retry_delay_store);
 
+/* busy_poll_usec callbacks */
+static ssize_t
+axsys_busy_poll_show(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+    struct kobject *kobj = (struct kobject *)dev;
+    struct axiomnet_sysfs *axsys = dev_get_drvdata(kobj_to_dev(kobj->parent));
+
+    return axsys_uint32_show(buf, axsys->busy_poll_usec);
+}
+static ssize_t
+axsys_busy_poll_store(struct device *dev, struct device_attribute *attr,
+			 const char *buf, size_t count)
+{
+    struct kobject *kobj = (struct kobject *)dev;
+    struct axiomnet_sysfs *axsys = dev_get_drvdata(kobj_to_dev(kobj->parent));
+    uint32_t usec;
+    ssize_t ret;
+
+    ret = axsys_uint32_store(buf, count, &usec);
+    if (ret < 0)
+        return ret;
+
+    if (usec > AXIOMNET_BUSY_POLL_MAX_USEC)
+        return -EINVAL;
+
+    axsys->busy_poll_usec = usec;
+
+    return ret;
+}
+static DEVICE_ATTR(busy_poll_usec, S_IRUGO | S_IWUSR,
+        axsys_busy_poll_show, axsys_busy_poll_store);
+
+/* raw_rx_inline callbacks */
+static ssize_t
+axsys_raw_rx_inline_show(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+    struct kobject *kobj = (struct kobject *)dev;
+    struct axiomnet_sysfs *axsys = dev_get_drvdata(kobj_to_dev(kobj->parent));
+
+    return axsys_uint32_show(buf, axsys->raw_rx_inline);
+}
+static ssize_t
+axsys_raw_rx_inline_store(struct device *dev, struct device_attribute *attr,
+			 const char *buf, size_t count)
+{
+    struct kobject *kobj = (struct kobject *)dev;
+    struct axiomnet_sysfs *axsys = dev_get_drvdata(kobj_to_dev(kobj->parent));
+    uint32_t enable;
+    ssize_t ret;
+
+    ret = axsys_uint32_store(buf, count, &enable);
+    if (ret < 0)
+        return ret;
+
+    if (enable > 1)
+        return -EINVAL;
+
+    axsys->raw_rx_inline = enable;
+
+    return ret;
+}
+static DEVICE_ATTR(raw_rx_inline, S_IRUGO | S_IWUSR,
+        axsys_raw_rx_inline_show, axsys_raw_rx_inline_store);
+
+/* raw_rx_steering callbacks */
+static ssize_t
+axsys_raw_rx_steering_show(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+    struct kobject *kobj = (struct kobject *)dev;
+    struct axiomnet_sysfs *axsys = dev_get_drvdata(kobj_to_dev(kobj->parent));
+    struct axiomnet_raw_rx_hwring *rx_ring = &axsys->drvdata->raw_rx_ring;
+    ssize_t len = 0;
+    int port;
+
+    /* worker of each port */
+    for (port = 0; port < AXIOM_PORT_NUM; port++) {
+        len += snprintf(buf + len, PAGE_SIZE - len, "%hhu%c",
+                READ_ONCE(rx_ring->port_worker[port]),
+                (port == AXIOM_PORT_MAX) ? '\n' : ' ');
+    }
+
+    return len;
+}
+static ssize_t
+axsys_raw_rx_steering_store(struct device *dev, struct device_attribute *attr,
+			 const char *buf, size_t count)
+{
+    struct kobject *kobj = (struct kobject *)dev;
+    struct axiomnet_sysfs *axsys = dev_get_drvdata(kobj_to_dev(kobj->parent));
+    struct axiomnet_drvdata *drvdata = axsys->drvdata;
+    unsigned int port, worker;
+
+    /* "<port> <worker>" */
+    if (sscanf(buf, "%u %u", &port, &worker) != 2)
+        return -EINVAL;
+
+    if (port > AXIOM_PORT_MAX || worker >= drvdata->raw_rx_workers_num)
+        return -EINVAL;
+
+    WRITE_ONCE(drvdata->raw_rx_ring.port_worker[port], worker);
+
+    /* the new worker moves the messages already handed off for the port */
+    axiom_kthread_wakeup(&drvdata->raw_rx_workers[worker].kthread);
+
+    return count;
+}
+static DEVICE_ATTR(raw_rx_steering, S_IRUGO | S_IWUSR,
+        axsys_raw_rx_steering_show, axsys_raw_rx_steering_store);
+
 static struct attribute *axiom_sysfs_param_attrs[] = {
     &dev_attr_watchdog_period_msec.attr,
     &dev_attr_retry_delay_usec.attr,
+    &dev_attr_busy_poll_usec.attr,
+    &dev_attr_raw_rx_inline.attr,
+    &dev_attr_raw_rx_steering.attr,
     NULL
 };
 ATTRIBUTE_GROUPS(axiom_sysfs_param);
@@ -173,30 +288,200 @@ static struct attribute *axiom_sysfs_info_attrs[] = {
 };
 ATTRIBUTE_GROUPS(axiom_sysfs_info);
 
+/* kthread of a kthread_* folder */
+static struct axiom_kthread *
+axsys_kobj2kthread(struct axiomnet_sysfs *axsys, struct kobject *kobj)
+{
+    int i;
+
+    for (i = 0; i < axsys->kthread_raw_num; i++) {
+        if (kobj == axsys->kthread_raw[i])
+            return &axsys->drvdata->raw_rx_workers[i].kthread;
+    }
+
+    if (kobj == axsys->kthread_rdma)
+        return &axsys->drvdata->kthread_rdma;
+
+    if (kobj == axsys->kthread_wtd)
+        return &axsys->drvdata->kthread_wtd;
+
+    return NULL;
+}
+
 static ssize_t
 axsys_pid_show(struct device *dev, struct device_attribute *attr,
 			char *buf)
 {
     struct kobject *kobj = (struct kobject *)dev;
     struct axiomnet_sysfs *axsys = dev_get_drvdata(kobj_to_dev(kobj->parent));
-    struct axiom_kthread *kthread = NULL;
-
-    if (kobj == axsys->kthread_raw) {
-        kthread = &axsys->drvdata->kthread_raw;
-    } else if (kobj == axsys->kthread_rdma) {
-        kthread = &axsys->drvdata->kthread_rdma;
-    } else if (kobj == axsys->kthread_wtd) {
-        kthread = &axsys->drvdata->kthread_wtd;
-    } else {
+    struct axiom_kthread *kthread;
+
+    kthread = axsys_kobj2kthread(axsys, kobj);
+    if (!kthread)
         return -EFAULT;
-    }
 
     return axsys_uint32_show(buf, axiom_kthread_getpid(kthread));
 }
 static DEVICE_ATTR(pid, S_IRUGO, axsys_pid_show, NULL);
 
+/*
+ * The RAW RX worker woken by the IRQ is chosen by its CPU: keep it in sync with
+ * the affinity (AXIOMNET_CPU_ANY if the worker can run on more CPUs).
+ */
+static void
+axsys_worker_cpu_update(struct axiomnet_sysfs *axsys, struct kobject *kobj,
+        const struct cpumask *cpus)
+{
+    int i, cpu;
+
+    cpu = (cpumask_weight(cpus) == 1) ? cpumask_first(cpus) : AXIOMNET_CPU_ANY;
+
+    for (i = 0; i < axsys->kthread_raw_num; i++) {
+        if (kobj == axsys->kthread_raw[i])
+            WRITE_ONCE(axsys->drvdata->raw_rx_workers[i].cpu, cpu);
+    }
+}
+
+/* cpus callbacks (CPU list, e.g. "0-1,3") */
+static ssize_t
+axsys_cpus_show(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+    struct kobject *kobj = (struct kobject *)dev;
+    struct axiomnet_sysfs *axsys = dev_get_drvdata(kobj_to_dev(kobj->parent));
+    struct axiom_kthread *kthread;
+
+    kthread = axsys_kobj2kthread(axsys, kobj);
+    if (!kthread)
+        return -EFAULT;
+
+    return snprintf(buf, PAGE_SIZE, "%*pbl\n",
+            cpumask_pr_args(axiom_kthread_get_affinity(kthread)));
+}
+static ssize_t
+axsys_cpus_store(struct device *dev, struct device_attribute *attr,
+			 const char *buf, size_t count)
+{
+    struct kobject *kobj = (struct kobject *)dev;
+    struct axiomnet_sysfs *axsys = dev_get_drvdata(kobj_to_dev(kobj->parent));
+    struct axiom_kthread *kthread;
+    cpumask_var_t cpus;
+    int ret;
+
+    kthread = axsys_kobj2kthread(axsys, kobj);
+    if (!kthread)
+        return -EFAULT;
+
+    if (!alloc_cpumask_var(&cpus, GFP_KERNEL))
+        return -ENOMEM;
+
+    ret = cpulist_parse(buf, cpus);
+    if (ret || cpumask_empty(cpus)) {
+        ret = -EINVAL;
+        goto free_cpus;
+    }
+
+    mutex_lock(&axsys->kthread_lock);
+    ret = axiom_kthread_set_affinity(kthread, cpus);
+    if (ret == 0)
+        axsys_worker_cpu_update(axsys, kobj, cpus);
+    mutex_unlock(&axsys->kthread_lock);
+
+free_cpus:
+    free_cpumask_var(cpus);
+
+    return ret ? ret : count;
+}
+static DEVICE_ATTR(cpus, S_IRUGO | S_IWUSR, axsys_cpus_show, axsys_cpus_store);
+
+/* nice callbacks */
+static ssize_t
+axsys_nice_show(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+    struct kobject *kobj = (struct kobject *)dev;
+    struct axiomnet_sysfs *axsys = dev_get_drvdata(kobj_to_dev(kobj->parent));
+    struct axiom_kthread *kthread;
+
+    kthread = axsys_kobj2kthread(axsys, kobj);
+    if (!kthread)
+        return -EFAULT;
+
+    return axsys_int32_show(buf, axiom_kthread_get_nice(kthread));
+}
+static ssize_t
+axsys_nice_store(struct device *dev, struct device_attribute *attr,
+			 const char *buf, size_t count)
+{
+    struct kobject *kobj = (struct kobject *)dev;
+    struct axiomnet_sysfs *axsys = dev_get_drvdata(kobj_to_dev(kobj->parent));
+    struct axiom_kthread *kthread;
+    int32_t nice;
+    ssize_t ret;
+
+    kthread = axsys_kobj2kthread(axsys, kobj);
+    if (!kthread)
+        return -EFAULT;
+
+    ret = axsys_int32_store(buf, count, &nice);
+    if (ret < 0)
+        return ret;
+
+    mutex_lock(&axsys->kthread_lock);
+    ret = axiom_kthread_set_nice(kthread, nice);
+    mutex_unlock(&axsys->kthread_lock);
+
+    return ret ? ret : count;
+}
+static DEVICE_ATTR(nice, S_IRUGO | S_IWUSR, axsys_nice_show, axsys_nice_store);
+
+/* rt_priority callbacks (0 = SCHED_NORMAL, > 0 = SCHED_FIFO priority) */
+static ssize_t
+axsys_rt_priority_show(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+    struct kobject *kobj = (struct kobject *)dev;
+    struct axiomnet_sysfs *axsys = dev_get_drvdata(kobj_to_dev(kobj->parent));
+    struct axiom_kthread *kthread;
+
+    kthread = axsys_kobj2kthread(axsys, kobj);
+    if (!kthread)
+        return -EFAULT;
+
+    return axsys_uint32_show(buf, axiom_kthread_get_rt_priority(kthread));
+}
+static ssize_t
+axsys_rt_priority_store(struct device *dev, struct device_attribute *attr,
+			 const char *buf, size_t count)
+{
+    struct kobject *kobj = (struct kobject *)dev;
+    struct axiomnet_sysfs *axsys = dev_get_drvdata(kobj_to_dev(kobj->parent));
+    struct axiom_kthread *kthread;
+    uint32_t rt_priority;
+    ssize_t ret;
+
+    kthread = axsys_kobj2kthread(axsys, kobj);
+    if (!kthread)
+        return -EFAULT;
+
+    ret = axsys_uint32_store(buf, count, &rt_priority);
+    if (ret < 0)
+        return ret;
+
+    mutex_lock(&axsys->kthread_lock);
+    ret = axiom_kthread_set_rt_priority(kthread, rt_priority);
+    mutex_unlock(&axsys->kthread_lock);
+
+    return ret ? ret : count;
+}
+static DEVICE_ATTR(rt_priority, S_IRUGO | S_IWUSR, axsys_rt_priority_show,
+        axsys_rt_priority_store);
+
 static struct attribute *axiom_sysfs_kthread_attrs[] = {
     &dev_attr_pid.attr,
+    &dev_attr_cpus.attr,
+    &dev_attr_nice.attr,
+    &dev_attr_rt_priority.attr,
     NULL
 };
 ATTRIBUTE_GROUPS(axiom_sysfs_kthread);
@@ -206,7 +491,9 @@ axiom_sysfs_init(const char *name, struct axiomnet_sysfs *axsys,
         struct axiomnet_drvdata *drvdata)
 {
     struct kobject *root;
-    int ret = 0;
+    int ret = 0, i;
+
+    mutex_init(&axsys->kthread_lock);
 
     axsys->dev = root_device_register(name);
     if (IS_ERR(axsys->dev)) {
@@ -237,21 +524,34 @@ axiom_sysfs_init(const char *name, struct axiomnet_sysfs *axsys,
         goto free_infok;
     }
 
-    axsys->kthread_raw = kobject_create_and_add("kthread_raw", root);
-    if (!axsys->kthread_raw) {
-        goto free_infog;
-    }
-
-    ret = sysfs_create_groups(axsys->kthread_raw,
-            axiom_sysfs_kthread_groups);
-    if (ret) {
-        EPRINTF("Unable to create group of kthread_raw attributes");
-        goto free_sched_rawk;
+    /* kthread_raw, kthread_raw1, ... one for each RAW RX worker */
+    for (i = 0; i < drvdata->raw_rx_workers_num; i++) {
+        char kname[32];
+
+        if (i == 0)
+            snprintf(kname, sizeof(kname), "kthread_raw");
+        else
+            snprintf(kname, sizeof(kname), "kthread_raw%d", i);
+
+        axsys->kthread_raw[i] = kobject_create_and_add(kname, root);
+        if (!axsys->kthread_raw[i]) {
+            ret = -ENOMEM;
+            goto free_sched_raw;
+        }
+
+        ret = sysfs_create_groups(axsys->kthread_raw[i],
+                axiom_sysfs_kthread_groups);
+        if (ret) {
+            EPRINTF("Unable to create group of %s attributes", kname);
+            kobject_put(axsys->kthread_raw[i]);
+            goto free_sched_raw;
+        }
     }
+    axsys->kthread_raw_num = drvdata->raw_rx_workers_num;
 
     axsys->kthread_rdma = kobject_create_and_add("kthread_rdma", root);
     if (!axsys->kthread_rdma) {
-        goto free_sched_rawg;
+        goto free_sched_raw;
     }
 
     ret = sysfs_create_groups(axsys->kthread_rdma,
@@ -284,11 +584,12 @@ free_sched_rdmag:
     sysfs_remove_groups(root, axiom_sysfs_kthread_groups);
 free_sched_rdmak:
     kobject_put(axsys->kthread_rdma);
-free_sched_rawg:
-    sysfs_remove_groups(root, axiom_sysfs_kthread_groups);
-free_sched_rawk:
-    kobject_put(axsys->kthread_raw);
-free_infog:
+free_sched_raw:
+    while (--i >= 0) {
+        sysfs_remove_groups(axsys->kthread_raw[i], axiom_sysfs_kthread_groups);
+        kobject_put(axsys->kthread_raw[i]);
+    }
+    axsys->kthread_raw_num = 0;
     sysfs_remove_groups(root, axiom_sysfs_info_groups);
 free_infok:
     kobject_put(axsys->info);
@@ -306,6 +607,8 @@ free_root:
 void
 axiom_sysfs_uninit(struct axiomnet_sysfs *axsys)
 {
+    int i;
+
     if (!axsys->dev)
         return;
 
@@ -313,8 +616,11 @@ axiom_sysfs_uninit(struct axiomnet_sysfs *axsys)
     kobject_put(axsys->kthread_wtd);
     sysfs_remove_groups(axsys->kthread_rdma, axiom_sysfs_kthread_groups);
     kobject_put(axsys->kthread_rdma);
-    sysfs_remove_groups(axsys->kthread_raw, axiom_sysfs_kthread_groups);
-    kobject_put(axsys->kthread_raw);
+    for (i = axsys->kthread_raw_num - 1; i >= 0; i--) {
+        sysfs_remove_groups(axsys->kthread_raw[i], axiom_sysfs_kthread_groups);
+        kobject_put(axsys->kthread_raw[i]);
+    }
+    axsys->kthread_raw_num = 0;
     sysfs_remove_groups(axsys->info, axiom_sysfs_info_groups);
     kobject_put(axsys->info);
     sysfs_remove_groups(axsys->param, axiom_sysfs_param_groups);
@@ -17,9 +17,12 @@ struct axiomnet_sysfs {
     struct device *dev;            /*!< \brief root device of sysfs */
     struct kobject *param;         /*!< \brief parameters folder kobject */
     struct kobject *info;          /*!< \brief info folder kobject */
-    struct kobject *kthread_raw;   /*!< \brief RAW kthread folder kobject */
+    /*! \brief RAW kthreads folder kobjects (one for each RAW RX worker) */
+    struct kobject *kthread_raw[AXIOM_PORT_NUM];
+    int kthread_raw_num;           /*!< \brief number of RAW kthreads */
     struct kobject *kthread_rdma;  /*!< \brief RDMA kthread folder kobject */
     struct kobject *kthread_wtd;   /*!< \brief WTD kthread folder kobject */
+    struct mutex kthread_lock;     /*!< \brief serializes the kthread setters */
 
     struct axiomnet_drvdata *drvdata;   /*!< \brief AXIOM driver data */
 
@@ -27,6 +30,10 @@ struct axiomnet_sysfs {
     uint32_t watchdog_period_msec;  /*!< \brief watchdog period in msec */
     uint32_t retry_delay_usec;      /*!< \brief usec to sleep when retry to TX a
                                                 long packet */
+    uint32_t busy_poll_usec;        /*!< \brief usec to spin in the receive
+                                                before sleeping */
+    uint32_t raw_rx_inline;         /*!< \brief RAW receivers read the HW FIFO
+                                                without waiting the kthreads */
 };
 
 /*!
@@ -19,10 +19,34 @@ typedef struct axiom_ioctl_routing {
     uint8_t enabled_mask;       /*!< \brief mask of interface enabled */
 } axiom_ioctl_routing_t;
 
+/*! \brief AXIOM ioctl routing table snapshot */
+typedef struct axiom_ioctl_routing_table {
+    uint32_t generation;        /*!< \brief incremented at each change of the
+                                             routing table */
+    uint8_t enabled_mask[AXIOM_NODES_NUM]; /*!< \brief mask of interface
+                                                       enabled for each node */
+} axiom_ioctl_routing_table_t;
+
+/*!
+ * \brief AXIOM information page, mapped read-only from the generic fd at
+ *        AXIOM_INFO_MMAP_OFFSET. It lets the user space check cheaply if the
+ *        data cached from the driver changed.
+ */
+typedef struct axiom_info_page {
+    uint32_t routing_gen;       /*!< \brief generation of the routing table
+                                             (see axiom_ioctl_routing_table) */
+} axiom_info_page_t;
+
+/*! \brief mmap offset of the information page on the generic fd */
+#define AXIOM_INFO_MMAP_OFFSET          0x40000000UL
+
 /*! \brief AXIOM ioctl RAW messages descriptor with a pointer to the payload */
 typedef struct axiom_ioctl_raw {
     axiom_raw_hdr_t header;     /*!< \brief message header */
     void *payload;              /*!< \brief pointer to the message payload */
+    uint32_t flags;             /*!< \brief send/receive flags */
+/* don't wait, also if the fd is blocking (per-call O_NONBLOCK) */
+#define AXIOCTL_MSG_FLAGS_NONBLOCK      0x0000001
 } axiom_ioctl_raw_t;
 
 /*! \brief AXIOM ioctl RAW messages descriptor with iovec for the payload */
@@ -30,6 +54,7 @@ typedef struct axiom_ioctl_raw_iov {
     axiom_raw_hdr_t header;     /*!< \brief message header */
     struct iovec *iov;          /*!< \brief iovec array */
     int iovcnt;                 /*!< \brief iovec counter */
+    uint32_t flags;             /*!< \brief AXIOCTL_MSG_FLAGS_* */
 } axiom_ioctl_raw_iov_t;
 
 /*! \brief AXIOM ioctl LONG messages descriptor with iovec for the payload */
@@ -37,12 +62,38 @@ typedef struct axiom_ioctl_long_iov {
     axiom_rdma_hdr_t header;    /*!< \brief message header */
     struct iovec *iov;          /*!< \brief iovec array */
     int iovcnt;                 /*!< \brief iovec counter */
+    uint32_t flags;             /*!< \brief AXIOCTL_MSG_FLAGS_* */
 } axiom_ioctl_long_iov_t;
 
+/*! \brief AXIOM ioctl RAW or LONG messages descriptor with iovec for the
+ *         payload */
+typedef struct axiom_ioctl_recv_iov {
+    union {
+        axiom_raw_hdr_t raw;    /*!< \brief RAW message header */
+        axiom_rdma_hdr_t rdma;  /*!< \brief LONG message header */
+    } header;                   /*!< \brief message header */
+    uint32_t payload_size;      /*!< \brief size of the iovec buffers */
+    uint32_t flags;             /*!< \brief receive flags */
+#define AXIOCTL_RECV_FLAGS_NONBLOCK     0x0000001
+    uint32_t event;             /*!< \brief queue of the message received
+                                            (AXIOM_EVENT_RAW or
+                                            AXIOM_EVENT_LONG) */
+    struct iovec *iov;          /*!< \brief iovec array */
+    int iovcnt;                 /*!< \brief iovec counter */
+} axiom_ioctl_recv_iov_t;
+
 /*! \brief AXIOM ioctl bind parameters */
 typedef struct axiom_ioctl_bind {
     uint8_t port;               /*!< \brief port to bind */
     uint8_t flush;              /*!< \brief flush previous packets */
+    uint16_t subport;           /*!< \brief sub-port to bind if port is
+                                             AXIOM_PORT_SUB (or
+                                             AXIOM_SUBPORT_ANY) */
+    uint32_t flags;             /*!< \brief bind flags */
+/* join the group of fds that bound the port with this flag */
+#define AXIOCTL_BIND_FLAGS_REUSEPORT    0x0000001
+/* the group delivers by source node instead of round robin */
+#define AXIOCTL_BIND_FLAGS_HASH_SRC     0x0000002
 } axiom_ioctl_bind_t;
 
 /*! \brief AXIOM ioctl RDMA  */
@@ -53,9 +104,78 @@ typedef struct axiom_ioctl_rdma {
     void *dst_addr;             /*!< \brief destination virtual address */
     uint32_t flags;             /*!< \brief asynchronous flag */
 #define AXIOCTL_RDMA_FLAGS_ASYNC        0x0000001
+/* src_addr and dst_addr are offsets in the src_mr and dst_mr regions */
+#define AXIOCTL_RDMA_FLAGS_MR           0x0000002
+/* don't wait a free slot, also if the fd is blocking */
+#define AXIOCTL_RDMA_FLAGS_NONBLOCK     0x0000004
     int app_id;                 /*!< \brief application ID */
+    uint32_t src_mr;            /*!< \brief MR of the source */
+    uint32_t dst_mr;            /*!< \brief MR of the destination */
 } axiom_ioctl_rdma_t;
 
+/*! \brief AXIOM ioctl memory region registration */
+typedef struct axiom_ioctl_mr {
+    void *addr;                 /*!< \brief start virtual address */
+    uint64_t size;              /*!< \brief size of the region */
+    int app_id;                 /*!< \brief application ID */
+    uint32_t mr;                /*!< \brief MR id (returned) */
+} axiom_ioctl_mr_t;
+
+/*! \brief AXIOM ioctl LONG messages descriptor with a pointer to the
+ *         payload */
+typedef struct axiom_ioctl_long {
+    axiom_rdma_hdr_t header;    /*!< \brief message header */
+    void *payload;              /*!< \brief pointer to the message payload */
+} axiom_ioctl_long_t;
+
+/*! \brief AXIOM submission ring entry */
+typedef struct axiom_ring_sqe {
+    uint64_t user_data;         /*!< \brief value copied in the completion */
+    uint32_t opcode;            /*!< \brief request to execute */
+#define AXIOM_RING_OP_SEND_RAW          1
+#define AXIOM_RING_OP_SEND_LONG         2
+#define AXIOM_RING_OP_RDMA              3
+    uint32_t flags;             /*!< \brief SQE flags */
+/* don't wait free slots: complete with -EAGAIN instead */
+#define AXIOM_RING_SQE_FLAGS_NONBLOCK   0x0000001
+    union {
+        axiom_ioctl_raw_t raw;  /*!< \brief RAW message to send */
+        axiom_ioctl_long_t long_msg;/*!< \brief LONG message to send */
+        axiom_ioctl_rdma_t rdma;/*!< \brief RDMA to start */
+    } op;                       /*!< \brief request arguments */
+} axiom_ring_sqe_t;
+
+/*!
+ * \brief AXIOM submission and completion ring indexes
+ *
+ * The indexes are free running: the entry of an index is (index & mask).
+ * The user space writes sq_tail and cq_head, the driver sq_head and cq_tail.
+ */
+typedef struct axiom_ring_hdr {
+    uint32_t sq_head;           /*!< \brief next SQE consumed by the driver */
+    uint32_t sq_tail;           /*!< \brief next SQE filled by the user */
+    uint32_t sq_mask;           /*!< \brief SQ entries - 1 */
+    uint32_t cq_head;           /*!< \brief next CQE read by the user */
+    uint32_t cq_tail;           /*!< \brief next CQE posted by the driver */
+    uint32_t cq_mask;           /*!< \brief CQ entries - 1 */
+} axiom_ring_hdr_t;
+
+/*! \brief AXIOM ioctl ring setup parameters */
+typedef struct axiom_ioctl_ring_setup {
+    uint32_t sq_entries;        /*!< \brief SQ entries (rounded up to a power
+                                            of 2 by the driver) */
+    uint32_t cq_entries;        /*!< \brief CQ entries (set by the driver) */
+    uint32_t sq_offset;         /*!< \brief offset of the SQ in the mmap */
+    uint32_t cq_offset;         /*!< \brief offset of the CQ in the mmap */
+    uint32_t size;              /*!< \brief size of the area to mmap */
+} axiom_ioctl_ring_setup_t;
+
+/*! \brief AXIOM ioctl ring enter parameters */
+typedef struct axiom_ioctl_ring_enter {
+    uint32_t to_submit;         /*!< \brief max number of SQE to consume */
+    uint32_t min_complete;      /*!< \brief CQE to wait before returning */
+} axiom_ioctl_ring_enter_t;
+
 /*! \brief AXIOM ioctl check/wait parameters */
 typedef struct axiom_ioctl_token {
     axiom_token_t *tokens;      /*!< \brief array of tokens */
@@ -67,7 +187,10 @@ typedef struct axiom_ioctl_debug {
     uint32_t flags;             /*!< \brief debug active flags */
 } axiom_ioctl_debug_t;
 
-/* ioctl defines */
+/*
+ * ioctl defines: the numbers encode the size of the argument, so the library
+ * and the driver must be built from the same version of the structs above.
+ */
 
 /*! \brief AXIOM IOCTL magic number used in the IOCTL id*/
 #define AXNET_MAGIC  0xAA
@@ -131,6 +254,28 @@ typedef struct axiom_ioctl_debug {
 #define AXNET_RDMA_WAIT         _IOWR(AXNET_MAGIC, 128, axiom_ioctl_token_t)
 /*! \brief AXIOM IOCTL to get the statistics */
 #define AXNET_GET_STATS         _IOR(AXNET_MAGIC, 129, axiom_stats_t)
+/*! \brief AXIOM IOCTL to set the busy poll time (usec) of the receive */
+#define AXNET_SET_BUSY_POLL     _IOW(AXNET_MAGIC, 130, int)
+/*! \brief AXIOM IOCTL to attach a RAW, LONG or RDMA fd to the event fd */
+#define AXNET_EVENT_ATTACH      _IOW(AXNET_MAGIC, 131, int)
+/*! \brief AXIOM IOCTL to get the pending events (AXIOM_EVENT_*) */
+#define AXNET_EVENT_GET         _IOR(AXNET_MAGIC, 132, uint32_t)
+/*! \brief AXIOM IOCTL to receive a RAW or LONG message from the event fd */
+#define AXNET_RECV              _IOWR(AXNET_MAGIC, 133, axiom_ioctl_recv_iov_t)
+/*! \brief AXIOM IOCTL to create the submission and completion rings */
+#define AXNET_RING_SETUP        _IOWR(AXNET_MAGIC, 134, \
+                                        axiom_ioctl_ring_setup_t)
+/*! \brief AXIOM IOCTL to submit the SQE and to wait the completions */
+#define AXNET_RING_ENTER        _IOW(AXNET_MAGIC, 135, axiom_ioctl_ring_enter_t)
+/*! \brief AXIOM IOCTL to register a memory region of the RDMA zone */
+#define AXNET_MR_REG            _IOWR(AXNET_MAGIC, 136, axiom_ioctl_mr_t)
+/*! \brief AXIOM IOCTL to deregister a memory region */
+#define AXNET_MR_DEREG          _IOW(AXNET_MAGIC, 137, uint32_t)
+/*! \brief AXIOM IOCTL to get the whole routing table and its generation */
+#define AXNET_GET_ROUTING_TABLE _IOR(AXNET_MAGIC, 138, \
+                                        axiom_ioctl_routing_table_t)
+/*! \brief AXIOM IOCTL to release the port or sub-port bound by the fd */
+#define AXNET_UNBIND            _IO(AXNET_MAGIC, 139)
 
 /*! \brief AXIOM IOCTL for debug (internal-use) */
 #define AXNET_DEBUG_INFO        _IOW(AXNET_MAGIC, 200, axiom_ioctl_debug_t)
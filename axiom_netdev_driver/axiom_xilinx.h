@@ -12,10 +12,14 @@
 #ifndef AXIOM_XILINX_H
 #define AXIOM_XILINX_H
 
+struct dma_chan;
+
 typedef struct axi_fifo {
     void __iomem *base_addr;
     void __iomem *axi4_base_addr;
+    phys_addr_t axi4_paddr;
     int axi4;
+    struct dma_chan *dma_chan;
 } axi_fifo_t;
 
 typedef struct axi_gpio {
@@ -352,6 +356,25 @@ axi_fifo_read64(axi_fifo_t *fifo)
     return readq(fifo->axi4_base_addr + XLLF_AXI4_RDFD_OFFSET);
 }
 
+/*
+ * The AXI4 data ports ignore the address inside their range, so a block of
+ * words can be moved with incremental accesses that the interconnect merges
+ * in bursts.
+ */
+static inline void
+axi_fifo_write64_burst(axi_fifo_t *fifo, const void *buf, size_t words)
+{
+    memcpy_toio(fifo->axi4_base_addr + XLLF_AXI4_TDFD_OFFSET, buf,
+            words * sizeof(uint64_t));
+}
+
+static inline void
+axi_fifo_read64_burst(axi_fifo_t *fifo, void *buf, size_t words)
+{
+    memcpy_fromio(buf, fifo->axi4_base_addr + XLLF_AXI4_RDFD_OFFSET,
+            words * sizeof(uint64_t));
+}
+
 static inline uint32_t
 axi_bram_read32(axi_bram_t *bram, uint64_t offset)
 {
@@ -0,0 +1,954 @@
+/*!
+ * \file axiom_bench.c
+ *
+ * \version     v1.2
+ * \date        2016-11-14
+ *
+ * This file contains the microbenchmarks of the Axiom NIC API for the
+ * user-space:
+ *      - RAW/LONG ping-pong latency (blocking or polling receive)
+ *      - RAW/LONG streaming bandwidth vs. message size
+ *      - RAW message rate with N sender threads
+ *      - RDMA write/read bandwidth with K outstanding tokens
+ *
+ * Results are printed in CSV or JSON lines format, one line for each test and
+ * message size, so different driver versions can be compared.
+ *
+ * The client runs the tests against a server (axiom_bench -S) started on the
+ * remote node, or against a server thread started in the same process (-L)
+ * when the remote node is the local node (loopback).
+ * axiom_bench_swnic runs the same tests on an emulated NIC (axiom_nic_api_sw.h)
+ * without the driver: the server always runs in a thread of the client.
+ *
+ * Copyright (C) 2016, Evidence Srl
+ * Terms of use are as specified in COPYING
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "dprintf.h"
+#include "axiom_utility.h"
+#include "axiom_nic_api_user.h"
+#include "axiom_nic_packets.h"
+#include "axiom_nic_limits.h"
+#ifdef AXIOM_SWNIC_SUPPORT
+#include "axiom_nic_regs.h"
+#include "axiom_nic_api_sw.h"
+#include "axiom_swnic_shim.h"
+#endif
+
+int verbose = 0;
+
+/*! \brief Magic number of the control messages */
+#define AXBENCH_MAGIC                   0x4258
+/*! \brief Default port of the server */
+#define AXBENCH_SERVER_PORT             5
+/*! \brief Default port where the client receives replies */
+#define AXBENCH_REPLY_PORT              6
+/*! \brief Max number of sender threads */
+#define AXBENCH_THREADS_MAX             64
+/*! \brief Max number of outstanding RDMA tokens */
+#define AXBENCH_TOKENS_MAX              256
+
+/*! \brief Benchmarks available */
+typedef enum {
+    AXBENCH_RAW_LAT,
+    AXBENCH_LONG_LAT,
+    AXBENCH_RAW_BW,
+    AXBENCH_LONG_BW,
+    AXBENCH_RAW_RATE,
+    AXBENCH_RDMA_WRITE_BW,
+    AXBENCH_RDMA_READ_BW,
+    AXBENCH_TEST_NUM,
+    AXBENCH_QUIT = AXBENCH_TEST_NUM
+} axbench_test_t;
+
+/*! \brief Description of the benchmarks */
+static const struct {
+    const char *name;
+    int long_msg;               /*!< \brief use LONG messages */
+    size_t max_size;            /*!< \brief max message size */
+} axbench_tests[AXBENCH_TEST_NUM] = {
+    [AXBENCH_RAW_LAT]       = { "raw-lat", 0, AXIOM_RAW_PAYLOAD_MAX_SIZE },
+    [AXBENCH_LONG_LAT]      = { "long-lat", 1, AXIOM_LONG_PAYLOAD_MAX_SIZE },
+    [AXBENCH_RAW_BW]        = { "raw-bw", 0, AXIOM_RAW_PAYLOAD_MAX_SIZE },
+    [AXBENCH_LONG_BW]       = { "long-bw", 1, AXIOM_LONG_PAYLOAD_MAX_SIZE },
+    [AXBENCH_RAW_RATE]      = { "raw-rate", 0, AXIOM_RAW_PAYLOAD_MAX_SIZE },
+    [AXBENCH_RDMA_WRITE_BW] = { "rdma-write-bw", 0,
+                                AXIOM_RDMA_PAYLOAD_MAX_SIZE },
+    [AXBENCH_RDMA_READ_BW]  = { "rdma-read-bw", 0,
+                                AXIOM_RDMA_PAYLOAD_MAX_SIZE },
+};
+
+/*! \brief Control message sent by the client to the server (RAW) */
+typedef struct axbench_ctrl {
+    uint16_t magic;             /*!< \brief AXBENCH_MAGIC */
+    uint8_t test;               /*!< \brief axbench_test_t */
+    uint8_t reply_port;         /*!< \brief port where to send the replies */
+    uint8_t poll;               /*!< \brief receive polling */
+    uint8_t padding[3];
+    uint32_t size;              /*!< \brief size of the messages */
+    uint32_t iterations;        /*!< \brief messages to receive */
+} __attribute__((packed)) axbench_ctrl_t;
+
+/*! \brief Benchmark configuration */
+typedef struct axbench_cfg {
+    axiom_node_id_t dst;        /*!< \brief node where the server runs */
+    axiom_port_t server_port;
+    axiom_port_t reply_port;
+    int tests[AXBENCH_TEST_NUM];/*!< \brief tests enabled */
+    size_t min_size;
+    size_t max_size;
+    int iterations;
+    int warmup;
+    int threads;                /*!< \brief sender threads (raw-rate) */
+    int tokens;                 /*!< \brief outstanding tokens (rdma) */
+    int poll;                   /*!< \brief 1 poll, 0 block, -1 both */
+    int json;                   /*!< \brief JSON lines output */
+    int local_server;           /*!< \brief start the server in a thread */
+} axbench_cfg_t;
+
+/*! \brief Benchmark result */
+typedef struct axbench_result {
+    int test;
+    int poll;
+    size_t size;
+    int iterations;
+    int threads;
+    int tokens;
+    double lat_min;             /*!< \brief latencies (usec) */
+    double lat_avg;
+    double lat_p50;
+    double lat_p99;
+    double lat_max;
+    double bw;                  /*!< \brief bandwidth (MB/s) */
+    double rate;                /*!< \brief message rate (msg/s) */
+} axbench_result_t;
+
+/*! \brief Sender thread of the message rate benchmark */
+typedef struct axbench_sender {
+    pthread_t thread;
+    axbench_cfg_t *cfg;
+    pthread_barrier_t *barrier;
+    size_t size;
+    int iterations;
+    int ret;
+} axbench_sender_t;
+
+static void
+usage(void)
+{
+    int i;
+
+    printf("usage: axiom_bench [arguments]\n");
+    printf("Microbenchmarks of the AXIOM NIC (latency, bandwidth, message "
+            "rate)\n\n");
+    printf("-S, --server            run the server\n");
+    printf("-d, --dst       node    node where the server runs\n");
+    printf("-L, --local             start the server in a thread of this\n"
+           "                        process (dst is the local node)\n");
+    printf("-t, --test      name    test to run (can be repeated) [all]\n");
+    printf("-s, --size      min:max message sizes (doubled) [8:max]\n");
+    printf("-i, --iter      n       iterations for each size [1000]\n");
+    printf("-w, --warmup    n       warmup iterations (latency) [100]\n");
+    printf("-T, --threads   n       sender threads (raw-rate) [1]\n");
+    printf("-k, --tokens    n       outstanding RDMA tokens [16]\n");
+    printf("-m, --mode      mode    receive mode: block, poll, both [block]\n");
+    printf("-p, --port      port    server port [%d]\n", AXBENCH_SERVER_PORT);
+    printf("-r, --reply     port    client reply port [%d]\n",
+            AXBENCH_REPLY_PORT);
+    printf("-j, --json              JSON lines output [CSV]\n");
+    printf("-v, --verbose           verbose\n");
+    printf("-h, --help              print this help\n\n");
+    printf("Tests:");
+    for (i = 0; i < AXBENCH_TEST_NUM; i++)
+        printf(" %s", axbench_tests[i].name);
+    printf("\n");
+}
+
+inline static uint64_t
+axbench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return timespec2nsec(ts);
+}
+
+inline static double
+axbench_ns2us(uint64_t nsec)
+{
+    return ((double)(nsec) / 1000);
+}
+
+static int
+axbench_cmp_u64(const void *a, const void *b)
+{
+    uint64_t va = *(const uint64_t *)a, vb = *(const uint64_t *)b;
+
+    return (va > vb) - (va < vb);
+}
+
+/* send a RAW or LONG message, retrying if the queue is full */
+static axiom_err_t
+axbench_send(axiom_dev_t *dev, int long_msg, axiom_node_id_t dst,
+        axiom_port_t port, size_t size, void *buf)
+{
+    axiom_err_t ret;
+
+    do {
+        if (long_msg) {
+            ret = axiom_send_long(dev, dst, port, size, buf);
+        } else {
+            ret = axiom_send_raw(dev, dst, port, AXIOM_TYPE_RAW_DATA, size,
+                    buf);
+        }
+    } while (ret == AXIOM_RET_NOTAVAIL);
+
+    return ret;
+}
+
+/* receive a RAW or LONG message (spinning when the device is not blocking) */
+static axiom_err_t
+axbench_recv(axiom_dev_t *dev, int long_msg, axiom_node_id_t *src,
+        size_t size, void *buf)
+{
+    axiom_port_t port;
+    axiom_err_t ret;
+
+    do {
+        if (long_msg) {
+            axiom_long_payload_size_t long_size = size;
+
+            ret = axiom_recv_long(dev, src, &port, &long_size, buf);
+        } else {
+            axiom_raw_payload_size_t raw_size = size;
+            axiom_type_t type;
+
+            ret = axiom_recv_raw(dev, src, &port, &type, &raw_size, buf);
+        }
+    } while (ret == AXIOM_RET_NOTAVAIL);
+
+    return ret;
+}
+
+inline static void
+axbench_set_poll(axiom_dev_t *dev, int poll)
+{
+    if (poll) {
+        axiom_set_flags(dev, AXIOM_FLAG_NOBLOCK_RAW | AXIOM_FLAG_NOBLOCK_LONG);
+    } else {
+        axiom_unset_flags(dev,
+                AXIOM_FLAG_NOBLOCK_RAW | AXIOM_FLAG_NOBLOCK_LONG);
+    }
+}
+
+/****************************** server ****************************************/
+
+static int
+axbench_server(axiom_port_t port)
+{
+    uint8_t *buf;
+    axiom_dev_t *dev;
+    axiom_err_t ret;
+    int err = -1;
+
+    buf = malloc(AXIOM_LONG_PAYLOAD_MAX_SIZE);
+    if (!buf) {
+        EPRINTF("malloc failed");
+        return -1;
+    }
+
+    dev = axiom_open(NULL);
+    if (!dev) {
+        EPRINTF("axiom_open failed! - errno = %d", errno);
+        goto free_buf;
+    }
+
+    ret = axiom_bind(dev, port);
+    if (ret != port) {
+        EPRINTF("axiom_bind failed - port: %d ret: %d", port, ret);
+        goto close;
+    }
+
+    while (1) {
+        axbench_ctrl_t ctrl;
+        axiom_node_id_t src;
+        int long_msg, i;
+
+        axbench_set_poll(dev, 0);
+
+        ret = axbench_recv(dev, 0, &src, sizeof(ctrl), &ctrl);
+        if (!AXIOM_RET_IS_OK(ret)) {
+            EPRINTF("receive control message failed - ret: %d", ret);
+            break;
+        }
+
+        if (ctrl.magic != AXBENCH_MAGIC || ctrl.test > AXBENCH_QUIT) {
+            IPRINTF(verbose, "unexpected message from %u discarded", src);
+            continue;
+        }
+
+        if (ctrl.test == AXBENCH_QUIT) {
+            err = 0;
+            break;
+        }
+
+        IPRINTF(verbose, "%s - client %u size %u iterations %u",
+                axbench_tests[ctrl.test].name, src, ctrl.size,
+                ctrl.iterations);
+
+        long_msg = axbench_tests[ctrl.test].long_msg;
+        axbench_set_poll(dev, ctrl.poll);
+
+        for (i = 0; i < ctrl.iterations; i++) {
+            ret = axbench_recv(dev, long_msg, &src, ctrl.size, buf);
+            if (!AXIOM_RET_IS_OK(ret))
+                break;
+
+            /* ping-pong: send back the message */
+            if (ctrl.test == AXBENCH_RAW_LAT || ctrl.test == AXBENCH_LONG_LAT) {
+                ret = axbench_send(dev, long_msg, src, ctrl.reply_port,
+                        ctrl.size, buf);
+                if (!AXIOM_RET_IS_OK(ret))
+                    break;
+            }
+        }
+
+        if (!AXIOM_RET_IS_OK(ret)) {
+            EPRINTF("%s failed - ret: %d", axbench_tests[ctrl.test].name, ret);
+            continue;
+        }
+
+        /* streaming: ack the whole burst */
+        if (ctrl.test != AXBENCH_RAW_LAT && ctrl.test != AXBENCH_LONG_LAT) {
+            ret = axbench_send(dev, 0, src, ctrl.reply_port, sizeof(ctrl),
+                    &ctrl);
+        }
+    }
+
+close:
+    axiom_close(dev);
+free_buf:
+    free(buf);
+    return err;
+}
+
+static void *
+axbench_server_thread(void *arg)
+{
+    axbench_cfg_t *cfg = arg;
+
+    axbench_server(cfg->server_port);
+
+    return NULL;
+}
+
+/****************************** client ****************************************/
+
+static axiom_err_t
+axbench_ctrl_send(axiom_dev_t *dev, axbench_cfg_t *cfg, int test, int poll,
+        size_t size, int iterations)
+{
+    axbench_ctrl_t ctrl;
+
+    memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.magic = AXBENCH_MAGIC;
+    ctrl.test = test;
+    ctrl.reply_port = cfg->reply_port;
+    ctrl.poll = poll;
+    ctrl.size = size;
+    ctrl.iterations = iterations;
+
+    return axbench_send(dev, 0, cfg->dst, cfg->server_port, sizeof(ctrl),
+            &ctrl);
+}
+
+/* wait the ack of a streaming test */
+static axiom_err_t
+axbench_ack_recv(axiom_dev_t *dev)
+{
+    axbench_ctrl_t ctrl;
+    axiom_node_id_t src;
+
+    return axbench_recv(dev, 0, &src, sizeof(ctrl), &ctrl);
+}
+
+static int
+axbench_latency(axiom_dev_t *dev, axbench_cfg_t *cfg, axbench_result_t *res,
+        uint8_t *buf, uint64_t *samples)
+{
+    int long_msg = axbench_tests[res->test].long_msg;
+    uint64_t sum = 0;
+    axiom_node_id_t src;
+    axiom_err_t ret;
+    int i;
+
+    ret = axbench_ctrl_send(dev, cfg, res->test, res->poll, res->size,
+            cfg->warmup + cfg->iterations);
+    if (!AXIOM_RET_IS_OK(ret))
+        return ret;
+
+    axbench_set_poll(dev, res->poll);
+
+    for (i = 0; i < cfg->warmup + cfg->iterations; i++) {
+        uint64_t start = axbench_now();
+
+        ret = axbench_send(dev, long_msg, cfg->dst, cfg->server_port,
+                res->size, buf);
+        if (!AXIOM_RET_IS_OK(ret))
+            goto err;
+
+        ret = axbench_recv(dev, long_msg, &src, res->size, buf);
+        if (!AXIOM_RET_IS_OK(ret))
+            goto err;
+
+        if (i >= cfg->warmup) {
+            /* one-way latency: half of the round trip */
+            samples[i - cfg->warmup] = (axbench_now() - start) / 2;
+            sum += samples[i - cfg->warmup];
+        }
+    }
+
+    qsort(samples, cfg->iterations, sizeof(*samples), axbench_cmp_u64);
+
+    res->lat_min = axbench_ns2us(samples[0]);
+    res->lat_avg = axbench_ns2us(sum) / cfg->iterations;
+    res->lat_p50 = axbench_ns2us(samples[cfg->iterations / 2]);
+    res->lat_p99 = axbench_ns2us(samples[(cfg->iterations * 99) / 100]);
+    res->lat_max = axbench_ns2us(samples[cfg->iterations - 1]);
+
+err:
+    axbench_set_poll(dev, 0);
+    return ret;
+}
+
+static int
+axbench_bandwidth(axiom_dev_t *dev, axbench_cfg_t *cfg, axbench_result_t *res,
+        uint8_t *buf)
+{
+    int long_msg = axbench_tests[res->test].long_msg;
+    uint64_t start, elapsed;
+    axiom_err_t ret;
+    int i;
+
+    ret = axbench_ctrl_send(dev, cfg, res->test, res->poll, res->size,
+            cfg->iterations);
+    if (!AXIOM_RET_IS_OK(ret))
+        return ret;
+
+    axbench_set_poll(dev, res->poll);
+
+    start = axbench_now();
+
+    for (i = 0; i < cfg->iterations; i++) {
+        ret = axbench_send(dev, long_msg, cfg->dst, cfg->server_port,
+                res->size, buf);
+        if (!AXIOM_RET_IS_OK(ret))
+            goto err;
+    }
+
+    ret = axbench_ack_recv(dev);
+    if (!AXIOM_RET_IS_OK(ret))
+        goto err;
+
+    elapsed = axbench_now() - start;
+
+    res->rate = cfg->iterations / nsec2sec(elapsed);
+    res->bw = (res->size * res->rate) / 1000000;
+
+err:
+    axbench_set_poll(dev, 0);
+    return ret;
+}
+
+static void *
+axbench_sender_thread(void *arg)
+{
+    axbench_sender_t *sender = arg;
+    uint8_t buf[AXIOM_RAW_PAYLOAD_MAX_SIZE];
+    axiom_dev_t *dev;
+    int i;
+
+    memset(buf, 0xA5, sizeof(buf));
+    sender->ret = AXIOM_RET_ERROR;
+
+    dev = axiom_open(NULL);
+    if (!dev) {
+        EPRINTF("axiom_open failed! - errno = %d", errno);
+    }
+
+    pthread_barrier_wait(sender->barrier);
+
+    if (!dev)
+        return NULL;
+
+    for (i = 0; i < sender->iterations; i++) {
+        sender->ret = axbench_send(dev, 0, sender->cfg->dst,
+                sender->cfg->server_port, sender->size, buf);
+        if (!AXIOM_RET_IS_OK(sender->ret))
+            break;
+    }
+
+    axiom_close(dev);
+
+    return NULL;
+}
+
+static int
+axbench_rate(axiom_dev_t *dev, axbench_cfg_t *cfg, axbench_result_t *res)
+{
+    axbench_sender_t senders[AXBENCH_THREADS_MAX];
+    pthread_barrier_t barrier;
+    uint64_t start, elapsed;
+    axiom_err_t ret;
+    int i, total = cfg->iterations * cfg->threads;
+
+    ret = axbench_ctrl_send(dev, cfg, res->test, res->poll, res->size, total);
+    if (!AXIOM_RET_IS_OK(ret))
+        return ret;
+
+    pthread_barrier_init(&barrier, NULL, cfg->threads + 1);
+
+    for (i = 0; i < cfg->threads; i++) {
+        senders[i].cfg = cfg;
+        senders[i].barrier = &barrier;
+        senders[i].size = res->size;
+        senders[i].iterations = cfg->iterations;
+        pthread_create(&senders[i].thread, NULL, axbench_sender_thread,
+                &senders[i]);
+    }
+
+    pthread_barrier_wait(&barrier);
+    start = axbench_now();
+
+    for (i = 0; i < cfg->threads; i++) {
+        pthread_join(senders[i].thread, NULL);
+        if (!AXIOM_RET_IS_OK(senders[i].ret))
+            ret = senders[i].ret;
+    }
+
+    pthread_barrier_destroy(&barrier);
+
+    if (!AXIOM_RET_IS_OK(ret))
+        return ret;
+
+    axbench_set_poll(dev, res->poll);
+    ret = axbench_ack_recv(dev);
+    axbench_set_poll(dev, 0);
+    if (!AXIOM_RET_IS_OK(ret))
+        return ret;
+
+    elapsed = axbench_now() - start;
+
+    res->rate = total / nsec2sec(elapsed);
+    res->bw = (res->size * res->rate) / 1000000;
+
+    return ret;
+}
+
+static int
+axbench_rdma(axiom_dev_t *dev, axbench_cfg_t *cfg, axbench_result_t *res,
+        size_t rdma_size)
+{
+    axiom_token_t tokens[AXBENCH_TOKENS_MAX];
+    /* offsets in the RDMA zone (RDMA debug mapping) */
+    uintptr_t local = 0, remote = rdma_size / 2;
+    uint64_t start, elapsed;
+    axiom_err_t ret = AXIOM_RET_OK;
+    int i, slot;
+
+    if (res->size > rdma_size / 2) {
+        EPRINTF("RDMA zone too small [%zu] for size %zu", rdma_size, res->size);
+        return AXIOM_RET_ERROR;
+    }
+
+    for (i = 0; i < res->tokens; i++)
+        AXIOM_TOKEN_INVALIDATE(&tokens[i]);
+
+    start = axbench_now();
+
+    for (i = 0; i < cfg->iterations; i++) {
+        slot = i % res->tokens;
+
+        /* K operations in flight: wait the oldest one */
+        if (AXIOM_TOKEN_IS_VALID(&tokens[slot])) {
+            ret = axiom_rdma_wait(dev, &tokens[slot], 1);
+            if (!AXIOM_RET_IS_OK(ret))
+                return ret;
+        }
+
+        if (res->test == AXBENCH_RDMA_WRITE_BW) {
+            ret = axiom_rdma_write(dev, cfg->dst, res->size, (void *)local,
+                    (void *)remote, &tokens[slot]);
+        } else {
+            ret = axiom_rdma_read(dev, cfg->dst, res->size, (void *)remote,
+                    (void *)local, &tokens[slot]);
+        }
+        if (!AXIOM_RET_IS_OK(ret))
+            return ret;
+    }
+
+    for (i = 0; i < res->tokens; i++) {
+        if (AXIOM_TOKEN_IS_VALID(&tokens[i])) {
+            ret = axiom_rdma_wait(dev, &tokens[i], 1);
+            if (!AXIOM_RET_IS_OK(ret))
+                return ret;
+        }
+    }
+
+    elapsed = axbench_now() - start;
+
+    res->rate = cfg->iterations / nsec2sec(elapsed);
+    res->bw = (res->size * res->rate) / 1000000;
+
+    return ret;
+}
+
+static void
+axbench_print(axbench_cfg_t *cfg, axbench_result_t *res)
+{
+    if (cfg->json) {
+        printf("{\"test\":\"%s\",\"mode\":\"%s\",\"size\":%zu,"
+                "\"iterations\":%d,\"threads\":%d,\"tokens\":%d,"
+                "\"lat_min_us\":%.3f,\"lat_avg_us\":%.3f,\"lat_p50_us\":%.3f,"
+                "\"lat_p99_us\":%.3f,\"lat_max_us\":%.3f,\"bw_mbs\":%.3f,"
+                "\"rate_msgs\":%.1f}\n",
+                axbench_tests[res->test].name, res->poll ? "poll" : "block",
+                res->size, res->iterations, res->threads, res->tokens,
+                res->lat_min, res->lat_avg, res->lat_p50, res->lat_p99,
+                res->lat_max, res->bw, res->rate);
+    } else {
+        printf("%s,%s,%zu,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f\n",
+                axbench_tests[res->test].name, res->poll ? "poll" : "block",
+                res->size, res->iterations, res->threads, res->tokens,
+                res->lat_min, res->lat_avg, res->lat_p50, res->lat_p99,
+                res->lat_max, res->bw, res->rate);
+    }
+    fflush(stdout);
+}
+
+static int
+axbench_client(axbench_cfg_t *cfg)
+{
+    uint64_t *samples;
+    uint8_t *buf;
+    axiom_dev_t *dev;
+    pthread_t server;
+    size_t rdma_size = 0;
+    axiom_err_t ret;
+    int test, poll, err = -1;
+
+    buf = malloc(AXIOM_LONG_PAYLOAD_MAX_SIZE);
+    samples = malloc(sizeof(*samples) * cfg->iterations);
+    if (!buf || !samples) {
+        EPRINTF("malloc failed");
+        goto free_buf;
+    }
+    memset(buf, 0x5A, AXIOM_LONG_PAYLOAD_MAX_SIZE);
+
+    dev = axiom_open(NULL);
+    if (!dev) {
+        EPRINTF("axiom_open failed! - errno = %d", errno);
+        goto free_buf;
+    }
+
+    ret = axiom_bind(dev, cfg->reply_port);
+    if (ret != cfg->reply_port) {
+        EPRINTF("axiom_bind failed - port: %d ret: %d", cfg->reply_port, ret);
+        goto close;
+    }
+
+    if (cfg->local_server) {
+        cfg->dst = axiom_get_node_id(dev);
+        if (pthread_create(&server, NULL, axbench_server_thread, cfg)) {
+            EPRINTF("server thread creation failed");
+            goto close;
+        }
+    }
+
+    if (cfg->tests[AXBENCH_RDMA_WRITE_BW] || cfg->tests[AXBENCH_RDMA_READ_BW]) {
+        /* the RDMA debug mapping allows to use offsets as addresses */
+        if (!axiom_rdma_mmap(dev, &rdma_size)) {
+            EPRINTF("axiom_rdma_mmap failed - RDMA tests disabled");
+            cfg->tests[AXBENCH_RDMA_WRITE_BW] = 0;
+            cfg->tests[AXBENCH_RDMA_READ_BW] = 0;
+        }
+    }
+
+    if (!cfg->json) {
+        printf("test,mode,size,iterations,threads,tokens,lat_min_us,"
+                "lat_avg_us,lat_p50_us,lat_p99_us,lat_max_us,bw_mbs,"
+                "rate_msgs\n");
+    }
+
+    err = 0;
+
+    for (test = 0; test < AXBENCH_TEST_NUM; test++) {
+        int rdma = (test == AXBENCH_RDMA_WRITE_BW ||
+                test == AXBENCH_RDMA_READ_BW);
+
+        if (!cfg->tests[test])
+            continue;
+
+        for (poll = 0; poll < 2; poll++) {
+            size_t size;
+
+            if ((cfg->poll >= 0 && poll != cfg->poll) || (rdma && poll))
+                continue;
+
+            for (size = cfg->min_size;
+                    size <= cfg->max_size &&
+                    size <= axbench_tests[test].max_size;
+                    size *= 2) {
+                axbench_result_t res;
+
+                memset(&res, 0, sizeof(res));
+                res.test = test;
+                res.poll = poll;
+                res.size = size;
+                res.iterations = cfg->iterations;
+                res.threads = (test == AXBENCH_RAW_RATE) ? cfg->threads : 1;
+                res.tokens = rdma ? cfg->tokens : 0;
+
+                switch (test) {
+                case AXBENCH_RAW_LAT:
+                case AXBENCH_LONG_LAT:
+                    ret = axbench_latency(dev, cfg, &res, buf, samples);
+                    break;
+                case AXBENCH_RAW_BW:
+                case AXBENCH_LONG_BW:
+                    ret = axbench_bandwidth(dev, cfg, &res, buf);
+                    break;
+                case AXBENCH_RAW_RATE:
+                    ret = axbench_rate(dev, cfg, &res);
+                    break;
+                default:
+                    /* RDMA sizes must be multiple of 8 bytes */
+                    if (size & ((1 << AXIOM_RDMA_PAYLOAD_SIZE_ORDER) - 1))
+                        continue;
+                    ret = axbench_rdma(dev, cfg, &res, rdma_size);
+                    break;
+                }
+
+                if (!AXIOM_RET_IS_OK(ret)) {
+                    EPRINTF("%s - size %zu failed - ret: %d",
+                            axbench_tests[test].name, size, ret);
+                    err = -1;
+                    break;
+                }
+
+                axbench_print(cfg, &res);
+            }
+        }
+    }
+
+    if (rdma_size)
+        axiom_rdma_munmap(dev);
+
+    if (cfg->local_server) {
+        axbench_ctrl_send(dev, cfg, AXBENCH_QUIT, 0, 0, 0);
+        pthread_join(server, NULL);
+    }
+
+close:
+    axiom_close(dev);
+free_buf:
+    free(samples);
+    free(buf);
+    return err;
+}
+
+#ifdef AXIOM_SWNIC_SUPPORT
+/* emulated NIC used by all the opens, with the loopback route to itself */
+static axiom_dev_t *
+axbench_swnic_alloc(void)
+{
+    axiom_dev_t *nic;
+
+    nic = axiom_sw_dev_alloc();
+    if (!nic) {
+        EPRINTF("axiom_sw_dev_alloc failed");
+        return NULL;
+    }
+
+    axiom_hw_set_routing(nic, axiom_hw_get_node_id(nic),
+            1 << AXIOMREG_ROUTING_LOOPBACK_IF);
+    axiom_swnic_select(nic);
+
+    return nic;
+}
+#endif /* AXIOM_SWNIC_SUPPORT */
+
+int
+main(int argc, char **argv)
+{
+    axbench_cfg_t cfg;
+    int server = 0, dst_set = 0, tests_set = 0;
+    int long_index, opt, i;
+    static struct option long_options[] = {
+        {"server", no_argument, 0, 'S'},
+        {"dst", required_argument, 0, 'd'},
+        {"local", no_argument, 0, 'L'},
+        {"test", required_argument, 0, 't'},
+        {"size", required_argument, 0, 's'},
+        {"iter", required_argument, 0, 'i'},
+        {"warmup", required_argument, 0, 'w'},
+        {"threads", required_argument, 0, 'T'},
+        {"tokens", required_argument, 0, 'k'},
+        {"mode", required_argument, 0, 'm'},
+        {"port", required_argument, 0, 'p'},
+        {"reply", required_argument, 0, 'r'},
+        {"json", no_argument, 0, 'j'},
+        {"verbose", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.server_port = AXBENCH_SERVER_PORT;
+    cfg.reply_port = AXBENCH_REPLY_PORT;
+    cfg.min_size = 8;
+    cfg.max_size = AXIOM_LONG_PAYLOAD_MAX_SIZE;
+    cfg.iterations = 1000;
+    cfg.warmup = 100;
+    cfg.threads = 1;
+    cfg.tokens = 16;
+
+    while ((opt = getopt_long(argc, argv, "Sd:Lt:s:i:w:T:k:m:p:r:jvh",
+                    long_options, &long_index)) != -1) {
+        switch (opt) {
+        case 'S':
+            server = 1;
+            break;
+        case 'd':
+            cfg.dst = atoi(optarg);
+            dst_set = 1;
+            break;
+        case 'L':
+            cfg.local_server = 1;
+            break;
+        case 't':
+            for (i = 0; i < AXBENCH_TEST_NUM; i++) {
+                if (strcmp(optarg, axbench_tests[i].name) == 0)
+                    break;
+            }
+            if (i == AXBENCH_TEST_NUM) {
+                EPRINTF("unknown test %s", optarg);
+                usage();
+                return -1;
+            }
+            cfg.tests[i] = 1;
+            tests_set = 1;
+            break;
+        case 's':
+            if (sscanf(optarg, "%zu:%zu", &cfg.min_size, &cfg.max_size) != 2)
+                cfg.max_size = cfg.min_size;
+            break;
+        case 'i':
+            cfg.iterations = atoi(optarg);
+            break;
+        case 'w':
+            cfg.warmup = atoi(optarg);
+            break;
+        case 'T':
+            cfg.threads = atoi(optarg);
+            break;
+        case 'k':
+            cfg.tokens = atoi(optarg);
+            break;
+        case 'm':
+            if (strcmp(optarg, "block") == 0) {
+                cfg.poll = 0;
+            } else if (strcmp(optarg, "poll") == 0) {
+                cfg.poll = 1;
+            } else if (strcmp(optarg, "both") == 0) {
+                cfg.poll = -1;
+            } else {
+                EPRINTF("unknown mode %s", optarg);
+                usage();
+                return -1;
+            }
+            break;
+        case 'p':
+            cfg.server_port = atoi(optarg);
+            break;
+        case 'r':
+            cfg.reply_port = atoi(optarg);
+            break;
+        case 'j':
+            cfg.json = 1;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'h':
+        default:
+            usage();
+            return -1;
+        }
+    }
+
+    if (cfg.server_port > AXIOM_PORT_MAX || cfg.reply_port > AXIOM_PORT_MAX ||
+            cfg.server_port == cfg.reply_port) {
+        EPRINTF("invalid ports - server: %d reply: %d", cfg.server_port,
+                cfg.reply_port);
+        return -1;
+    }
+
+#ifdef AXIOM_SWNIC_SUPPORT
+    /* nothing can reach the emulated NIC from other processes */
+    if (server || dst_set) {
+        EPRINTF("only the local server (-L) runs on the emulated NIC");
+        return -1;
+    }
+    cfg.local_server = 1;
+#endif
+
+    if (server)
+        return axbench_server(cfg.server_port);
+
+    if (!dst_set && !cfg.local_server) {
+        EPRINTF("destination node or local server required");
+        usage();
+        return -1;
+    }
+
+    if (cfg.min_size == 0 || cfg.min_size > cfg.max_size ||
+            cfg.iterations <= 0 || cfg.warmup < 0 ||
+            cfg.threads <= 0 || cfg.threads > AXBENCH_THREADS_MAX ||
+            cfg.tokens <= 0 || cfg.tokens > AXBENCH_TOKENS_MAX) {
+        EPRINTF("invalid arguments");
+        usage();
+        return -1;
+    }
+
+    if (!tests_set) {
+        for (i = 0; i < AXBENCH_TEST_NUM; i++)
+            cfg.tests[i] = 1;
+    }
+
+#ifdef AXIOM_SWNIC_SUPPORT
+    {
+        axiom_dev_t *nic = axbench_swnic_alloc();
+        int ret;
+
+        if (!nic)
+            return -1;
+
+        ret = axbench_client(&cfg);
+        axiom_sw_dev_free(nic);
+
+        return ret;
+    }
+#else
+    return axbench_client(&cfg);
+#endif
+}
@@ -0,0 +1,347 @@
+/*!
+ * \file axiom_evia_test.c
+ *
+ * \version     v1.2
+ * \date        2016-11-14
+ *
+ * This file contains the unit test and the benchmark of the EVI alloc manager
+ * (evi_alloc.h), compared with the previous implementation based on the
+ * linear scan of an array of owners:
+ *      - random alloc/free sequences must return the same ranges
+ *      - time of the alloc/free with many owners and a fragmented zone
+ *
+ * Copyright (C) 2016, Evidence Srl
+ * Terms of use are as specified in COPYING
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "dprintf.h"
+#include "evi_alloc.h"
+
+int verbose = 0;
+
+/*! \brief Owners used in the tests */
+#define EVIA_TEST_OWNERS        (EVIA_OWNERS - 1)
+
+/*********************** reference implementation ****************************/
+
+/*! \brief EVI alloc status of the linear scan implementation */
+typedef struct evia_ref {
+    int elems;                  /*!< \brief number of total elements */
+    int free;                   /*!< \brief number of free elements */
+    evia_elem_t *array;         /*!< \brief owner of each element */
+} evia_ref_t;
+
+static int
+evia_ref_init(evia_ref_t *ea, int elems)
+{
+    ea->array = malloc(elems * sizeof(*(ea->array)) + 1);
+    if (ea->array == NULL)
+        return -1;
+
+    ea->elems = elems;
+    ea->free = elems;
+    memset(ea->array, EVIA_NONE, elems * sizeof(*(ea->array)));
+
+    return 0;
+}
+
+static void
+evia_ref_release(evia_ref_t *ea)
+{
+    free(ea->array);
+    ea->array = NULL;
+}
+
+static int
+evia_ref_alloc(evia_ref_t *ea, evia_elem_t value, int num)
+{
+    int i, count = 0, start;
+
+    if (num > ea->free)
+        return -1;
+
+    for (i = 0; (count < num) && (i < ea->elems); i++) {
+        if (ea->array[i] == EVIA_NONE) {
+            count++;
+        } else {
+            count = 0;
+        }
+    }
+
+    if (count != num)
+        return -1;
+
+    start = i - count;
+
+    for (i = start; i < start + count; i++) {
+        ea->array[i] = value;
+    }
+
+    ea->free -= count;
+
+    return start;
+}
+
+static void
+evia_ref_free(evia_ref_t *ea, evia_elem_t value)
+{
+    int i;
+
+    for (i = 0; i < ea->elems; i++) {
+        if (ea->array[i] == value) {
+            ea->array[i] = EVIA_NONE;
+            ea->free++;
+        }
+    }
+}
+
+/******************************** tests ***************************************/
+
+static void
+usage(void)
+{
+    printf("usage: axiom_evia_test [arguments]\n");
+    printf("Unit test and benchmark of the EVI alloc manager\n\n");
+    printf("Arguments:\n");
+    printf("-e, --elems      elems     number of elements [default: 65536]\n");
+    printf("-i, --iterations iter      random operations [default: 100000]\n");
+    printf("-s, --seed       seed      random seed [default: 1]\n");
+    printf("-b, --no-bench             run only the unit test\n");
+    printf("-v, --verbose              verbose output\n");
+    printf("-h, --help                 print this help\n\n");
+}
+
+inline static uint64_t
+evia_test_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* random size: mostly small requests, sometimes big ones */
+inline static int
+evia_test_size(int elems)
+{
+    if (rand() % 8)
+        return 1 + rand() % 16;
+
+    return 1 + rand() % (elems / 8 + 1);
+}
+
+/* compare the results of the two implementations on the same sequence */
+static int
+evia_test_compare(int elems, int iterations)
+{
+    evi_alloc_t ea;
+    evia_ref_t ref;
+    int i, ret = 0;
+
+    if (evia_init(&ea, elems) || evia_ref_init(&ref, elems)) {
+        EPRINTF("init failed - elems: %d", elems);
+        return -1;
+    }
+
+    for (i = 0; i < iterations; i++) {
+        evia_elem_t owner = rand() % EVIA_TEST_OWNERS;
+        int num, start, start_ref;
+
+        if (rand() % 3) {
+            num = evia_test_size(elems);
+            start = evia_alloc(&ea, owner, num);
+            start_ref = evia_ref_alloc(&ref, owner, num);
+
+            if (start != start_ref) {
+                EPRINTF("iteration %d: alloc owner %d num %d - start %d "
+                        "expected %d", i, owner, num, start, start_ref);
+                ret = -1;
+                break;
+            }
+            IPRINTF(verbose, "alloc owner %d num %d - start %d", owner, num,
+                    start);
+        } else {
+            evia_free(&ea, owner);
+            evia_ref_free(&ref, owner);
+            IPRINTF(verbose, "free owner %d", owner);
+        }
+
+        if (ea.free != ref.free) {
+            EPRINTF("iteration %d: free %d expected %d", i, ea.free,
+                    ref.free);
+            ret = -1;
+            break;
+        }
+    }
+
+    evia_release(&ea);
+    evia_ref_release(&ref);
+
+    return ret;
+}
+
+/* corner cases */
+static int
+evia_test_limits(void)
+{
+    evi_alloc_t ea;
+    int i, ret = 0;
+
+    if (evia_init(&ea, 10))
+        return -1;
+
+    /* zero elements, EVIA_NONE owner, too big */
+    if (evia_alloc(&ea, 1, 0) != 0 || evia_alloc(&ea, EVIA_NONE, 1) != -1 ||
+            evia_alloc(&ea, 1, 11) != -1 || ea.free != 10)
+        ret = -1;
+
+    /* fill the zone, then free the middle extent */
+    if (evia_alloc(&ea, 1, 3) != 0 || evia_alloc(&ea, 2, 4) != 3 ||
+            evia_alloc(&ea, 3, 3) != 7 || evia_alloc(&ea, 4, 1) != -1)
+        ret = -1;
+
+    evia_free(&ea, 2);
+    if (ea.free != 4 || evia_alloc(&ea, 4, 5) != -1 ||
+            evia_alloc(&ea, 4, 4) != 3)
+        ret = -1;
+
+    /* release of all the owners */
+    for (i = 0; i < EVIA_OWNERS; i++) {
+        evia_free(&ea, i);
+    }
+    if (ea.free != 10 || evia_alloc(&ea, 5, 10) != 0)
+        ret = -1;
+
+    evia_release(&ea);
+
+    if (ret)
+        EPRINTF("limits test failed");
+
+    return ret;
+}
+
+/*
+ * Fragment the zone allocating small extents for all the owners, then
+ * measure the time of alloc/free cycles of a single owner.
+ */
+#define EVIA_BENCH(_name, _type, _init, _alloc, _free, _release)            \
+static double                                                               \
+_name(int elems, int iterations)                                            \
+{                                                                           \
+    _type ea;                                                               \
+    uint64_t start;                                                         \
+    int i, num = elems / (2 * EVIA_TEST_OWNERS);                            \
+                                                                            \
+    if (num < 1)                                                            \
+        num = 1;                                                            \
+                                                                            \
+    if (_init(&ea, elems))                                                  \
+        return -1;                                                          \
+                                                                            \
+    for (i = 0; i < 2 * EVIA_TEST_OWNERS; i++) {                            \
+        _alloc(&ea, i % (EVIA_TEST_OWNERS - 1), num);                       \
+    }                                                                       \
+    _free(&ea, 0);                                                          \
+                                                                            \
+    start = evia_test_now();                                                \
+    for (i = 0; i < iterations; i++) {                                      \
+        _alloc(&ea, EVIA_TEST_OWNERS - 1, 1 + i % num);                     \
+        _alloc(&ea, EVIA_TEST_OWNERS - 1, 1 + i % num);                     \
+        _free(&ea, EVIA_TEST_OWNERS - 1);                                   \
+    }                                                                       \
+                                                                            \
+    _release(&ea);                                                          \
+                                                                            \
+    return (double)(evia_test_now() - start) / iterations;                  \
+}
+
+EVIA_BENCH(evia_bench_tree, evi_alloc_t, evia_init, evia_alloc, evia_free,
+        evia_release)
+EVIA_BENCH(evia_bench_ref, evia_ref_t, evia_ref_init, evia_ref_alloc,
+        evia_ref_free, evia_ref_release)
+
+int
+main(int argc, char **argv)
+{
+    int elems = 65536, iterations = 100000, seed = 1, bench = 1;
+    int long_index = 0, opt = 0, ret;
+    double tree_ns, ref_ns;
+
+    static struct option long_options[] = {
+        {"elems", required_argument, 0, 'e'},
+        {"iterations", required_argument, 0, 'i'},
+        {"seed", required_argument, 0, 's'},
+        {"no-bench", no_argument, 0, 'b'},
+        {"verbose", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "e:i:s:bvh",
+                    long_options, &long_index)) != -1) {
+        switch (opt) {
+            case 'e':
+                elems = atoi(optarg);
+                break;
+            case 'i':
+                iterations = atoi(optarg);
+                break;
+            case 's':
+                seed = atoi(optarg);
+                break;
+            case 'b':
+                bench = 0;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'h':
+            default:
+                usage();
+                exit(-1);
+        }
+    }
+
+    if (elems <= 0 || iterations <= 0) {
+        EPRINTF("elems and iterations must be positive");
+        usage();
+        exit(-1);
+    }
+
+    srand(seed);
+
+    ret = evia_test_limits();
+    ret |= evia_test_compare(1, 1000);
+    ret |= evia_test_compare(37, iterations);
+    ret |= evia_test_compare(elems, iterations);
+    if (ret) {
+        printf("evi_alloc unit test: FAILED\n");
+        return 1;
+    }
+    printf("evi_alloc unit test: PASSED\n");
+
+    if (!bench)
+        return 0;
+
+    /* the linear scan is slow: use less iterations */
+    iterations = iterations / 10 + 1;
+    tree_ns = evia_bench_tree(elems, iterations);
+    ref_ns = evia_bench_ref(elems, iterations);
+    if (tree_ns < 0 || ref_ns < 0) {
+        EPRINTF("benchmark init failed - elems: %d", elems);
+        return 1;
+    }
+
+    printf("elems,iterations,tree_ns,linear_ns,speedup\n");
+    printf("%d,%d,%.1f,%.1f,%.1f\n", elems, iterations, tree_ns, ref_ns,
+            ref_ns / tree_ns);
+
+    return 0;
+}
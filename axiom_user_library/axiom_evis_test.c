@@ -0,0 +1,300 @@
+/*!
+ * \file axiom_evis_test.c
+ *
+ * \version     v1.2
+ * \date        2016-11-14
+ *
+ * This file contains the unit test and the benchmark of the EVI lock-free
+ * stack (evi_stack.h) used for the RDMA msg id slots, compared with the
+ * previous free list of the EVI queue manager protected by a spinlock:
+ *      - concurrent pop/push must never give the same slot to two threads
+ *      - time of a pop/push pair with 1..N concurrent threads
+ *
+ * Copyright (C) 2016, Evidence Srl
+ * Terms of use are as specified in COPYING
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "dprintf.h"
+#include "axiom_utility.h"
+#include "evi_queue.h"
+#include "evi_stack.h"
+
+int verbose = 0;
+
+/*! \brief Slots of the RDMA msg id pool */
+#define EVIS_TEST_SLOTS         256
+
+/*! \brief Spinlock protected free list (previous implementation) */
+typedef struct evis_ref {
+    pthread_spinlock_t lock;
+    evi_queue_t evi_queue;
+} evis_ref_t;
+
+/*! \brief Thread arguments */
+typedef struct evis_test_thread {
+    pthread_t tid;
+    int iterations;
+    int errors;
+    evi_stack_t *stack;
+    evis_ref_t *ref;
+    uint8_t *used;
+} evis_test_thread_t;
+
+static void
+usage(void)
+{
+    printf("usage: axiom_evis_test [arguments]\n");
+    printf("Unit test and benchmark of the EVI lock-free stack\n\n");
+    printf("Arguments:\n");
+    printf("-t, --threads    threads   max concurrent threads [default: 4]\n");
+    printf("-i, --iterations iter      ops per thread [default: 1000000]\n");
+    printf("-b, --no-bench             run only the unit test\n");
+    printf("-v, --verbose              verbose output\n");
+    printf("-h, --help                 print this help\n\n");
+}
+
+inline static uint64_t
+evis_test_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* every slot popped must be owned only by the thread that popped it */
+static void *
+evis_test_worker(void *arg)
+{
+    evis_test_thread_t *t = arg;
+    int i;
+
+    for (i = 0; i < t->iterations; i++) {
+        int32_t slot;
+
+        slot = evis_pop(t->stack);
+        if (slot == EVIS_NONE)
+            continue;
+
+        if (__atomic_exchange_n(&t->used[slot], 1, __ATOMIC_ACQ_REL) != 0) {
+            t->errors++;
+            continue;
+        }
+
+        __atomic_store_n(&t->used[slot], 0, __ATOMIC_RELEASE);
+        evis_push(t->stack, slot);
+    }
+
+    return NULL;
+}
+
+static int
+evis_test_concurrent(int threads, int slots, int iterations)
+{
+    evis_test_thread_t *t;
+    evi_stack_t stack;
+    uint8_t *used;
+    int i, count, errors = 0;
+
+    t = calloc(threads, sizeof(*t));
+    used = calloc(slots, sizeof(*used));
+    if (t == NULL || used == NULL || evis_init(&stack, slots)) {
+        EPRINTF("init failed - slots: %d", slots);
+        free(t);
+        free(used);
+        return -1;
+    }
+
+    for (i = 0; i < threads; i++) {
+        t[i].iterations = iterations;
+        t[i].stack = &stack;
+        t[i].used = used;
+        pthread_create(&t[i].tid, NULL, evis_test_worker, &t[i]);
+    }
+
+    for (i = 0; i < threads; i++) {
+        pthread_join(t[i].tid, NULL);
+        errors += t[i].errors;
+    }
+
+    /* all the slots must be in the stack once */
+    for (count = 0; evis_pop(&stack) != EVIS_NONE; count++)
+        ;
+
+    IPRINTF(verbose, "threads %d slots %d - errors %d free %d", threads,
+            slots, errors, count);
+
+    if (errors || count != slots) {
+        EPRINTF("threads %d slots %d: %d slots shared - %d free expected %d",
+                threads, slots, errors, count, slots);
+        errors = -1;
+    }
+
+    evis_release(&stack);
+    free(used);
+    free(t);
+
+    return errors ? -1 : 0;
+}
+
+static void *
+evis_bench_stack(void *arg)
+{
+    evis_test_thread_t *t = arg;
+    int i;
+
+    for (i = 0; i < t->iterations; i++) {
+        int32_t slot = evis_pop(t->stack);
+
+        if (slot != EVIS_NONE)
+            evis_push(t->stack, slot);
+    }
+
+    return NULL;
+}
+
+static void *
+evis_bench_ref(void *arg)
+{
+    evis_test_thread_t *t = arg;
+    evis_ref_t *ref = t->ref;
+    int i;
+
+    for (i = 0; i < t->iterations; i++) {
+        eviq_pnt_t slot;
+
+        pthread_spin_lock(&ref->lock);
+        slot = eviq_free_pop(&ref->evi_queue);
+        pthread_spin_unlock(&ref->lock);
+
+        if (slot == EVIQ_NONE)
+            continue;
+
+        pthread_spin_lock(&ref->lock);
+        eviq_free_push(&ref->evi_queue, slot);
+        pthread_spin_unlock(&ref->lock);
+    }
+
+    return NULL;
+}
+
+/* returns the time of a pop/push pair, measured on all the threads */
+static double
+evis_bench(void *(*worker)(void *), int threads, int iterations)
+{
+    evis_test_thread_t *t;
+    evi_stack_t stack;
+    evis_ref_t ref;
+    uint64_t start, elapsed;
+    int i;
+
+    t = calloc(threads, sizeof(*t));
+    if (t == NULL || evis_init(&stack, EVIS_TEST_SLOTS) ||
+            eviq_init(&ref.evi_queue, 0, EVIS_TEST_SLOTS)) {
+        free(t);
+        return -1;
+    }
+    pthread_spin_init(&ref.lock, PTHREAD_PROCESS_PRIVATE);
+
+    start = evis_test_now();
+    for (i = 0; i < threads; i++) {
+        t[i].iterations = iterations;
+        t[i].stack = &stack;
+        t[i].ref = &ref;
+        pthread_create(&t[i].tid, NULL, worker, &t[i]);
+    }
+
+    for (i = 0; i < threads; i++) {
+        pthread_join(t[i].tid, NULL);
+    }
+    elapsed = evis_test_now() - start;
+
+    pthread_spin_destroy(&ref.lock);
+    eviq_release(&ref.evi_queue);
+    evis_release(&stack);
+    free(t);
+
+    return (double)elapsed / ((double)iterations * threads);
+}
+
+int
+main(int argc, char **argv)
+{
+    int threads = 4, iterations = 1000000, bench = 1;
+    int long_index = 0, opt = 0, ret, i;
+
+    static struct option long_options[] = {
+        {"threads", required_argument, 0, 't'},
+        {"iterations", required_argument, 0, 'i'},
+        {"no-bench", no_argument, 0, 'b'},
+        {"verbose", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "t:i:bvh",
+                    long_options, &long_index)) != -1) {
+        switch (opt) {
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'i':
+                iterations = atoi(optarg);
+                break;
+            case 'b':
+                bench = 0;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'h':
+            default:
+                usage();
+                exit(-1);
+        }
+    }
+
+    if (threads <= 0 || iterations <= 0) {
+        EPRINTF("threads and iterations must be positive");
+        usage();
+        exit(-1);
+    }
+
+    /* few slots and more threads than slots stress the empty stack */
+    ret = evis_test_concurrent(threads + 1, 1, iterations);
+    ret |= evis_test_concurrent(threads + 1, threads, iterations);
+    ret |= evis_test_concurrent(threads, EVIS_TEST_SLOTS, iterations);
+    if (ret) {
+        printf("evi_stack unit test: FAILED\n");
+        return 1;
+    }
+    printf("evi_stack unit test: PASSED\n");
+
+    if (!bench)
+        return 0;
+
+    printf("threads,iterations,lockfree_ns,spinlock_ns,speedup\n");
+    for (i = 1; i <= threads; i++) {
+        double stack_ns, ref_ns;
+
+        stack_ns = evis_bench(evis_bench_stack, i, iterations);
+        ref_ns = evis_bench(evis_bench_ref, i, iterations);
+        if (stack_ns < 0 || ref_ns < 0) {
+            EPRINTF("benchmark init failed - threads: %d", i);
+            return 1;
+        }
+
+        printf("%d,%d,%.1f,%.1f,%.2f\n", i, iterations, stack_ns, ref_ns,
+                ref_ns / stack_ns);
+    }
+
+    return 0;
+}
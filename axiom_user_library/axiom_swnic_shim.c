@@ -0,0 +1,1274 @@
+/*!
+ * \file axiom_swnic_shim.c
+ *
+ * \version     v1.2
+ * \date        2016-11-14
+ *
+ * This file contains the user-space shim that runs the AXIOM user library
+ * on the AXIOM NIC software emulator.
+ *
+ * Copyright (C) 2016, Evidence Srl.
+ * Terms of use are as specified in COPYING
+ */
+/* memfd_create() */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#include "dprintf.h"
+#include "axiom_nic_regs.h"
+#include "axiom_nic_packets.h"
+#include "axiom_nic_api_sw.h"
+#include "axiom_netdev_user.h"
+#include "axiom_utility.h"
+#include "axiom_swnic_shim.h"
+
+/*! \brief Types of the AXIOM devices (same of the driver) */
+#define AXSHIM_FDTYPE_GENERIC   0
+#define AXSHIM_FDTYPE_RAW       1
+#define AXSHIM_FDTYPE_LONG      2
+#define AXSHIM_FDTYPE_RDMA      3
+/*! \brief Port of the file descriptors not bound */
+#define AXSHIM_PORT_INVALID     -1
+/*! \brief Number of RAW packets queued on each port */
+#define AXSHIM_QUEUE_LEN        AXIOM_SW_RAW_FIFO_LEN
+/*! \brief Size of the RDMA zone of the applications on each emulated NIC */
+#define AXSHIM_RDMA_SIZE        (4 * 1024 * 1024)
+/*! \brief Number of LONG buffers (RX and TX) */
+#define AXSHIM_LONG_BUF_NUM     AXIOMREG_LEN_LONG_BUF
+/*! \brief Size of each LONG buffer (same of the driver) */
+#define AXSHIM_LONG_BUF_SIZE    65536
+/*! \brief RDMA zone: application area, LONG RX buffers, LONG TX buffers */
+#define AXSHIM_ZONE_SIZE        (AXSHIM_RDMA_SIZE + \
+        2 * AXSHIM_LONG_BUF_NUM * AXSHIM_LONG_BUF_SIZE)
+/*! \brief Message IDs: one for each LONG TX buffer, then the RDMA ones */
+#define AXSHIM_MSG_ID_NUM       (2 * AXSHIM_LONG_BUF_NUM)
+/*! \brief Retries of a LONG message without RX buffers (like the driver) */
+#define AXSHIM_LONG_RETRY_MAX   1000
+/*! \brief Delay between the retries of a LONG message [usec] */
+#define AXSHIM_RETRY_DELAY_USEC 200
+
+/*! \brief States of the message IDs */
+#define AXSHIM_MSG_FREE         0
+#define AXSHIM_MSG_PENDING      1
+#define AXSHIM_MSG_ACKED        2
+#define AXSHIM_MSG_NACKED       3
+
+/*! \brief Paths opened by axiom_open(), indexed by AXSHIM_FDTYPE_* */
+static const char * const axshim_dev_names[] = {
+    "/dev/axiom",
+    "/dev/axiom-raw",
+    "/dev/axiom-long",
+    "/dev/axiom-rdma",
+};
+#define AXSHIM_DEV_NUM  (sizeof(axshim_dev_names) / sizeof(axshim_dev_names[0]))
+
+/*! \brief RAW packets received on a port and not yet read */
+typedef struct axshim_queue {
+    axiom_raw_msg_t msg[AXSHIM_QUEUE_LEN];
+    int head;
+    int count;
+} axshim_queue_t;
+
+/*! \brief LONG messages received on a port and not yet read */
+typedef struct axshim_long_queue {
+    axiom_rdma_hdr_t hdr[AXSHIM_LONG_BUF_NUM];
+    int head;
+    int count;
+} axshim_long_queue_t;
+
+/*! \brief Driver state of an emulated NIC */
+typedef struct axshim_nic {
+    axiom_dev_t *dev;           /*!< \brief emulated NIC */
+    int refs;                   /*!< \brief file descriptors opened */
+    uint8_t port_used;          /*!< \brief RAW ports bound */
+    uint8_t long_port_used;     /*!< \brief LONG ports bound */
+    uint32_t routing_gen;       /*!< \brief generation of the routing table */
+    uint8_t routing_table[AXIOM_NODES_NUM]; /*!< \brief mirror of the
+                                                routing table */
+    axshim_queue_t queues[AXIOM_PORT_NUM]; /*!< \brief RAW port queues */
+    axiom_raw_msg_t raw_stall;  /*!< \brief RAW packet waiting space in the
+                                    queue of its port */
+    int raw_stalled;            /*!< \brief raw_stall is valid */
+    axshim_long_queue_t long_queues[AXIOM_PORT_NUM]; /*!< \brief LONG port
+                                                         queues */
+    int zone_fd;                /*!< \brief memfd of the RDMA zone */
+    uint8_t *zone;              /*!< \brief RDMA zone mapped by the shim */
+    void *rdma_map;             /*!< \brief RDMA zone mapped by the library */
+    uint8_t msg_state[AXSHIM_MSG_ID_NUM]; /*!< \brief AXSHIM_MSG_* */
+} axshim_nic_t;
+
+/*! \brief File descriptor opened through the shim */
+typedef struct axshim_file {
+    int type;                   /*!< \brief AXSHIM_FDTYPE_* */
+    int bind_port;              /*!< \brief RAW or LONG port bound */
+    axshim_nic_t *nic;          /*!< \brief NIC of the file (NULL if free) */
+} axshim_file_t;
+
+static pthread_mutex_t axshim_lock = PTHREAD_MUTEX_INITIALIZER;
+static axiom_dev_t *axshim_selected;
+static axshim_nic_t *axshim_nics[AXIOM_SW_NICS_MAX];
+static axshim_file_t axshim_files[AXSHIM_FD_MAX];
+
+/* get the file of a fd returned by the shim (NULL for the other fds) */
+inline static axshim_file_t *
+axshim_file(int fd)
+{
+    if (fd < AXSHIM_FD_BASE || fd >= AXSHIM_FD_BASE + AXSHIM_FD_MAX)
+        return NULL;
+
+    return &axshim_files[fd - AXSHIM_FD_BASE];
+}
+
+/* give a LONG RX buffer to the emulator, with the same layout of the driver */
+static void
+axshim_long_buf_free(axshim_nic_t *nic, int buf_id)
+{
+    axiomreg_long_buf_t long_buf;
+
+    memset(&long_buf, 0, sizeof(long_buf));
+    long_buf.field.address = AXSHIM_RDMA_SIZE + (buf_id * AXSHIM_LONG_BUF_SIZE);
+    long_buf.field.size = AXIOM_LONG_PAYLOAD_MAX_SIZE;
+    long_buf.field.msg_id = 0xFF;
+    long_buf.field.flags = AXIOMREG_LONG_BUF_FREE;
+
+    axiom_hw_set_long_buf(nic->dev, buf_id, &long_buf);
+}
+
+/* address of a LONG TX buffer in the RDMA zone */
+inline static uint8_t *
+axshim_long_tx_buf(axshim_nic_t *nic, int buf_id)
+{
+    return nic->zone + AXSHIM_RDMA_SIZE +
+        ((AXSHIM_LONG_BUF_NUM + buf_id) * AXSHIM_LONG_BUF_SIZE);
+}
+
+/* the RDMA zone is a memfd, so the library can map it with axiom_swnic_mmap */
+static int
+axshim_zone_init(axshim_nic_t *nic)
+{
+    axiom_rdma_hdr_t hdr;
+    int i;
+
+    nic->zone_fd = memfd_create("axiom-swnic-zone", 0);
+    if (nic->zone_fd < 0)
+        return -1;
+
+    if (ftruncate(nic->zone_fd, AXSHIM_ZONE_SIZE))
+        goto err;
+
+    nic->zone = mmap(NULL, AXSHIM_ZONE_SIZE, PROT_READ | PROT_WRITE,
+            MAP_SHARED, nic->zone_fd, 0);
+    if (nic->zone == MAP_FAILED)
+        goto err;
+
+    /* the descriptors left by a previous open are stale */
+    while (axiom_hw_rdma_rx_avail(nic->dev) > 0)
+        axiom_hw_rdma_rx(nic->dev, &hdr);
+
+    axiom_hw_set_rdma_zone(nic->dev, (uintptr_t)nic->zone,
+            (uintptr_t)nic->zone + AXSHIM_ZONE_SIZE - 1);
+
+    for (i = 0; i < AXSHIM_LONG_BUF_NUM; i++)
+        axshim_long_buf_free(nic, i);
+
+    return 0;
+
+err:
+    close(nic->zone_fd);
+    return -1;
+}
+
+static void
+axshim_zone_release(axshim_nic_t *nic)
+{
+    axiomreg_long_buf_t long_buf;
+    int i;
+
+    /* the LONG messages and the RDMA to this NIC fail from now on */
+    memset(&long_buf, 0, sizeof(long_buf));
+    for (i = 0; i < AXSHIM_LONG_BUF_NUM; i++)
+        axiom_hw_set_long_buf(nic->dev, i, &long_buf);
+
+    axiom_hw_set_rdma_zone(nic->dev, 0, 0);
+
+    munmap(nic->zone, AXSHIM_ZONE_SIZE);
+    close(nic->zone_fd);
+}
+
+/* get the driver state of an emulated NIC (allocated at the first open) */
+static axshim_nic_t *
+axshim_nic_get(axiom_dev_t *dev)
+{
+    int i, free_slot = -1;
+
+    for (i = 0; i < AXIOM_SW_NICS_MAX; i++) {
+        if (axshim_nics[i] && axshim_nics[i]->dev == dev) {
+            axshim_nics[i]->refs++;
+            return axshim_nics[i];
+        }
+        if (!axshim_nics[i] && free_slot < 0)
+            free_slot = i;
+    }
+
+    if (free_slot < 0)
+        return NULL;
+
+    axshim_nics[free_slot] = calloc(1, sizeof(axshim_nic_t));
+    if (!axshim_nics[free_slot])
+        return NULL;
+
+    axshim_nics[free_slot]->dev = dev;
+    axshim_nics[free_slot]->refs = 1;
+
+    /* the routing table of the NIC survives the previous opens */
+    for (i = 0; i < AXIOM_NODES_NUM; i++)
+        axiom_hw_get_routing(dev, i,
+                &axshim_nics[free_slot]->routing_table[i]);
+
+    if (axshim_zone_init(axshim_nics[free_slot])) {
+        free(axshim_nics[free_slot]);
+        axshim_nics[free_slot] = NULL;
+        return NULL;
+    }
+
+    return axshim_nics[free_slot];
+}
+
+static void
+axshim_nic_put(axshim_nic_t *nic)
+{
+    int i;
+
+    if (--nic->refs)
+        return;
+
+    for (i = 0; i < AXIOM_SW_NICS_MAX; i++) {
+        if (axshim_nics[i] == nic)
+            axshim_nics[i] = NULL;
+    }
+
+    axshim_zone_release(nic);
+    free(nic);
+}
+
+/*
+ * Move the packets of the RX FIFO of the NIC in the queues of the ports.
+ * A packet for a bound port with the queue full stops the drain, so the
+ * senders wait space in the RX FIFO instead of losing the packets.
+ */
+static void
+axshim_raw_rx_drain(axshim_nic_t *nic)
+{
+    axiom_raw_msg_t *msg = &nic->raw_stall;
+
+    while (nic->raw_stalled || axiom_hw_raw_rx_avail(nic->dev) > 0) {
+        axshim_queue_t *queue;
+        int port;
+
+        if (!nic->raw_stalled)
+            axiom_hw_raw_rx(nic->dev, msg);
+        nic->raw_stalled = 0;
+
+        /* sub-ports are not emulated */
+        port = msg->header.rx.port_type.field.port;
+        if (unlikely(port >= AXIOM_PORT_NUM)) {
+            EPRINTF("message discarded - port %d", port);
+            continue;
+        }
+        queue = &nic->queues[port];
+
+        if (unlikely(queue->count == AXSHIM_QUEUE_LEN)) {
+            if ((1 << port) & nic->port_used) {
+                nic->raw_stalled = 1;
+                break;
+            }
+
+            EPRINTF("message discarded - port %d", port);
+            continue;
+        }
+
+        memcpy(&queue->msg[(queue->head + queue->count) % AXSHIM_QUEUE_LEN],
+                msg, sizeof(msg->header) + msg->header.rx.payload_size);
+        queue->count++;
+    }
+}
+
+inline static void
+axshim_raw_flush(axshim_file_t *file)
+{
+    if (file->bind_port == AXSHIM_PORT_INVALID)
+        return;
+
+    axshim_raw_rx_drain(file->nic);
+    file->nic->queues[file->bind_port].head = 0;
+    file->nic->queues[file->bind_port].count = 0;
+}
+
+/* dispatch the descriptors of the RDMA RX FIFO of the NIC */
+static void
+axshim_rdma_rx_drain(axshim_nic_t *nic)
+{
+    axiom_rdma_hdr_t hdr;
+
+    while (axiom_hw_rdma_rx_avail(nic->dev) > 0) {
+        axshim_long_queue_t *queue;
+        int port, buf_id;
+
+        axiom_hw_rdma_rx(nic->dev, &hdr);
+
+        /* ACK of a message sent by this NIC */
+        if (hdr.rx.port_type.field.s) {
+            if (likely(hdr.rx.msg_id < AXSHIM_MSG_ID_NUM))
+                nic->msg_state[hdr.rx.msg_id] =
+                    hdr.rx.port_type.field.error ?
+                    AXSHIM_MSG_NACKED : AXSHIM_MSG_ACKED;
+            continue;
+        }
+
+        /* the RDMA writes have nothing to notify */
+        if (hdr.rx.port_type.field.type != AXIOM_TYPE_LONG_DATA)
+            continue;
+
+        buf_id = ((int64_t)hdr.rx.dst_addr - AXSHIM_RDMA_SIZE) /
+            AXSHIM_LONG_BUF_SIZE;
+        if (unlikely(hdr.rx.dst_addr < AXSHIM_RDMA_SIZE ||
+                    buf_id >= AXSHIM_LONG_BUF_NUM)) {
+            EPRINTF("invalid dst_addr: 0x%x", hdr.rx.dst_addr);
+            continue;
+        }
+
+        /* nobody bound on the port: give the buffer back to the NIC */
+        port = hdr.rx.port_type.field.port;
+        if (unlikely(!((1 << port) & nic->long_port_used))) {
+            EPRINTF("message discarded - port %d", port);
+            axshim_long_buf_free(nic, buf_id);
+            continue;
+        }
+        queue = &nic->long_queues[port];
+
+        /* never full: the messages are less than the LONG buffers */
+        memcpy(&queue->hdr[(queue->head + queue->count) % AXSHIM_LONG_BUF_NUM],
+                &hdr, sizeof(hdr));
+        queue->count++;
+    }
+}
+
+/* the shim is the RX handler of all the emulated NICs of the process */
+static void
+axshim_rdma_rx_drain_all(void)
+{
+    int i;
+
+    for (i = 0; i < AXIOM_SW_NICS_MAX; i++) {
+        if (axshim_nics[i])
+            axshim_rdma_rx_drain(axshim_nics[i]);
+    }
+}
+
+static void
+axshim_long_flush(axshim_file_t *file)
+{
+    axshim_nic_t *nic = file->nic;
+    axshim_long_queue_t *queue;
+
+    if (file->bind_port == AXSHIM_PORT_INVALID)
+        return;
+
+    axshim_rdma_rx_drain(nic);
+
+    /* give the buffers of the messages not read back to the NIC */
+    queue = &nic->long_queues[file->bind_port];
+    while (queue->count) {
+        axshim_long_buf_free(nic, (queue->hdr[queue->head].rx.dst_addr -
+                    AXSHIM_RDMA_SIZE) / AXSHIM_LONG_BUF_SIZE);
+        queue->head = (queue->head + 1) % AXSHIM_LONG_BUF_NUM;
+        queue->count--;
+    }
+}
+
+/* RAW and LONG ports are bound independently, like in the driver */
+inline static uint8_t *
+axshim_port_used(axshim_file_t *file)
+{
+    if (file->type == AXSHIM_FDTYPE_LONG)
+        return &file->nic->long_port_used;
+
+    return &file->nic->port_used;
+}
+
+static void
+axshim_unbind(axshim_file_t *file)
+{
+    if (file->bind_port == AXSHIM_PORT_INVALID)
+        return;
+
+    /* the LONG buffers of the port would be lost */
+    if (file->type == AXSHIM_FDTYPE_LONG)
+        axshim_long_flush(file);
+
+    *axshim_port_used(file) &= ~(1 << file->bind_port);
+    file->bind_port = AXSHIM_PORT_INVALID;
+}
+
+static int
+axshim_bind(axshim_file_t *file, axiom_ioctl_bind_t *bind)
+{
+    uint8_t *port_used;
+    int i;
+
+    if (file->type != AXSHIM_FDTYPE_RAW && file->type != AXSHIM_FDTYPE_LONG)
+        return -EFAULT;
+
+    /* sub-ports and groups are not emulated */
+    if (bind->port == AXIOM_PORT_SUB ||
+            (bind->flags & AXIOCTL_BIND_FLAGS_REUSEPORT))
+        return -EINVAL;
+
+    axshim_unbind(file);
+    port_used = axshim_port_used(file);
+
+    if (bind->port == AXIOM_PORT_ANY) {
+        for (i = 0; i < AXIOM_PORT_NUM; i++) {
+            if (!((1 << i) & *port_used)) {
+                bind->port = i;
+                break;
+            }
+        }
+
+        if (bind->port == AXIOM_PORT_ANY)
+            return -EBUSY;
+    } else if (bind->port >= AXIOM_PORT_NUM) {
+        return -EFBIG;
+    }
+
+    if ((1 << bind->port) & *port_used)
+        return -EBUSY;
+
+    *port_used |= (1 << bind->port);
+    file->bind_port = bind->port;
+
+    if (bind->flush) {
+        if (file->type == AXSHIM_FDTYPE_LONG)
+            axshim_long_flush(file);
+        else
+            axshim_raw_flush(file);
+    }
+
+    return 0;
+}
+
+/* called without the shim lock: the TX may wait space in the RX FIFOs */
+static int
+axshim_raw_send(axshim_file_t *file, axiom_raw_hdr_t *header,
+        const struct iovec *iov, int iovcnt, int nonblock)
+{
+    axiom_dev_t *dev = file->nic->dev;
+    axiom_raw_msg_t raw_msg;
+    int i, offset;
+
+    if (unlikely(header->tx.payload_size > sizeof(raw_msg.payload)))
+        return -EFBIG;
+
+    if (unlikely(header->tx.port_type.field.type !=
+                AXIOM_TYPE_RAW_NEIGHBOUR &&
+                file->nic->routing_table[header->tx.dst] == 0x0))
+        return -ENXIO;
+
+    if (nonblock && axiom_hw_raw_tx_avail(dev) == 0)
+        return -EAGAIN;
+
+    offset = 0;
+    for (i = 0; i < iovcnt; i++) {
+        if ((iov[i].iov_len + offset) > header->tx.payload_size)
+            return -EFBIG;
+
+        memcpy((uint8_t *)(&(raw_msg.payload)) + offset, iov[i].iov_base,
+                iov[i].iov_len);
+        offset += iov[i].iov_len;
+    }
+
+    memcpy(&(raw_msg.header), header, sizeof(raw_msg.header));
+
+    /* reset error and s bit */
+    raw_msg.header.tx.port_type.field.error = 0;
+    raw_msg.header.tx.port_type.field.s = 0;
+
+    return axiom_hw_raw_tx(dev, &raw_msg);
+}
+
+static ssize_t
+axshim_raw_recv(axshim_file_t *file, axiom_raw_hdr_t *header,
+        const struct iovec *iov, int iovcnt, int nonblock)
+{
+    axiom_raw_msg_t *raw_msg;
+    axshim_queue_t *queue;
+    int i, offset;
+
+    if (unlikely(file->bind_port == AXSHIM_PORT_INVALID)) {
+        EPRINTF("port not assigned");
+        return -EFAULT;
+    }
+
+    queue = &file->nic->queues[file->bind_port];
+
+    /* the emulator has no RX interrupt handler: poll the RX FIFO */
+    axshim_raw_rx_drain(file->nic);
+    while (queue->count == 0) {
+        if (nonblock)
+            return -EAGAIN;
+
+        pthread_mutex_unlock(&axshim_lock);
+        sched_yield();
+        pthread_mutex_lock(&axshim_lock);
+
+        /* the file may be closed in the meantime */
+        if (!file->nic || file->bind_port == AXSHIM_PORT_INVALID)
+            return -EFAULT;
+
+        axshim_raw_rx_drain(file->nic);
+    }
+
+    raw_msg = &queue->msg[queue->head];
+
+    if (unlikely(header->rx.payload_size < raw_msg->header.rx.payload_size)) {
+        EPRINTF("payload received too big - payload: available %d - "
+                "received %d", header->rx.payload_size,
+                raw_msg->header.rx.payload_size);
+        return -EFBIG;
+    }
+
+    memcpy(header, &(raw_msg->header), sizeof(*header));
+
+    offset = 0;
+    for (i = 0; (i < iovcnt) &&
+            (offset < raw_msg->header.rx.payload_size); i++) {
+        int copied = iov[i].iov_len;
+
+        if (copied > raw_msg->header.rx.payload_size - offset)
+            copied = raw_msg->header.rx.payload_size - offset;
+
+        memcpy(iov[i].iov_base, (uint8_t *)(&(raw_msg->payload)) + offset,
+                copied);
+        offset += copied;
+    }
+
+    queue->head = (queue->head + 1) % AXSHIM_QUEUE_LEN;
+    queue->count--;
+
+    return sizeof(*header) + header->rx.payload_size;
+}
+
+static long
+axshim_ioctl_raw(axshim_file_t *file, unsigned long request, void *arg)
+{
+    axiom_ioctl_raw_t *raw = arg;
+    axiom_ioctl_raw_iov_t *raw_iov = arg;
+    struct iovec iov;
+    long ret = 0;
+
+    switch (request) {
+    case AXNET_BIND:
+        ret = axshim_bind(file, arg);
+        break;
+    case AXNET_UNBIND:
+        axshim_unbind(file);
+        break;
+    case AXNET_SEND_RAW:
+        iov.iov_base = raw->payload;
+        iov.iov_len = raw->header.tx.payload_size;
+        pthread_mutex_unlock(&axshim_lock);
+        ret = axshim_raw_send(file, &raw->header, &iov, 1,
+                raw->flags & AXIOCTL_MSG_FLAGS_NONBLOCK);
+        pthread_mutex_lock(&axshim_lock);
+        break;
+    case AXNET_SEND_RAW_IOV:
+        pthread_mutex_unlock(&axshim_lock);
+        ret = axshim_raw_send(file, &raw_iov->header, raw_iov->iov,
+                raw_iov->iovcnt, raw_iov->flags & AXIOCTL_MSG_FLAGS_NONBLOCK);
+        pthread_mutex_lock(&axshim_lock);
+        break;
+    case AXNET_RECV_RAW:
+        iov.iov_base = raw->payload;
+        iov.iov_len = raw->header.rx.payload_size;
+        ret = axshim_raw_recv(file, &raw->header, &iov, 1,
+                raw->flags & AXIOCTL_MSG_FLAGS_NONBLOCK);
+        break;
+    case AXNET_RECV_RAW_IOV:
+        ret = axshim_raw_recv(file, &raw_iov->header, raw_iov->iov,
+                raw_iov->iovcnt, raw_iov->flags & AXIOCTL_MSG_FLAGS_NONBLOCK);
+        break;
+    case AXNET_SEND_RAW_AVAIL:
+        *(int *)arg = axiom_hw_raw_tx_avail(file->nic->dev);
+        break;
+    case AXNET_RECV_RAW_AVAIL:
+        if (file->bind_port == AXSHIM_PORT_INVALID)
+            return -EFAULT;
+        axshim_raw_rx_drain(file->nic);
+        *(int *)arg = file->nic->queues[file->bind_port].count;
+        break;
+    case AXNET_FLUSH_RAW:
+        axshim_raw_flush(file);
+        break;
+    case AXNET_SET_BUSY_POLL:
+        /* the shim always polls */
+        break;
+    default:
+        ret = -ENOTTY;
+    }
+
+    return ret;
+}
+
+/* take a free message ID in [first, first + num) */
+static int
+axshim_msg_id_get(axshim_nic_t *nic, int first, int num)
+{
+    int i;
+
+    for (i = first; i < first + num; i++) {
+        if (nic->msg_state[i] == AXSHIM_MSG_FREE) {
+            nic->msg_state[i] = AXSHIM_MSG_PENDING;
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* number of free message IDs in [first, first + num) */
+static int
+axshim_msg_id_avail(axshim_nic_t *nic, int first, int num)
+{
+    int i, avail = 0;
+
+    for (i = first; i < first + num; i++) {
+        if (nic->msg_state[i] == AXSHIM_MSG_FREE)
+            avail++;
+    }
+
+    return avail;
+}
+
+/*
+ * Send a RDMA descriptor and wait its ACK, polling the RDMA RX FIFOs.
+ * Called with the shim lock held, released during the TX and the wait.
+ * Returns 0 if acked, 1 if the NIC replied with an error, -EFAULT if the file
+ * is closed in the meantime.
+ */
+static int
+axshim_rdma_tx_wait(axshim_file_t *file, axiom_rdma_hdr_t *header)
+{
+    axshim_nic_t *nic = file->nic;
+    axiom_dev_t *dev = nic->dev;
+    int msg_id = header->tx.msg_id;
+
+    nic->msg_state[msg_id] = AXSHIM_MSG_PENDING;
+
+    /* reset error and s bit */
+    header->tx.port_type.field.error = 0;
+    header->tx.port_type.field.s = 0;
+
+    pthread_mutex_unlock(&axshim_lock);
+    axiom_hw_rdma_tx(dev, header);
+    pthread_mutex_lock(&axshim_lock);
+
+    for (;;) {
+        /* the file may be closed in the meantime */
+        if (file->nic != nic)
+            return -EFAULT;
+
+        axshim_rdma_rx_drain_all();
+        if (nic->msg_state[msg_id] != AXSHIM_MSG_PENDING)
+            break;
+
+        pthread_mutex_unlock(&axshim_lock);
+        sched_yield();
+        pthread_mutex_lock(&axshim_lock);
+    }
+
+    return nic->msg_state[msg_id] == AXSHIM_MSG_NACKED;
+}
+
+/* the LONG messages are acked before returning */
+static int
+axshim_long_send(axshim_file_t *file, axiom_rdma_hdr_t *user_header,
+        const struct iovec *iov, int iovcnt, int nonblock)
+{
+    axshim_nic_t *nic = file->nic;
+    axiom_rdma_hdr_t header;
+    uint8_t *payload;
+    int msg_id, i, offset, retries, ret;
+
+    if (unlikely(user_header->tx.payload_size > AXIOM_LONG_PAYLOAD_MAX_SIZE))
+        return -EFBIG;
+
+    if (unlikely(nic->routing_table[user_header->tx.dst] == 0x0))
+        return -ENXIO;
+
+    /* the message ID is the TX buffer */
+    while ((msg_id = axshim_msg_id_get(nic, 0, AXSHIM_LONG_BUF_NUM)) < 0) {
+        if (nonblock)
+            return -EAGAIN;
+
+        pthread_mutex_unlock(&axshim_lock);
+        sched_yield();
+        pthread_mutex_lock(&axshim_lock);
+
+        if (file->nic != nic)
+            return -EFAULT;
+    }
+
+    if (nonblock && axiom_hw_rdma_tx_avail(nic->dev) == 0) {
+        ret = -EAGAIN;
+        goto free_id;
+    }
+
+    /* copy the payload in the TX buffer */
+    payload = axshim_long_tx_buf(nic, msg_id);
+    offset = 0;
+    for (i = 0; i < iovcnt; i++) {
+        if ((iov[i].iov_len + offset) > user_header->tx.payload_size) {
+            ret = -EFBIG;
+            goto free_id;
+        }
+
+        memcpy(payload + offset, iov[i].iov_base, iov[i].iov_len);
+        offset += iov[i].iov_len;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.tx.port_type = user_header->tx.port_type;
+    header.tx.dst = user_header->tx.dst;
+    header.tx.msg_id = msg_id;
+    header.tx.payload_size = user_header->tx.payload_size;
+    header.tx.src_addr = payload - nic->zone;
+
+    /* no LONG buffer free on the receiver: retry, like the driver */
+    for (retries = 0; ; retries++) {
+        ret = axshim_rdma_tx_wait(file, &header);
+        if (ret < 0)
+            return ret;
+        if (ret == 0)
+            break;
+
+        if (retries == AXSHIM_LONG_RETRY_MAX) {
+            EPRINTF("Message discarded after %d retries - "
+                    "msg_id: %u dst_id: %u port: %u", retries, msg_id,
+                    header.tx.dst, header.tx.port_type.field.port);
+            break;
+        }
+
+        pthread_mutex_unlock(&axshim_lock);
+        usleep(AXSHIM_RETRY_DELAY_USEC);
+        pthread_mutex_lock(&axshim_lock);
+
+        if (file->nic != nic)
+            return -EFAULT;
+    }
+
+    ret = msg_id;
+
+free_id:
+    nic->msg_state[msg_id] = AXSHIM_MSG_FREE;
+    return ret;
+}
+
+static ssize_t
+axshim_long_recv(axshim_file_t *file, axiom_rdma_hdr_t *header,
+        const struct iovec *iov, int iovcnt, int nonblock)
+{
+    axshim_long_queue_t *queue;
+    axiom_rdma_hdr_t *hdr;
+    uint8_t *payload;
+    int i, offset, buf_id;
+
+    if (unlikely(file->bind_port == AXSHIM_PORT_INVALID)) {
+        EPRINTF("port not assigned");
+        return -EFAULT;
+    }
+
+    queue = &file->nic->long_queues[file->bind_port];
+
+    /* the emulator has no RX interrupt handler: poll the RX FIFO */
+    axshim_rdma_rx_drain(file->nic);
+    while (queue->count == 0) {
+        if (nonblock)
+            return -EAGAIN;
+
+        pthread_mutex_unlock(&axshim_lock);
+        sched_yield();
+        pthread_mutex_lock(&axshim_lock);
+
+        /* the file may be closed in the meantime */
+        if (!file->nic || file->bind_port == AXSHIM_PORT_INVALID)
+            return -EFAULT;
+
+        axshim_rdma_rx_drain(file->nic);
+    }
+
+    hdr = &queue->hdr[queue->head];
+
+    if (unlikely(header->rx.payload_size < hdr->rx.payload_size)) {
+        EPRINTF("payload received too big - payload: available %d - "
+                "received %d", header->rx.payload_size,
+                hdr->rx.payload_size);
+        return -EFBIG;
+    }
+
+    memcpy(header, hdr, sizeof(*header));
+
+    buf_id = (hdr->rx.dst_addr - AXSHIM_RDMA_SIZE) / AXSHIM_LONG_BUF_SIZE;
+    payload = file->nic->zone + hdr->rx.dst_addr;
+
+    offset = 0;
+    for (i = 0; (i < iovcnt) && (offset < header->rx.payload_size); i++) {
+        int copied = iov[i].iov_len;
+
+        if (copied > header->rx.payload_size - offset)
+            copied = header->rx.payload_size - offset;
+
+        memcpy(iov[i].iov_base, payload + offset, copied);
+        offset += copied;
+    }
+
+    queue->head = (queue->head + 1) % AXSHIM_LONG_BUF_NUM;
+    queue->count--;
+
+    /* free the buffer for the NIC */
+    axshim_long_buf_free(file->nic, buf_id);
+
+    return sizeof(*header) + header->rx.payload_size;
+}
+
+static long
+axshim_ioctl_long(axshim_file_t *file, unsigned long request, void *arg)
+{
+    axiom_ioctl_long_t *long_msg = arg;
+    axiom_ioctl_long_iov_t *long_iov = arg;
+    struct iovec iov;
+    long ret = 0;
+
+    switch (request) {
+    case AXNET_BIND:
+        ret = axshim_bind(file, arg);
+        break;
+    case AXNET_UNBIND:
+        axshim_unbind(file);
+        break;
+    case AXNET_SEND_LONG:
+        iov.iov_base = long_msg->payload;
+        iov.iov_len = long_msg->header.tx.payload_size;
+        ret = axshim_long_send(file, &long_msg->header, &iov, 1, 0);
+        break;
+    case AXNET_SEND_LONG_IOV:
+        ret = axshim_long_send(file, &long_iov->header, long_iov->iov,
+                long_iov->iovcnt, long_iov->flags & AXIOCTL_MSG_FLAGS_NONBLOCK);
+        break;
+    case AXNET_RECV_LONG:
+        iov.iov_base = long_msg->payload;
+        iov.iov_len = long_msg->header.rx.payload_size;
+        ret = axshim_long_recv(file, &long_msg->header, &iov, 1, 0);
+        break;
+    case AXNET_RECV_LONG_IOV:
+        ret = axshim_long_recv(file, &long_iov->header, long_iov->iov,
+                long_iov->iovcnt, long_iov->flags & AXIOCTL_MSG_FLAGS_NONBLOCK);
+        break;
+    case AXNET_SEND_LONG_AVAIL:
+        *(int *)arg = axiom_hw_rdma_tx_avail(file->nic->dev) &&
+            axshim_msg_id_avail(file->nic, 0, AXSHIM_LONG_BUF_NUM);
+        break;
+    case AXNET_RECV_LONG_AVAIL:
+        if (file->bind_port == AXSHIM_PORT_INVALID)
+            return -EFAULT;
+        axshim_rdma_rx_drain(file->nic);
+        *(int *)arg = file->nic->long_queues[file->bind_port].count;
+        break;
+    case AXNET_FLUSH_LONG:
+        if (file->bind_port == AXSHIM_PORT_INVALID)
+            return -EFAULT;
+        axshim_long_flush(file);
+        break;
+    case AXNET_SET_BUSY_POLL:
+        /* the shim always polls */
+        break;
+    default:
+        ret = -ENOTTY;
+    }
+
+    return ret;
+}
+
+/*
+ * Offset in the application area of the RDMA zone: the addresses in the zone
+ * mapped by the library are translated, the other ones are offsets (like in
+ * the RDMA debug mode of the driver).
+ */
+static int
+axshim_rdma_offset(axshim_nic_t *nic, void *addr, uint32_t size,
+        uint32_t *offset)
+{
+    uintptr_t off = (uintptr_t)addr;
+
+    if (nic->rdma_map && off >= (uintptr_t)nic->rdma_map &&
+            off < (uintptr_t)nic->rdma_map + AXSHIM_RDMA_SIZE)
+        off -= (uintptr_t)nic->rdma_map;
+
+    if (unlikely(size > AXSHIM_RDMA_SIZE || off > AXSHIM_RDMA_SIZE - size ||
+                (off & (AXIOM_RDMA_ADDRESS_ALIGNMENT - 1)))) {
+        EPRINTF("invalid address %p size %u", addr, size);
+        return -EFAULT;
+    }
+
+    *offset = off;
+    return 0;
+}
+
+/* the RDMA are completed before returning, also the asynchronous ones */
+static int
+axshim_rdma(axshim_file_t *file, axiom_ioctl_rdma_t *rdma)
+{
+    axshim_nic_t *nic = file->nic;
+    uint32_t size, src_addr, dst_addr;
+    int msg_id, ret;
+
+    /* the memory regions are not emulated (AXNET_MR_REG fails) */
+    if (unlikely(rdma->flags & AXIOCTL_RDMA_FLAGS_MR))
+        return -EINVAL;
+
+    if (unlikely(nic->routing_table[rdma->header.tx.dst] == 0x0))
+        return -ENXIO;
+
+    size = (uint32_t)rdma->header.tx.payload_size <<
+        AXIOM_RDMA_PAYLOAD_SIZE_ORDER;
+    if (axshim_rdma_offset(nic, rdma->src_addr, size, &src_addr) ||
+            axshim_rdma_offset(nic, rdma->dst_addr, size, &dst_addr))
+        return -EFAULT;
+
+    msg_id = axshim_msg_id_get(nic, AXSHIM_LONG_BUF_NUM,
+            AXSHIM_MSG_ID_NUM - AXSHIM_LONG_BUF_NUM);
+    while (msg_id < 0) {
+        if (rdma->flags & AXIOCTL_RDMA_FLAGS_NONBLOCK)
+            return -EAGAIN;
+
+        pthread_mutex_unlock(&axshim_lock);
+        sched_yield();
+        pthread_mutex_lock(&axshim_lock);
+
+        if (file->nic != nic)
+            return -EFAULT;
+
+        msg_id = axshim_msg_id_get(nic, AXSHIM_LONG_BUF_NUM,
+                AXSHIM_MSG_ID_NUM - AXSHIM_LONG_BUF_NUM);
+    }
+
+    if ((rdma->flags & AXIOCTL_RDMA_FLAGS_NONBLOCK) &&
+            axiom_hw_rdma_tx_avail(nic->dev) == 0) {
+        nic->msg_state[msg_id] = AXSHIM_MSG_FREE;
+        return -EAGAIN;
+    }
+
+    rdma->header.tx.msg_id = msg_id;
+    rdma->header.tx.src_addr = src_addr;
+    rdma->header.tx.dst_addr = dst_addr;
+
+    ret = axshim_rdma_tx_wait(file, &rdma->header);
+    if (ret < 0)
+        return ret;
+
+    nic->msg_state[msg_id] = AXSHIM_MSG_FREE;
+
+    if (ret) {
+        EPRINTF("RDMA failed - msg_id: %d dst_id: %u", msg_id,
+                rdma->header.tx.dst);
+        return -EFAULT;
+    }
+
+    /* the token is already acked */
+    rdma->token.raw = 0;
+    rdma->token.rdma.msg_id = msg_id;
+    rdma->token.rdma.status = AXIOM_TOKEN_ACKED;
+
+    return msg_id;
+}
+
+/* every RDMA is completed when the ioctl returns: the pending tokens too */
+static int
+axshim_rdma_check(axiom_ioctl_token_t *token_ioctl)
+{
+    int i, acked = 0;
+
+    for (i = 0; i < token_ioctl->count; i++) {
+        axiom_token_t *token = &token_ioctl->tokens[i];
+
+        if (token->rdma.status == AXIOM_TOKEN_PENDING)
+            token->rdma.status = AXIOM_TOKEN_ACKED;
+        if (token->rdma.status == AXIOM_TOKEN_ACKED)
+            acked++;
+    }
+
+    return acked;
+}
+
+static long
+axshim_ioctl_rdma(axshim_file_t *file, unsigned long request, void *arg)
+{
+    axiom_ioctl_token_t *token_ioctl = arg;
+    long ret = 0;
+
+    switch (request) {
+    case AXNET_RDMA_SIZE:
+        *(uint64_t *)arg = AXSHIM_RDMA_SIZE;
+        break;
+    case AXNET_RDMA_WRITE:
+    case AXNET_RDMA_READ:
+        ret = axshim_rdma(file, arg);
+        break;
+    case AXNET_RDMA_CHECK:
+        ret = axshim_rdma_check(token_ioctl);
+        break;
+    case AXNET_RDMA_WAIT:
+        if (token_ioctl->count != 1) {
+            EPRINTF("Expected only 1 token [token count: %d]",
+                    token_ioctl->count);
+            return -EINVAL;
+        }
+        axshim_rdma_check(token_ioctl);
+        break;
+    default:
+        ret = -ENOTTY;
+    }
+
+    return ret;
+}
+
+static long
+axshim_ioctl_generic(axshim_file_t *file, unsigned long request, void *arg)
+{
+    axshim_nic_t *nic = file->nic;
+    axiom_ioctl_routing_t *routing = arg;
+    axiom_ioctl_routing_table_t *routing_table = arg;
+    uint8_t *buf_uint8 = arg, buf_uint8_2;
+    long ret = 0;
+
+    switch (request) {
+    case AXNET_SET_NODEID:
+        axiom_hw_set_node_id(nic->dev, *buf_uint8);
+        break;
+    case AXNET_GET_NODEID:
+        *buf_uint8 = axiom_hw_get_node_id(nic->dev);
+        break;
+    case AXNET_SET_ROUTING:
+        ret = axiom_hw_set_routing(nic->dev, routing->node_id,
+                routing->enabled_mask);
+        if (ret)
+            return -EFAULT;
+        nic->routing_table[routing->node_id] = routing->enabled_mask;
+        nic->routing_gen++;
+        break;
+    case AXNET_GET_ROUTING:
+        ret = axiom_hw_get_routing(nic->dev, routing->node_id,
+                &routing->enabled_mask);
+        if (ret)
+            return -EFAULT;
+        if (nic->routing_table[routing->node_id] != routing->enabled_mask) {
+            nic->routing_table[routing->node_id] = routing->enabled_mask;
+            nic->routing_gen++;
+        }
+        break;
+    case AXNET_GET_ROUTING_TABLE:
+        routing_table->generation = nic->routing_gen;
+        memcpy(routing_table->enabled_mask, nic->routing_table,
+                sizeof(routing_table->enabled_mask));
+        break;
+    case AXNET_GET_IFNUMBER:
+        ret = axiom_hw_get_if_number(nic->dev, buf_uint8);
+        break;
+    case AXNET_GET_IFINFO:
+        ret = axiom_hw_get_if_info(nic->dev, *buf_uint8, &buf_uint8_2);
+        *buf_uint8 = buf_uint8_2;
+        break;
+    case AXNET_SET_BUSY_POLL:
+        break;
+    default:
+        ret = -ENOTTY;
+    }
+
+    return ret;
+}
+
+void
+axiom_swnic_select(axiom_dev_t *nic)
+{
+    pthread_mutex_lock(&axshim_lock);
+    axshim_selected = nic;
+    pthread_mutex_unlock(&axshim_lock);
+}
+
+int
+axiom_swnic_open(const char *path, int flags)
+{
+    axshim_nic_t *nic;
+    int type, fd;
+
+    for (type = 0; type < AXSHIM_DEV_NUM; type++) {
+        if (!strcmp(path, axshim_dev_names[type]))
+            break;
+    }
+
+    if (type == AXSHIM_DEV_NUM) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    pthread_mutex_lock(&axshim_lock);
+
+    if (!axshim_selected) {
+        errno = ENODEV;
+        goto err;
+    }
+
+    for (fd = 0; fd < AXSHIM_FD_MAX; fd++) {
+        if (!axshim_files[fd].nic)
+            break;
+    }
+
+    if (fd == AXSHIM_FD_MAX) {
+        errno = EMFILE;
+        goto err;
+    }
+
+    nic = axshim_nic_get(axshim_selected);
+    if (!nic) {
+        errno = ENOMEM;
+        goto err;
+    }
+
+    axshim_files[fd].type = type;
+    axshim_files[fd].bind_port = AXSHIM_PORT_INVALID;
+    axshim_files[fd].nic = nic;
+
+    pthread_mutex_unlock(&axshim_lock);
+
+    return AXSHIM_FD_BASE + fd;
+
+err:
+    pthread_mutex_unlock(&axshim_lock);
+    return -1;
+}
+
+int
+axiom_swnic_close(int fd)
+{
+    axshim_file_t *file = axshim_file(fd);
+
+    if (!file)
+        return close(fd);
+
+    pthread_mutex_lock(&axshim_lock);
+
+    if (!file->nic) {
+        pthread_mutex_unlock(&axshim_lock);
+        errno = EBADF;
+        return -1;
+    }
+
+    axshim_unbind(file);
+    axshim_nic_put(file->nic);
+    file->nic = NULL;
+
+    pthread_mutex_unlock(&axshim_lock);
+
+    return 0;
+}
+
+int
+axiom_swnic_ioctl(int fd, unsigned long request, void *arg, ...)
+{
+    axshim_file_t *file = axshim_file(fd);
+    long ret;
+
+    if (!file)
+        return ioctl(fd, request, arg);
+
+    pthread_mutex_lock(&axshim_lock);
+
+    if (!file->nic) {
+        ret = -EBADF;
+    } else if (file->type == AXSHIM_FDTYPE_GENERIC) {
+        ret = axshim_ioctl_generic(file, request, arg);
+    } else if (file->type == AXSHIM_FDTYPE_RAW) {
+        ret = axshim_ioctl_raw(file, request, arg);
+    } else if (file->type == AXSHIM_FDTYPE_LONG) {
+        ret = axshim_ioctl_long(file, request, arg);
+    } else {
+        ret = axshim_ioctl_rdma(file, request, arg);
+    }
+
+    pthread_mutex_unlock(&axshim_lock);
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
+void *
+axiom_swnic_mmap(void *addr, size_t length, int prot, int flags, int fd,
+        off_t offset)
+{
+    axshim_file_t *file = axshim_file(fd);
+    void *ret = MAP_FAILED;
+
+    if (!file)
+        return mmap(addr, length, prot, flags, fd, offset);
+
+    pthread_mutex_lock(&axshim_lock);
+
+    /* only the application area of the RDMA zone can be mapped */
+    if (!file->nic) {
+        errno = EBADF;
+    } else if (file->type != AXSHIM_FDTYPE_RDMA) {
+        errno = ENODEV;
+    } else if (length != AXSHIM_RDMA_SIZE || offset != 0) {
+        errno = EINVAL;
+    } else {
+        ret = mmap(addr, length, prot, flags, file->nic->zone_fd, 0);
+        if (ret != MAP_FAILED && !file->nic->rdma_map)
+            file->nic->rdma_map = ret;
+    }
+
+    pthread_mutex_unlock(&axshim_lock);
+
+    return ret;
+}
+
+int
+axiom_swnic_munmap(void *addr, size_t length)
+{
+    int i;
+
+    pthread_mutex_lock(&axshim_lock);
+
+    for (i = 0; i < AXIOM_SW_NICS_MAX; i++) {
+        if (axshim_nics[i] && axshim_nics[i]->rdma_map == addr)
+            axshim_nics[i]->rdma_map = NULL;
+    }
+
+    pthread_mutex_unlock(&axshim_lock);
+
+    return munmap(addr, length);
+}
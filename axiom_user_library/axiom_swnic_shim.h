@@ -0,0 +1,104 @@
+/*!
+ * \file axiom_swnic_shim.h
+ *
+ * \version     v1.2
+ * \date        2016-11-14
+ *
+ * This file contains the user-space shim that runs the AXIOM user library
+ * on the AXIOM NIC software emulator (axiom_nic_api_sw.h), without the
+ * kernel module.
+ *
+ * When axiom_user_api.c is compiled with AXIOM_SWNIC_SUPPORT, the system
+ * calls used on the AXIOM devices are replaced by the functions of this file,
+ * that emulate the ioctls of the driver on top of the axiom_hw_* API of the
+ * emulated NIC selected with axiom_swnic_select().
+ * The generic, RAW, LONG and RDMA ioctls are emulated; the RDMA transfers
+ * complete before the ioctl returns, also when asynchronous. The other ones
+ * (memory registration, rings, events, generic receive) fail with ENOTTY.
+ *
+ * Copyright (C) 2016, Evidence Srl.
+ * Terms of use are as specified in COPYING
+ */
+#ifndef AXIOM_SWNIC_SHIM_h
+#define AXIOM_SWNIC_SHIM_h
+
+#include <sys/types.h>
+
+#include "axiom_nic_types.h"
+
+/*! \brief First file descriptor returned by the shim */
+#define AXSHIM_FD_BASE          0x10000
+/*! \brief Max number of file descriptors opened through the shim */
+#define AXSHIM_FD_MAX           64
+
+/*!
+ * \brief Select the emulated NIC used by the next axiom_open()
+ *
+ * \param nic           Emulated NIC returned by axiom_sw_dev_alloc()
+ *                      (NULL to fail the next opens)
+ */
+void
+axiom_swnic_select(axiom_dev_t *nic);
+
+/*!
+ * \brief open() of the AXIOM devices on the selected emulated NIC
+ *
+ * \param path          Path of the AXIOM device
+ * \param flags         Open flags (unused)
+ *
+ * \return The new file descriptor on success, otherwise -1 and errno is set.
+ */
+int
+axiom_swnic_open(const char *path, int flags);
+
+/*!
+ * \brief close() of the file descriptors returned by axiom_swnic_open()
+ *
+ * The other file descriptors are closed with the system call.
+ *
+ * \param fd            File descriptor to close
+ *
+ * \return 0 on success, otherwise -1 and errno is set.
+ */
+int
+axiom_swnic_close(int fd);
+
+/*!
+ * \brief ioctl() of the file descriptors returned by axiom_swnic_open()
+ *
+ * The other file descriptors are handled by the system call.
+ *
+ * \param fd            File descriptor
+ * \param request       AXNET_* ioctl
+ * \param arg           Argument of the ioctl (NULL if not needed)
+ *
+ * \return The value returned by the driver on success, otherwise -1 and
+ *         errno is set.
+ */
+int
+axiom_swnic_ioctl(int fd, unsigned long request, void *arg, ...);
+
+/*!
+ * \brief mmap() of the file descriptors returned by axiom_swnic_open()
+ *
+ * On the RDMA device it maps the application area of the RDMA zone of the
+ * emulated NIC (offset 0, length returned by the AXNET_RDMA_SIZE ioctl); it
+ * fails with ENODEV on the other AXIOM devices. The other file descriptors
+ * are handled by the system call.
+ *
+ * \return The mapped address on success, otherwise MAP_FAILED and errno is
+ *         set.
+ */
+void *
+axiom_swnic_mmap(void *addr, size_t length, int prot, int flags, int fd,
+        off_t offset);
+
+/*!
+ * \brief munmap() of the areas mapped through axiom_swnic_mmap()
+ *
+ * \return 0 on success, otherwise -1 and errno is set.
+ */
+int
+axiom_swnic_munmap(void *addr, size_t length);
+
+#endif /* !AXIOM_SWNIC_SHIM_h */
@@ -0,0 +1,457 @@
+/*!
+ * \file axiom_swnic_test.c
+ *
+ * \version     v1.2
+ * \date        2016-11-14
+ *
+ * This file contains the test of the AXIOM user library on the AXIOM NIC
+ * software emulator (through the shim of axiom_swnic_shim.h):
+ *      - two emulated NICs connected by a link exchange RAW and LONG messages
+ *      - RDMA write and read between the RDMA zones of the two NICs
+ *      - the next hop follows the routing table set through the library
+ *      - a node not in the routing table is not reachable
+ *      - the packets routed on an interface not connected are discarded and
+ *        counted by the emulator
+ *
+ * Copyright (C) 2016, Evidence Srl
+ * Terms of use are as specified in COPYING
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/uio.h>
+
+#include "dprintf.h"
+#include "axiom_nic_api_user.h"
+#include "axiom_nic_regs.h"
+#include "axiom_nic_packets.h"
+#include "axiom_nic_api_sw.h"
+#include "axiom_swnic_shim.h"
+
+int verbose = 0;
+
+/*! \brief Node id of the 1st emulated NIC */
+#define SWNIC_TEST_NODE_A       1
+/*! \brief Node id of the 2nd emulated NIC */
+#define SWNIC_TEST_NODE_B       2
+/*! \brief Node id routed on an interface not connected */
+#define SWNIC_TEST_NODE_LOST    9
+/*! \brief Node id not in the routing tables */
+#define SWNIC_TEST_NODE_NONE    3
+/*! \brief Interface that connects the two NICs */
+#define SWNIC_TEST_IF_LINK      1
+/*! \brief Interface not connected */
+#define SWNIC_TEST_IF_NONE      2
+/*! \brief Port bound on both nodes */
+#define SWNIC_TEST_PORT         1
+/*! \brief Size of the RDMA transfers */
+#define SWNIC_TEST_RDMA_SIZE    (64 * 1024)
+
+static void
+usage(void)
+{
+    printf("usage: axiom_swnic_test [arguments]\n");
+    printf("Test of the AXIOM user library on the software NIC emulator\n\n");
+    printf("Arguments:\n");
+    printf("-m, --messages   msgs      messages sent by each node "
+            "[default: 16]\n");
+    printf("-v, --verbose              verbose output\n");
+    printf("-h, --help                 print this help\n\n");
+}
+
+/* open the library on an emulated NIC, like a process on that node */
+static axiom_dev_t *
+swnic_test_open(axiom_dev_t *nic, axiom_node_id_t node_id)
+{
+    axiom_dev_t *dev;
+    axiom_err_t ret;
+
+    axiom_swnic_select(nic);
+    dev = axiom_open(NULL);
+    if (!dev) {
+        EPRINTF("axiom_open failed - node: %u", node_id);
+        return NULL;
+    }
+
+    axiom_set_node_id(dev, node_id);
+
+    ret = axiom_bind(dev, SWNIC_TEST_PORT);
+    if (ret != SWNIC_TEST_PORT) {
+        EPRINTF("axiom_bind failed - node: %u ret: %d", node_id, ret);
+        goto err;
+    }
+
+    return dev;
+
+err:
+    axiom_close(dev);
+    return NULL;
+}
+
+/* send 'msgs' RAW messages from src to dst and check them on dst */
+static int
+swnic_test_raw(axiom_dev_t *src, axiom_node_id_t src_id, axiom_dev_t *dst,
+        axiom_node_id_t dst_id, int msgs)
+{
+    uint8_t buf[AXIOM_RAW_PAYLOAD_MAX_SIZE];
+    axiom_raw_payload_size_t size;
+    axiom_node_id_t node;
+    axiom_port_t port;
+    axiom_type_t type;
+    axiom_err_t ret;
+    int i, j;
+
+    /* messages of all the sizes, less than the RX FIFO of the emulator */
+    for (i = 0; i < msgs; i++) {
+        size = (i * 37) % AXIOM_RAW_PAYLOAD_MAX_SIZE + 1;
+        for (j = 0; j < size; j++)
+            buf[j] = (uint8_t)(i + j);
+
+        ret = axiom_send_raw(src, dst_id, SWNIC_TEST_PORT,
+                AXIOM_TYPE_RAW_DATA, size, buf);
+        if (!AXIOM_RET_IS_OK(ret)) {
+            EPRINTF("axiom_send_raw failed - msg: %d ret: %d", i, ret);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < msgs; i++) {
+        size = sizeof(buf);
+        ret = axiom_recv_raw(dst, &node, &port, &type, &size, buf);
+        if (!AXIOM_RET_IS_OK(ret)) {
+            EPRINTF("axiom_recv_raw failed - msg: %d ret: %d", i, ret);
+            return -1;
+        }
+
+        if (node != src_id || port != SWNIC_TEST_PORT ||
+                type != AXIOM_TYPE_RAW_DATA ||
+                size != (i * 37) % AXIOM_RAW_PAYLOAD_MAX_SIZE + 1) {
+            EPRINTF("wrong header - msg: %d src: %u port: %u type: %u "
+                    "size: %u", i, node, port, type, size);
+            return -1;
+        }
+
+        for (j = 0; j < size; j++) {
+            if (buf[j] != (uint8_t)(i + j)) {
+                EPRINTF("wrong payload - msg: %d byte: %d", i, j);
+                return -1;
+            }
+        }
+    }
+
+    IPRINTF(verbose, "%d RAW messages from node %u to node %u", msgs,
+            src_id, dst_id);
+
+    return 0;
+}
+
+/* send 'msgs' LONG messages from src to dst and check them on dst */
+static int
+swnic_test_long(axiom_dev_t *src, axiom_node_id_t src_id, axiom_dev_t *dst,
+        axiom_node_id_t dst_id, int msgs)
+{
+    axiom_long_payload_size_t size;
+    axiom_node_id_t node;
+    axiom_port_t port;
+    struct iovec iov[2];
+    uint8_t *buf;
+    axiom_err_t ret;
+    int i, j, err = -1;
+
+    buf = malloc(AXIOM_LONG_PAYLOAD_MAX_SIZE);
+    if (!buf) {
+        EPRINTF("malloc failed");
+        return -1;
+    }
+
+    /* the receiver has a LONG buffer for each message */
+    for (i = 0; i < msgs; i++) {
+        size = AXIOM_LONG_PAYLOAD_MAX_SIZE -
+            (i * 4099) % AXIOM_LONG_PAYLOAD_MAX_SIZE;
+        for (j = 0; j < size; j++)
+            buf[j] = (uint8_t)(i * 3 + j);
+
+        /* the odd messages are scattered in two buffers */
+        if (i & 1) {
+            iov[0].iov_base = buf;
+            iov[0].iov_len = size / 2;
+            iov[1].iov_base = buf + size / 2;
+            iov[1].iov_len = size - size / 2;
+            ret = axiom_send_iov_long(src, dst_id, SWNIC_TEST_PORT, size, iov,
+                    2);
+        } else {
+            ret = axiom_send_long(src, dst_id, SWNIC_TEST_PORT, size, buf);
+        }
+        if (!AXIOM_RET_IS_OK(ret)) {
+            EPRINTF("axiom_send_long failed - msg: %d ret: %d", i, ret);
+            goto out;
+        }
+    }
+
+    if (axiom_recv_long_avail(dst) != msgs) {
+        EPRINTF("LONG messages available - %d [expected %d]",
+                axiom_recv_long_avail(dst), msgs);
+        goto out;
+    }
+
+    for (i = 0; i < msgs; i++) {
+        size = AXIOM_LONG_PAYLOAD_MAX_SIZE;
+        ret = axiom_recv_long(dst, &node, &port, &size, buf);
+        if (!AXIOM_RET_IS_OK(ret)) {
+            EPRINTF("axiom_recv_long failed - msg: %d ret: %d", i, ret);
+            goto out;
+        }
+
+        if (node != src_id || port != SWNIC_TEST_PORT ||
+                size != AXIOM_LONG_PAYLOAD_MAX_SIZE -
+                (i * 4099) % AXIOM_LONG_PAYLOAD_MAX_SIZE) {
+            EPRINTF("wrong header - msg: %d src: %u port: %u size: %u", i,
+                    node, port, size);
+            goto out;
+        }
+
+        for (j = 0; j < size; j++) {
+            if (buf[j] != (uint8_t)(i * 3 + j)) {
+                EPRINTF("wrong payload - msg: %d byte: %d", i, j);
+                goto out;
+            }
+        }
+    }
+
+    IPRINTF(verbose, "%d LONG messages from node %u to node %u", msgs,
+            src_id, dst_id);
+    err = 0;
+
+out:
+    free(buf);
+    return err;
+}
+
+/* write the RDMA zone of the remote node and read it back */
+static int
+swnic_test_rdma(axiom_dev_t *dev, axiom_node_id_t remote_id)
+{
+    axiom_token_t token;
+    size_t rdma_size = 0;
+    uint8_t *zone;
+    axiom_err_t ret;
+    int i, err = -1;
+
+    /* one zone per process: the remote node uses the same addresses */
+    zone = axiom_rdma_mmap(dev, &rdma_size);
+    if (!zone || rdma_size < 3 * SWNIC_TEST_RDMA_SIZE) {
+        EPRINTF("axiom_rdma_mmap failed - size: %zu", rdma_size);
+        return -1;
+    }
+
+    for (i = 0; i < SWNIC_TEST_RDMA_SIZE; i++) {
+        zone[i] = (uint8_t)(i * 7);
+        zone[2 * SWNIC_TEST_RDMA_SIZE + i] = 0;
+    }
+
+    ret = axiom_rdma_write(dev, remote_id, SWNIC_TEST_RDMA_SIZE, zone,
+            zone + SWNIC_TEST_RDMA_SIZE, &token);
+    if (!AXIOM_RET_IS_OK(ret)) {
+        EPRINTF("axiom_rdma_write failed - ret: %d", ret);
+        goto out;
+    }
+
+    ret = axiom_rdma_wait(dev, &token, 1);
+    if (!AXIOM_RET_IS_OK(ret) || !AXIOM_TOKEN_IS_ACKED(&token)) {
+        EPRINTF("axiom_rdma_wait failed - ret: %d", ret);
+        goto out;
+    }
+
+    ret = axiom_rdma_read_sync(dev, remote_id, SWNIC_TEST_RDMA_SIZE,
+            zone + SWNIC_TEST_RDMA_SIZE, zone + 2 * SWNIC_TEST_RDMA_SIZE,
+            NULL);
+    if (!AXIOM_RET_IS_OK(ret)) {
+        EPRINTF("axiom_rdma_read_sync failed - ret: %d", ret);
+        goto out;
+    }
+
+    if (memcmp(zone, zone + 2 * SWNIC_TEST_RDMA_SIZE, SWNIC_TEST_RDMA_SIZE)) {
+        EPRINTF("wrong data read from node %u", remote_id);
+        goto out;
+    }
+
+    /* outside the RDMA zone */
+    ret = axiom_rdma_write_sync(dev, remote_id, SWNIC_TEST_RDMA_SIZE, zone,
+            zone + rdma_size, NULL);
+    if (AXIOM_RET_IS_OK(ret)) {
+        EPRINTF("RDMA write outside the zone - ret: %d", ret);
+        goto out;
+    }
+
+    ret = axiom_rdma_write_sync(dev, SWNIC_TEST_NODE_NONE,
+            SWNIC_TEST_RDMA_SIZE, zone, zone, NULL);
+    if (ret != AXIOM_RET_NOTREACH) {
+        EPRINTF("node not routed - ret: %d", ret);
+        goto out;
+    }
+
+    IPRINTF(verbose, "RDMA write/read of %d bytes on node %u",
+            SWNIC_TEST_RDMA_SIZE, remote_id);
+    err = 0;
+
+out:
+    axiom_rdma_munmap(dev);
+    return err;
+}
+
+static int
+swnic_test_routing(axiom_dev_t *nic, axiom_dev_t *dev, axiom_dev_t *dst)
+{
+    axiom_raw_payload_size_t size;
+    axiom_node_id_t node;
+    axiom_port_t port;
+    axiom_type_t type;
+    axiom_if_id_t if_id;
+    uint8_t buf[8] = { 0 };
+    axiom_err_t ret;
+
+    ret = axiom_next_hop(dev, SWNIC_TEST_NODE_B, &if_id);
+    if (!AXIOM_RET_IS_OK(ret) || if_id != SWNIC_TEST_IF_LINK) {
+        EPRINTF("wrong next hop - ret: %d if: %u", ret, if_id);
+        return -1;
+    }
+
+    /* not in the routing table: refused by the driver */
+    ret = axiom_send_raw(dev, SWNIC_TEST_NODE_NONE, SWNIC_TEST_PORT,
+            AXIOM_TYPE_RAW_DATA, sizeof(buf), buf);
+    if (ret != AXIOM_RET_NOTREACH) {
+        EPRINTF("node not routed - ret: %d", ret);
+        return -1;
+    }
+
+    /* routed on an interface not connected: discarded by the emulator */
+    ret = axiom_set_routing(dev, SWNIC_TEST_NODE_LOST,
+            1 << SWNIC_TEST_IF_NONE);
+    if (!AXIOM_RET_IS_OK(ret))
+        return -1;
+
+    ret = axiom_send_raw(dev, SWNIC_TEST_NODE_LOST, SWNIC_TEST_PORT,
+            AXIOM_TYPE_RAW_DATA, sizeof(buf), buf);
+    if (!AXIOM_RET_IS_OK(ret)) {
+        EPRINTF("axiom_send_raw failed - ret: %d", ret);
+        return -1;
+    }
+
+    if (axiom_sw_raw_discarded(nic) != 1) {
+        EPRINTF("RAW packets discarded - %u [expected 1]",
+                axiom_sw_raw_discarded(nic));
+        return -1;
+    }
+
+    ret = axiom_next_hop(dev, SWNIC_TEST_NODE_LOST, &if_id);
+    if (!AXIOM_RET_IS_OK(ret) || if_id != SWNIC_TEST_IF_NONE) {
+        EPRINTF("wrong next hop - ret: %d if: %u", ret, if_id);
+        return -1;
+    }
+
+    /* nothing must reach the other node */
+    axiom_set_flags(dst, AXIOM_FLAG_NOBLOCK_RAW);
+    size = sizeof(buf);
+    ret = axiom_recv_raw(dst, &node, &port, &type, &size, buf);
+    axiom_unset_flags(dst, AXIOM_FLAG_NOBLOCK_RAW);
+    if (ret != AXIOM_RET_NOTAVAIL) {
+        EPRINTF("unexpected RAW message - ret: %d", ret);
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    axiom_dev_t *nic_a = NULL, *nic_b = NULL, *dev_a = NULL, *dev_b = NULL;
+    int long_index = 0, opt = 0, msgs = 16, long_msgs, ret = 1;
+
+    static struct option long_options[] = {
+        {"messages", required_argument, 0, 'm'},
+        {"verbose", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "m:vh",
+                    long_options, &long_index)) != -1) {
+        switch (opt) {
+            case 'm':
+                msgs = atoi(optarg);
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'h':
+            default:
+                usage();
+                exit(-1);
+        }
+    }
+
+    if (msgs <= 0 || msgs > AXIOM_SW_RAW_FIFO_LEN) {
+        EPRINTF("messages must be in [1, %d]", AXIOM_SW_RAW_FIFO_LEN);
+        usage();
+        exit(-1);
+    }
+
+    /* the LONG messages are received after the last one is sent */
+    long_msgs = msgs < AXIOMREG_LEN_LONG_BUF ? msgs : AXIOMREG_LEN_LONG_BUF;
+
+    nic_a = axiom_sw_dev_alloc();
+    nic_b = axiom_sw_dev_alloc();
+    if (!nic_a || !nic_b) {
+        EPRINTF("axiom_sw_dev_alloc failed");
+        goto out;
+    }
+
+    if (!AXIOM_RET_IS_OK(axiom_sw_connect(nic_a, SWNIC_TEST_IF_LINK, nic_b,
+                    SWNIC_TEST_IF_LINK)))
+        goto out;
+
+    dev_a = swnic_test_open(nic_a, SWNIC_TEST_NODE_A);
+    dev_b = swnic_test_open(nic_b, SWNIC_TEST_NODE_B);
+    if (!dev_a || !dev_b)
+        goto out;
+
+    if (!AXIOM_RET_IS_OK(axiom_set_routing(dev_a, SWNIC_TEST_NODE_B,
+                    1 << SWNIC_TEST_IF_LINK)) ||
+            !AXIOM_RET_IS_OK(axiom_set_routing(dev_b, SWNIC_TEST_NODE_A,
+                    1 << SWNIC_TEST_IF_LINK))) {
+        EPRINTF("axiom_set_routing failed");
+        goto out;
+    }
+
+    if (swnic_test_raw(dev_a, SWNIC_TEST_NODE_A, dev_b, SWNIC_TEST_NODE_B,
+                msgs) ||
+            swnic_test_raw(dev_b, SWNIC_TEST_NODE_B, dev_a, SWNIC_TEST_NODE_A,
+                msgs) ||
+            swnic_test_long(dev_a, SWNIC_TEST_NODE_A, dev_b, SWNIC_TEST_NODE_B,
+                long_msgs) ||
+            swnic_test_long(dev_b, SWNIC_TEST_NODE_B, dev_a, SWNIC_TEST_NODE_A,
+                long_msgs) ||
+            swnic_test_rdma(dev_a, SWNIC_TEST_NODE_B) ||
+            swnic_test_routing(nic_a, dev_a, dev_b))
+        goto out;
+
+    ret = 0;
+
+out:
+    printf("axiom swnic test: %s\n", ret ? "FAILED" : "PASSED");
+
+    if (dev_b)
+        axiom_close(dev_b);
+    if (dev_a)
+        axiom_close(dev_a);
+    if (nic_b)
+        axiom_sw_dev_free(nic_b);
+    if (nic_a)
+        axiom_sw_dev_free(nic_a);
+
+    return ret;
+}
@@ -0,0 +1,140 @@
+/*!
+ * \file axiom_trace2json.c
+ *
+ * \version     v1.2
+ * \date        2016-11-14
+ *
+ * This file contains the tool to convert the binary trace file produced by the
+ * tracing backend of the Axiom NIC API into the Chrome trace JSON format
+ * (chrome://tracing)
+ *
+ * Copyright (C) 2016, Evidence Srl
+ * Terms of use are as specified in COPYING
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "dprintf.h"
+#include "axiom_nic_trace.h"
+
+static void
+usage(void)
+{
+    printf("usage: axiom_trace2json TRACE_FILE [JSON_FILE]\n");
+    printf("Convert an AXIOM NIC API trace file into the Chrome trace JSON "
+            "format\n\n");
+    printf("TRACE_FILE              binary trace file (axiom_trace.<pid>.bin)\n");
+    printf("JSON_FILE               output file (default: stdout)\n");
+}
+
+static const char *
+op_name(uint16_t op)
+{
+    if (op == AXIOM_TRACE_OP_END || op >= AXIOM_TRACE_OP_LAST)
+        return "unknown";
+
+    return axiom_trace_op_desc[op - 1];
+}
+
+static int
+convert_thread(FILE *in, FILE *out, uint32_t pid, int *first_event)
+{
+    axiom_trace_thread_hdr_t thread_hdr;
+    axiom_trace_event_t event;
+    uint32_t i;
+
+    if (fread(&thread_hdr, sizeof(thread_hdr), 1, in) != 1) {
+        EPRINTF("trace file truncated");
+        return -1;
+    }
+
+    if (thread_hdr.lost) {
+        fprintf(stderr, "thread %" PRIu32 ": %" PRIu64 " events lost "
+                "(increase " AXIOM_ENV_TRACE_EVENTS ")\n",
+                thread_hdr.tid, thread_hdr.lost);
+    }
+
+    for (i = 0; i < thread_hdr.events; i++) {
+        if (fread(&event, sizeof(event), 1, in) != 1) {
+            EPRINTF("trace file truncated");
+            return -1;
+        }
+
+        /* timestamps are in microseconds */
+        fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"axiom\",\"ph\":\"X\","
+                "\"ts\":%" PRIu64 ".%03" PRIu64 ",\"dur\":%" PRIu32 ".%03"
+                PRIu32 ",\"pid\":%" PRIu32 ",\"tid\":%" PRIu32 ","
+                "\"args\":{\"node\":%" PRIu16 ",\"size\":%" PRIu32 ","
+                "\"ret\":%" PRId32 "}}",
+                *first_event ? "" : ",", op_name(event.op),
+                event.start / 1000, event.start % 1000,
+                event.duration / 1000, event.duration % 1000,
+                pid, thread_hdr.tid, event.node, event.size, event.ret);
+
+        *first_event = 0;
+    }
+
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    axiom_trace_file_hdr_t file_hdr;
+    FILE *in, *out = stdout;
+    int first_event = 1, ret = -1;
+    uint32_t i;
+
+    if (argc < 2 || argc > 3) {
+        usage();
+        return -1;
+    }
+
+    in = fopen(argv[1], "r");
+    if (!in) {
+        EPRINTF("impossible to open %s - errno: %d", argv[1], errno);
+        return -1;
+    }
+
+    if (argc == 3) {
+        out = fopen(argv[2], "w");
+        if (!out) {
+            EPRINTF("impossible to open %s - errno: %d", argv[2], errno);
+            goto close_in;
+        }
+    }
+
+    if (fread(&file_hdr, sizeof(file_hdr), 1, in) != 1 ||
+            file_hdr.magic != AXIOM_TRACE_MAGIC) {
+        EPRINTF("%s is not an axiom trace file", argv[1]);
+        goto close_out;
+    }
+
+    if (file_hdr.version != AXIOM_TRACE_VERSION ||
+            file_hdr.event_size != sizeof(axiom_trace_event_t)) {
+        EPRINTF("trace file version %d not supported", file_hdr.version);
+        goto close_out;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    for (i = 0; i < file_hdr.threads; i++) {
+        if (convert_thread(in, out, file_hdr.pid, &first_event))
+            break;
+    }
+
+    fprintf(out, "\n]}\n");
+
+    ret = (i == file_hdr.threads) ? 0 : -1;
+
+close_out:
+    if (out != stdout)
+        fclose(out);
+close_in:
+    fclose(in);
+
+    return ret;
+}
@@ -29,66 +29,16 @@
 #include "axiom_netdev_user.h"
 #include "axiom_utility.h"
 
+#include "axiom_nic_trace.h"
+
 #ifdef AXIOM_EXTRAE_SUPPORT
 #include <extrae_types.h>
 #include <extrae_user_events.h>
 static extrae_type_t axiom_extrae_apinic = 9990000;
 static int axiom_extrae_apinic_init = 0;
 
-typedef enum {
-    AX_EXTRAE_APINIC_END,
-    AX_EXTRAE_APINIC_OPEN,
-    AX_EXTRAE_APINIC_CLOSE,
-    AX_EXTRAE_APINIC_SEND,
-    AX_EXTRAE_APINIC_SEND_IOV,
-    AX_EXTRAE_APINIC_RECV,
-    AX_EXTRAE_APINIC_RECV_IOV,
-    AX_EXTRAE_APINIC_SEND_RAW,
-    AX_EXTRAE_APINIC_SEND_IOV_RAW,
-    AX_EXTRAE_APINIC_RECV_RAW,
-    AX_EXTRAE_APINIC_RECV_IOV_RAW,
-    AX_EXTRAE_APINIC_SEND_RAW_AVAIL,
-    AX_EXTRAE_APINIC_RECV_RAW_AVAIL,
-    AX_EXTRAE_APINIC_SEND_LONG,
-    AX_EXTRAE_APINIC_SEND_IOV_LONG,
-    AX_EXTRAE_APINIC_RECV_LONG,
-    AX_EXTRAE_APINIC_RECV_IOV_LONG,
-    AX_EXTRAE_APINIC_SEND_LONG_AVAIL,
-    AX_EXTRAE_APINIC_RECV_LONG_AVAIL,
-    AX_EXTRAE_APINIC_RDMA_READ,
-    AX_EXTRAE_APINIC_RDMA_WRITE,
-    AX_EXTRAE_APINIC_RDMA_CHECK,
-    AX_EXTRAE_APINIC_RDMA_WAIT,
-    AX_EXTRAE_APINIC_LAST
-} axiom_extrae_apinic_t;
-
-char* axiom_extrae_apinic_desc[] = {
-    "axiom_open()",
-    "axiom_close()",
-    "axiom_send()",
-    "axiom_send_iov()",
-    "axiom_recv()",
-    "axiom_recv_iov()",
-    "axiom_send_raw()",
-    "axiom_send_iov_raw()",
-    "axiom_recv_raw()",
-    "axiom_recv_iov_raw()",
-    "axiom_send_raw_avail()",
-    "axiom_recv_raw_avail()",
-    "axiom_send_long()",
-    "axiom_send_iov_long()",
-    "axiom_recv_long()",
-    "axiom_recv_iov_long()",
-    "axiom_send_long_avail()",
-    "axiom_recv_long_avail()",
-    "axiom_rdma_read()",
-    "axiom_rdma_write()",
-    "axiom_rdma_check()",
-    "axiom_rdma_wait()",
-};
-
-void axiom_extrae_init(extrae_type_t *type, char *name, char **val_desc,
-        unsigned val_num, int *initialized) {
+void axiom_extrae_init(extrae_type_t *type, char *name,
+        const char * const *val_desc, unsigned val_num, int *initialized) {
     if (!(*initialized) && Extrae_is_initialized()) {
         extrae_value_t *values = malloc(sizeof(*values) *val_num);
         int i;
@@ -96,7 +46,8 @@ void axiom_extrae_init(extrae_type_t *type, char *name, char **val_desc,
         for (i = 0; i < val_num; i++)
             values[i] = i + 1;
 
-        Extrae_define_event_type(type, name, &val_num, values, val_desc);
+        Extrae_define_event_type(type, name, &val_num, values,
+                (char **)val_desc);
 
         IPRINTF(1, "%s - extrae initialized", name);
 
@@ -108,7 +59,7 @@ void axiom_extrae_init(extrae_type_t *type, char *name, char **val_desc,
 #define AXIOM_EXTRAE(f)                                                 \
     do {                                                                \
         axiom_extrae_init(&axiom_extrae_apinic, "AXIOM NIC API",        \
-                axiom_extrae_apinic_desc, AX_EXTRAE_APINIC_LAST - 1,    \
+                axiom_trace_op_desc, AXIOM_TRACE_OP_LAST - 1,           \
                 &axiom_extrae_apinic_init);                             \
         f;                                                              \
     } while(0);
@@ -116,16 +67,182 @@ void axiom_extrae_init(extrae_type_t *type, char *name, char **val_desc,
 #define AXIOM_EXTRAE(f)
 #endif
 
+#ifdef AXIOM_TRACE_SUPPORT
+#include <pthread.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+/*!
+ * \brief Per-thread ring buffer of trace events.
+ *
+ * Only the owner thread writes the events and advances 'head' (with release
+ * semantic), so the recording path is lock-free. The buffers are never freed,
+ * in order to dump also the events of the terminated threads.
+ */
+typedef struct axiom_trace_buf {
+    struct axiom_trace_buf *next;       /*!< \brief next buffer in the list */
+    uint64_t head;                      /*!< \brief number of events recorded */
+    uint32_t mask;                      /*!< \brief ring size - 1 */
+    uint32_t tid;                       /*!< \brief owner thread id */
+    axiom_trace_event_t events[];       /*!< \brief events ring */
+} axiom_trace_buf_t;
+
+/*! \brief list of all per-thread buffers */
+static axiom_trace_buf_t *axiom_trace_bufs = NULL;
+/*! \brief buffer of the current thread */
+static __thread axiom_trace_buf_t *axiom_trace_local = NULL;
+/*! \brief number of events in each ring (power of 2) */
+static uint32_t axiom_trace_events;
+static pthread_once_t axiom_trace_once = PTHREAD_ONCE_INIT;
+
+static void
+axiom_trace_atexit(void)
+{
+    axiom_trace_dump(NULL);
+}
+
+static void
+axiom_trace_init(void)
+{
+    unsigned long events = AXIOM_TRACE_EVENTS_DEFAULT;
+    char *events_s;
+
+    events_s = getenv(AXIOM_ENV_TRACE_EVENTS);
+    if (events_s) {
+        events = strtoul(events_s, NULL, 10);
+    }
+
+    axiom_trace_events = 1;
+    while (axiom_trace_events < events && axiom_trace_events < (1U << 30))
+        axiom_trace_events <<= 1;
+
+    atexit(axiom_trace_atexit);
+}
+
+static axiom_trace_buf_t *
+axiom_trace_buf_alloc(void)
+{
+    axiom_trace_buf_t *buf;
+
+    pthread_once(&axiom_trace_once, axiom_trace_init);
+
+    buf = calloc(1, sizeof(*buf) +
+            sizeof(buf->events[0]) * axiom_trace_events);
+    if (!buf) {
+        EPRINTF("failed to allocate trace buffer");
+        return NULL;
+    }
+
+    buf->mask = axiom_trace_events - 1;
+    buf->tid = syscall(SYS_gettid);
+
+    /* lock-free insertion in the global list */
+    buf->next = __atomic_load_n(&axiom_trace_bufs, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&axiom_trace_bufs, &buf->next, buf,
+                1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    return buf;
+}
+
+inline static uint64_t
+axiom_trace_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return timespec2nsec(ts);
+}
+
+inline static void
+axiom_trace_record(axiom_trace_op_t op, uint64_t start, int node, size_t size,
+        int ret)
+{
+    axiom_trace_buf_t *buf = axiom_trace_local;
+    axiom_trace_event_t *event;
+    uint64_t head, duration;
+
+    if (unlikely(!buf)) {
+        buf = axiom_trace_local = axiom_trace_buf_alloc();
+        if (!buf)
+            return;
+    }
+
+    head = buf->head;
+    event = &buf->events[head & buf->mask];
+
+    /* the calls longer than ~4.29 s are saturated */
+    duration = axiom_trace_now() - start;
+    if (unlikely(duration > UINT32_MAX))
+        duration = UINT32_MAX;
+
+    event->start = start;
+    event->duration = (uint32_t)duration;
+    event->op = op;
+    event->node = node;
+    event->size = size;
+    event->ret = ret;
+
+    __atomic_store_n(&buf->head, head + 1, __ATOMIC_RELEASE);
+}
+
+#define AXIOM_TRACE_BEGIN()                                             \
+    uint64_t axiom_trace_start = axiom_trace_now()
+#define AXIOM_TRACE_END(op, node, size, ret)                            \
+    axiom_trace_record(op, axiom_trace_start, node, size, ret)
+#else
+#define AXIOM_TRACE_BEGIN()
+#define AXIOM_TRACE_END(op, node, size, ret)
+#endif
+
+/*! \brief Instrument the beginning of the API function 'op' */
+#define AXIOM_INSTR_BEGIN(op)                                           \
+    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, op))                 \
+    AXIOM_TRACE_BEGIN()
+/*! \brief Instrument the end of the API function 'op' */
+#define AXIOM_INSTR_END(op, node, size, ret)                            \
+    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AXIOM_TRACE_OP_END)) \
+    AXIOM_TRACE_END(op, node, size, ret)
+
 /*! \brief Axiom char dev default name */
 #define AXIOM_DEV_NAME          "/dev/axiom"
 #define AXIOM_DEV_RAW_NAME      "/dev/axiom-raw"
 #define AXIOM_DEV_LONG_NAME     "/dev/axiom-long"
 #define AXIOM_DEV_RDMA_NAME     "/dev/axiom-rdma"
 
-#define AXIOM_NUM_RECV_FDS      2
+#ifdef AXIOM_SWNIC_SUPPORT
+/* the AXIOM devices are emulated by the shim on the software NIC */
+#include "axiom_swnic_shim.h"
+#define open(...)       axiom_swnic_open(__VA_ARGS__)
+#define close(...)      axiom_swnic_close(__VA_ARGS__)
+#define ioctl(...)      axiom_swnic_ioctl(__VA_ARGS__, NULL)
+#define mmap(...)       axiom_swnic_mmap(__VA_ARGS__)
+#define munmap(...)     axiom_swnic_munmap(__VA_ARGS__)
+#endif /* AXIOM_SWNIC_SUPPORT */
 
 #define AXIOM_RDMA_DEBUG
 
+/*! \brief Size of the address chunks used as keys of the MR hash table */
+#define AXIOM_MR_CHUNK_ORDER    21
+/*! \brief Number of buckets of the MR hash table */
+#define AXIOM_MR_HASH_SIZE      64
+
+/*! \brief Memory region registered in the driver */
+struct axiom_mr {
+    uintptr_t start;            /*!< \brief first address of the region */
+    uintptr_t end;              /*!< \brief first address after the region */
+    uint32_t id;                /*!< \brief id of the region in the driver */
+    int refs;                   /*!< \brief axiom_mr_register() calls */
+    struct axiom_mr *next;      /*!< \brief next region registered */
+};
+
+/*! \brief Entry of the MR hash table (a region is linked in the buckets of
+ *         all the chunks that it covers) */
+typedef struct axiom_mr_link {
+    axiom_mr_t *mr;             /*!< \brief memory region */
+    struct axiom_mr_link *next; /*!< \brief next entry of the bucket */
+} axiom_mr_link_t;
+
 /*!
  * \brief axiom arguments for the axiom_open() function
  */
@@ -134,13 +251,115 @@ typedef struct axiom_dev {
     int fd_raw;          /*!< \brief fd of the AXIOM raw char dev */
     int fd_long;         /*!< \brief fd of the AXIOM long char dev */
     int fd_rdma;         /*!< \brief fd of the AXIOM rdma char dev */
-    struct pollfd recv_fds[AXIOM_NUM_RECV_FDS];
     axiom_flags_t flags; /*!< \brief axiom flags */
     void *rdma_addr;     /*!< \brief rdma zone pointer */
     uint64_t rdma_size;  /*!< \brief rdma zone size */
     int appid;           /*!< \brief application ID to use in the RDMA */
+    int event_attached;  /*!< \brief fds attached to the event fd */
+    axiom_ring_hdr_t *ring_hdr;  /*!< \brief ring indexes (NULL if the ring
+                                              is not created) */
+    axiom_ring_sqe_t *ring_sqes; /*!< \brief submission ring */
+    axiom_ring_cqe_t *ring_cqes; /*!< \brief completion ring */
+    uint32_t ring_sq_entries;    /*!< \brief submission ring entries */
+    uint32_t ring_cq_entries;    /*!< \brief completion ring entries */
+    size_t ring_size;            /*!< \brief size of the ring mapping */
+    uint32_t ring_sq_reserved;   /*!< \brief next SQE reserved by a channel
+                                              (published in sq_tail) */
+    uint32_t *ring_sq_ready;     /*!< \brief index + 1 of the SQE written in
+                                              each slot, not yet published */
+    axiom_mr_t *mr_list;         /*!< \brief memory regions registered */
+    axiom_mr_link_t *mr_hash[AXIOM_MR_HASH_SIZE]; /*!< \brief memory regions
+                                                          by address range */
+    struct axiom_dev *owner;     /*!< \brief device that owns the fds, the RDMA
+                                              zone and the ring (itself if
+                                              it is not a channel) */
+    axiom_subport_t subport;     /*!< \brief sub-port bound (AXIOM_SUBPORT_ANY
+                                              if not bound) */
+    axiom_ioctl_routing_table_t routing; /*!< \brief cached routing table */
+    int routing_cached;          /*!< \brief routing table loaded */
+    axiom_info_page_t *info;     /*!< \brief information page of the driver
+                                              (NULL if not mapped) */
 } axiom_dev_t;
 
+/*
+ * A memory region is linked in the buckets of all the address chunks that it
+ * covers, so the region that contains an address is found in one bucket.
+ */
+inline static int
+axiom_mr_bucket(uintptr_t chunk)
+{
+    return chunk % AXIOM_MR_HASH_SIZE;
+}
+
+/* number of buckets where a region is linked, starting from its first chunk */
+inline static uintptr_t
+axiom_mr_nbuckets(axiom_mr_t *mr)
+{
+    uintptr_t chunks = ((mr->end - 1) >> AXIOM_MR_CHUNK_ORDER) -
+        (mr->start >> AXIOM_MR_CHUNK_ORDER) + 1;
+
+    return (chunks < AXIOM_MR_HASH_SIZE) ? chunks : AXIOM_MR_HASH_SIZE;
+}
+
+static void
+axiom_mr_unlink(axiom_dev_t *dev, axiom_mr_t *mr)
+{
+    uintptr_t chunk = mr->start >> AXIOM_MR_CHUNK_ORDER, i;
+
+    for (i = 0; i < axiom_mr_nbuckets(mr); i++) {
+        axiom_mr_link_t **pnext = &dev->mr_hash[axiom_mr_bucket(chunk + i)];
+
+        while (*pnext) {
+            axiom_mr_link_t *link = *pnext;
+
+            if (link->mr == mr) {
+                *pnext = link->next;
+                free(link);
+                break;
+            }
+            pnext = &link->next;
+        }
+    }
+}
+
+static axiom_err_t
+axiom_mr_link(axiom_dev_t *dev, axiom_mr_t *mr)
+{
+    uintptr_t chunk = mr->start >> AXIOM_MR_CHUNK_ORDER, i;
+
+    for (i = 0; i < axiom_mr_nbuckets(mr); i++) {
+        axiom_mr_link_t *link = malloc(sizeof(*link));
+        int bucket = axiom_mr_bucket(chunk + i);
+
+        if (unlikely(link == NULL)) {
+            axiom_mr_unlink(dev, mr);
+            return AXIOM_RET_NOMEM;
+        }
+
+        link->mr = mr;
+        link->next = dev->mr_hash[bucket];
+        dev->mr_hash[bucket] = link;
+    }
+
+    return AXIOM_RET_OK;
+}
+
+/* returns the region that contains [addr, addr + size), or NULL */
+inline static axiom_mr_t *
+axiom_mr_lookup(axiom_dev_t *dev, uintptr_t addr, size_t size)
+{
+    axiom_mr_link_t *link;
+
+    link = dev->mr_hash[axiom_mr_bucket(addr >> AXIOM_MR_CHUNK_ORDER)];
+    for (; link; link = link->next) {
+        axiom_mr_t *mr = link->mr;
+
+        if (mr->start <= addr && addr < mr->end && size <= mr->end - addr)
+            return mr;
+    }
+
+    return NULL;
+}
 
 static int
 axiom_get_appid(void)
@@ -162,7 +381,7 @@ axiom_dev_t *
 axiom_open(axiom_args_t *args) {
     axiom_dev_t *dev;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_OPEN));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_OPEN);
 
     dev = calloc(1, sizeof(*dev));
     if (!dev) {
@@ -181,16 +400,12 @@ axiom_open(axiom_args_t *args) {
         EPRINTF("impossible to open %s", AXIOM_DEV_RAW_NAME);
         goto close_fd_gen;
     }
-    dev->recv_fds[0].fd = dev->fd_raw;
-    dev->recv_fds[0].events = POLLIN;
 
     dev->fd_long = open(AXIOM_DEV_LONG_NAME, O_RDWR);
     if (dev->fd_long < 0) {
         EPRINTF("impossible to open %s", AXIOM_DEV_LONG_NAME);
         goto close_fd_raw;
     }
-    dev->recv_fds[1].fd = dev->fd_long;
-    dev->recv_fds[1].events = POLLIN;
 
     dev->fd_rdma = open(AXIOM_DEV_RDMA_NAME, O_RDWR);
     if (dev->fd_rdma < 0) {
@@ -208,9 +423,19 @@ axiom_open(axiom_args_t *args) {
         }
     }
 
+    /* not fatal: without the page the routing cache is reloaded on misses */
+    dev->info = mmap(NULL, sizeof(*dev->info), PROT_READ, MAP_SHARED,
+            dev->fd_generic, AXIOM_INFO_MMAP_OFFSET);
+    if (dev->info == MAP_FAILED) {
+        DPRINTF("info page not mapped - errno: %s", strerror(errno));
+        dev->info = NULL;
+    }
+
     dev->appid = axiom_get_appid();
+    dev->owner = dev;
+    dev->subport = AXIOM_SUBPORT_ANY;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_OPEN, 0, 0, AXIOM_RET_OK);
     return dev;
 
 close_fd_rdma:
@@ -223,17 +448,43 @@ close_fd_gen:
     close(dev->fd_generic);
 free_dev:
     free(dev);
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_OPEN, 0, 0, AXIOM_RET_ERROR);
     return NULL;
 }
 
 void
 axiom_close(axiom_dev_t *dev)
 {
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_CLOSE));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_CLOSE);
+
+    if (!dev) {
+        AXIOM_INSTR_END(AXIOM_TRACE_OP_CLOSE, 0, 0, AXIOM_RET_ERROR);
+        return;
+    }
+
+    /* the driver releases the regions on close, but a channel shares the fd */
+    while (dev->mr_list) {
+        axiom_mr_t *mr = dev->mr_list;
+
+        if (dev->owner != dev)
+            ioctl(dev->fd_rdma, AXNET_MR_DEREG, &mr->id);
+        axiom_mr_unlink(dev, mr);
+        dev->mr_list = mr->next;
+        free(mr);
+    }
 
-    if (!dev)
+    if (dev->owner != dev) {
+        free(dev);
+        AXIOM_INSTR_END(AXIOM_TRACE_OP_CLOSE, 0, 0, AXIOM_RET_OK);
         return;
+    }
+
+    if (dev->ring_hdr) {
+        munmap(dev->ring_hdr, dev->ring_size);
+        free(dev->ring_sq_ready);
+    }
+    if (dev->info)
+        munmap(dev->info, sizeof(*dev->info));
 
     close(dev->fd_rdma);
     close(dev->fd_long);
@@ -241,56 +492,44 @@ axiom_close(axiom_dev_t *dev)
     close(dev->fd_generic);
     free(dev);
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_CLOSE, 0, 0, AXIOM_RET_OK);
 }
 
-static axiom_err_t
-axiom_fcntl(int fd, int flag, int set)
+axiom_dev_t *
+axiom_channel_open(axiom_dev_t *dev, axiom_flags_t flags)
 {
-    int fd_flags;
+    axiom_dev_t *chan;
 
-    fd_flags = fcntl(fd, F_GETFL);
-    if (fd_flags == -1) {
-        EPRINTF("fcntl error - errno: %s", strerror(errno));
-        return AXIOM_RET_ERROR;
+    if (!dev || dev->fd_generic <= 0) {
+        EPRINTF("axiom device is not opened - dev: %p", dev);
+        return NULL;
     }
 
-    if (set)
-        fd_flags |= flag;
-    else
-        fd_flags &= ~flag;
-
-    if (fcntl(fd, F_SETFL, fd_flags) == -1) {
-        EPRINTF("fcntl error - errno: %s", strerror(errno));
-        return AXIOM_RET_ERROR;
+    chan = calloc(1, sizeof(*chan));
+    if (!chan) {
+        EPRINTF("failed to allocate memory");
+        return NULL;
     }
 
-    return AXIOM_RET_OK;
+    chan->fd_generic = dev->fd_generic;
+    chan->fd_raw = dev->fd_raw;
+    chan->fd_long = dev->fd_long;
+    chan->fd_rdma = dev->fd_rdma;
+    chan->flags = flags;
+    chan->appid = dev->appid;
+    chan->owner = dev->owner;
+
+    return chan;
 }
 
-static axiom_err_t
-axiom_update_flags(axiom_dev_t *dev, axiom_flags_t update_flags)
+/*
+ * The non-blocking flags are passed to the driver in each call, instead of
+ * setting O_NONBLOCK on the fds shared by all the channels.
+ */
+inline static uint32_t
+axiom_msg_flags(axiom_dev_t *dev, axiom_flags_t noblock)
 {
-    axiom_err_t ret = 0;
-
-    /* check if flags are set or not */
-
-    if (update_flags & AXIOM_FLAG_NOBLOCK_RAW) {
-        ret |= axiom_fcntl(dev->fd_raw, O_NONBLOCK,
-                dev->flags & AXIOM_FLAG_NOBLOCK_RAW);
-    }
-
-    if (update_flags & AXIOM_FLAG_NOBLOCK_LONG) {
-        ret |= axiom_fcntl(dev->fd_long, O_NONBLOCK,
-                dev->flags & AXIOM_FLAG_NOBLOCK_LONG);
-    }
-
-    if (update_flags & AXIOM_FLAG_NOBLOCK_RDMA) {
-        ret |= axiom_fcntl(dev->fd_rdma, O_NONBLOCK,
-                dev->flags & AXIOM_FLAG_NOBLOCK_RDMA);
-    }
-
-    return AXIOM_RET_OK;
+    return (dev->flags & noblock) ? AXIOCTL_MSG_FLAGS_NONBLOCK : 0;
 }
 
 axiom_err_t
@@ -303,7 +542,7 @@ axiom_set_flags(axiom_dev_t *dev, axiom_flags_t flags)
 
     dev->flags |= flags;
 
-    return axiom_update_flags(dev, flags);
+    return AXIOM_RET_OK;
 }
 
 axiom_err_t
@@ -316,7 +555,7 @@ axiom_unset_flags(axiom_dev_t *dev, axiom_flags_t flags)
 
     dev->flags &= ~flags;
 
-    return axiom_update_flags(dev, flags);
+    return AXIOM_RET_OK;
 }
 
 axiom_err_t
@@ -340,6 +579,103 @@ axiom_get_fds(axiom_dev_t *dev, int *raw_fd, int *long_fd, int *rdma_fd)
     return AXIOM_RET_OK;
 }
 
+axiom_err_t
+axiom_set_busy_poll(axiom_dev_t *dev, int usec)
+{
+    int ret;
+
+    if (!dev || dev->fd_generic <= 0) {
+        EPRINTF("axiom device is not opened - dev: %p", dev);
+        return AXIOM_RET_ERROR;
+    }
+
+    ret = ioctl(dev->fd_raw, AXNET_SET_BUSY_POLL, &usec);
+    if (ret < 0) {
+        EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
+        return AXIOM_RET_ERROR;
+    }
+
+    ret = ioctl(dev->fd_long, AXNET_SET_BUSY_POLL, &usec);
+    if (ret < 0) {
+        EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
+        return AXIOM_RET_ERROR;
+    }
+
+    /* used by axiom_recv_any() */
+    ret = ioctl(dev->fd_generic, AXNET_SET_BUSY_POLL, &usec);
+    if (ret < 0) {
+        EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
+        return AXIOM_RET_ERROR;
+    }
+
+    return AXIOM_RET_OK;
+}
+
+/* attach the RAW, LONG and RDMA fds to the generic fd (event fd) */
+static axiom_err_t
+axiom_event_attach(axiom_dev_t *dev)
+{
+    int fds[3], ret, i;
+
+    if (likely(dev->event_attached))
+        return AXIOM_RET_OK;
+
+    fds[0] = dev->fd_raw;
+    fds[1] = dev->fd_long;
+    fds[2] = dev->fd_rdma;
+
+    for (i = 0; i < 3; i++) {
+        ret = ioctl(dev->fd_generic, AXNET_EVENT_ATTACH, &fds[i]);
+        if (ret < 0 && errno != EBUSY) {
+            EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
+            return AXIOM_RET_ERROR;
+        }
+    }
+
+    dev->event_attached = 1;
+
+    return AXIOM_RET_OK;
+}
+
+axiom_err_t
+axiom_get_event_fd(axiom_dev_t *dev, int *event_fd)
+{
+    axiom_err_t ret;
+
+    if (!dev || dev->fd_generic <= 0) {
+        EPRINTF("axiom device is not opened - dev: %p", dev);
+        return AXIOM_RET_ERROR;
+    }
+
+    ret = axiom_event_attach(dev);
+    if (!AXIOM_RET_IS_OK(ret))
+        return ret;
+
+    *event_fd = dev->fd_generic;
+
+    return AXIOM_RET_OK;
+}
+
+int
+axiom_get_events(axiom_dev_t *dev)
+{
+    uint32_t events;
+    int ret;
+
+    if (!dev || dev->fd_generic <= 0) {
+        EPRINTF("axiom device is not opened - dev: %p", dev);
+        return AXIOM_RET_ERROR;
+    }
+
+    ret = ioctl(dev->fd_generic, AXNET_EVENT_GET, &events);
+    if (ret < 0) {
+        EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
+        return AXIOM_RET_ERROR;
+    }
+
+    return events;
+}
+
 axiom_err_t
 axiom_bind(axiom_dev_t *dev, axiom_port_t port)
 {
@@ -351,8 +687,20 @@ axiom_bind(axiom_dev_t *dev, axiom_port_t port)
         return AXIOM_RET_ERROR;
     }
 
+    if (port == AXIOM_PORT_SUB) {
+        EPRINTF("port %d is reserved to the sub-ports - use axiom_bind_ex",
+                port);
+        return AXIOM_RET_ERROR;
+    }
+
     ioctl_bind.port = port;
+    ioctl_bind.subport = AXIOM_SUBPORT_ANY;
     ioctl_bind.flush = (dev->flags & AXIOM_FLAG_NOFLUSH) ? 0 : 1;
+    ioctl_bind.flags = 0;
+    if (dev->flags & AXIOM_FLAG_REUSEPORT)
+        ioctl_bind.flags |= AXIOCTL_BIND_FLAGS_REUSEPORT;
+    if (dev->flags & AXIOM_FLAG_REUSEPORT_HASH)
+        ioctl_bind.flags |= AXIOCTL_BIND_FLAGS_HASH_SRC;
 
     if (dev->fd_raw >= 0) {
         ret = ioctl(dev->fd_raw, AXNET_BIND, &ioctl_bind);
@@ -373,6 +721,80 @@ axiom_bind(axiom_dev_t *dev, axiom_port_t port)
     return ioctl_bind.port;
 }
 
+axiom_err_t
+axiom_bind_ex(axiom_dev_t *dev, axiom_subport_t subport)
+{
+    axiom_ioctl_bind_t ioctl_bind;
+    int ret;
+
+    if (!dev || dev->fd_generic <= 0) {
+        EPRINTF("axiom device is not opened - dev: %p", dev);
+        return AXIOM_RET_ERROR;
+    }
+
+    ioctl_bind.port = AXIOM_PORT_SUB;
+    ioctl_bind.subport = subport;
+    ioctl_bind.flush = (dev->flags & AXIOM_FLAG_NOFLUSH) ? 0 : 1;
+    ioctl_bind.flags = 0;
+
+    /* the LONG fd binds the sub-port assigned to the RAW fd */
+    if (dev->fd_raw >= 0) {
+        ret = ioctl(dev->fd_raw, AXNET_BIND, &ioctl_bind);
+        if (ret < 0) {
+            EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
+            return AXIOM_RET_ERROR;
+        }
+    }
+
+    if (dev->fd_long >= 0) {
+        ret = ioctl(dev->fd_long, AXNET_BIND, &ioctl_bind);
+        if (ret < 0) {
+            EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
+            /* the previous binds are lost: don't leave the RAW half bound */
+            if (dev->fd_raw >= 0)
+                ioctl(dev->fd_raw, AXNET_UNBIND);
+            dev->owner->subport = AXIOM_SUBPORT_ANY;
+            return AXIOM_RET_ERROR;
+        }
+    }
+
+    /* the bind is shared by all the channels of the device */
+    dev->owner->subport = ioctl_bind.subport;
+
+    return ioctl_bind.subport;
+}
+
+/* load the routing table in the cache of the device with one ioctl */
+static axiom_err_t
+axiom_routing_load(axiom_dev_t *dev)
+{
+    int ret;
+
+    ret = ioctl(dev->fd_generic, AXNET_GET_ROUTING_TABLE, &dev->routing);
+    if (ret < 0) {
+        EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
+        dev->routing_cached = 0;
+        return AXIOM_RET_ERROR;
+    }
+
+    dev->routing_cached = 1;
+
+    return AXIOM_RET_OK;
+}
+
+/* check if the driver changed the routing table after the load */
+inline static int
+axiom_routing_stale(axiom_dev_t *dev)
+{
+    axiom_info_page_t *info = dev->owner->info;
+
+    if (!dev->routing_cached)
+        return 1;
+
+    return info && __atomic_load_n(&info->routing_gen, __ATOMIC_RELAXED) !=
+        dev->routing.generation;
+}
+
 axiom_err_t
 axiom_next_hop(axiom_dev_t *dev, axiom_node_id_t dst_id,
                axiom_if_id_t *if_number) {
@@ -385,9 +807,18 @@ axiom_next_hop(axiom_dev_t *dev, axiom_node_id_t dst_id,
         return AXIOM_RET_ERROR;
     }
 
-    ret = axiom_get_routing(dev, dst_id, &enabled_mask);
-    if (!AXIOM_RET_IS_OK(ret))
-        return ret;
+    /*
+     * Reload when the generation in the information page changes. Without
+     * the page, a node not reachable in the cache may be added after the
+     * load, so a miss reloads too.
+     */
+    if (axiom_routing_stale(dev) || (!dev->owner->info &&
+                dev->routing.enabled_mask[dst_id] == 0)) {
+        ret = axiom_routing_load(dev);
+        if (!AXIOM_RET_IS_OK(ret))
+            return ret;
+    }
+    enabled_mask = dev->routing.enabled_mask[dst_id];
 
     for (i = 0; i < AXIOM_INTERFACES_NUM; i++) {
         if (enabled_mask & (uint8_t)(1 << i)) {
@@ -403,7 +834,7 @@ axiom_send(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
         size_t payload_size, void *payload)
 {
     axiom_err_t ret;
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_SEND));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_SEND);
 
     if (payload_size <= AXIOM_RAW_PAYLOAD_MAX_SIZE) {
         ret = axiom_send_raw(dev, dst_id, port, AXIOM_TYPE_RAW_DATA,
@@ -413,7 +844,7 @@ axiom_send(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
                 (axiom_long_payload_size_t)(payload_size), payload);
     }
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_SEND, dst_id, payload_size, ret);
 
     return ret;
 }
@@ -424,7 +855,7 @@ axiom_send_iov(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
 {
     axiom_err_t ret;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_SEND_IOV));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_SEND_IOV);
 
     if (payload_size <= AXIOM_RAW_PAYLOAD_MAX_SIZE) {
         ret = axiom_send_iov_raw(dev, dst_id, port, AXIOM_TYPE_RAW_DATA,
@@ -434,69 +865,126 @@ axiom_send_iov(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
                 (axiom_long_payload_size_t)(payload_size), iov, iovcnt);
     }
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_SEND_IOV, dst_id, payload_size, ret);
 
     return ret;
 }
 
 axiom_err_t
-axiom_recv(axiom_dev_t *dev, axiom_node_id_t *src_id, axiom_port_t *port,
-        axiom_type_t *type, size_t *payload_size, void *payload)
+axiom_send_ex(axiom_dev_t *dev, axiom_node_id_t dst_id,
+        axiom_subport_t dst_subport, size_t payload_size, void *payload)
 {
-    axiom_err_t ret;
-    int timeout = -1, fds_ready, i;
-
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_RECV));
+    axiom_subport_hdr_t tag;
+    struct iovec iov[2];
+    size_t size = sizeof(tag) + payload_size;
 
     if (unlikely(!dev)) {
-        EPRINTF("axiom device is not opened - dev: %p", dev);
-        ret = AXIOM_RET_ERROR;
-        goto end;
+        EPRINTF("axiom device is not opened");
+        return AXIOM_RET_ERROR;
     }
 
-    if (dev->flags & (AXIOM_FLAG_NOBLOCK_RAW | AXIOM_FLAG_NOBLOCK_LONG))
-        timeout = 0;
+    if (unlikely(payload_size > AXIOM_LONG_PAYLOAD_MAX_SIZE - sizeof(tag))) {
+        EPRINTF("payload size too big - size: %zu [%zu]", payload_size,
+                AXIOM_LONG_PAYLOAD_MAX_SIZE - sizeof(tag));
+        return AXIOM_RET_ERROR;
+    }
 
-    fds_ready = poll(dev->recv_fds, AXIOM_NUM_RECV_FDS, timeout);
+    tag.dst = dst_subport;
+    tag.src = dev->owner->subport;
 
-    if (fds_ready < 0) {
-        ret = AXIOM_RET_ERROR;
-        goto end;
+    iov[0].iov_base = &tag;
+    iov[0].iov_len = sizeof(tag);
+    iov[1].iov_base = payload;
+    iov[1].iov_len = payload_size;
+
+    if (size <= AXIOM_RAW_PAYLOAD_MAX_SIZE) {
+        return axiom_send_iov_raw(dev, dst_id, AXIOM_PORT_SUB,
+                AXIOM_TYPE_RAW_DATA, (axiom_raw_payload_size_t)(size), iov, 2);
     }
 
-    if (fds_ready == 0) {
-        ret = AXIOM_RET_NOTAVAIL;
-        goto end;
+    return axiom_send_iov_long(dev, dst_id, AXIOM_PORT_SUB,
+            (axiom_long_payload_size_t)(size), iov, 2);
+}
+
+inline static axiom_err_t
+axiom_recv_raw_finalize(axiom_raw_hdr_t *header, axiom_node_id_t *src_id,
+        axiom_port_t *port, axiom_type_t *type,
+        axiom_raw_payload_size_t *payload_size);
+inline static axiom_err_t
+axiom_recv_long_finalize(axiom_rdma_hdr_t *header, axiom_node_id_t *src_id,
+        axiom_port_t *port, axiom_long_payload_size_t *payload_size);
+
+/* receive a raw or a long message, whichever is available, with one ioctl */
+static axiom_err_t
+axiom_recv_any(axiom_dev_t *dev, axiom_node_id_t *src_id, axiom_port_t *port,
+        axiom_type_t *type, size_t *payload_size, struct iovec *iov, int iovcnt)
+{
+    axiom_ioctl_recv_iov_t recv_msg;
+    axiom_err_t ret;
+
+    if (unlikely(!dev || dev->fd_generic <= 0)) {
+        EPRINTF("axiom device is not opened - dev: %p", dev);
+        return AXIOM_RET_ERROR;
     }
 
-    for (i = 0; i < AXIOM_NUM_RECV_FDS; i++) {
-        ret = AXIOM_RET_ERROR;
-        if (dev->recv_fds[i].revents & POLLIN) {
-            if (dev->recv_fds[i].fd == dev->fd_raw) {
-                axiom_raw_payload_size_t raw_psize = AXIOM_RAW_PAYLOAD_MAX_SIZE;
-                if (*payload_size < AXIOM_RAW_PAYLOAD_MAX_SIZE) {
-                    raw_psize = (axiom_raw_payload_size_t)(*payload_size);
-                }
-                ret = axiom_recv_raw(dev, src_id, port, type, &raw_psize,
-                        payload);
-                *payload_size = raw_psize;
-                break;
-            } else if (dev->recv_fds[i].fd == dev->fd_long) {
-                axiom_long_payload_size_t long_psize =
-                    AXIOM_LONG_PAYLOAD_MAX_SIZE;
-                if (*payload_size < AXIOM_LONG_PAYLOAD_MAX_SIZE) {
-                    long_psize = (axiom_long_payload_size_t)(*payload_size);
-                }
-                ret = axiom_recv_long(dev, src_id, port, &long_psize, payload);
-                *type = AXIOM_TYPE_LONG_DATA;
-                *payload_size = long_psize;
-                break;
-            }
+    ret = axiom_event_attach(dev);
+    if (unlikely(!AXIOM_RET_IS_OK(ret)))
+        return ret;
+
+    recv_msg.payload_size = *payload_size;
+    recv_msg.flags = 0;
+    if (dev->flags & (AXIOM_FLAG_NOBLOCK_RAW | AXIOM_FLAG_NOBLOCK_LONG))
+        recv_msg.flags |= AXIOCTL_RECV_FLAGS_NONBLOCK;
+    recv_msg.iov = iov;
+    recv_msg.iovcnt = iovcnt;
+
+    ret = ioctl(dev->fd_generic, AXNET_RECV, &recv_msg);
+    if (unlikely(ret < 0)) {
+        if (errno == EAGAIN) {
+            ret = AXIOM_RET_NOTAVAIL;
+        } else if (errno == EINTR) {
+            ret = AXIOM_RET_INTR;
+        } else {
+            EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
+            ret = AXIOM_RET_ERROR;
         }
+        return ret;
     }
 
-end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    if (recv_msg.event == AXIOM_EVENT_RAW) {
+        axiom_raw_payload_size_t raw_psize;
+
+        ret = axiom_recv_raw_finalize(&recv_msg.header.raw, src_id, port, type,
+                &raw_psize);
+        *payload_size = raw_psize;
+    } else {
+        axiom_long_payload_size_t long_psize;
+
+        ret = axiom_recv_long_finalize(&recv_msg.header.rdma, src_id, port,
+                &long_psize);
+        *type = AXIOM_TYPE_LONG_DATA;
+        *payload_size = long_psize;
+    }
+
+    return ret;
+}
+
+axiom_err_t
+axiom_recv(axiom_dev_t *dev, axiom_node_id_t *src_id, axiom_port_t *port,
+        axiom_type_t *type, size_t *payload_size, void *payload)
+{
+    struct iovec iov;
+    axiom_err_t ret;
+
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_RECV);
+
+    iov.iov_base = payload;
+    iov.iov_len = *payload_size;
+
+    ret = axiom_recv_any(dev, src_id, port, type, payload_size, &iov, 1);
+
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_RECV,
+            AXIOM_RET_IS_OK(ret) ? *src_id : 0, *payload_size, ret);
     return ret;
 }
 
@@ -505,60 +993,46 @@ axiom_recv_iov(axiom_dev_t *dev, axiom_node_id_t *src_id, axiom_port_t *port,
         axiom_type_t *type, size_t *payload_size, struct iovec *iov, int iovcnt)
 {
     axiom_err_t ret;
-    int timeout = -1, fds_ready, i;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_RECV_IOV));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_RECV_IOV);
 
-    if (unlikely(!dev)) {
-        EPRINTF("axiom device is not opened - dev: %p", dev);
-        ret = AXIOM_RET_ERROR;
-        goto end;
-    }
+    ret = axiom_recv_any(dev, src_id, port, type, payload_size, iov, iovcnt);
 
-    if (dev->flags & (AXIOM_FLAG_NOBLOCK_RAW | AXIOM_FLAG_NOBLOCK_LONG))
-        timeout = 0;
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_RECV_IOV,
+            AXIOM_RET_IS_OK(ret) ? *src_id : 0, *payload_size, ret);
+    return ret;
+}
 
-    fds_ready = poll(dev->recv_fds, AXIOM_NUM_RECV_FDS, timeout);
+axiom_err_t
+axiom_recv_ex(axiom_dev_t *dev, axiom_node_id_t *src_id,
+        axiom_subport_t *src_subport, size_t *payload_size, void *payload)
+{
+    axiom_subport_hdr_t tag;
+    struct iovec iov[2];
+    axiom_port_t port;
+    axiom_type_t type;
+    size_t size = sizeof(tag) + *payload_size;
+    axiom_err_t ret;
 
-    if (fds_ready < 0) {
-        ret = AXIOM_RET_ERROR;
-        goto end;
-    }
+    iov[0].iov_base = &tag;
+    iov[0].iov_len = sizeof(tag);
+    iov[1].iov_base = payload;
+    iov[1].iov_len = *payload_size;
 
-    if (fds_ready == 0) {
-        ret = AXIOM_RET_NOTAVAIL;
-        goto end;
-    }
+    ret = axiom_recv_any(dev, src_id, &port, &type, &size, iov, 2);
+    if (unlikely(!AXIOM_RET_IS_OK(ret)))
+        return ret;
 
-    for (i = 0; i < AXIOM_NUM_RECV_FDS; i++) {
-        ret = AXIOM_RET_ERROR;
-        if (dev->recv_fds[i].revents & POLLIN) {
-            if (dev->recv_fds[i].fd == dev->fd_raw) {
-                axiom_raw_payload_size_t raw_psize = AXIOM_RAW_PAYLOAD_MAX_SIZE;
-                if (*payload_size < AXIOM_RAW_PAYLOAD_MAX_SIZE) {
-                    raw_psize = (axiom_raw_payload_size_t)(*payload_size);
-                }
-                ret = axiom_recv_iov_raw(dev, src_id, port, type, &raw_psize,
-                        iov, iovcnt);
-                *payload_size = raw_psize;
-                break;
-            } else if (dev->recv_fds[i].fd == dev->fd_long) {
-                axiom_long_payload_size_t long_psize =
-                    AXIOM_LONG_PAYLOAD_MAX_SIZE;
-                if (*payload_size < AXIOM_LONG_PAYLOAD_MAX_SIZE) {
-                    long_psize = (axiom_long_payload_size_t)(*payload_size);
-                }
-                ret = axiom_recv_iov_long(dev, src_id, port, &long_psize,
-                        iov, iovcnt);
-                *type = AXIOM_TYPE_LONG_DATA;
-                *payload_size = long_psize;
-                break;
-            }
-        }
+    /* the driver delivers on the sub-port queue only tagged messages */
+    if (unlikely(port != AXIOM_PORT_SUB || size < sizeof(tag))) {
+        EPRINTF("message without sub-port tag - port: %d size: %zu", port,
+                size);
+        return AXIOM_RET_ERROR;
     }
 
-end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    *src_subport = tag.src;
+    *payload_size = size - sizeof(tag);
+
     return ret;
 }
 
@@ -589,7 +1063,7 @@ axiom_send_raw(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
     axiom_ioctl_raw_t raw_msg;
     int ret;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_SEND_RAW));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_SEND_RAW);
 
     if (unlikely(!dev || dev->fd_raw <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -603,6 +1077,7 @@ axiom_send_raw(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
         goto end;
 
     raw_msg.payload = payload;
+    raw_msg.flags = axiom_msg_flags(dev, AXIOM_FLAG_NOBLOCK_RAW);
 
     ret = ioctl(dev->fd_raw, AXNET_SEND_RAW, &raw_msg);
     if (unlikely(ret < 0)) {
@@ -624,7 +1099,7 @@ axiom_send_raw(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
             raw_msg.header.tx.payload_size);
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_SEND_RAW, dst_id, payload_size, ret);
     return ret;
 }
 
@@ -636,8 +1111,7 @@ axiom_send_iov_raw(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
     axiom_ioctl_raw_iov_t raw_msg;
     int ret;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic,
-                AX_EXTRAE_APINIC_SEND_IOV_RAW));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_SEND_IOV_RAW);
 
     if (unlikely(!dev || dev->fd_raw <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -652,6 +1126,7 @@ axiom_send_iov_raw(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
 
     raw_msg.iov = iov;
     raw_msg.iovcnt = iovcnt;
+    raw_msg.flags = axiom_msg_flags(dev, AXIOM_FLAG_NOBLOCK_RAW);
 
     ret = ioctl(dev->fd_raw, AXNET_SEND_RAW_IOV, &raw_msg);
     if (unlikely(ret < 0)) {
@@ -673,7 +1148,7 @@ axiom_send_iov_raw(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
             raw_msg.header.tx.payload_size);
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_SEND_IOV_RAW, dst_id, payload_size, ret);
     return ret;
 }
 
@@ -703,7 +1178,7 @@ axiom_recv_raw(axiom_dev_t *dev, axiom_node_id_t *src_id,
     axiom_ioctl_raw_t raw_msg;
     int ret;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_RECV_RAW));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_RECV_RAW);
 
     if (unlikely(!dev || dev->fd_raw <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -720,6 +1195,7 @@ axiom_recv_raw(axiom_dev_t *dev, axiom_node_id_t *src_id,
 
     raw_msg.header.rx.payload_size = *payload_size;
     raw_msg.payload = payload;
+    raw_msg.flags = axiom_msg_flags(dev, AXIOM_FLAG_NOBLOCK_RAW);
 
     ret = ioctl(dev->fd_raw, AXNET_RECV_RAW, &raw_msg);
     if (unlikely(ret < 0)) {
@@ -740,7 +1216,8 @@ axiom_recv_raw(axiom_dev_t *dev, axiom_node_id_t *src_id,
             payload_size);
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_RECV_RAW,
+            AXIOM_RET_IS_OK(ret) ? *src_id : 0, *payload_size, ret);
     return ret;
 }
 
@@ -752,8 +1229,7 @@ axiom_recv_iov_raw(axiom_dev_t *dev, axiom_node_id_t *src_id,
     axiom_ioctl_raw_iov_t raw_msg;
     int ret;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic,
-                AX_EXTRAE_APINIC_RECV_IOV_RAW));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_RECV_IOV_RAW);
 
     if (unlikely(!dev || dev->fd_raw <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -772,6 +1248,7 @@ axiom_recv_iov_raw(axiom_dev_t *dev, axiom_node_id_t *src_id,
 
     raw_msg.iov = iov;
     raw_msg.iovcnt = iovcnt;
+    raw_msg.flags = axiom_msg_flags(dev, AXIOM_FLAG_NOBLOCK_RAW);
 
     ret = ioctl(dev->fd_raw, AXNET_RECV_RAW_IOV, &raw_msg);
     if (unlikely(ret < 0)) {
@@ -791,7 +1268,8 @@ axiom_recv_iov_raw(axiom_dev_t *dev, axiom_node_id_t *src_id,
     ret = axiom_recv_raw_finalize(&raw_msg.header, src_id, port, type,
             payload_size);
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_RECV_IOV_RAW,
+            AXIOM_RET_IS_OK(ret) ? *src_id : 0, *payload_size, ret);
     return ret;
 }
 
@@ -800,8 +1278,7 @@ axiom_send_raw_avail(axiom_dev_t *dev)
 {
     int ret, avail;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic,
-                AX_EXTRAE_APINIC_SEND_RAW_AVAIL));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_SEND_RAW_AVAIL);
 
     if (unlikely(!dev || dev->fd_raw <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -820,7 +1297,7 @@ axiom_send_raw_avail(axiom_dev_t *dev)
     ret = avail;
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_SEND_RAW_AVAIL, 0, 0, ret);
     return ret;
 }
 
@@ -829,8 +1306,7 @@ axiom_recv_raw_avail(axiom_dev_t *dev)
 {
     int ret, avail;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic,
-                AX_EXTRAE_APINIC_RECV_RAW_AVAIL));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_RECV_RAW_AVAIL);
 
     if (unlikely(!dev || dev->fd_raw <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -849,7 +1325,7 @@ axiom_recv_raw_avail(axiom_dev_t *dev)
     ret = avail;
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_RECV_RAW_AVAIL, 0, 0, ret);
     return ret;
 }
 
@@ -895,10 +1371,11 @@ axiom_err_t
 axiom_send_long(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
         axiom_long_payload_size_t payload_size, void *payload)
 {
-    axiom_long_msg_t long_msg;
+    axiom_ioctl_long_iov_t long_msg;
+    struct iovec iov;
     int ret;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_SEND_LONG));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_SEND_LONG);
 
     if (unlikely(!dev || dev->fd_long <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -911,9 +1388,14 @@ axiom_send_long(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
     if (unlikely(!AXIOM_RET_IS_OK(ret)))
         goto end;
 
-    long_msg.payload = payload;
+    /* the iovec ioctl carries the per-call flags */
+    iov.iov_base = payload;
+    iov.iov_len = payload_size;
+    long_msg.iov = &iov;
+    long_msg.iovcnt = 1;
+    long_msg.flags = axiom_msg_flags(dev, AXIOM_FLAG_NOBLOCK_LONG);
 
-    ret = ioctl(dev->fd_long, AXNET_SEND_LONG, &long_msg);
+    ret = ioctl(dev->fd_long, AXNET_SEND_LONG_IOV, &long_msg);
     if (unlikely(ret < 0)) {
         if (errno == EAGAIN) {
             ret = AXIOM_RET_NOTAVAIL;
@@ -932,7 +1414,7 @@ axiom_send_long(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
             long_msg.header.tx.payload_size);
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_SEND_LONG, dst_id, payload_size, ret);
     return ret;
 }
 
@@ -943,8 +1425,7 @@ axiom_send_iov_long(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
     axiom_ioctl_long_iov_t long_msg;
     int ret;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic,
-                AX_EXTRAE_APINIC_SEND_IOV_LONG));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_SEND_IOV_LONG);
 
     if (unlikely(!dev || dev->fd_long <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -959,6 +1440,7 @@ axiom_send_iov_long(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
 
     long_msg.iov = iov;
     long_msg.iovcnt = iovcnt;
+    long_msg.flags = axiom_msg_flags(dev, AXIOM_FLAG_NOBLOCK_LONG);
 
     ret = ioctl(dev->fd_long, AXNET_SEND_LONG_IOV, &long_msg);
     if (unlikely(ret < 0)) {
@@ -979,7 +1461,7 @@ axiom_send_iov_long(axiom_dev_t *dev, axiom_node_id_t dst_id, axiom_port_t port,
             long_msg.header.tx.payload_size);
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_SEND_IOV_LONG, dst_id, payload_size, ret);
     return ret;
 }
 
@@ -998,10 +1480,11 @@ axiom_err_t
 axiom_recv_long(axiom_dev_t *dev, axiom_node_id_t *src_id, axiom_port_t *port,
         axiom_long_payload_size_t *payload_size, void *payload)
 {
-    axiom_long_msg_t long_msg;
+    axiom_ioctl_long_iov_t long_msg;
+    struct iovec iov;
     int ret;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_RECV_LONG));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_RECV_LONG);
 
     if (unlikely(!dev || dev->fd_long <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -1017,9 +1500,15 @@ axiom_recv_long(axiom_dev_t *dev, axiom_node_id_t *src_id, axiom_port_t *port,
     }
 
     long_msg.header.rx.payload_size = *payload_size;
-    long_msg.payload = payload;
 
-    ret = ioctl(dev->fd_long, AXNET_RECV_LONG, &long_msg);
+    /* the iovec ioctl carries the per-call flags */
+    iov.iov_base = payload;
+    iov.iov_len = *payload_size;
+    long_msg.iov = &iov;
+    long_msg.iovcnt = 1;
+    long_msg.flags = axiom_msg_flags(dev, AXIOM_FLAG_NOBLOCK_LONG);
+
+    ret = ioctl(dev->fd_long, AXNET_RECV_LONG_IOV, &long_msg);
     if (unlikely(ret < 0)) {
         if (errno == EAGAIN) {
             ret = AXIOM_RET_NOTAVAIL;
@@ -1038,7 +1527,8 @@ axiom_recv_long(axiom_dev_t *dev, axiom_node_id_t *src_id, axiom_port_t *port,
             payload_size);
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_RECV_LONG,
+            AXIOM_RET_IS_OK(ret) ? *src_id : 0, *payload_size, ret);
     return ret;
 }
 
@@ -1049,8 +1539,7 @@ axiom_recv_iov_long(axiom_dev_t *dev, axiom_node_id_t *src_id, axiom_port_t *por
     axiom_ioctl_long_iov_t long_msg;
     int ret;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic,
-                AX_EXTRAE_APINIC_RECV_IOV_LONG));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_RECV_IOV_LONG);
 
     if (unlikely(!dev || dev->fd_long <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -1069,6 +1558,7 @@ axiom_recv_iov_long(axiom_dev_t *dev, axiom_node_id_t *src_id, axiom_port_t *por
 
     long_msg.iov = iov;
     long_msg.iovcnt = iovcnt;
+    long_msg.flags = axiom_msg_flags(dev, AXIOM_FLAG_NOBLOCK_LONG);
 
     ret = ioctl(dev->fd_long, AXNET_RECV_LONG_IOV, &long_msg);
     if (unlikely(ret < 0)) {
@@ -1088,7 +1578,8 @@ axiom_recv_iov_long(axiom_dev_t *dev, axiom_node_id_t *src_id, axiom_port_t *por
     ret = axiom_recv_long_finalize(&long_msg.header, src_id, port,
             payload_size);
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_RECV_IOV_LONG,
+            AXIOM_RET_IS_OK(ret) ? *src_id : 0, *payload_size, ret);
     return ret;
 }
 
@@ -1097,8 +1588,7 @@ axiom_send_long_avail(axiom_dev_t *dev)
 {
     int ret, avail;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic,
-                AX_EXTRAE_APINIC_SEND_LONG_AVAIL));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_SEND_LONG_AVAIL);
 
     if (unlikely(!dev || dev->fd_long <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -1117,7 +1607,7 @@ axiom_send_long_avail(axiom_dev_t *dev)
     ret = avail;
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_SEND_LONG_AVAIL, 0, 0, ret);
     return ret;
 }
 
@@ -1126,8 +1616,7 @@ axiom_recv_long_avail(axiom_dev_t *dev)
 {
     int ret, avail;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic,
-                AX_EXTRAE_APINIC_RECV_LONG_AVAIL));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_RECV_LONG_AVAIL);
 
     if (unlikely(!dev || dev->fd_long <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -1146,7 +1635,7 @@ axiom_recv_long_avail(axiom_dev_t *dev)
     ret = avail;
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_RECV_LONG_AVAIL, 0, 0, ret);
     return ret;
 }
 
@@ -1183,6 +1672,9 @@ axiom_rdma_mmap(axiom_dev_t *dev, size_t *sizep)
         return NULL;
     }
 
+    /* the channels share the RDMA zone of the device */
+    dev = dev->owner;
+
     if (unlikely(dev->rdma_addr)) {
         EPRINTF("axiom rdma zone already mapped");
         return NULL;
@@ -1229,19 +1721,164 @@ axiom_rdma_munmap(axiom_dev_t *dev)
         return AXIOM_RET_ERROR;
     }
 
+    dev = dev->owner;
     if (unlikely(!dev->rdma_addr)) {
         EPRINTF("axiom rdma zone not mapped");
         return AXIOM_RET_ERROR;
     }
 
-    ret = munmap(dev->rdma_addr, dev->rdma_size);
-    if (unlikely(ret)) {
-        EPRINTF("munmap failed - errno: %s", strerror(errno));
+    ret = munmap(dev->rdma_addr, dev->rdma_size);
+    if (unlikely(ret)) {
+        EPRINTF("munmap failed - errno: %s", strerror(errno));
+        return AXIOM_RET_ERROR;
+    }
+
+    dev->rdma_addr = NULL;
+    dev->rdma_size = 0;
+
+    return AXIOM_RET_OK;
+}
+
+axiom_mr_t *
+axiom_mr_register(axiom_dev_t *dev, void *addr, size_t size)
+{
+    axiom_ioctl_mr_t mr_ioctl;
+    axiom_mr_t *mr;
+    uintptr_t start = (uintptr_t)addr;
+    int ret;
+
+    if (unlikely(!dev || dev->fd_rdma <= 0)) {
+        EPRINTF("axiom device is not opened - dev: %p", dev);
+        return NULL;
+    }
+
+    if (unlikely(size == 0 || start + size < start)) {
+        EPRINTF("invalid region - addr: %p size: %zu", addr, size);
+        return NULL;
+    }
+
+    /* the same range is already registered */
+    mr = axiom_mr_lookup(dev, start, size);
+    if (mr && mr->start == start && mr->end == start + size) {
+        mr->refs++;
+        return mr;
+    }
+
+    mr = calloc(1, sizeof(*mr));
+    if (unlikely(mr == NULL)) {
+        EPRINTF("failed to allocate memory");
+        return NULL;
+    }
+
+    mr_ioctl.addr = addr;
+    mr_ioctl.size = size;
+    mr_ioctl.app_id = dev->appid;
+
+    ret = ioctl(dev->fd_rdma, AXNET_MR_REG, &mr_ioctl);
+    if (unlikely(ret < 0)) {
+        EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
+        goto free_mr;
+    }
+
+    mr->start = start;
+    mr->end = start + size;
+    mr->id = mr_ioctl.mr;
+    mr->refs = 1;
+
+    if (unlikely(!AXIOM_RET_IS_OK(axiom_mr_link(dev, mr)))) {
+        EPRINTF("failed to allocate memory");
+        goto dereg_mr;
+    }
+
+    mr->next = dev->mr_list;
+    dev->mr_list = mr;
+
+    return mr;
+
+dereg_mr:
+    ioctl(dev->fd_rdma, AXNET_MR_DEREG, &mr->id);
+free_mr:
+    free(mr);
+    return NULL;
+}
+
+axiom_err_t
+axiom_mr_deregister(axiom_dev_t *dev, axiom_mr_t *mr)
+{
+    axiom_mr_t **pnext;
+    int ret;
+
+    if (unlikely(!dev || dev->fd_rdma <= 0 || !mr)) {
+        EPRINTF("axiom device is not opened - dev: %p", dev);
+        return AXIOM_RET_ERROR;
+    }
+
+    if (--mr->refs > 0)
+        return AXIOM_RET_OK;
+
+    axiom_mr_unlink(dev, mr);
+    for (pnext = &dev->mr_list; *pnext; pnext = &(*pnext)->next) {
+        if (*pnext == mr) {
+            *pnext = mr->next;
+            break;
+        }
+    }
+
+    ret = ioctl(dev->fd_rdma, AXNET_MR_DEREG, &mr->id);
+    free(mr);
+
+    if (unlikely(ret < 0)) {
+        EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
+        return AXIOM_RET_ERROR;
+    }
+
+    return AXIOM_RET_OK;
+}
+
+inline static axiom_err_t
+axiom_rdma_prepare(axiom_dev_t *dev, axiom_ioctl_rdma_t *rdma,
+        axiom_type_t type, axiom_node_id_t remote_id, size_t payload_size,
+        void *src_addr, void *dst_addr, uint32_t flags)
+{
+    if (unlikely(payload_size & ((1 << AXIOM_RDMA_PAYLOAD_SIZE_ORDER) - 1))) {
+        EPRINTF("payload size [%zu] must be multiple of %d", payload_size,
+                (1 << AXIOM_RDMA_PAYLOAD_SIZE_ORDER));
+        return AXIOM_RET_ERROR;
+    }
+
+    if (unlikely(payload_size > (AXIOM_RDMA_PAYLOAD_MAX_SIZE))) {
+        EPRINTF("payload size too big - size: %zu [%d]", payload_size,
+                AXIOM_RDMA_PAYLOAD_MAX_SIZE);
         return AXIOM_RET_ERROR;
     }
 
-    dev->rdma_addr = NULL;
-    dev->rdma_size = 0;
+    rdma->header.tx.port_type.field.type = type;
+    rdma->header.tx.port_type.field.s = 0;
+    rdma->header.tx.dst = remote_id;
+    rdma->header.tx.payload_size =
+        (payload_size >> AXIOM_RDMA_PAYLOAD_SIZE_ORDER);
+
+    rdma->app_id = dev->appid;
+    rdma->src_addr = src_addr;
+    rdma->dst_addr = dst_addr;
+    rdma->flags = flags;
+    if (dev->flags & AXIOM_FLAG_NOBLOCK_RDMA)
+        rdma->flags |= AXIOCTL_RDMA_FLAGS_NONBLOCK;
+
+    /* buffers inside registered regions: the driver skips the translation */
+    if (dev->mr_list) {
+        axiom_mr_t *src_mr, *dst_mr;
+
+        src_mr = axiom_mr_lookup(dev, (uintptr_t)src_addr, payload_size);
+        dst_mr = axiom_mr_lookup(dev, (uintptr_t)dst_addr, payload_size);
+        if (src_mr && dst_mr) {
+            rdma->src_addr = (void *)((uintptr_t)src_addr - src_mr->start);
+            rdma->dst_addr = (void *)((uintptr_t)dst_addr - dst_mr->start);
+            rdma->src_mr = src_mr->id;
+            rdma->dst_mr = dst_mr->id;
+            rdma->flags |= AXIOCTL_RDMA_FLAGS_MR;
+        }
+    }
 
     return AXIOM_RET_OK;
 }
@@ -1254,7 +1891,7 @@ axiom_rdma_write_internal(axiom_dev_t *dev, axiom_node_id_t remote_id,
     axiom_ioctl_rdma_t rdma;
     int ret;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_RDMA_WRITE));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_RDMA_WRITE);
 
     if (unlikely(!dev || dev->fd_rdma <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -1262,32 +1899,12 @@ axiom_rdma_write_internal(axiom_dev_t *dev, axiom_node_id_t remote_id,
         goto end;
     }
 
-    if (unlikely(payload_size & ((1 << AXIOM_RDMA_PAYLOAD_SIZE_ORDER) - 1))) {
-        EPRINTF("payload size [%zu] must be multiple of %d", payload_size,
-                (1 << AXIOM_RDMA_PAYLOAD_SIZE_ORDER));
-        ret = AXIOM_RET_ERROR;
-        goto end;
-    }
+    DPRINTF("[packet] payload_size: 0x%zx", payload_size);
 
-    if (unlikely(payload_size > (AXIOM_RDMA_PAYLOAD_MAX_SIZE))) {
-        EPRINTF("payload size too big - size: %zu [%d]", payload_size,
-                AXIOM_RAW_PAYLOAD_MAX_SIZE);
-        ret = AXIOM_RET_ERROR;
+    ret = axiom_rdma_prepare(dev, &rdma, AXIOM_TYPE_RDMA_WRITE, remote_id,
+            payload_size, local_src_addr, remote_dst_addr, flags);
+    if (unlikely(!AXIOM_RET_IS_OK(ret)))
         goto end;
-    }
-
-    DPRINTF("[packet] payload_size: 0x%x", payload_size);
-
-    rdma.header.tx.port_type.field.type = AXIOM_TYPE_RDMA_WRITE;
-    rdma.header.tx.port_type.field.s = 0;
-    rdma.header.tx.dst = remote_id;
-    rdma.header.tx.payload_size =
-        (payload_size >> AXIOM_RDMA_PAYLOAD_SIZE_ORDER);
-
-    rdma.app_id = dev->appid;
-    rdma.src_addr = local_src_addr;
-    rdma.dst_addr = remote_dst_addr;
-    rdma.flags = flags;
 
     ret = ioctl(dev->fd_rdma, AXNET_RDMA_WRITE, &rdma);
     if (unlikely(ret < 0)) {
@@ -1311,7 +1928,7 @@ axiom_rdma_write_internal(axiom_dev_t *dev, axiom_node_id_t remote_id,
     ret = rdma.token.rdma.msg_id;
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_RDMA_WRITE, remote_id, payload_size, ret);
     return ret;
 }
 
@@ -1341,7 +1958,7 @@ axiom_rdma_read_internal(axiom_dev_t *dev, axiom_node_id_t remote_id,
     axiom_ioctl_rdma_t rdma;
     int ret;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_RDMA_READ));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_RDMA_READ);
 
     if (unlikely(!dev || dev->fd_rdma <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -1349,30 +1966,10 @@ axiom_rdma_read_internal(axiom_dev_t *dev, axiom_node_id_t remote_id,
         goto end;
     }
 
-    if (unlikely(payload_size & ((1 << AXIOM_RDMA_PAYLOAD_SIZE_ORDER) - 1))) {
-        EPRINTF("payload size [%zu] must be multiple of %d", payload_size,
-                (1 << AXIOM_RDMA_PAYLOAD_SIZE_ORDER));
-        ret = AXIOM_RET_ERROR;
-        goto end;
-    }
-
-    if (unlikely(payload_size > (AXIOM_RDMA_PAYLOAD_MAX_SIZE))) {
-        EPRINTF("payload size too big - size: %zu [%d]", payload_size,
-                AXIOM_RAW_PAYLOAD_MAX_SIZE);
-        ret = AXIOM_RET_ERROR;
+    ret = axiom_rdma_prepare(dev, &rdma, AXIOM_TYPE_RDMA_READ, remote_id,
+            payload_size, remote_src_addr, local_dst_addr, flags);
+    if (unlikely(!AXIOM_RET_IS_OK(ret)))
         goto end;
-    }
-
-    rdma.header.tx.port_type.field.type = AXIOM_TYPE_RDMA_READ;
-    rdma.header.tx.port_type.field.s = 0;
-    rdma.header.tx.dst = remote_id;
-    rdma.header.tx.payload_size =
-        (payload_size >> AXIOM_RDMA_PAYLOAD_SIZE_ORDER);
-
-    rdma.app_id = dev->appid;
-    rdma.src_addr = remote_src_addr;
-    rdma.dst_addr = local_dst_addr;
-    rdma.flags = flags;
 
     ret = ioctl(dev->fd_rdma, AXNET_RDMA_READ, &rdma);
     if (unlikely(ret < 0)) {
@@ -1396,7 +1993,7 @@ axiom_rdma_read_internal(axiom_dev_t *dev, axiom_node_id_t remote_id,
     ret = rdma.token.rdma.msg_id;
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_RDMA_READ, remote_id, payload_size, ret);
     return ret;
 }
 
@@ -1418,13 +2015,59 @@ axiom_rdma_read(axiom_dev_t *dev, axiom_node_id_t remote_id,
             remote_src_addr, local_dst_addr, token, AXIOCTL_RDMA_FLAGS_ASYNC);
 }
 
+/* address of an offset inside a region, or NULL if the buffer overflows */
+inline static void *
+axiom_mr_addr(axiom_mr_t *mr, size_t offset, size_t size)
+{
+    if (unlikely(!mr || offset >= mr->end - mr->start ||
+                size > mr->end - mr->start - offset)) {
+        EPRINTF("buffer outside the region - offset: %zu size: %zu", offset,
+                size);
+        return NULL;
+    }
+
+    return (void *)(mr->start + offset);
+}
+
+axiom_err_t
+axiom_rdma_write_mr(axiom_dev_t *dev, axiom_node_id_t remote_id,
+        size_t payload_size, axiom_mr_t *local_mr, size_t local_offset,
+        axiom_mr_t *remote_mr, size_t remote_offset, axiom_token_t *token)
+{
+    void *src_addr, *dst_addr;
+
+    src_addr = axiom_mr_addr(local_mr, local_offset, payload_size);
+    dst_addr = axiom_mr_addr(remote_mr, remote_offset, payload_size);
+    if (unlikely(!src_addr || !dst_addr))
+        return AXIOM_RET_ERROR;
+
+    return axiom_rdma_write_internal(dev, remote_id, payload_size,
+            src_addr, dst_addr, token, AXIOCTL_RDMA_FLAGS_ASYNC);
+}
+
+axiom_err_t
+axiom_rdma_read_mr(axiom_dev_t *dev, axiom_node_id_t remote_id,
+        size_t payload_size, axiom_mr_t *remote_mr, size_t remote_offset,
+        axiom_mr_t *local_mr, size_t local_offset, axiom_token_t *token)
+{
+    void *src_addr, *dst_addr;
+
+    src_addr = axiom_mr_addr(remote_mr, remote_offset, payload_size);
+    dst_addr = axiom_mr_addr(local_mr, local_offset, payload_size);
+    if (unlikely(!src_addr || !dst_addr))
+        return AXIOM_RET_ERROR;
+
+    return axiom_rdma_read_internal(dev, remote_id, payload_size,
+            src_addr, dst_addr, token, AXIOCTL_RDMA_FLAGS_ASYNC);
+}
+
 axiom_err_t
 axiom_rdma_check(axiom_dev_t *dev, axiom_token_t *tokens, int tokencnt)
 {
     axiom_ioctl_token_t token_ioctl;
     int ret;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_RDMA_CHECK));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_RDMA_CHECK);
     if (unlikely(!dev || dev->fd_rdma <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
         ret = AXIOM_RET_ERROR;
@@ -1441,7 +2084,7 @@ axiom_rdma_check(axiom_dev_t *dev, axiom_token_t *tokens, int tokencnt)
     }
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_RDMA_CHECK, 0, 0, ret);
     return ret;
 }
 
@@ -1462,7 +2105,7 @@ axiom_rdma_wait(axiom_dev_t *dev, axiom_token_t *tokens, int tokencnt)
     int acked;
     int ret;
 
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_RDMA_WAIT));
+    AXIOM_INSTR_BEGIN(AXIOM_TRACE_OP_RDMA_WAIT);
 
     if (unlikely(!dev || dev->fd_rdma <= 0)) {
         EPRINTF("axiom device is not opened - dev: %p", dev);
@@ -1504,10 +2147,272 @@ axiom_rdma_wait(axiom_dev_t *dev, axiom_token_t *tokens, int tokencnt)
     ret = AXIOM_RET_OK;
 
 end:
-    AXIOM_EXTRAE(Extrae_event(axiom_extrae_apinic, AX_EXTRAE_APINIC_END));
+    AXIOM_INSTR_END(AXIOM_TRACE_OP_RDMA_WAIT, 0, 0, ret);
+    return ret;
+}
+
+axiom_err_t
+axiom_ring_setup(axiom_dev_t *dev, unsigned entries)
+{
+    axiom_ioctl_ring_setup_t setup;
+    axiom_err_t ret;
+    uint8_t *addr;
+
+    if (!dev || dev->fd_generic <= 0) {
+        EPRINTF("axiom device is not opened - dev: %p", dev);
+        return AXIOM_RET_ERROR;
+    }
+
+    /* the channels share the ring of the device */
+    dev = dev->owner;
+    if (dev->ring_hdr) {
+        EPRINTF("ring already created");
+        return AXIOM_RET_ERROR;
+    }
+
+    /* the driver executes the operations through the attached fds */
+    ret = axiom_event_attach(dev);
+    if (!AXIOM_RET_IS_OK(ret))
+        return ret;
+
+    setup.sq_entries = entries;
+    ret = ioctl(dev->fd_generic, AXNET_RING_SETUP, &setup);
+    if (ret < 0) {
+        EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
+        return AXIOM_RET_ERROR;
+    }
+
+    addr = mmap(NULL, setup.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+            dev->fd_generic, 0);
+    if (addr == MAP_FAILED) {
+        EPRINTF("mmap failed - errno: %s", strerror(errno));
+        return AXIOM_RET_ERROR;
+    }
+
+    dev->ring_sq_ready = calloc(setup.sq_entries,
+            sizeof(*dev->ring_sq_ready));
+    if (!dev->ring_sq_ready) {
+        EPRINTF("calloc failed - sq_entries: %u", setup.sq_entries);
+        munmap(addr, setup.size);
+        return AXIOM_RET_ERROR;
+    }
+
+    dev->ring_hdr = (axiom_ring_hdr_t *)addr;
+    dev->ring_sqes = (axiom_ring_sqe_t *)(addr + setup.sq_offset);
+    dev->ring_cqes = (axiom_ring_cqe_t *)(addr + setup.cq_offset);
+    dev->ring_sq_entries = setup.sq_entries;
+    dev->ring_cq_entries = setup.cq_entries;
+    dev->ring_size = setup.size;
+    dev->ring_sq_reserved = dev->ring_hdr->sq_tail;
+
+    DPRINTF("ring - sq_entries: %u cq_entries: %u size: %u",
+            setup.sq_entries, setup.cq_entries, setup.size);
+
+    return AXIOM_RET_OK;
+}
+
+/*
+ * Publish to the driver (sq_tail) the SQEs written in order from the current
+ * tail. Any producer can publish the SQEs of the others, so the last one that
+ * marks its slot ready moves the tail over all the slots ready.
+ */
+inline static void
+axiom_ring_sq_publish(axiom_dev_t *owner)
+{
+    axiom_ring_hdr_t *hdr = owner->ring_hdr;
+    uint32_t tail, mask = owner->ring_sq_entries - 1;
+
+    tail = __atomic_load_n(&hdr->sq_tail, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&owner->ring_sq_ready[tail & mask],
+                __ATOMIC_SEQ_CST) == tail + 1) {
+        /* on failure another producer moved the tail: go on from there */
+        __atomic_compare_exchange_n(&hdr->sq_tail, &tail, tail + 1, 0,
+                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    }
+}
+
+/*
+ * Queue a SQE filled by the caller, with the flags of the channel. The
+ * channels share the ring of the device, so the slot is reserved with a CAS
+ * on the library producer index (ring_sq_reserved), marked ready when written
+ * and the SQEs are published to the driver (sq_tail) in the order of the
+ * reservation. A producer never waits for the others: a SQE written before
+ * the ones reserved earlier is published by the last of them.
+ */
+inline static axiom_err_t
+axiom_ring_sqe_push(axiom_dev_t *dev, axiom_ring_sqe_t *sqe,
+        uint32_t opcode, uint64_t user_data)
+{
+    axiom_flags_t noblock = AXIOM_FLAG_NOBLOCK_RDMA;
+    axiom_ring_hdr_t *hdr;
+    axiom_dev_t *owner;
+    uint32_t index, slot;
+
+    if (unlikely(!dev || !dev->owner->ring_hdr)) {
+        EPRINTF("ring not created - dev: %p", dev);
+        return AXIOM_RET_ERROR;
+    }
+
+    if (opcode == AXIOM_RING_OP_SEND_RAW)
+        noblock = AXIOM_FLAG_NOBLOCK_RAW;
+    else if (opcode == AXIOM_RING_OP_SEND_LONG)
+        noblock = AXIOM_FLAG_NOBLOCK_LONG;
+
+    sqe->user_data = user_data;
+    sqe->opcode = opcode;
+    sqe->flags = (dev->flags & noblock) ? AXIOM_RING_SQE_FLAGS_NONBLOCK : 0;
+
+    owner = dev->owner;
+    hdr = owner->ring_hdr;
+
+    index = __atomic_load_n(&owner->ring_sq_reserved, __ATOMIC_RELAXED);
+    do {
+        if (unlikely(index - __atomic_load_n(&hdr->sq_head, __ATOMIC_ACQUIRE)
+                    >= owner->ring_sq_entries))
+            return AXIOM_RET_NOTAVAIL;
+    } while (!__atomic_compare_exchange_n(&owner->ring_sq_reserved, &index,
+                index + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    slot = index & (owner->ring_sq_entries - 1);
+    owner->ring_sqes[slot] = *sqe;
+
+    /* seq_cst: the producer that moves the tail must see this flag */
+    __atomic_store_n(&owner->ring_sq_ready[slot], index + 1, __ATOMIC_SEQ_CST);
+    axiom_ring_sq_publish(owner);
+
+    return AXIOM_RET_OK;
+}
+
+axiom_err_t
+axiom_ring_send_raw(axiom_dev_t *dev, axiom_node_id_t dst_id,
+        axiom_port_t port, axiom_type_t type,
+        axiom_raw_payload_size_t payload_size, void *payload,
+        uint64_t user_data)
+{
+    axiom_ring_sqe_t sqe;
+    axiom_err_t ret;
+
+    ret = axiom_send_raw_prepare(&sqe.op.raw.header, dst_id, port, type,
+            payload_size);
+    if (unlikely(!AXIOM_RET_IS_OK(ret)))
+        return ret;
+
+    sqe.op.raw.payload = payload;
+
+    return axiom_ring_sqe_push(dev, &sqe, AXIOM_RING_OP_SEND_RAW, user_data);
+}
+
+axiom_err_t
+axiom_ring_send_long(axiom_dev_t *dev, axiom_node_id_t dst_id,
+        axiom_port_t port, axiom_long_payload_size_t payload_size,
+        void *payload, uint64_t user_data)
+{
+    axiom_ring_sqe_t sqe;
+    axiom_err_t ret;
+
+    ret = axiom_send_long_prepare(&sqe.op.long_msg.header, dst_id, port,
+            payload_size);
+    if (unlikely(!AXIOM_RET_IS_OK(ret)))
+        return ret;
+
+    sqe.op.long_msg.payload = payload;
+
+    return axiom_ring_sqe_push(dev, &sqe, AXIOM_RING_OP_SEND_LONG, user_data);
+}
+
+axiom_err_t
+axiom_ring_rdma_write(axiom_dev_t *dev, axiom_node_id_t remote_id,
+        size_t payload_size, void *local_src_addr, void *remote_dst_addr,
+        uint64_t user_data)
+{
+    axiom_ring_sqe_t sqe;
+    axiom_err_t ret;
+
+    ret = axiom_rdma_prepare(dev, &sqe.op.rdma, AXIOM_TYPE_RDMA_WRITE,
+            remote_id, payload_size, local_src_addr, remote_dst_addr, 0);
+    if (unlikely(!AXIOM_RET_IS_OK(ret)))
+        return ret;
+
+    return axiom_ring_sqe_push(dev, &sqe, AXIOM_RING_OP_RDMA, user_data);
+}
+
+axiom_err_t
+axiom_ring_rdma_read(axiom_dev_t *dev, axiom_node_id_t remote_id,
+        size_t payload_size, void *remote_src_addr, void *local_dst_addr,
+        uint64_t user_data)
+{
+    axiom_ring_sqe_t sqe;
+    axiom_err_t ret;
+
+    ret = axiom_rdma_prepare(dev, &sqe.op.rdma, AXIOM_TYPE_RDMA_READ,
+            remote_id, payload_size, remote_src_addr, local_dst_addr, 0);
+    if (unlikely(!AXIOM_RET_IS_OK(ret)))
+        return ret;
+
+    return axiom_ring_sqe_push(dev, &sqe, AXIOM_RING_OP_RDMA, user_data);
+}
+
+int
+axiom_ring_submit(axiom_dev_t *dev, unsigned min_complete)
+{
+    axiom_ioctl_ring_enter_t enter;
+    int ret;
+
+    if (unlikely(!dev || !dev->owner->ring_hdr)) {
+        EPRINTF("ring not created - dev: %p", dev);
+        return AXIOM_RET_ERROR;
+    }
+
+    enter.to_submit = dev->owner->ring_sq_entries;
+    enter.min_complete = min_complete;
+
+    ret = ioctl(dev->fd_generic, AXNET_RING_ENTER, &enter);
+    if (unlikely(ret < 0)) {
+        if (errno == EAGAIN || errno == EBUSY) {
+            ret = AXIOM_RET_NOTAVAIL;
+        } else if (errno == EINTR) {
+            ret = AXIOM_RET_INTR;
+        } else {
+            EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
+            ret = AXIOM_RET_ERROR;
+        }
+    }
+
     return ret;
 }
 
+int
+axiom_ring_complete(axiom_dev_t *dev, axiom_ring_cqe_t *cqes, int count)
+{
+    axiom_ring_hdr_t *hdr;
+    uint32_t head, tail;
+    int i;
+
+    if (unlikely(!dev || !dev->owner->ring_hdr)) {
+        EPRINTF("ring not created - dev: %p", dev);
+        return AXIOM_RET_ERROR;
+    }
+
+    dev = dev->owner;
+    hdr = dev->ring_hdr;
+    head = __atomic_load_n(&hdr->cq_head, __ATOMIC_ACQUIRE);
+
+    /*
+     * The channels share the ring: the CQEs copied are taken only if no other
+     * thread moved the head meanwhile. The driver doesn't overwrite the CQEs
+     * after the head, so the copy is valid if the CAS succeeds.
+     */
+    do {
+        tail = __atomic_load_n(&hdr->cq_tail, __ATOMIC_ACQUIRE);
+
+        for (i = 0; i < count && head + i != tail; i++)
+            cqes[i] = dev->ring_cqes[(head + i) & (dev->ring_cq_entries - 1)];
+    } while (i && !__atomic_compare_exchange_n(&hdr->cq_head, &head,
+                head + i, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+
+    return i;
+}
+
 uint32_t
 axiom_read_ni_status(axiom_dev_t *dev)
 {
@@ -1620,6 +2525,9 @@ axiom_set_routing(axiom_dev_t *dev, axiom_node_id_t node_id,
 
     ret = ioctl(dev->fd_generic, AXNET_SET_ROUTING, &routing);
 
+    /* the cached routing table is reloaded at the next lookup */
+    dev->routing_cached = 0;
+
     if (ret < 0) {
         EPRINTF("ioctl error - ret: %d errno: %s", ret, strerror(errno));
         return AXIOM_RET_ERROR;
@@ -1655,6 +2563,29 @@ axiom_get_routing(axiom_dev_t *dev, axiom_node_id_t node_id,
     return AXIOM_RET_OK;
 }
 
+axiom_err_t
+axiom_get_routing_table(axiom_dev_t *dev, uint8_t *enabled_mask,
+        uint32_t *generation)
+{
+    axiom_err_t ret;
+
+    if (!dev || dev->fd_generic <= 0) {
+        EPRINTF("axiom device is not opened - dev: %p", dev);
+        return AXIOM_RET_ERROR;
+    }
+
+    ret = axiom_routing_load(dev);
+    if (!AXIOM_RET_IS_OK(ret))
+        return ret;
+
+    memcpy(enabled_mask, dev->routing.enabled_mask,
+            sizeof(dev->routing.enabled_mask));
+    if (generation)
+        *generation = dev->routing.generation;
+
+    return AXIOM_RET_OK;
+}
+
 int
 axiom_get_num_nodes(axiom_dev_t *dev)
 {
@@ -1672,15 +2603,24 @@ axiom_get_num_nodes(axiom_dev_t *dev)
     /* get local id */
     node_id = axiom_get_node_id(dev);
 
+    /*
+     * The nodes are counted on the cached table, loaded again with one ioctl
+     * when the generation in the information page changes. Without the page
+     * the changes are not visible, so the table is always loaded.
+     */
+    if (axiom_routing_stale(dev) || !dev->owner->info) {
+        err = axiom_routing_load(dev);
+        if (err)
+            return AXIOM_RET_ERROR;
+    }
+
     for (i = 0; i < AXIOM_NODES_NUM; i++) {
 
         /* we already count local node */
         if (i == node_id)
             continue;
 
-        err = axiom_get_routing(dev, i, &enabled_mask);
-        if (err)
-            break;
+        enabled_mask = dev->routing.enabled_mask[i];
 
         /*
          * count node i, if it is reachable through physical interfaces
@@ -1779,3 +2719,104 @@ axiom_debug_info(axiom_dev_t *dev, uint32_t flags)
 
     return AXIOM_RET_OK;
 }
+
+#ifdef AXIOM_TRACE_SUPPORT
+static void
+axiom_trace_dump_buf(FILE *file, axiom_trace_buf_t *buf)
+{
+    axiom_trace_thread_hdr_t thread_hdr;
+    axiom_trace_event_t *events;
+    uint64_t size = (uint64_t)buf->mask + 1, head, first, valid, i;
+
+    head = __atomic_load_n(&buf->head, __ATOMIC_ACQUIRE);
+    first = (head > size) ? head - size : 0;
+
+    events = malloc(sizeof(*events) * (head - first + 1));
+    if (!events) {
+        EPRINTF("failed to allocate memory");
+        return;
+    }
+
+    for (i = first; i < head; i++) {
+        events[i - first] = buf->events[i & buf->mask];
+    }
+
+    /* the copy above must be completed before head is read again */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    /*
+     * discard the events overwritten by the owner during the copy, and the
+     * slot of the event that it may be writing now (head & mask)
+     */
+    valid = __atomic_load_n(&buf->head, __ATOMIC_RELAXED);
+    valid = (valid >= size) ? valid - size + 1 : 0;
+    if (valid < first)
+        valid = first;
+    if (valid > head)
+        valid = head;
+
+    thread_hdr.tid = buf->tid;
+    thread_hdr.events = (uint32_t)(head - valid);
+    thread_hdr.lost = valid;
+
+    fwrite(&thread_hdr, sizeof(thread_hdr), 1, file);
+    fwrite(&events[valid - first], sizeof(*events), thread_hdr.events, file);
+
+    free(events);
+}
+
+axiom_err_t
+axiom_trace_dump(const char *filename)
+{
+    axiom_trace_file_hdr_t file_hdr;
+    axiom_trace_buf_t *bufs, *buf;
+    char default_name[64];
+    FILE *file;
+
+    bufs = __atomic_load_n(&axiom_trace_bufs, __ATOMIC_ACQUIRE);
+
+    if (!filename)
+        filename = getenv(AXIOM_ENV_TRACE_FILE);
+
+    if (!filename) {
+        snprintf(default_name, sizeof(default_name), "%s.%d.bin",
+                AXIOM_TRACE_FILE_DEFAULT, getpid());
+        filename = default_name;
+    }
+
+    file = fopen(filename, "w");
+    if (!file) {
+        EPRINTF("impossible to open %s - errno: %s", filename,
+                strerror(errno));
+        return AXIOM_RET_ERROR;
+    }
+
+    file_hdr.magic = AXIOM_TRACE_MAGIC;
+    file_hdr.version = AXIOM_TRACE_VERSION;
+    file_hdr.event_size = sizeof(axiom_trace_event_t);
+    file_hdr.pid = getpid();
+    file_hdr.threads = 0;
+    for (buf = bufs; buf; buf = buf->next)
+        file_hdr.threads++;
+
+    fwrite(&file_hdr, sizeof(file_hdr), 1, file);
+
+    for (buf = bufs; buf; buf = buf->next)
+        axiom_trace_dump_buf(file, buf);
+
+    if (fclose(file)) {
+        EPRINTF("impossible to write %s - errno: %s", filename,
+                strerror(errno));
+        return AXIOM_RET_ERROR;
+    }
+
+    return AXIOM_RET_OK;
+}
+#else /* !AXIOM_TRACE_SUPPORT */
+axiom_err_t
+axiom_trace_dump(const char *filename)
+{
+    EPRINTF("axiom tracing not supported by this library");
+    return AXIOM_RET_ERROR;
+}
+#endif /* AXIOM_TRACE_SUPPORT */
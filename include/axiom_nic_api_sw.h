@@ -0,0 +1,139 @@
+/*!
+ * \file axiom_nic_api_sw.h
+ *
+ * \version     v1.2
+ * \date        2016-11-14
+ *
+ * This file contains the API of the AXIOM NIC software emulator.
+ *
+ * The emulator implements the AXIOM NIC HARDWARE API (axiom_nic_api_hw.h)
+ * without any hardware: every emulated NIC is attached to a virtual switch
+ * that forwards RAW, LONG and RDMA packets between the NICs of the same host,
+ * following the routing table of each NIC and the links set with
+ * axiom_sw_connect().
+ * The same source is used as kernel module backend (SWNIC=1) and as user
+ * space library (libaxiom_swnic.a). In user space, the AXIOM user library
+ * runs on the emulated NICs through the shim of axiom_swnic_shim.h.
+ * In user space the RDMA zone set with axiom_hw_set_rdma_zone() is a buffer
+ * of the caller (virtual addresses); a zone at address 0 removes it.
+ *
+ * Copyright (C) 2016, Evidence Srl.
+ * Terms of use are as specified in COPYING
+ */
+#ifndef AXIOM_NIC_API_SW_h
+#define AXIOM_NIC_API_SW_h
+
+/**
+ * \defgroup AXIOM_NIC
+ *
+ * \{
+ */
+
+#include "axiom_nic_api_hw.h"
+
+/*! \brief Max number of NICs attached to the virtual switch */
+#define AXIOM_SW_NICS_MAX               16
+/*! \brief Number of packets in each RAW FIFO (TX and RX) */
+#define AXIOM_SW_RAW_FIFO_LEN           64
+/*! \brief Number of descriptors in each RDMA FIFO (TX and RX) */
+#define AXIOM_SW_RDMA_FIFO_LEN          64
+/*! \brief Value returned by the version register of the emulated NIC */
+#define AXIOM_SW_VERSION                0x00535700
+
+/*!
+ * \brief Interrupt handler of an emulated NIC
+ *
+ * The handler is called, without any emulator lock held, by the context that
+ * raised an unmasked interrupt (e.g. the sender of a packet). It must read
+ * and acknowledge the pending interrupts like an hardware handler.
+ *
+ * \param data          Private data passed to axiom_sw_set_irq_handler()
+ */
+typedef void (*axiom_sw_irq_handler_t)(void *data);
+
+/*!
+ * \brief Allocate a new emulated NIC and attach it to the virtual switch
+ *
+ * The NIC starts with node id 0, all interrupts masked, empty routing table
+ * and no links.
+ *
+ * \return A pointer to axiom_dev_t on success, otherwise NULL.
+ */
+axiom_dev_t *
+axiom_sw_dev_alloc(void);
+
+/*!
+ * \brief Detach an emulated NIC from the virtual switch and free it
+ *
+ * \param dev           The axiom device private data pointer
+ */
+void
+axiom_sw_dev_free(axiom_dev_t *dev);
+
+/*!
+ * \brief Connect two interfaces of two emulated NICs with a virtual link
+ *
+ * \param dev_a         The axiom device private data pointer of the 1st NIC
+ * \param if_a          Interface of the 1st NIC [1, AXIOM_INTERFACES_MAX]
+ * \param dev_b         The axiom device private data pointer of the 2nd NIC
+ * \param if_b          Interface of the 2nd NIC [1, AXIOM_INTERFACES_MAX]
+ *
+ * \return Returns AXIOM_RET_OK on success, an error otherwise.
+ */
+axiom_err_t
+axiom_sw_connect(axiom_dev_t *dev_a, axiom_if_id_t if_a, axiom_dev_t *dev_b,
+        axiom_if_id_t if_b);
+
+/*!
+ * \brief Set the interrupt handler of an emulated NIC
+ *
+ * \param dev           The axiom device private data pointer
+ * \param handler       Handler called when an unmasked interrupt is raised
+ *                      (NULL to remove the handler)
+ * \param data          Private data passed to the handler
+ */
+void
+axiom_sw_set_irq_handler(axiom_dev_t *dev, axiom_sw_irq_handler_t handler,
+        void *data);
+
+/*!
+ * \brief Get the number of RAW packets sent by an emulated NIC and discarded
+ *        by the virtual switch because the destination is not reachable
+ *
+ * \param dev           The axiom device private data pointer
+ *
+ * \return The number of RAW packets discarded.
+ */
+uint32_t
+axiom_sw_raw_discarded(axiom_dev_t *dev);
+
+#ifndef __KERNEL__
+/*
+ * In the kernel these functions are declared in axiom_kernel_api.h, together
+ * with the memory mapped registers needed by the hardware backends.
+ */
+
+/*! \brief Print AXIOM NIC status register */
+void
+axiom_print_status_reg(axiom_dev_t *dev);
+
+/*! \brief Print AXIOM NIC control register */
+void
+axiom_print_control_reg(axiom_dev_t *dev);
+
+/*! \brief Print AXIOM NIC routing registers */
+void
+axiom_print_routing_reg(axiom_dev_t *dev);
+
+/*! \brief Print AXIOM NIC queue registers */
+void
+axiom_print_queue_reg(axiom_dev_t *dev);
+
+/*! \brief Print AXIOM NIC FPGA debug register */
+void
+axiom_print_fpga_debug(axiom_dev_t *dev);
+#endif /* !__KERNEL__ */
+
+/** \} */
+
+#endif /* !AXIOM_NIC_API_SW_h */
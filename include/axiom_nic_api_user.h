@@ -47,13 +47,32 @@ axiom_dev_t *
 axiom_open(axiom_args_t *args);
 
 /*!
- * \brief This function close an axiom device
+ * \brief This function close an axiom device or a channel
+ *
+ * The channels of a device must be closed before the device.
  *
  * \param dev           The axiom device private data pointer
  */
 void
 axiom_close(axiom_dev_t *dev);
 
+/*!
+ * \brief This function opens a new channel on an axiom device
+ *
+ * A channel shares the fds, the bound port, the RDMA zone and the ring of the
+ * device, but it has its own flags and its own registered memory regions.
+ * The threads of an application can use one channel each, without locks and
+ * without changing the behaviour of the other threads.
+ *
+ * \param dev           The axiom device private data pointer
+ * \param flags         Axiom flags of the channel
+ *
+ * \return Returns a pointer to the channel, to use as an axiom device,
+ *         NULL otherwise.
+ */
+axiom_dev_t *
+axiom_channel_open(axiom_dev_t *dev, axiom_flags_t flags);
+
 /*!
  * \brief This function set the flags of the axiom device.
  *
@@ -62,6 +81,9 @@ axiom_close(axiom_dev_t *dev);
  *   - AXIOM_FLAGS_NOBLOCK
  *   - AXIOM_FLAGS_NOFLUSH
  *
+ * The flags are passed to the driver in each call and they don't change the
+ * fds, so they affect only this device (or channel).
+ *
  * \param dev           The axiom device private data pointer
  * \param flags         Axiom flags (multiple flags can be passed)
  *
@@ -96,7 +118,197 @@ axiom_err_t
 axiom_get_fds(axiom_dev_t *dev, int *raw_fd, int *long_fd, int *rdma_fd);
 
 /*!
- * \brief This function bind the current process on a specified port
+ * \brief This function sets the busy poll time of the blocking receive of
+ *        raw and long messages.
+ *
+ * When there are no messages to receive, the receive spins for up to usec
+ * microseconds (polling also the RAW hardware FIFO) before sleeping.
+ *
+ * \param dev           The axiom device private data pointer
+ * \param usec          Microseconds to spin (0 to disable the busy poll,
+ *                      negative to use the default set in the sysfs
+ *                      parameter busy_poll_usec)
+ *
+ * \return Returns AXIOM_RET_OK on success, an error otherwise.
+ */
+axiom_err_t
+axiom_set_busy_poll(axiom_dev_t *dev, int usec);
+
+/*!
+ * \brief This function returns a single file descriptor, that can be used
+ *        with select/poll/epoll, readable when there are raw or long messages
+ *        to receive on the bound port or asynchronous RDMA completed.
+ *
+ * The descriptor signals when a queue becomes not empty, so it can be used
+ * also with EPOLLET. The port must be bound before adding the descriptor to
+ * a poll/epoll set. Use axiom_get_events() to know which queue is ready.
+ *
+ * \param dev           The axiom device private data pointer
+ * \param event_fd      The fd that signals the events
+ *
+ * \return Returns AXIOM_RET_OK on success, an error otherwise.
+ */
+axiom_err_t
+axiom_get_event_fd(axiom_dev_t *dev, int *event_fd);
+
+/*!
+ * \brief This function returns the events pending on the event fd.
+ *
+ * \param dev           The axiom device private data pointer
+ *
+ * \return Returns the pending events (AXIOM_EVENT_RAW, AXIOM_EVENT_LONG and
+ *         AXIOM_EVENT_RDMA) on success, an error (< 0) otherwise.
+ */
+int
+axiom_get_events(axiom_dev_t *dev);
+
+/*!
+ * \brief This function creates the submission and the completion rings, to
+ *        keep many RAW, LONG and RDMA operations in flight with few syscalls.
+ *
+ * The operations are queued with axiom_ring_send_raw(),
+ * axiom_ring_send_long(), axiom_ring_rdma_write() and axiom_ring_rdma_read()
+ * (no syscall), started with axiom_ring_submit() and their results are read
+ * with axiom_ring_complete(). The event fd (axiom_get_event_fd()) reports
+ * AXIOM_EVENT_CQ when completions are available. The channels of the device
+ * share its ring: each thread can queue operations and read completions on
+ * its own channel (a completion can be read by any of them). A thread that
+ * queues an operation does not wait for the threads that are queueing the
+ * previous ones: the driver sees the operations in the order of the queueing.
+ *
+ * \param dev           The axiom device private data pointer
+ * \param entries       Number of submission entries (rounded up to a power
+ *                      of 2); the completion ring has twice the entries
+ *
+ * \return Returns AXIOM_RET_OK on success, an error otherwise.
+ */
+axiom_err_t
+axiom_ring_setup(axiom_dev_t *dev, unsigned entries);
+
+/*!
+ * \brief This function queues a raw message in the submission ring.
+ *
+ * The payload is copied by axiom_ring_submit(), so it must be valid until
+ * then.
+ *
+ * \param dev           The axiom device private data pointer
+ * \param dst_id        The remote node id that will receive the raw message
+ * \param port          port of the raw message
+ * \param type          type of the raw message
+ * \param payload_size  size of data to send
+ * \param payload       data to send
+ * \param user_data     value returned in the completion
+ *
+ * \return Returns AXIOM_RET_OK on success, AXIOM_RET_NOTAVAIL if the
+ *         submission ring is full, an error otherwise.
+ */
+axiom_err_t
+axiom_ring_send_raw(axiom_dev_t *dev, axiom_node_id_t dst_id,
+        axiom_port_t port, axiom_type_t type,
+        axiom_raw_payload_size_t payload_size, void *payload,
+        uint64_t user_data);
+
+/*!
+ * \brief This function queues a long message in the submission ring.
+ *
+ * The payload is copied by axiom_ring_submit(), so it must be valid until
+ * then.
+ *
+ * \param dev           The axiom device private data pointer
+ * \param dst_id        The remote node id that will receive the long message
+ * \param port          port of the long message
+ * \param payload_size  size of data to send
+ * \param payload       data to send
+ * \param user_data     value returned in the completion
+ *
+ * \return Returns AXIOM_RET_OK on success, AXIOM_RET_NOTAVAIL if the
+ *         submission ring is full, an error otherwise.
+ */
+axiom_err_t
+axiom_ring_send_long(axiom_dev_t *dev, axiom_node_id_t dst_id,
+        axiom_port_t port, axiom_long_payload_size_t payload_size,
+        void *payload, uint64_t user_data);
+
+/*!
+ * \brief This function queues a RDMA write in the submission ring. The
+ *        completion is posted when the remote node acks the write.
+ *
+ * \param dev             The axiom device private data pointer
+ * \param remote_id       The remote node id that will receive the data
+ * \param payload_size    size of data to transfer
+ * \param local_src_addr  address in the local RDMA zone
+ * \param remote_dst_addr address in the remote RDMA zone
+ * \param user_data       value returned in the completion
+ *
+ * \return Returns AXIOM_RET_OK on success, AXIOM_RET_NOTAVAIL if the
+ *         submission ring is full, an error otherwise.
+ */
+axiom_err_t
+axiom_ring_rdma_write(axiom_dev_t *dev, axiom_node_id_t remote_id,
+        size_t payload_size, void *local_src_addr, void *remote_dst_addr,
+        uint64_t user_data);
+
+/*!
+ * \brief This function queues a RDMA read in the submission ring. The
+ *        completion is posted when the data is received.
+ *
+ * \param dev             The axiom device private data pointer
+ * \param remote_id       The remote node id that will send the data
+ * \param payload_size    size of data to transfer
+ * \param remote_src_addr address in the remote RDMA zone
+ * \param local_dst_addr  address in the local RDMA zone
+ * \param user_data       value returned in the completion
+ *
+ * \return Returns AXIOM_RET_OK on success, AXIOM_RET_NOTAVAIL if the
+ *         submission ring is full, an error otherwise.
+ */
+axiom_err_t
+axiom_ring_rdma_read(axiom_dev_t *dev, axiom_node_id_t remote_id,
+        size_t payload_size, void *remote_src_addr, void *local_dst_addr,
+        uint64_t user_data);
+
+/*!
+ * \brief This function starts all the operations queued in the submission
+ *        ring with a single syscall.
+ *
+ * The send operations block or not following the AXIOM_FLAG_NOBLOCK_* flags:
+ * in non-blocking mode the operations not started remain in the ring.
+ *
+ * \param dev           The axiom device private data pointer
+ * \param min_complete  Completions to wait before returning (0 to return
+ *                      immediately)
+ *
+ * \return Returns the number of operations started on success,
+ *         AXIOM_RET_NOTAVAIL if no operation can be started (completion ring
+ *         full or no space in the NIC), an error otherwise.
+ */
+int
+axiom_ring_submit(axiom_dev_t *dev, unsigned min_complete);
+
+/*!
+ * \brief This function reads the completions of the operations started.
+ *
+ * The result of each completion is 0 on success, a negative errno otherwise
+ * (e.g. -ENXIO if the node is not reachable, -EIO if the RDMA is discarded).
+ *
+ * \param dev           The axiom device private data pointer
+ * \param cqes          Array filled with the completions
+ * \param count         Max number of completions to read
+ *
+ * \return Returns the number of completions read on success, an error
+ *         otherwise.
+ */
+int
+axiom_ring_complete(axiom_dev_t *dev, axiom_ring_cqe_t *cqes, int count);
+
+/*!
+ * \brief This function bind the current process on a specified port.
+ *        With AXIOM_FLAG_REUSEPORT set, up to 8 processes can bind the same
+ *        port (all with the flag) and the driver spreads the messages among
+ *        them: round robin, or by source node if the first process of the
+ *        group set also AXIOM_FLAG_REUSEPORT_HASH. The messages not yet
+ *        received by a process that leaves the group (unbind or close),
+ *        and those in flight towards it, are dropped.
  *
  * \param dev           The axiom device private data pointer
  * \param port          Port number (specify AXIOM_PORT_ANY to bind a random
@@ -107,9 +319,33 @@ axiom_get_fds(axiom_dev_t *dev, int *raw_fd, int *long_fd, int *rdma_fd);
 axiom_err_t
 axiom_bind(axiom_dev_t *dev, axiom_port_t port);
 
+/*!
+ * \brief This function binds the current process on a specified sub-port.
+ *        The sub-ports are software ports carried by the HW port
+ *        AXIOM_PORT_SUB and demultiplexed by the driver, so more than
+ *        AXIOM_PORT_NUM processes can receive on the same node. The
+ *        messages are exchanged with axiom_send_ex() and axiom_recv_ex().
+ *
+ * \param dev           The axiom device private data pointer
+ * \param subport       Sub-port number (specify AXIOM_SUBPORT_ANY to bind a
+ *                      random sub-port available)
+ *
+ * \return Returns the sub-port bound on success, an error (< 0) otherwise.
+ *         On error the previous bind is released and the device is left
+ *         unbound.
+ */
+axiom_err_t
+axiom_bind_ex(axiom_dev_t *dev, axiom_subport_t subport);
+
 /*!
  * \brief  This function return the interface to reach a specified node
  *
+ * The routing table is cached in the device and reloaded when the driver
+ * reports (through a page mapped at open) that it changed, also if it was
+ * changed by another process with axiom_set_routing(). With an older driver
+ * without that page, the cache is reloaded only when the node is not
+ * reachable, so a changed route of a reachable node is not seen.
+ *
  * \param dev           The axiom device private data pointer
  * \param dst_id        Node id of target node
  * \param if_number     Interface id to reache a node
@@ -191,6 +427,40 @@ axiom_recv_iov(axiom_dev_t *dev, axiom_node_id_t *src_id, axiom_port_t *port,
         axiom_type_t *type, size_t *payload_size, struct iovec *iov,
         int iovcnt);
 
+/*!
+ * \brief  This function sends data to a sub-port of a remote node.
+ *         The sub-port tag (axiom_subport_hdr_t) is sent before the payload,
+ *         so a RAW message is used if the payload_size fits the RAW payload
+ *         with the tag, otherwise a LONG message is used.
+ *
+ * \param dev           The axiom device private data pointer
+ * \param dst_id        The remote node id that will receive the data
+ * \param dst_subport   sub-port of the remote node
+ * \param payload_size  size of data to be sent
+ * \param payload       data to be sent
+ *
+ * \return Returns a unique positive message id on success, an error otherwise.
+ */
+axiom_err_t
+axiom_send_ex(axiom_dev_t *dev, axiom_node_id_t dst_id,
+        axiom_subport_t dst_subport, size_t payload_size, void *payload);
+
+/*!
+ * \brief This function receives data on the sub-port bound with
+ *        axiom_bind_ex().
+ *
+ * \param dev           The axiom device private data pointer
+ * \param src_id        The source node id that sent the data
+ * \param src_subport   sub-port of the source node
+ * \param payload_size  size of data received (in: size of the buffer)
+ * \param payload       data received
+ *
+ * \return Returns a unique positive message id on success, an error otherwise.
+ */
+axiom_err_t
+axiom_recv_ex(axiom_dev_t *dev, axiom_node_id_t *src_id,
+        axiom_subport_t *src_subport, size_t *payload_size, void *payload);
+
 /*!
  * \brief  This function sends raw data to a remote node.
  *
@@ -294,7 +564,6 @@ axiom_flush_raw(axiom_dev_t *dev);
  * \param dev           The axiom device private data pointer
  *
  * \return Returns the number of raw messages to receive available.
- * XXX: for now return 0 when there are not slot available, 1 otherwise. (TBC)
  */
 int
 axiom_recv_raw_avail(axiom_dev_t *dev);
@@ -394,7 +663,6 @@ axiom_flush_long(axiom_dev_t *dev);
  * \param dev           The axiom device private data pointer
  *
  * \return Returns the number of long messages to receive available.
- * XXX: for now return 0 when there are not slot available, 1 otherwise. (TBC)
  */
 int
 axiom_recv_long_avail(axiom_dev_t *dev);
@@ -511,6 +779,97 @@ axiom_rdma_check(axiom_dev_t *dev, axiom_token_t *tokens, int tokencnt);
 axiom_err_t
 axiom_rdma_wait(axiom_dev_t *dev, axiom_token_t *tokens, int tokencnt);
 
+/*!
+ * \brief This function registers a memory region inside the RDMA zone.
+ *
+ * The region is validated and translated by the driver only once. The RDMA
+ * functions that use buffers inside registered regions (source and
+ * destination) send to the driver the region and the offset, avoiding the
+ * translation of the virtual addresses at each request.
+ * The regions are cached by address range: registering again the same range
+ * returns the same region.
+ *
+ * \param dev             The axiom device private data pointer
+ * \param addr            start address of the region inside the RDMA zone
+ * \param size            size of the region
+ *
+ * \return Returns the memory region on success, NULL otherwise.
+ */
+axiom_mr_t *
+axiom_mr_register(axiom_dev_t *dev, void *addr, size_t size);
+
+/*!
+ * \brief This function deregisters a memory region. The region is released
+ *        when it is deregistered as many times as it was registered.
+ *
+ * \param dev             The axiom device private data pointer
+ * \param mr              memory region returned by axiom_mr_register()
+ *
+ * \return Returns AXIOM_RET_OK on success, an error otherwise.
+ */
+axiom_err_t
+axiom_mr_deregister(axiom_dev_t *dev, axiom_mr_t *mr);
+
+/*!
+ * \brief This function writes data to a remote node memory, using offsets
+ *        inside registered memory regions.
+ *        It is an asynchronous operations. The token can be used to check or
+ *        wait the completion of the operation.
+ *
+ * There are no remote keys: remote_mr is a region registered on the local
+ * node, translated in a RDMA zone offset with the local MR table. The remote
+ * buffer must be at the same offset of the RDMA zone of the remote node, i.e.
+ * both processes must map the RDMA zone with axiom_rdma_mmap() and use the
+ * same virtual address for the buffer.
+ *
+ * \param dev             The axiom device private data pointer
+ * \param remote_id       The remote node id where data will be stored
+ * \param payload_size    size of data to be transfer (must be multiple of 8)
+ * \param local_mr        region where data will be read
+ * \param local_offset    offset inside local_mr
+ * \param remote_mr       local region that maps the remote buffer where data
+ *                        will be stored
+ * \param remote_offset   offset inside remote_mr
+ * \param token           token that can be used to check the status of the RDMA
+ *                        (it can be NULL)
+ *
+ * \return Returns a unique positive message id on success, an error otherwise.
+ */
+axiom_err_t
+axiom_rdma_write_mr(axiom_dev_t *dev, axiom_node_id_t remote_id,
+        size_t payload_size, axiom_mr_t *local_mr, size_t local_offset,
+        axiom_mr_t *remote_mr, size_t remote_offset, axiom_token_t *token);
+
+/*!
+ * \brief This function reads data from a remote node memory, using offsets
+ *        inside registered memory regions.
+ *        It is an asynchronous operations. The token can be used to check or
+ *        wait the completion of the operation.
+ *
+ * There are no remote keys: remote_mr is a region registered on the local
+ * node, translated in a RDMA zone offset with the local MR table. The remote
+ * buffer must be at the same offset of the RDMA zone of the remote node, i.e.
+ * both processes must map the RDMA zone with axiom_rdma_mmap() and use the
+ * same virtual address for the buffer.
+ *
+ * \param dev             The axiom device private data pointer
+ * \param remote_id       The remote node id where data will be read
+ * \param payload_size    size of data to be transfer (must be multiple of 8)
+ * \param remote_mr       local region that maps the remote buffer where data
+ *                        will be read
+ * \param remote_offset   offset inside remote_mr
+ * \param local_mr        region where data will be stored
+ * \param local_offset    offset inside local_mr
+ * \param token           token that can be used to check the status of the RDMA
+ *                        (it can be NULL)
+ *
+ * \return Returns a unique positive message id on success, an error otherwise.
+ */
+axiom_err_t
+axiom_rdma_read_mr(axiom_dev_t *dev, axiom_node_id_t remote_id,
+        size_t payload_size, axiom_mr_t *remote_mr, size_t remote_offset,
+        axiom_mr_t *local_mr, size_t local_offset, axiom_token_t *token);
+
 /*!
  * \brief This function map in the userspace process the RDMA zone
  *
@@ -640,6 +999,24 @@ axiom_err_t
 axiom_get_routing(axiom_dev_t *dev, axiom_node_id_t node_id,
         uint8_t *enabled_mask);
 
+/*!
+ * \brief This function gets the whole local routing table with one request
+ *        to the driver. The table is also cached in the device, so
+ *        axiom_next_hop() and axiom_get_num_nodes() don't query the driver
+ *        for each node.
+ *
+ * \param dev           The axiom device private data pointer
+ * \param enabled_mask  bit mask interface of each node (AXIOM_NODES_NUM
+ *                      elements, see axiom_get_routing())
+ * \param generation    generation of the table, changed by each update of
+ *                      the routing table (can be NULL)
+ *
+ * \return Returns AXIOM_RET_OK on success, an error otherwise.
+ */
+axiom_err_t
+axiom_get_routing_table(axiom_dev_t *dev, uint8_t *enabled_mask,
+        uint32_t *generation);
+
 /*!
  * \brief This function returns the number of nodes in the network, including
  *        the local node.
@@ -682,6 +1059,24 @@ axiom_get_statistics(axiom_dev_t *dev, axiom_stats_t *stats);
 axiom_err_t
 axiom_debug_info(axiom_dev_t *dev, uint32_t flags);
 
+/*!
+ * \brief This function dumps the events recorded by the tracing backend into
+ *        a binary trace file (see axiom_nic_trace.h).
+ *
+ * The events are recorded only by the tracing library
+ * (libaxiom_user_api_trace.so) and they are also dumped automatically at the
+ * exit of the process. The file can be converted in the Chrome trace JSON
+ * format using the axiom_trace2json tool.
+ *
+ * \param filename      Name of the trace file. If it is NULL, the name is
+ *                      taken from the AXIOM_TRACE_FILE environment variable
+ *                      or the default "axiom_trace.<pid>.bin" is used.
+ *
+ * \return Returns AXIOM_RET_OK on success, an error otherwise.
+ */
+axiom_err_t
+axiom_trace_dump(const char *filename);
+
 /** \} */
 
 #endif /* !AXIOM_NIC_API_USER_h */
@@ -27,10 +27,16 @@
 /*! \brief Maximum number of interfaces supported by the AXIOM NIC */
 #define AXIOM_INTERFACES_NUM                    (AXIOM_INTERFACES_MAX + 1)
 /*! \brief Max value of port available in RAW messages.
- *         Note: port 7 is reserved for XSMLL messages */
+ *         Note: port 7 is reserved for XSMLL and sub-port messages */
 #define AXIOM_PORT_MAX                          6
 /*! \brief Max number of port available in RAW messages. */
 #define AXIOM_PORT_NUM                          (AXIOM_PORT_MAX + 1)
+/*! \brief HW port of the messages addressed to a sub-port */
+#define AXIOM_PORT_SUB                          (AXIOM_PORT_MAX + 1)
+/*! \brief Max value of sub-port (software ports demultiplexed by the driver) */
+#define AXIOM_SUBPORT_MAX                       255
+/*! \brief Max number of sub-port */
+#define AXIOM_SUBPORT_NUM                       (AXIOM_SUBPORT_MAX + 1)
 /*! \brief Max value of type available */
 #define AXIOM_TYPE_MAX                          7
 /*! \brief Max number of type available */
@@ -110,6 +110,14 @@ typedef struct axiom_raw_msg {
     axiom_raw_payload_t payload;        /*!< \brief message payload */
 } __attribute__((packed)) axiom_raw_msg_t;
 
+/*!
+ * \brief Sub-port tag at the start of the payload of the messages sent to
+ *        AXIOM_PORT_SUB (RAW and LONG)
+ */
+typedef struct axiom_subport_hdr {
+    uint16_t dst;               /*!< \brief destination sub-port */
+    uint16_t src;               /*!< \brief source sub-port */
+} __attribute__((packed)) axiom_subport_hdr_t;
 
 /************************* RDMA Packets structure *****************************/
 
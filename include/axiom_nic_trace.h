@@ -0,0 +1,130 @@
+/*!
+ * \file axiom_nic_trace.h
+ *
+ * \version     v1.2
+ * \date        2016-11-14
+ *
+ * This file contains the AXIOM NIC user API tracing definitions:
+ *      - traced API functions
+ *      - binary trace file format
+ *
+ * Copyright (C) 2016, Evidence Srl.
+ * Terms of use are as specified in COPYING
+ */
+#ifndef AXIOM_NIC_TRACE_h
+#define AXIOM_NIC_TRACE_h
+
+/**
+ * \defgroup AXIOM_NIC
+ *
+ * \{
+ */
+
+#include <stdint.h>
+
+/*! \brief Environment variable with the trace file name */
+#define AXIOM_ENV_TRACE_FILE            "AXIOM_TRACE_FILE"
+/*! \brief Environment variable with the number of events per thread */
+#define AXIOM_ENV_TRACE_EVENTS          "AXIOM_TRACE_EVENTS"
+
+/*! \brief Default trace file name (the pid is appended) */
+#define AXIOM_TRACE_FILE_DEFAULT        "axiom_trace"
+/*! \brief Default number of events in the ring buffer of each thread */
+#define AXIOM_TRACE_EVENTS_DEFAULT      65536
+
+/*! \brief Trace file magic number ("AXTR") */
+#define AXIOM_TRACE_MAGIC               0x52545841
+/*! \brief Trace file version */
+#define AXIOM_TRACE_VERSION             1
+
+/*! \brief Traced API functions (0 is reserved to the END event) */
+typedef enum {
+    AXIOM_TRACE_OP_END,
+    AXIOM_TRACE_OP_OPEN,
+    AXIOM_TRACE_OP_CLOSE,
+    AXIOM_TRACE_OP_SEND,
+    AXIOM_TRACE_OP_SEND_IOV,
+    AXIOM_TRACE_OP_RECV,
+    AXIOM_TRACE_OP_RECV_IOV,
+    AXIOM_TRACE_OP_SEND_RAW,
+    AXIOM_TRACE_OP_SEND_IOV_RAW,
+    AXIOM_TRACE_OP_RECV_RAW,
+    AXIOM_TRACE_OP_RECV_IOV_RAW,
+    AXIOM_TRACE_OP_SEND_RAW_AVAIL,
+    AXIOM_TRACE_OP_RECV_RAW_AVAIL,
+    AXIOM_TRACE_OP_SEND_LONG,
+    AXIOM_TRACE_OP_SEND_IOV_LONG,
+    AXIOM_TRACE_OP_RECV_LONG,
+    AXIOM_TRACE_OP_RECV_IOV_LONG,
+    AXIOM_TRACE_OP_SEND_LONG_AVAIL,
+    AXIOM_TRACE_OP_RECV_LONG_AVAIL,
+    AXIOM_TRACE_OP_RDMA_READ,
+    AXIOM_TRACE_OP_RDMA_WRITE,
+    AXIOM_TRACE_OP_RDMA_CHECK,
+    AXIOM_TRACE_OP_RDMA_WAIT,
+    AXIOM_TRACE_OP_LAST
+} axiom_trace_op_t;
+
+/*! \brief Name of the traced API functions (indexed by op - 1) */
+static const char * const axiom_trace_op_desc[AXIOM_TRACE_OP_LAST - 1] = {
+    "axiom_open()",
+    "axiom_close()",
+    "axiom_send()",
+    "axiom_send_iov()",
+    "axiom_recv()",
+    "axiom_recv_iov()",
+    "axiom_send_raw()",
+    "axiom_send_iov_raw()",
+    "axiom_recv_raw()",
+    "axiom_recv_iov_raw()",
+    "axiom_send_raw_avail()",
+    "axiom_recv_raw_avail()",
+    "axiom_send_long()",
+    "axiom_send_iov_long()",
+    "axiom_recv_long()",
+    "axiom_recv_iov_long()",
+    "axiom_send_long_avail()",
+    "axiom_recv_long_avail()",
+    "axiom_rdma_read()",
+    "axiom_rdma_write()",
+    "axiom_rdma_check()",
+    "axiom_rdma_wait()",
+};
+
+/*!
+ * \brief Event recorded for each traced API call
+ */
+typedef struct axiom_trace_event {
+    uint64_t start;             /*!< \brief start time (ns, CLOCK_MONOTONIC) */
+    uint32_t duration;          /*!< \brief duration of the call (ns,
+                                             saturated at UINT32_MAX) */
+    uint16_t op;                /*!< \brief traced function (axiom_trace_op_t) */
+    uint16_t node;              /*!< \brief destination/source node id */
+    uint32_t size;              /*!< \brief payload size (bytes) */
+    int32_t ret;                /*!< \brief return value of the call */
+} axiom_trace_event_t;
+
+/*!
+ * \brief Header at the beginning of the trace file
+ */
+typedef struct axiom_trace_file_hdr {
+    uint32_t magic;             /*!< \brief AXIOM_TRACE_MAGIC */
+    uint16_t version;           /*!< \brief AXIOM_TRACE_VERSION */
+    uint16_t event_size;        /*!< \brief sizeof(axiom_trace_event_t) */
+    uint32_t pid;               /*!< \brief pid of the traced process */
+    uint32_t threads;           /*!< \brief number of thread blocks */
+} axiom_trace_file_hdr_t;
+
+/*!
+ * \brief Header of each thread block in the trace file, followed by 'events'
+ *        axiom_trace_event_t
+ */
+typedef struct axiom_trace_thread_hdr {
+    uint32_t tid;               /*!< \brief thread id */
+    uint32_t events;            /*!< \brief number of events in the block */
+    uint64_t lost;              /*!< \brief events overwritten in the ring */
+} axiom_trace_thread_hdr_t;
+
+/** \} */
+
+#endif /* !AXIOM_NIC_TRACE_h */
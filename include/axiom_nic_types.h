@@ -12,6 +12,8 @@
 #ifndef AXIOM_NIC_TYPES_h
 #define AXIOM_NIC_TYPES_h
 
+#include "axiom_nic_limits.h"
+
 /**
  * \defgroup AXIOM_NIC
  *
@@ -21,6 +23,8 @@
 /********************************* Types **************************************/
 /*! \brief AXIOM port of messages */
 typedef uint8_t	            axiom_port_t;
+/*! \brief AXIOM sub-port of messages (software port on AXIOM_PORT_SUB) */
+typedef uint16_t            axiom_subport_t;
 /*! \brief AXIOM type of messages */
 typedef uint8_t	            axiom_type_t;
 /*! \brief AXIOM queue length type */
@@ -53,6 +57,10 @@ typedef uint64_t            axiom_flags_t;
 typedef union axiom_token   axiom_token_t;
 /*! \brief AXIOM statistics */
 typedef struct axiom_stats  axiom_stats_t;
+/*! \brief AXIOM memory region registered for the RDMA */
+typedef struct axiom_mr     axiom_mr_t;
+/*! \brief AXIOM completion ring entry */
+typedef struct axiom_ring_cqe axiom_ring_cqe_t;
 
 /*! \brief Invalid node ID */
 #define AXIOM_NULL_NODE                 255
@@ -60,6 +68,8 @@ typedef struct axiom_stats  axiom_stats_t;
 #define AXIOM_NULL_APP_ID               255
 /*! \brief Ask any port number during the bind */
 #define AXIOM_PORT_ANY                  255
+/*! \brief Ask any sub-port number during the bind */
+#define AXIOM_SUBPORT_ANY               0xFFFF
 
 /****************************** Return Values *********************************/
 /*! \brief Return value OK */
@@ -90,6 +100,23 @@ typedef struct axiom_stats  axiom_stats_t;
 #define AXIOM_FLAG_NOBLOCK              0x00000007
 /*! \brief Avoid flush of RX port queue after the axiom_bind() API */
 #define AXIOM_FLAG_NOFLUSH              0x00000008
+/*! \brief axiom_bind() joins the group of processes that bound the port with
+ *         this flag: the messages are delivered round robin among them */
+#define AXIOM_FLAG_REUSEPORT            0x00000010
+/*! \brief With AXIOM_FLAG_REUSEPORT, the messages of a source node are always
+ *         delivered to the same process of the group */
+#define AXIOM_FLAG_REUSEPORT_HASH       0x00000020
+
+
+/******************************* Axiom events *********************************/
+/*! \brief RAW messages available on the bound port */
+#define AXIOM_EVENT_RAW                 0x00000001
+/*! \brief LONG messages available on the bound port */
+#define AXIOM_EVENT_LONG                0x00000002
+/*! \brief Asynchronous RDMA completed */
+#define AXIOM_EVENT_RDMA                0x00000004
+/*! \brief Completions available in the submission ring */
+#define AXIOM_EVENT_CQ                  0x00000008
 
 
 /**************************** Axiom debug flags *******************************/
@@ -175,6 +202,48 @@ struct axiom_stats {
     uint64_t retries_rdma;
     /*! \brief Number of RDMA/LONG packets discarded */
     uint64_t discarded_rdma;
+
+    /*
+     * AXNET_GET_STATS encodes sizeof(axiom_stats_t): a binary built with a
+     * different layout gets ENOTTY, so it must be rebuilt with the driver.
+     */
+
+    /*! \brief Number of blocked syscall woken up without anything to do */
+    uint64_t spurious_raw_tx;
+    uint64_t spurious_raw_rx;
+    uint64_t spurious_long_tx;
+    uint64_t spurious_long_rx;
+    uint64_t spurious_rdma_tx;
+    uint64_t spurious_rdma_rx;
+
+    /*! \brief Number of receive satisfied by busy polling (no sleep) */
+    uint64_t busy_poll_raw_rx;
+    uint64_t busy_poll_long_rx;
+
+    /*! \brief Number of RAW receive served reading the HW FIFO inline */
+    uint64_t inline_raw_rx;
+
+    /*! \brief Number of requests consumed from the submission rings */
+    uint64_t ring_sqe;
+    /*! \brief Number of AXNET_RING_ENTER calls */
+    uint64_t ring_enter;
+
+    /*! \brief Messages queued on each port when the statistics are read */
+    uint64_t queue_raw_rx[AXIOM_PORT_NUM];
+    uint64_t queue_long_rx[AXIOM_PORT_NUM];
+    /*! \brief Max messages queued on each port (high-water mark) */
+    uint64_t hwm_raw_rx[AXIOM_PORT_NUM];
+    uint64_t hwm_long_rx[AXIOM_PORT_NUM];
+    /*! \brief Free slots of the RX queues when the statistics are read */
+    uint64_t free_raw_rx;
+    uint64_t free_long_rx;
+};
+
+/*! \brief AXIOM completion ring entry definition */
+struct axiom_ring_cqe {
+    uint64_t user_data;         /*!< \brief user_data of the request */
+    int32_t result;             /*!< \brief 0 on success, -errno otherwise */
+    uint32_t flags;             /*!< \brief reserved */
 };
 
 /*! \brief AXIOM token definition */
@@ -183,7 +252,8 @@ union axiom_token {
     struct {
         uint64_t msg_id : 8;    /*!< \brief message ID */
         uint64_t status : 8;    /*!< \brief token status */
-        uint64_t padding : 16;
+        uint64_t counted : 1;   /*!< \brief completion counted for poll */
+        uint64_t padding : 15;
         uint64_t value : 32;    /*!< \brief token value */
     } rdma;
 };
@@ -6,6 +6,12 @@
  *
  * This file contains the EVI alloc manager.
  *
+ * The free elements are tracked by a segment tree: each node stores the
+ * longest run of free elements in its range and the free runs at its edges,
+ * so the first fit of a contiguous range is found in O(log n). The elements
+ * allocated by each owner are kept in a list of extents, so the release of an
+ * owner costs O(extents * log n).
+ *
  * Copyright (C) 2016, Evidence Srl.
  * Terms of use are as specified in COPYING
  */
@@ -27,11 +33,26 @@
 /*! \brief Element used in the EVI alloc manager */
 typedef uint8_t evia_elem_t;
 
+/*! \brief Number of owners (values of evia_elem_t) */
+#define EVIA_OWNERS     (1 << (8 * sizeof(evia_elem_t)))
+
+/*! \brief Node of the segment tree */
+typedef struct evia_node {
+    int max;                    /*!< \brief longest free run in the range */
+    int pre;                    /*!< \brief free run at the range start */
+    int suf;                    /*!< \brief free run at the range end */
+} evia_node_t;
+
 /*! \brief EVI alloc status */
 typedef struct evi_alloc {
     int elems;                  /*!< number of total elements */
     int free;                   /*!< number of free elements */
-    evia_elem_t *array;         /*!< \brief array of elements */
+    int size;                   /*!< \brief leaves of the tree (power of 2) */
+    evia_node_t *tree;          /*!< \brief segment tree (root in tree[1]) */
+    int *ext_len;               /*!< \brief length of the extent that starts
+                                            in each element */
+    int *ext_next;              /*!< \brief next extent of the same owner */
+    int owner_head[EVIA_OWNERS];/*!< \brief first extent of each owner */
 } evi_alloc_t;
 
 //#define EVIA_DEBUG
@@ -39,24 +60,116 @@ typedef struct evi_alloc {
 static void
 evia_dump(evi_alloc_t *ea)
 {
-    int i;
-
-    EVIA_PRINTF("evi_alloc: free %d - total %d", ea->free, ea->elems);
+    int i, start;
 
-    for (i = 0; i < ea->elems; i++) {
-        if (!(i % 10))
-            EVIA_PRINTF("\n %04d:  ", i);
+    EVIA_PRINTF("evi_alloc: free %d - total %d - max run %d\n", ea->free,
+            ea->elems, ea->tree[1].max);
 
-        EVIA_PRINTF(1, "0x%02x ", ea->array[i]);
+    for (i = 0; i < EVIA_OWNERS; i++) {
+        for (start = ea->owner_head[i]; start != -1;
+                start = ea->ext_next[start]) {
+            EVIA_PRINTF(" 0x%02x: [%d - %d]\n", i, start,
+                    start + ea->ext_len[start] - 1);
+        }
     }
-
-    EVIA_PRINTF(1, "\n");
 }
 #define EVIA_DUMP(_1)   evia_dump(_1)
 #else /* !EVIA_DEBUG */
 #define EVIA_DUMP(_1)
 #endif /* EVIA_DEBUG */
 
+inline static void
+evia_node_set(evi_alloc_t *ea, int node, int len, int free)
+{
+    int run = free ? len : 0;
+
+    ea->tree[node].max = run;
+    ea->tree[node].pre = run;
+    ea->tree[node].suf = run;
+}
+
+/* update a node from its children */
+inline static void
+evia_node_pull(evi_alloc_t *ea, int node, int len)
+{
+    evia_node_t *l = &ea->tree[2 * node], *r = &ea->tree[2 * node + 1];
+    evia_node_t *n = &ea->tree[node];
+    int half = len / 2;
+
+    n->max = l->suf + r->pre;
+    if (l->max > n->max)
+        n->max = l->max;
+    if (r->max > n->max)
+        n->max = r->max;
+    n->pre = (l->pre == half) ? half + r->pre : l->pre;
+    n->suf = (r->suf == half) ? half + l->suf : r->suf;
+}
+
+/*
+ * A node updated as a whole is all free or all used, while its children may
+ * still hold the previous state: propagate it before visiting them.
+ */
+inline static void
+evia_node_push(evi_alloc_t *ea, int node, int len)
+{
+    if (ea->tree[node].max == len) {
+        evia_node_set(ea, 2 * node, len / 2, 1);
+        evia_node_set(ea, 2 * node + 1, len / 2, 1);
+    } else if (ea->tree[node].max == 0) {
+        evia_node_set(ea, 2 * node, len / 2, 0);
+        evia_node_set(ea, 2 * node + 1, len / 2, 0);
+    }
+}
+
+/* mark [start, end) free or used */
+static void
+evia_update(evi_alloc_t *ea, int node, int node_start, int len, int start,
+        int end, int free)
+{
+    int half = len / 2;
+
+    if (end <= node_start || start >= node_start + len)
+        return;
+
+    if (start <= node_start && node_start + len <= end) {
+        evia_node_set(ea, node, len, free);
+        return;
+    }
+
+    evia_node_push(ea, node, len);
+    evia_update(ea, 2 * node, node_start, half, start, end, free);
+    evia_update(ea, 2 * node + 1, node_start + half, half, start, end, free);
+    evia_node_pull(ea, node, len);
+}
+
+/* returns the first element of the first free run of num elements, or -1 */
+static int
+evia_find(evi_alloc_t *ea, int num)
+{
+    int node = 1, node_start = 0, len = ea->size, half;
+
+    if (ea->tree[1].max < num)
+        return -1;
+
+    while (len > 1) {
+        evia_node_push(ea, node, len);
+        half = len / 2;
+
+        if (ea->tree[2 * node].max >= num) {
+            node = 2 * node;
+        } else if (ea->tree[2 * node].suf + ea->tree[2 * node + 1].pre >=
+                num) {
+            return node_start + half - ea->tree[2 * node].suf;
+        } else {
+            node = 2 * node + 1;
+            node_start += half;
+        }
+        len = half;
+    }
+
+    return node_start;
+}
+
 /*!
  * \brief Release the resorces for the EVI alloc status
  *
@@ -65,10 +178,16 @@ evia_dump(evi_alloc_t *ea)
 static void
 evia_release(evi_alloc_t *ea)
 {
-    if (ea->array)
-        EVIA_FREE(ea->array);
-
-    ea->array = NULL;
+    if (ea->tree)
+        EVIA_FREE(ea->tree);
+    if (ea->ext_len)
+        EVIA_FREE(ea->ext_len);
+    if (ea->ext_next)
+        EVIA_FREE(ea->ext_next);
+
+    ea->tree = NULL;
+    ea->ext_len = NULL;
+    ea->ext_next = NULL;
 }
 
 /*!
@@ -82,18 +201,41 @@ evia_release(evi_alloc_t *ea)
 static int
 evia_init(evi_alloc_t *ea, int elems)
 {
-    int i;
+    int i, first, len;
+
+    ea->tree = NULL;
+    ea->ext_len = NULL;
+    ea->ext_next = NULL;
 
-    ea->array = EVIA_MALLOC(elems * sizeof(*(ea->array)));
-    if (ea->array == NULL)
+    if (elems < 0)
+        goto err;
+
+    for (ea->size = 1; ea->size < elems; ea->size <<= 1)
+        ;
+
+    ea->tree = EVIA_MALLOC(2 * ea->size * sizeof(*(ea->tree)));
+    ea->ext_len = EVIA_MALLOC(ea->size * sizeof(*(ea->ext_len)));
+    ea->ext_next = EVIA_MALLOC(ea->size * sizeof(*(ea->ext_next)));
+    if (ea->tree == NULL || ea->ext_len == NULL || ea->ext_next == NULL)
         goto err;
 
     ea->elems = elems;
     ea->free = elems;
 
-    //memset(ea->array, EVIA_NONE, elems * sizeof(*(ea->array)));
-    for (i = 0; i < ea->elems; i++) {
-        ea->array[i] = EVIA_NONE;
+    for (i = 0; i < EVIA_OWNERS; i++) {
+        ea->owner_head[i] = -1;
+    }
+
+    /* the leaves over elems are never free */
+    for (i = 0; i < ea->size; i++) {
+        evia_node_set(ea, ea->size + i, 1, i < elems);
+    }
+
+    /* build the tree bottom-up, one level at a time */
+    for (first = ea->size / 2, len = 2; first > 0; first /= 2, len *= 2) {
+        for (i = first; i < 2 * first; i++) {
+            evia_node_pull(ea, i, len);
+        }
     }
 
     EVIA_DUMP(ea);
@@ -105,58 +247,70 @@ err:
     return -1;
 }
 
+/*!
+ * \brief Allocate the first range of contiguous free elements
+ *
+ * \param ea            EVI alloc status pointer
+ * \param value         Owner of the elements (!= EVIA_NONE)
+ * \param num           Number of elements to allocate
+ *
+ * \return the first element allocated on success, otherwise -1
+ */
 static int
 evia_alloc(evi_alloc_t *ea, evia_elem_t value, int num)
 {
-    int i, count = 0, start;
+    int start;
 
     EVIA_DUMP(ea);
 
-    if (num > ea->free) {
-        DPRINTF("num %d free %d", num, ea->free);
+    if (num > ea->free || num < 0 || value == EVIA_NONE) {
+        DPRINTF("num %d free %d value %d", num, ea->free, value);
         return -1;
     }
 
-    for (i = 0; (count < num) && (i < ea->elems); i++) {
-        if (ea->array[i] == EVIA_NONE) {
-            count++;
-        } else {
-            count = 0;
-        }
-    }
+    if (num == 0)
+        return 0;
 
-    if (count != num) {
-        DPRINTF("num %d count %d", num, count);
+    start = evia_find(ea, num);
+    if (start < 0) {
+        DPRINTF("num %d max run %d", num, ea->tree[1].max);
         return -1;
     }
 
-    start = i - count;
+    evia_update(ea, 1, 0, ea->size, start, start + num, 0);
 
-    for (i = start; i < start + count; i++) {
-        ea->array[i] = value;
-    }
+    ea->ext_len[start] = num;
+    ea->ext_next[start] = ea->owner_head[value];
+    ea->owner_head[value] = start;
 
-    ea->free -= count;
+    ea->free -= num;
 
     EVIA_DUMP(ea);
 
     return start;
 }
 
+/*!
+ * \brief Release all the elements allocated by an owner
+ *
+ * \param ea            EVI alloc status pointer
+ * \param value         Owner of the elements
+ */
 static void
 evia_free(evi_alloc_t *ea, evia_elem_t value)
 {
-    int i;
+    int start;
 
     EVIA_DUMP(ea);
 
-    for (i = 0; i < ea->elems; i++) {
-        if (ea->array[i] == value) {
-            ea->array[i] = EVIA_NONE;
-            ea->free++;
-        }
+    for (start = ea->owner_head[value]; start != -1;
+            start = ea->ext_next[start]) {
+        evia_update(ea, 1, 0, ea->size, start, start + ea->ext_len[start], 1);
+        ea->free += ea->ext_len[start];
     }
 
+    ea->owner_head[value] = -1;
+
     EVIA_DUMP(ea);
 }
 
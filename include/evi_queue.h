@@ -28,16 +28,33 @@
 /*! \brief Pointer used in the EVI queue manager */
 typedef int16_t eviq_pnt_t;
 
+#ifdef __KERNEL__
+#define EVIQ_CACHE_ALIGNED      ____cacheline_aligned
+#else /* !__KERNEL__ */
+#define EVIQ_CACHE_ALIGNED      __attribute__((aligned(64)))
+#endif /* __KERNEL__ */
+
+/*!
+ * \brief EVI queue list
+ *
+ * Head, tail and counter of a queue are in the same cache line, and each queue
+ * has its own cache line.
+ */
+typedef struct eviq_list {
+    eviq_pnt_t head;    /*!< \brief first element of the queue */
+    eviq_pnt_t tail;    /*!< \brief last element of the queue */
+    int count;          /*!< \brief number of elements in the queue */
+    int hwm;            /*!< \brief max number of elements reached */
+} EVIQ_CACHE_ALIGNED eviq_list_t;
+
 /*! \brief EVI queue status */
 typedef struct evi_queue {
+    eviq_list_t free;   /*!< \brief queue of free elems (LIFO, no tail) */
+
     int queues;         /*!< number of queue handled */
     int free_elems;     /*!< number of initial free elements */
 
-    eviq_pnt_t *head;   /*!< \brief array of the queue head */
-    eviq_pnt_t *tail;   /*!< \brief array of the queue tail */
-
-    eviq_pnt_t free;    /*!< \brief queue of free elems */
-
+    eviq_list_t *lists; /*!< \brief array of the queues */
     eviq_pnt_t *next;   /*!< \brief array for all elements to chain them */
 } evi_queue_t;
 
@@ -51,12 +68,11 @@ eviq_release(evi_queue_t *q)
 {
     if (q->next)
         EVI_FREE(q->next);
-    if (q->tail)
-        EVI_FREE(q->tail);
-    if (q->head)
-        EVI_FREE(q->head);
+    if (q->lists)
+        EVI_FREE(q->lists);
 
-    q->head = q->tail = q->next = NULL;
+    q->lists = NULL;
+    q->next = NULL;
 }
 
 /*!
@@ -73,22 +89,21 @@ eviq_init(evi_queue_t *q, int queues, int free_elems)
 {
     int i;
 
-    q->head = q->tail = q->next = NULL;
+    q->lists = NULL;
+    q->next = NULL;
     q->queues = queues;
     q->free_elems = free_elems;
 
     if (queues > 0) {
-        q->head = EVI_MALLOC(queues * sizeof(*(q->head)));
-        if (q->head == NULL)
-            goto err;
-
-        q->tail = EVI_MALLOC(queues* sizeof(*(q->tail)));
-        if (q->tail == NULL)
+        q->lists = EVI_MALLOC(queues * sizeof(*(q->lists)));
+        if (q->lists == NULL)
             goto err;
 
         for (i = 0; i < queues; i++) {
-            q->head[i] = EVIQ_NONE;
-            q->tail[i] = EVIQ_NONE;
+            q->lists[i].head = EVIQ_NONE;
+            q->lists[i].tail = EVIQ_NONE;
+            q->lists[i].count = 0;
+            q->lists[i].hwm = 0;
         }
     }
 
@@ -96,7 +111,10 @@ eviq_init(evi_queue_t *q, int queues, int free_elems)
     if (q->next == NULL)
         goto err;
 
-    q->free = 0;
+    q->free.head = 0;
+    q->free.tail = EVIQ_NONE;
+    q->free.count = free_elems;
+    q->free.hwm = free_elems;
 
     for (i = 0; i < (free_elems - 1); i++) {
         q->next[i] = i + 1;
@@ -120,7 +138,20 @@ err:
 inline static int
 eviq_free_avail(evi_queue_t *q)
 {
-    return (q->free != EVIQ_NONE);
+    return (q->free.head != EVIQ_NONE);
+}
+
+/*!
+ * \brief Number of elements in the free queue
+ *
+ * \param q             EVI queue status pointer
+ *
+ * \return number of free elements
+ */
+inline static int
+eviq_free_count(evi_queue_t *q)
+{
+    return q->free.count;
 }
 
 /*!
@@ -136,17 +167,44 @@ eviq_free_pop(evi_queue_t *q)
     eviq_pnt_t slot;
 
     /* remove slot at the head of the free queue */
-    slot = q->free;
+    slot = q->free.head;
     /* no slot to remove */
     if (unlikely(slot == EVIQ_NONE)) {
         return EVIQ_NONE;
     }
 
-    q->free = q->next[slot];
+    q->free.head = q->next[slot];
+    q->free.count--;
 
     return slot;
 }
 
+/*!
+ * \brief Pop up to n slots from the free queue
+ *
+ * \param q             EVI queue status pointer
+ * \param slots         Array filled with the slots removed
+ * \param n             Max number of slots to remove
+ *
+ * \return number of slots removed
+ */
+inline static int
+eviq_free_pop_n(evi_queue_t *q, eviq_pnt_t *slots, int n)
+{
+    eviq_pnt_t slot = q->free.head;
+    int i;
+
+    for (i = 0; i < n && slot != EVIQ_NONE; i++) {
+        slots[i] = slot;
+        slot = q->next[slot];
+    }
+
+    q->free.head = slot;
+    q->free.count -= i;
+
+    return i;
+}
+
 /*!
  * \brief Push one slot in the free queue
  *
@@ -157,8 +215,33 @@ inline static void
 eviq_free_push(evi_queue_t *q, eviq_pnt_t slot)
 {
     /* insert slot at the head of the free list */
-    q->next[slot] = q->free;
-    q->free = slot;
+    q->next[slot] = q->free.head;
+    q->free.head = slot;
+    q->free.count++;
+}
+
+/*!
+ * \brief Push n slots in the free queue
+ *
+ * \param q             EVI queue status pointer
+ * \param slots         Slots to enqueue
+ * \param n             Number of slots
+ */
+inline static void
+eviq_free_push_n(evi_queue_t *q, const eviq_pnt_t *slots, int n)
+{
+    int i;
+
+    if (unlikely(n <= 0))
+        return;
+
+    /* chain the slots and insert the chain at the head of the free list */
+    for (i = 0; i < n - 1; i++) {
+        q->next[slots[i]] = slots[i + 1];
+    }
+    q->next[slots[n - 1]] = q->free.head;
+    q->free.head = slots[0];
+    q->free.count += n;
 }
 
 /*!
@@ -175,7 +258,41 @@ eviq_avail(evi_queue_t *q, int queue_id)
     if (unlikely(q->queues == 0))
         return 0;
 
-    return (q->head[queue_id] != EVIQ_NONE);
+    return (q->lists[queue_id].head != EVIQ_NONE);
+}
+
+/*!
+ * \brief Number of elements in the specified queue
+ *
+ * \param q             EVI queue status pointer
+ * \param queue_id      Queue identifier
+ *
+ * \return number of elements in the queue
+ */
+inline static int
+eviq_count(evi_queue_t *q, int queue_id)
+{
+    if (unlikely(q->queues == 0))
+        return 0;
+
+    return q->lists[queue_id].count;
+}
+
+/*!
+ * \brief Max number of elements reached by the specified queue
+ *
+ * \param q             EVI queue status pointer
+ * \param queue_id      Queue identifier
+ *
+ * \return high-water mark of the queue
+ */
+inline static int
+eviq_hwm(evi_queue_t *q, int queue_id)
+{
+    if (unlikely(q->queues == 0))
+        return 0;
+
+    return q->lists[queue_id].hwm;
 }
 
 /*!
@@ -189,23 +306,63 @@ eviq_avail(evi_queue_t *q, int queue_id)
 inline static void
 eviq_enqueue(evi_queue_t *q, int queue_id, eviq_pnt_t slot)
 {
-    eviq_pnt_t old_tail;
+    eviq_list_t *list;
 
     if (unlikely(q->queues == 0))
         return;
 
+    list = &q->lists[queue_id];
+
     /* insert at the tail */
     q->next[slot] = EVIQ_NONE;
-    old_tail = q->tail[queue_id];
 
-    if (old_tail != EVIQ_NONE) {
-        q->next[old_tail] = slot;
+    if (list->tail != EVIQ_NONE) {
+        q->next[list->tail] = slot;
     } else {
         /* if the queue is empty, we need update also the head */
-        q->head[queue_id] = slot;
+        list->head = slot;
     }
 
-    q->tail[queue_id] = slot;
+    list->tail = slot;
+    list->count++;
+    if (list->count > list->hwm)
+        list->hwm = list->count;
+}
+
+/*!
+ * \brief Insert n elements at the tail of the specified queue
+ *
+ * \param q             EVI queue status pointer
+ * \param queue_id      Queue identifier
+ * \param slots         Slots to insert (in order)
+ * \param n             Number of slots
+ */
+inline static void
+eviq_enqueue_n(evi_queue_t *q, int queue_id, const eviq_pnt_t *slots, int n)
+{
+    eviq_list_t *list;
+    int i;
+
+    if (unlikely(q->queues == 0 || n <= 0))
+        return;
+
+    list = &q->lists[queue_id];
+
+    for (i = 0; i < n - 1; i++) {
+        q->next[slots[i]] = slots[i + 1];
+    }
+    q->next[slots[n - 1]] = EVIQ_NONE;
+
+    if (list->tail != EVIQ_NONE) {
+        q->next[list->tail] = slots[0];
+    } else {
+        list->head = slots[0];
+    }
+
+    list->tail = slots[n - 1];
+    list->count += n;
+    if (list->count > list->hwm)
+        list->hwm = list->count;
 }
 
 /*!
@@ -219,30 +376,69 @@ eviq_enqueue(evi_queue_t *q, int queue_id, eviq_pnt_t slot)
 inline static eviq_pnt_t
 eviq_dequeue(evi_queue_t *q, int queue_id)
 {
-    eviq_pnt_t slot, new_head;
+    eviq_list_t *list;
+    eviq_pnt_t slot;
 
     if (unlikely(q->queues == 0))
         return EVIQ_NONE;
 
+    list = &q->lists[queue_id];
+
     /* remove slot at the head of the queue */
-    slot = q->head[queue_id];
+    slot = list->head;
     /* no slot to remove */
     if (unlikely(slot == EVIQ_NONE)) {
         return EVIQ_NONE;
     }
 
-    new_head = q->next[slot];
+    list->head = q->next[slot];
 
-    if (new_head == EVIQ_NONE) {
+    if (list->head == EVIQ_NONE) {
         /* if the queue is empty, we need update also the tail */
-        q->tail[queue_id] = EVIQ_NONE;
+        list->tail = EVIQ_NONE;
     }
 
-    q->head[queue_id] = q->next[slot];
+    list->count--;
 
     return slot;
 }
 
+/*!
+ * \brief Remove up to n elements at the head from the specified queue
+ *
+ * \param q             EVI queue status pointer
+ * \param queue_id      Queue identifier
+ * \param slots         Array filled with the slots removed (in order)
+ * \param n             Max number of slots to remove
+ *
+ * \return number of slots removed
+ */
+inline static int
+eviq_dequeue_n(evi_queue_t *q, int queue_id, eviq_pnt_t *slots, int n)
+{
+    eviq_list_t *list;
+    eviq_pnt_t slot;
+    int i;
+
+    if (unlikely(q->queues == 0))
+        return 0;
+
+    list = &q->lists[queue_id];
+    slot = list->head;
+
+    for (i = 0; i < n && slot != EVIQ_NONE; i++) {
+        slots[i] = slot;
+        slot = q->next[slot];
+    }
+
+    list->head = slot;
+    if (slot == EVIQ_NONE)
+        list->tail = EVIQ_NONE;
+    list->count -= i;
+
+    return i;
+}
+
 #ifdef EVIQ_DEBUG
 static void
 _eviq_print_queue(evi_queue_t *q, eviq_pnt_t slot)
@@ -262,19 +458,20 @@ _eviq_print_queue(evi_queue_t *q, eviq_pnt_t slot)
 static void
 eviq_print_queue(evi_queue_t *q, int queue_id)
 {
-    eviq_pnt_t slot = q->head[queue_id];
+    eviq_pnt_t slot = q->lists[queue_id].head;
 
-    EVI_PRINTF("queue[%d] - head: %d tail: %d\n", queue_id, q->head[queue_id],
-            q->tail[queue_id]);
+    EVI_PRINTF("queue[%d] - head: %d tail: %d count: %d hwm: %d\n",
+            queue_id, q->lists[queue_id].head, q->lists[queue_id].tail,
+            q->lists[queue_id].count, q->lists[queue_id].hwm);
     _eviq_print_queue(q, slot);
 }
 
 static void
 eviq_print_free(evi_queue_t *q)
 {
-    eviq_pnt_t slot = q->free;
+    eviq_pnt_t slot = q->free.head;
 
-    EVI_PRINTF("free - head: %d\n", q->free);
+    EVI_PRINTF("free - head: %d count: %d\n", q->free.head, q->free.count);
     _eviq_print_queue(q, slot);
 }
 #endif /* EVIQ_DEBUG */
@@ -0,0 +1,163 @@
+/*!
+ * \file evi_stack.h
+ *
+ * \version     v1.2
+ * \date        2016-11-14
+ *
+ * This file contains the EVI lock-free stack of free elements.
+ *
+ * The stack is a LIFO of indexes chained by the next array. The head stores
+ * the first index and a tag incremented at each update, so a pop that read
+ * a stale next (the head was popped and pushed again meanwhile) fails the
+ * compare and swap and retries (no ABA). Pop and push are a load and a
+ * compare and swap, and can be called concurrently from any context.
+ *
+ * Copyright (C) 2016, Evidence Srl.
+ * Terms of use are as specified in COPYING
+ */
+#ifndef EVI_STACK_h
+#define EVI_STACK_h
+
+#define EVIS_NONE       (-1)                    /*!< \brief none elements */
+
+#ifdef __KERNEL__
+#define EVIS_MALLOC(_1)         (kmalloc(_1, GFP_KERNEL))
+#define EVIS_FREE(_1)           (kfree(_1))
+#define EVIS_CACHE_ALIGNED      ____cacheline_aligned
+#define EVIS_READ(_p)           READ_ONCE(*(_p))
+#define EVIS_WRITE(_p, _v)      WRITE_ONCE(*(_p), (_v))
+#define EVIS_CAS(_p, _o, _n)    (cmpxchg64((_p), (_o), (_n)) == (_o))
+#else /* !__KERNEL__ */
+#define EVIS_MALLOC(_1)         (malloc(_1))
+#define EVIS_FREE(_1)           (free(_1))
+#define EVIS_CACHE_ALIGNED      __attribute__((aligned(64)))
+#define EVIS_READ(_p)           __atomic_load_n((_p), __ATOMIC_ACQUIRE)
+#define EVIS_WRITE(_p, _v)      __atomic_store_n((_p), (_v), __ATOMIC_RELAXED)
+#define EVIS_CAS(_p, _o, _n)    __sync_bool_compare_and_swap((_p), (_o), (_n))
+#endif /* __KERNEL__ */
+
+/*! \brief Index of the first element stored in the head */
+#define EVIS_INDEX(_head)       ((int32_t)(uint32_t)(_head))
+/*! \brief Tag stored in the head */
+#define EVIS_TAG(_head)         ((uint32_t)((_head) >> 32))
+
+/*! \brief EVI stack status */
+typedef struct evi_stack {
+    int elems;                  /*!< \brief number of elements */
+    int32_t *next;              /*!< \brief array to chain the elements */
+
+    uint64_t head EVIS_CACHE_ALIGNED; /*!< \brief tag (32 MSB) and index of
+                                                  the first element (32 LSB) */
+} evi_stack_t;
+
+inline static uint64_t
+evis_head(int32_t index, uint32_t tag)
+{
+    return ((uint64_t)tag << 32) | (uint32_t)index;
+}
+
+/*!
+ * \brief Release the resorces for the EVI stack status
+ *
+ * \param s             EVI stack status pointer
+ */
+inline static void
+evis_release(evi_stack_t *s)
+{
+    if (s->next)
+        EVIS_FREE(s->next);
+
+    s->next = NULL;
+}
+
+/*!
+ * \brief Init the EVI stack status with all the elements free
+ *
+ * \param s             EVI stack status pointer
+ * \param elems         Number of elements
+ *
+ * \return 0 on success, otherwise -1
+ */
+inline static int
+evis_init(evi_stack_t *s, int elems)
+{
+    int i;
+
+    s->elems = elems;
+    s->head = evis_head(EVIS_NONE, 0);
+
+    s->next = EVIS_MALLOC(elems * sizeof(*(s->next)));
+    if (s->next == NULL)
+        return -1;
+
+    for (i = 0; i < elems; i++) {
+        s->next[i] = (i == elems - 1) ? EVIS_NONE : i + 1;
+    }
+
+    if (elems > 0)
+        s->head = evis_head(0, 0);
+
+    return 0;
+}
+
+/*!
+ * \brief Chek if there are free elements in the stack
+ *
+ * \param s             EVI stack status pointer
+ *
+ * \return 0 if there are not elements, otherwise an integer != 0
+ */
+inline static int
+evis_avail(evi_stack_t *s)
+{
+    return (EVIS_INDEX(EVIS_READ(&s->head)) != EVIS_NONE);
+}
+
+/*!
+ * \brief Pop one element from the stack
+ *
+ * \param s             EVI stack status pointer
+ *
+ * \return element removed on success, otherwise EVIS_NONE
+ */
+inline static int32_t
+evis_pop(evi_stack_t *s)
+{
+    uint64_t old, new;
+    int32_t slot;
+
+    do {
+        old = EVIS_READ(&s->head);
+        slot = EVIS_INDEX(old);
+        if (slot == EVIS_NONE)
+            return EVIS_NONE;
+
+        new = evis_head(EVIS_READ(&s->next[slot]), EVIS_TAG(old) + 1);
+    } while (!EVIS_CAS(&s->head, old, new));
+
+    return slot;
+}
+
+/*!
+ * \brief Push one element in the stack
+ *
+ * \param s             EVI stack status pointer
+ * \param slot          Element to insert
+ *
+ * \return 1 if the stack was empty, otherwise 0
+ */
+inline static int
+evis_push(evi_stack_t *s, int32_t slot)
+{
+    uint64_t old, new;
+
+    do {
+        old = EVIS_READ(&s->head);
+        EVIS_WRITE(&s->next[slot], EVIS_INDEX(old));
+        new = evis_head(slot, EVIS_TAG(old) + 1);
+    } while (!EVIS_CAS(&s->head, old, new));
+
+    return (EVIS_INDEX(old) == EVIS_NONE);
+}
+
+#endif /* EVI_STACK_h */